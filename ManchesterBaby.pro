@@ -4,6 +4,7 @@ greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
 TARGET = ManchesterBaby
 TEMPLATE = app
+CONFIG += c++17
 
 # The following define makes your compiler emit warnings if you use
 # any feature of Qt which has been marked as deprecated (the exact warnings
@@ -20,10 +21,40 @@ DEFINES += QT_DEPRECATED_WARNINGS
 SOURCES += \
         main.cpp \
         widget.cpp \
+        dashboard.cpp \
         baby.cpp \
-        assembler.cpp
+        shadow.cpp \
+        assembler.cpp \
+        loopaccel.cpp \
+        fusion.cpp \
+        analysis.cpp \
+        stepbound.cpp \
+        clock.cpp \
+        events.cpp \
+        devices.cpp \
+        peephole.cpp \
+        asmcache.cpp \
+        startup.cpp
 
 HEADERS += \
         widget.h \
+        dashboard.h \
         baby.h \
-        assembler.h
+        shadow.h \
+        assembler.h \
+        probes.h \
+        loopaccel.h \
+        fusion.h \
+        analysis.h \
+        stepbound.h \
+        clock.h \
+        events.h \
+        devices.h \
+        peephole.h \
+        asmcache.h \
+        constasm.h \
+        startup.h \
+        isa.h \
+        memtrace.h \
+        word.h \
+        widebaby.h
@@ -0,0 +1,179 @@
+#include "analysis.h"
+
+// Analyse an image, as loaded into the store
+ImageAnalysis::ImageAnalysis(const std::vector<std::bitset<SIZE_32_BIT>> &image) : image(image) {
+    if (this->image.size() < SIZE_32_BIT) {
+        this->image.resize(SIZE_32_BIT);
+    }
+    written.assign(this->image.size(), false);
+    // Stores found can make more jumps computed, which can make more code reachable: repeat until stable
+    do {
+        findCode();
+    } while (findStores());
+
+    for (StoreSite &site: storeSites) {
+        site.targetsCode = !site.constantTarget || isCode(site.target);
+        selfModifying = selfModifying || site.targetsCode;
+    }
+}
+
+// Whether the address can be fetched as an instruction
+bool ImageAnalysis::isCode(unsigned long address) const {
+    return address < code.size() && code[address];
+}
+
+// Whether the cell can only ever be used as data: never reachable as code
+bool ImageAnalysis::isPureData(unsigned long address) const {
+    return !isCode(address);
+}
+
+// Whether the cell can be written by a reachable STO
+bool ImageAnalysis::isWritten(unsigned long address) const {
+    return writesAnywhere || (address < written.size() && written[address]);
+}
+
+// Whether the program can modify its own code
+bool ImageAnalysis::isSelfModifying() const {
+    return selfModifying;
+}
+
+// Whether a jump at the end of a loop goes backwards (only then can loop acceleration help)
+bool ImageAnalysis::hasBackwardJumps() const {
+    return backwardJumps;
+}
+
+// Whether reachability had to assume any address can run
+bool ImageAnalysis::isImprecise() const {
+    return imprecise;
+}
+
+// Reachable STO instructions
+const std::vector<ImageAnalysis::StoreSite> &ImageAnalysis::stores() const {
+    return storeSites;
+}
+
+// Human-readable warnings about self-modification and imprecision, one per line
+std::vector<std::string> ImageAnalysis::report() const {
+    std::vector<std::string> lines;
+    for (const StoreSite &site: storeSites) {
+        if (!site.constantTarget) {
+            lines.push_back("Warning: STO at address " + std::to_string(site.address) +
+                            " can be rewritten at run time, so it may write anywhere");
+        } else if (site.targetsCode) {
+            lines.push_back("Warning: STO at address " + std::to_string(site.address) +
+                            " writes into the instruction at address " + std::to_string(site.target) +
+                            " (self-modifying code)");
+        }
+    }
+    for (const std::string &note: notes) {
+        lines.push_back("Warning: " + note);
+    }
+    return lines;
+}
+
+// One round of reachability, using the current set of written cells
+void ImageAnalysis::findCode() {
+    code.assign(image.size(), false);
+    notes.clear();
+    imprecise = false;
+    backwardJumps = false;
+
+    std::vector<int> pending{0};
+    std::vector<int> next;
+    code[0] = true;
+    while (!pending.empty()) {
+        int address = pending.back();
+        pending.pop_back();
+        next.clear();
+        if (!successors(address, next)) {
+            // Anything can run from here on
+            imprecise = true;
+            for (int i = 0; i < SIZE_32_BIT; ++i) {
+                code[i] = true;
+            }
+            backwardJumps = true;
+            return;
+        }
+        for (int target: next) {
+            if (!code[target]) {
+                code[target] = true;
+                pending.push_back(target);
+            }
+        }
+    }
+}
+
+// Cells written by the reachable STOs. Returns whether anything changed.
+bool ImageAnalysis::findStores() {
+    bool changed = false;
+    storeSites.clear();
+    for (int address = 0; address < SIZE_32_BIT; ++address) {
+        if (!code[address]) {
+            continue;
+        }
+        ManchesterBaby::Instruction ins = ManchesterBaby::decodeInstruction(image[address]);
+        // XCH and XAD write their operand too
+        if (ins.opcode != STO && ins.opcode != XCH && ins.opcode != XAD) {
+            continue;
+        }
+        bool constantTarget = !isWritten(address);
+        storeSites.push_back({address, ins.operand, constantTarget, false});
+        if (!constantTarget) {
+            changed = changed || !writesAnywhere;
+            writesAnywhere = true;
+        } else if (ins.operand < written.size() && !written[ins.operand]) {
+            written[ins.operand] = true;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+// Successors of the instruction at address, or false if they can't be known
+bool ImageAnalysis::successors(int address, std::vector<int> &next) {
+    const std::string at = " at address " + std::to_string(address);
+    if (isWritten(address)) {
+        notes.push_back("Instruction" + at + " can be rewritten at run time");
+        return false;
+    }
+    ManchesterBaby::Instruction ins = ManchesterBaby::decodeInstruction(image[address]);
+    long target = (long) ins.operand;
+    switch (ins.opcode) {
+        case JMP:
+        case JRP:
+            if (!ins.immediate) {
+                if (ins.operand >= image.size()) {
+                    notes.push_back("Jump" + at + " reads past the end of the store");
+                    return false;
+                }
+                if (isWritten(ins.operand)) {
+                    notes.push_back("Jump" + at + " goes through cell " + std::to_string(ins.operand) +
+                                    ", which is written at run time");
+                    return false;
+                }
+                target = (int) ManchesterBaby::convertInstruction(image[ins.operand]);
+            }
+            // Same arithmetic as jmp()/jrp() followed by increment_ci()
+            target = ((ins.opcode == JRP ? address : 0) + (int) target + 1) % SIZE_32_BIT;
+            if (target < 0) {
+                notes.push_back("Jump" + at + " leaves the store");
+                return false;
+            }
+            backwardJumps = backwardJumps || target <= address;
+            next.push_back((int) target);
+            return true;
+        case CMP:
+            next.push_back((address + 1) % SIZE_32_BIT);
+            next.push_back((address + 2) % SIZE_32_BIT);
+            return true;
+        case STP:
+            return true;
+        default:
+            // Unknown opcodes halt the machine
+            if (ins.opcode > XAD) {
+                return true;
+            }
+            next.push_back((address + 1) % SIZE_32_BIT);
+            return true;
+    }
+}
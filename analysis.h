@@ -0,0 +1,75 @@
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+
+#include <bitset>
+#include <string>
+#include <vector>
+
+#include "baby.h"
+
+// Load-time analysis of a machine image: which addresses can run as code, which STO instructions can write into
+// code, and which cells are pure data.
+//
+// Reachability starts at address 0, where the first instruction is fetched, and follows every successor an
+// instruction can have: the next address, both sides of a CMP, and JMP/JRP targets. Jumps through a cell that no
+// STO writes have a known target; jumps through a written cell, and instructions that are themselves written,
+// make every address reachable, and the result is then marked imprecise. STO operands are constants in the
+// instruction word, so a store has a known target unless the STO itself can be rewritten.
+class ImageAnalysis {
+public:
+    // A reachable STO instruction (or XCH or XAD, which store too)
+    struct StoreSite {
+        int address;                // Where the STO is
+        unsigned long target;       // Its operand as loaded
+        bool constantTarget;        // False if the STO can itself be rewritten, so the target isn't known
+        bool targetsCode;           // Whether it can write a reachable instruction
+    };
+
+    explicit ImageAnalysis(const std::vector<std::bitset<SIZE_32_BIT>> &image);
+
+    // Whether the address can be fetched as an instruction
+    [[nodiscard]] bool isCode(unsigned long address) const;
+
+    // Whether the cell can only ever be used as data: never reachable as code
+    [[nodiscard]] bool isPureData(unsigned long address) const;
+
+    // Whether the cell can be written by a reachable STO
+    [[nodiscard]] bool isWritten(unsigned long address) const;
+
+    // Whether the program can modify its own code
+    [[nodiscard]] bool isSelfModifying() const;
+
+    // Whether a jump at the end of a loop goes backwards (only then can loop acceleration help)
+    [[nodiscard]] bool hasBackwardJumps() const;
+
+    // Whether reachability had to assume any address can run
+    [[nodiscard]] bool isImprecise() const;
+
+    // Reachable STO instructions
+    [[nodiscard]] const std::vector<StoreSite> &stores() const;
+
+    // Human-readable warnings about self-modification and imprecision, one per line
+    [[nodiscard]] std::vector<std::string> report() const;
+
+private:
+    std::vector<std::bitset<SIZE_32_BIT>> image;
+    std::vector<bool> code;             // Reachable as code
+    std::vector<bool> written;          // Possible STO targets
+    std::vector<StoreSite> storeSites;
+    std::vector<std::string> notes;     // Reasons for imprecision
+    bool selfModifying{false};
+    bool backwardJumps{false};
+    bool imprecise{false};
+    bool writesAnywhere{false};         // A STO with an unknown target exists
+
+    // One round of reachability, using the current set of written cells
+    void findCode();
+
+    // Cells written by the reachable STOs. Returns whether anything changed.
+    bool findStores();
+
+    // Successors of the instruction at address, or false if they can't be known
+    bool successors(int address, std::vector<int> &next);
+};
+
+#endif //ANALYSIS_H
@@ -0,0 +1,90 @@
+#include <cerrno>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "asmcache.h"
+#include "assembler.h"
+
+AssemblyCache::AssemblyCache(std::string directory) : directory(std::move(directory)) {}
+
+// Key of a source assembled by this assembler, with or without the peephole pass
+uint64_t AssemblyCache::key(const std::string &source, bool optimize) {
+    // FNV-1a over the version, the options and the text, each ended by a zero byte
+    uint64_t hash = 14695981039346656037ULL;
+    auto mix = [&hash](const std::string &text) {
+        for (unsigned char c: text) {
+            hash = (hash ^ c) * 1099511628211ULL;
+        }
+        hash = (hash ^ 0) * 1099511628211ULL;
+    };
+    mix(Assembler::VERSION);
+    mix(optimize ? "optimize" : "");
+    mix(source);
+    return hash;
+}
+
+std::string AssemblyCache::entryPath(uint64_t key, const char *extension) const {
+    char name[17];
+    snprintf(name, sizeof(name), "%016llx", (unsigned long long) key);
+    return directory + "/" + name + extension;
+}
+
+// Function to read a whole file
+bool readFile(const std::string &path, std::string &contents) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    contents = buffer.str();
+    return true;
+}
+
+// Function to write a whole file through a temporary one, so that readers see the old contents or the new
+static bool writeFile(const std::string &path, const std::string &contents) {
+    const std::string temporary = path + ".tmp" + std::to_string(getpid());
+    std::ofstream file(temporary, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    file << contents;
+    file.close();
+    if (!file || std::rename(temporary.c_str(), path.c_str()) != 0) {
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Function to write the machine code and log cached under key to output.txt and log.txt
+bool AssemblyCache::restore(uint64_t key) const {
+    std::string machineCode;
+    std::string log;
+    if (!readFile(entryPath(key, ".out"), machineCode) || !readFile(entryPath(key, ".log"), log)) {
+        return false;
+    }
+    time_t now = time(nullptr);
+    std::string stamp = ctime(&now);
+    stamp.pop_back();
+    log += "\n[" + stamp + "] Restored from the assembly cache: " + entryPath(key, ".out") + "\n";
+    return writeFile("output.txt", machineCode) && writeFile("log.txt", log);
+}
+
+// Function to file output.txt and log.txt under key
+bool AssemblyCache::save(uint64_t key) const {
+    std::string machineCode;
+    std::string log;
+    if (!readFile("output.txt", machineCode) || !readFile("log.txt", log)) {
+        return false;
+    }
+    if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+        return false;
+    }
+    // The log goes in first, so an entry whose machine code is there is complete
+    return writeFile(entryPath(key, ".log"), log) && writeFile(entryPath(key, ".out"), machineCode);
+}
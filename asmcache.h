@@ -0,0 +1,37 @@
+#ifndef ASMCACHE_H
+#define ASMCACHE_H
+
+#include <cstdint>
+#include <string>
+
+// Content-addressed cache of assembled programs.
+//
+// An entry is the machine code and the log that Assembler::assemble wrote for a source, filed under a 64-bit FNV-1a
+// hash of the source text, the assembler version and the options. A source that has been assembled before, by the
+// same assembler with the same options, is restored from the cache instead of being assembled again; any change to
+// the text or a new Assembler::VERSION gives a new key. Entries are written to a temporary file and renamed into
+// place, so programs sharing a cache never read half an entry. The directory can be deleted at any time.
+class AssemblyCache {
+public:
+    explicit AssemblyCache(std::string directory = ".babycache");
+
+    // Key of a source assembled by this assembler, with or without the peephole pass
+    static uint64_t key(const std::string &source, bool optimize);
+
+    // Function to write the machine code and log cached under key to output.txt and log.txt. Returns false, touching
+    // nothing, if there is no such entry.
+    bool restore(uint64_t key) const;
+
+    // Function to file output.txt and log.txt under key. Returns false if they could not be written.
+    bool save(uint64_t key) const;
+
+private:
+    std::string directory;
+
+    [[nodiscard]] std::string entryPath(uint64_t key, const char *extension) const;
+};
+
+// Function to read a whole file. Returns false if it cannot be opened.
+bool readFile(const std::string &path, std::string &contents);
+
+#endif //ASMCACHE_H
@@ -4,6 +4,12 @@
 #include<ctime>
 
 #include "assembler.h"
+#include "analysis.h"
+#include "stepbound.h"
+#include "devices.h"
+#include "isa.h"
+#include "peephole.h"
+#include "probes.h"
 
 using namespace std;
 
@@ -27,141 +33,50 @@ string substr(string str, int start, int end) {
     return s;
 }
 
-// Function to translate an assembly instruction into a machine code representation
-string translateInstruction(const string &instruction, int address, int addressingMode) {
-    string s = "00000000000000000000000000000000";// Initialize a string with 32 bits, initially filled with zeros
-    int temp = 0;// Temporary variable to track bit position while converting address to binary
-    int flag = address >= 0 ? 1 : 0;
-    address = flag ? address : -address;
-
-    // Convert the address to binary and update the corresponding bits in the string
-    while (address) {
-        if (address % 2)s[temp] = '1';
-        address /= 2;
-        ++temp;
-    }
+// Function to translate an assembly instruction into a machine code representation, for a word layout
+template<class Layout>
+string translateInstruction(const string &instruction, long long address, int addressingMode) {
+    using Value = typename Layout::Value;
+    Value value;
     if (instruction == "VAR") {
-        if (!flag) {
-            for (int i = 0; i < 32; ++i) {
-                if (s[i] == '0')s[i] = '1';
-                else s[i] = '0';
-            }
-            s[0] += 1;
-            for (int i = 0; i < 31; ++i) {
-                if (s[i] == '2') {
-                    s[i] = '0';
-                    s[i + 1] += 1;
-                } else break;
-            }
-            if (s[31] == '2')
-                s[31] = '0';
-        }
-        return s;
+        value = (Value) address;    // Negative numbers in two's complement
+    } else {
+        // The operand (its magnitude if negative), then the opcode bits and the addressing mode bit
+        value = (Value) (address >= 0 ? address : -address);
+        value |= (Value) Assembler::getOpCode(instruction) << Layout::opcodeShift;
+        value = (value & ~Layout::immediateMask) | ((Value) addressingMode << Layout::immediateBit);
     }
-    int value = Assembler::getOpCode(instruction);// Get the opcode value from the instruction
-    temp = 13;// Reset the temporary variable for updating bits in the string
-    // Convert the opcode value to binary and update the corresponding bits in the string
-    while (value) {
-        if (value % 2)s[temp] = '1';
-        value /= 2;
-        ++temp;
+
+    // Machine code is written least significant bit first
+    string s(Layout::bits, '0');
+    for (int i = 0; i < Layout::bits; ++i) {
+        if ((value >> i) & 1U) {
+            s[i] = '1';
+        }
     }
-    // Update the addressing mode bit (bit 30) if the instruction is not "VAR"
-    s[30] = (char) (addressingMode + '0');
     return s;
 }
 
+template string translateInstruction<Layout32>(const string &instruction, long long address, int addressingMode);
+
+template string translateInstruction<Layout64>(const string &instruction, long long address, int addressingMode);
+
 // Function to perform the assembly process, taking a SymbolTable and logging the process
-void Assembler::assemble(const SymbolTable &table) {
+bool Assembler::assemble(const SymbolTable &table, bool optimize) {
     vector <string> binaryCode;// Vector to store binary code generated during assembly
     vector <string> log;// Vector to store log messages during assembly
     time_t now = time(nullptr);// Get the current time
+    BABY_PROBE0(baby, asm_start);
     // Add a compilation start message to the log
     log.push_back("[" + ((string) ctime(&now)).substr(0, ((string) ctime(&now)).length() - 1) +
                   "] Compilation Start: assemble.txt");
     // Attempt to process the assembly code and generate binary code
     try {
-        binaryCode = Assembler::processAssembleCode(table, log);
+        binaryCode = Assembler::processAssembleCode(table, log, optimize);
     }
     catch (const std::invalid_argument &e) {
         // Handle exceptions related to assembly errors
-        string s = e.what();
-        // Extract error code from the exception message
-        int errorCode = 0;
-        for (int i = 0; i < 3; ++i) {
-            errorCode = errorCode * 10 + s[i] - '0';
-        }
-        // Extract error line number from the exception message
-        int errorLine = 0;
-        for (int i = 5; i > 2; --i) {
-            errorLine = errorLine * 10 + s[i] - '0';
-        }
-        switch (errorCode) {
-            case 100:
-                // Label definition error (already defined elsewhere)
-                log.emplace_back("");
-                log.emplace_back("[" + ((string) ctime(&now)).substr(0, ((string) ctime(&now)).length() - 1) +
-                                 "] Error: Label '" + substr(s, 6, s.length()) + "' definition error");
-                log.emplace_back("- File: assemble.txt");
-                log.emplace_back("- Line number: " + std::to_string(errorLine));
-                log.emplace_back("- Description: Label '" + substr(s, 6, s.length()) + "' is defined more than once");
-                log.emplace_back("- Suggestion: Check whether the label name is spelled correctly");
-                break;
-            case 101:
-                // Label definition error (not defined)
-                log.emplace_back("");
-                log.emplace_back("[" + ((string) ctime(&now)).substr(0, ((string) ctime(&now)).length() - 1) +
-                                 "] Error: Label '" + substr(s, 6, s.length()) + "' definition error");
-                log.emplace_back("- File: assemble.txt");
-                log.emplace_back("- Line number: " + std::to_string(errorLine));
-                log.emplace_back("- Description: Label '" + substr(s, 6, s.length()) + "' is not defined");
-                log.emplace_back(
-                        "- Suggestion: Check whether the operand name in the instruction is spelled correctly");
-                break;
-            case 102:
-                // Error when a value is not a signed 32-bit integer
-                log.emplace_back("");
-                log.emplace_back(
-                        "[" + ((string) ctime(&now)).substr(0, ((string) ctime(&now)).length() - 1) + "] Error: '" +
-                        substr(s, 6, s.length()) + "' is not a value");
-                log.emplace_back("- File: assemble.txt");
-                log.emplace_back("- Line number: " + std::to_string(errorLine));
-                log.emplace_back(
-                        "- Description: '" + substr(s, 6, s.length()) + "' should be a signed 32-bit integer but not");
-                log.emplace_back("- Suggestion: Check whether the value is entered correctly");
-                break;
-            case 103:
-                // Error when an instruction is not in the instruction set
-                log.emplace_back("");
-                log.emplace_back("[" + ((string) ctime(&now)).substr(0, ((string) ctime(&now)).length() - 1) +
-                                 "] Error: Instruction '" + substr(s, 6, s.length()) + "' not exist");
-                log.emplace_back("- File: assemble.txt");
-                log.emplace_back("- Line number: " + std::to_string(errorLine));
-                log.emplace_back(
-                        "- Description: Instruction '" + substr(s, 6, s.length()) + "' is not in the instruction set");
-                log.emplace_back("- Suggestion: Check whether the instruction is spelled correctly");
-                break;
-            case 104:
-                // Error when a label can't support immediate addressing
-                log.emplace_back("");
-                log.emplace_back("[" + ((string) ctime(&now)).substr(0, ((string) ctime(&now)).length() - 1) +
-                                 "] Error: Wrong addressing way");
-                log.emplace_back("- File: assemble.txt");
-                log.emplace_back("- Line number: " + std::to_string(errorLine));
-                log.emplace_back(
-                        "- Description: Label '" + substr(s, 6, s.length()) + "' can't support immediate addressing");
-                log.emplace_back("- Suggestion: Check whether the instruction is spelled correctly");
-                break;
-            default:
-                // Handle any other unknown assembly error
-                log.emplace_back("");
-                log.emplace_back("[" + ((string) ctime(&now)).substr(0, ((string) ctime(&now)).length() - 1) +
-                                 "] Error: Unexpected error");
-                log.emplace_back("- File: assemble.txt");
-                log.emplace_back("- Description: Unknown assembly error occurred");
-                log.emplace_back("- Error: " + s);
-                break;
-        }
+        Assembler::logError(e, log);
     }
     // Log generation for the code generation phase
     log.emplace_back("");
@@ -173,32 +88,150 @@ void Assembler::assemble(const SymbolTable &table) {
     else {
         // Export binary code to a file
         Assembler::exportToFile(binaryCode);
+        BABY_PROBE1(baby, asm_codegen, binaryCode.size());
         log.emplace_back("- Code generating completion time: " +
                          ((string) ctime(&now)).substr(0, ((string) ctime(&now)).length() - 1));
+        // Report code that modifies itself, which keeps the simulator off its fastest modes
+        vector <std::bitset<SIZE_32_BIT>> image;
+        for (const string &line: binaryCode) {
+            image.emplace_back(line);
+        }
+        ImageAnalysis analysis(image);
+        log.emplace_back("");
+        log.emplace_back(
+                "[" + ((string) ctime(&now)).substr(0, ((string) ctime(&now)).length() - 1) + "] Phase: Analysis");
+        for (const string &warning: analysis.report()) {
+            log.emplace_back("- " + warning);
+        }
+        if (!analysis.isSelfModifying()) {
+            log.emplace_back("- The program never modifies its own code");
+        }
+        // How long the program can run, worked out without running it
+        for (const string &line: StepBoundAnalysis(image).report()) {
+            log.emplace_back("- " + line);
+        }
     }
     // Additional log entries for compiler configuration
     log.emplace_back("");
     log.emplace_back("Compiler Configuration:");
     log.emplace_back("- Assembler name: Assembler baby");
-    log.emplace_back("- Assembler version: v1.0");
+    log.emplace_back(string("- Assembler version: ") + Assembler::VERSION);
     log.emplace_back("");
     log.emplace_back("[" + ((string) ctime(&now)).substr(0, ((string) ctime(&now)).length() - 1) + "] Compilation end");
     // Export the final log
     Assembler::exportToLog(log);
+    BABY_PROBE1(baby, asm_done, binaryCode.size());
+    return !binaryCode.empty();
+}
+
+// Function to log an assembly error thrown by processAssembleCode
+void Assembler::logError(const std::invalid_argument &error, vector <string> &log) {
+    time_t now = time(nullptr);
+    string s = error.what();
+    // Extract error code from the exception message
+    int errorCode = 0;
+    for (int i = 0; i < 3; ++i) {
+        errorCode = errorCode * 10 + s[i] - '0';
+    }
+    // Extract error line number from the exception message
+    int errorLine = 0;
+    for (int i = 5; i > 2; --i) {
+        errorLine = errorLine * 10 + s[i] - '0';
+    }
+    switch (errorCode) {
+        case 100:
+            // Label definition error (already defined elsewhere)
+            log.emplace_back("");
+            log.emplace_back("[" + ((string) ctime(&now)).substr(0, ((string) ctime(&now)).length() - 1) +
+                             "] Error: Label '" + substr(s, 6, s.length()) + "' definition error");
+            log.emplace_back("- File: assemble.txt");
+            log.emplace_back("- Line number: " + std::to_string(errorLine));
+            log.emplace_back("- Description: Label '" + substr(s, 6, s.length()) + "' is defined more than once");
+            log.emplace_back("- Suggestion: Check whether the label name is spelled correctly");
+            break;
+        case 101:
+            // Label definition error (not defined)
+            log.emplace_back("");
+            log.emplace_back("[" + ((string) ctime(&now)).substr(0, ((string) ctime(&now)).length() - 1) +
+                             "] Error: Label '" + substr(s, 6, s.length()) + "' definition error");
+            log.emplace_back("- File: assemble.txt");
+            log.emplace_back("- Line number: " + std::to_string(errorLine));
+            log.emplace_back("- Description: Label '" + substr(s, 6, s.length()) + "' is not defined");
+            log.emplace_back(
+                    "- Suggestion: Check whether the operand name in the instruction is spelled correctly");
+            break;
+        case 102:
+            // Error when a value is not a signed 32-bit integer
+            log.emplace_back("");
+            log.emplace_back(
+                    "[" + ((string) ctime(&now)).substr(0, ((string) ctime(&now)).length() - 1) + "] Error: '" +
+                    substr(s, 6, s.length()) + "' is not a value");
+            log.emplace_back("- File: assemble.txt");
+            log.emplace_back("- Line number: " + std::to_string(errorLine));
+            log.emplace_back(
+                    "- Description: '" + substr(s, 6, s.length()) + "' should be a signed 32-bit integer but not");
+            log.emplace_back("- Suggestion: Check whether the value is entered correctly");
+            break;
+        case 103:
+            // Error when an instruction is not in the instruction set
+            log.emplace_back("");
+            log.emplace_back("[" + ((string) ctime(&now)).substr(0, ((string) ctime(&now)).length() - 1) +
+                             "] Error: Instruction '" + substr(s, 6, s.length()) + "' not exist");
+            log.emplace_back("- File: assemble.txt");
+            log.emplace_back("- Line number: " + std::to_string(errorLine));
+            log.emplace_back(
+                    "- Description: Instruction '" + substr(s, 6, s.length()) + "' is not in the instruction set");
+            log.emplace_back("- Suggestion: Check whether the instruction is spelled correctly");
+            break;
+        case 104:
+            // Error when a label can't support immediate addressing
+            log.emplace_back("");
+            log.emplace_back("[" + ((string) ctime(&now)).substr(0, ((string) ctime(&now)).length() - 1) +
+                             "] Error: Wrong addressing way");
+            log.emplace_back("- File: assemble.txt");
+            log.emplace_back("- Line number: " + std::to_string(errorLine));
+            log.emplace_back(
+                    "- Description: Label '" + substr(s, 6, s.length()) + "' can't support immediate addressing");
+            log.emplace_back("- Suggestion: Check whether the instruction is spelled correctly");
+            break;
+        default:
+            // Handle any other unknown assembly error
+            log.emplace_back("");
+            log.emplace_back("[" + ((string) ctime(&now)).substr(0, ((string) ctime(&now)).length() - 1) +
+                             "] Error: Unexpected error");
+            log.emplace_back("- File: assemble.txt");
+            log.emplace_back("- Description: Unknown assembly error occurred");
+            log.emplace_back("- Error: " + s);
+            break;
+    }
 }
 
 // Function to process the assemble language
-vector <string> Assembler::processAssembleCode(SymbolTable table, vector <string> &log) {
-    string line; // Each line of the file
-    vector <string> assembleCode;
-    vector <string> binaryCode;
-    int addr = 0; // Variables representing label line numbers
+vector <string> Assembler::processAssembleCode(SymbolTable table, vector <string> &log, bool optimize) {
     std::ifstream inputFile("assemble.txt");
     if (!inputFile.is_open()) {
         throw std::runtime_error("Failed to open file for writing.");
     }
     // Log file loading success
     log.emplace_back("- Load file successfully");
+    vector <string> binaryCode = processAssembleCode(table, inputFile, log, optimize);
+    inputFile.close();
+    return binaryCode;
+}
+
+// Function to process the assemble language read from a stream
+vector <string> Assembler::processAssembleCode(SymbolTable table, std::istream &inputFile, vector <string> &log,
+                                               bool optimize, SourceMap *sourceMap) {
+    string line; // Each line of the file
+    vector <string> assembleCode;
+    vector<int> lineNumbers; // Line in the file of each entry of assembleCode
+    int lineNumber = 0;
+    if (sourceMap != nullptr) {
+        sourceMap->clear();
+    }
+    vector <string> binaryCode;
+    vector<int> labelled; // Addresses of the labels, which the optimizer keeps in place
+    int addr = 0; // Variables representing label line numbers
     time_t now = time(nullptr);
     log.emplace_back("");
     log.emplace_back(
@@ -206,10 +239,14 @@ vector <string> Assembler::processAssembleCode(SymbolTable table, vector <string
     log.emplace_back("- Scan labels and except empty lines");
     // Process each line of the input file at the first time
     while (getline(inputFile, line)) {
+        lineNumber++;
+        // Drop the carriage return of files saved with Windows line endings
+        if (!line.empty() && line.back() == '\r') line.pop_back();
         // Skip empty lines and comments
         if (line.empty() || line[0] == ';')continue;
         // Add the line to the assembleCode vector
         assembleCode.push_back(line);
+        lineNumbers.push_back(lineNumber);
         // Check for label presence
         int colonPos = findChar(line, ':');
         if (colonPos != -1) {
@@ -227,13 +264,14 @@ vector <string> Assembler::processAssembleCode(SymbolTable table, vector <string
             // Log the addition of a label to the symbol table
             log.emplace_back("- Add label '" + label + "' to symbol table");
             table.addLabel(label, addr);
+            labelled.push_back(addr);
         }
         addr++;
     }
     // Log completion of preprocessing phase
     log.emplace_back("- Preprocessing completion time: " +
                      ((string) ctime(&now)).substr(0, ((string) ctime(&now)).length() - 1));
-    inputFile.close();
+    BABY_PROBE1(baby, asm_preprocess, assembleCode.size());
     addr = 0;
     log.emplace_back("");
     log.emplace_back("[" + ((string) ctime(&now)).substr(0, ((string) ctime(&now)).length() - 1) + "] Phase: Parsing");
@@ -271,12 +309,14 @@ vector <string> Assembler::processAssembleCode(SymbolTable table, vector <string
                 temps += opcodeString;
                 throw invalid_argument("103" + temps);
             }
-            // Check for special case where it is empty and opcode is not "CMP" or "STP" or "LNT" or "SHL" or "SHR"
+            // Check for special case where it is empty and the instruction takes no operand (CMP, STP, LNT, SHL, SHR)
             if (!((operandString == ";" || operandString.empty()) &&
-                  (opcodeString == "CMP" || opcodeString == "STP" || opcodeString == "LNT" || opcodeString == "SHL" ||
-                   opcodeString == "SHR"))) {
+                  INSTRUCTIONS[getOpCode(opcodeString)].operand == OperandUse::None)) {
                 if (operandString[0] != '#') {
-                    if (table.searchLabel(operandString) == -1) {
+                    // Device ports (see devices.h) are known by name unless a label takes it
+                    if (table.searchLabel(operandString) == -1 && deviceAddress(operandString) != -1) {
+                        address = deviceAddress(operandString);
+                    } else if (table.searchLabel(operandString) == -1) {
                         // Handle undefined label exception
                         string temps;
                         for (int ii = 0; ii < 3; ++ii) {
@@ -285,13 +325,12 @@ vector <string> Assembler::processAssembleCode(SymbolTable table, vector <string
                         }
                         temps += operandString;
                         throw invalid_argument("101" + temps);
+                    } else {
+                        address = table.searchLabel(operandString);
                     }
-                    address = table.searchLabel(operandString);
                 } else {
                     // Handle immediate addressing mode for certain opcodes
-                    if (opcodeString != "JMP" && opcodeString != "JRP" && opcodeString != "LDN" &&
-                        opcodeString != "SUB" && opcodeString != "LDP" && opcodeString != "ADD" &&
-                        opcodeString != "DIV" && opcodeString != "MOD") {
+                    if (!takesImmediate(getOpCode(opcodeString))) {
                         // Handle invalid immediate operand for this opcode exception
                         string temps;
                         for (int ii = 0; ii < 3; ++ii) {
@@ -354,54 +393,62 @@ vector <string> Assembler::processAssembleCode(SymbolTable table, vector <string
         binaryCode.push_back(BinaryCode);
         // Log the completion of assembling the current code line
         log.emplace_back("- Complete assembling code: " + BinaryCode);
+        // Remember where the word came from
+        if (sourceMap != nullptr) {
+            sourceMap->push_back({lineNumbers[addr], i, opcodeString == "VAR"});
+        }
         // Move to the next memory address
         addr++;
     }
+    BABY_PROBE1(baby, asm_parse, binaryCode.size());
     // Log the completion time of parsing
     log.emplace_back(
             "- Parsing completion time: " + ((string) ctime(&now)).substr(0, ((string) ctime(&now)).length() - 1));
+    if (optimize) {
+        const vector <string> original = binaryCode;
+        optimizeCode(binaryCode, labelled, log);
+        // Words may have moved, so the lines no longer match the addresses
+        if (sourceMap != nullptr && binaryCode != original) {
+            sourceMap->clear();
+        }
+    }
     return binaryCode;
 
 }
 
+// Function to run the peephole pass over generated code and log what it did
+void Assembler::optimizeCode(vector <string> &binaryCode, const vector<int> &labels, vector <string> &log) {
+    time_t now = time(nullptr);
+    log.emplace_back("");
+    log.emplace_back(
+            "[" + ((string) ctime(&now)).substr(0, ((string) ctime(&now)).length() - 1) + "] Phase: Optimization");
+    vector <std::bitset<SIZE_32_BIT>> image;
+    for (const string &line: binaryCode) {
+        image.emplace_back(line);
+    }
+    PeepholeReport report = optimizeImage(image, labels, true);
+    for (const string &note: report.notes) {
+        log.emplace_back("- " + note);
+    }
+    binaryCode.clear();
+    for (const auto &word: image) {
+        binaryCode.push_back(word.to_string());
+    }
+    log.emplace_back("- " + to_string(report.removed) + " instructions removed, " + to_string(report.rewritten) +
+                     " rewritten, " + to_string(report.stepsSaved) +
+                     (report.measured ? " steps saved in a run to the halt" : " steps saved per pass through them"));
+}
+
 // Function to get the opcode corresponding to the instruction
 int Assembler::getOpCode(const std::string &instruction) {
-    if (instruction == "JMP")
-        return Assembler::JMP;
-    else if (instruction == "JRP")
-        return Assembler::JRP;
-    else if (instruction == "CMP")
-        return Assembler::CMP;
-    else if (instruction == "LDN")
-        return Assembler::LDN;
-    else if (instruction == "SUB")
-        return Assembler::SUB;
-    else if (instruction == "STO")
-        return Assembler::STO;
-    else if (instruction == "STP")
-        return Assembler::STP;
-    else if (instruction == "VAR")
-        return Assembler::VAR;
-    else if (instruction == "LDP")
-        return Assembler::LDP;
-    else if (instruction == "ADD")
-        return Assembler::ADD;
-    else if (instruction == "DIV")
-        return Assembler::DIV;
-    else if (instruction == "MOD")
-        return Assembler::MOD;
-    else if (instruction == "LAN")
-        return Assembler::LAN;
-    else if (instruction == "LOR")
-        return Assembler::LOR;
-    else if (instruction == "LNT")
-        return Assembler::LNT;
-    else if (instruction == "SHL")
-        return Assembler::SHL;
-    else if (instruction == "SHR")
-        return Assembler::SHR;
-    else
+    if (instruction == "VAR") {
+        return 0;
+    }
+    const int opcode = opcodeOf(instruction);
+    if (opcode < 0) {
         throw std::runtime_error("Invalid enum value");
+    }
+    return opcode;
 }
 
 // Function to export binary code to a file
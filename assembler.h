@@ -8,6 +8,9 @@
 #include <cstdio>
 #include <cstring>
 #include <map>
+#include <stdexcept>
+
+#include "word.h"
 
 // Class for symbol table
 class SymbolTable {
@@ -26,45 +29,62 @@ public:
     int searchLabel(const std::string &label);
 };
 
+// Where a word of an assembled program comes from
+struct SourceLine {
+    int line;               // Line number in the source, from 1
+    std::string text;       // The line as written
+    bool data;              // Whether it is a VAR rather than an instruction
+};
+
+// Source line of every word of an assembled program, by address
+using SourceMap = std::vector<SourceLine>;
+
+// Function to translate an assembly instruction into a machine code representation, for a word layout (see word.h).
+// Defined for Layout32, the default, and Layout64.
+template<class Layout = Layout32>
+std::string translateInstruction(const std::string &instruction, long long address, int addressingMode);
+
 // Class for assembler
 class Assembler {
 private:
 
 public:
 
-    static const int VAR = 0;
-    static const int JMP = 0;
-    static const int JRP = 1;
-    static const int LDN = 2;
-    static const int STO = 3;
-    static const int SUB = 4;
-    static const int CMP = 6;
-    static const int STP = 7;
-    static const int LDP = 8;
-    static const int ADD = 9;
-    static const int DIV = 10;
-    static const int MOD = 11;
-    static const int LAN = 12;
-    static const int LOR = 13;
-    static const int LNT = 14;
-    static const int SHL = 15;
-    static const int SHR = 16;
+    // Version of the assembler, part of the key of every cached assembly (see asmcache.h): raise it whenever the
+    // same source would assemble differently
+    static constexpr const char *VERSION = "v1.1";
 
     // Constructor & Destructor
     Assembler();
 
     ~Assembler();
 
-    // Function to perform the assembly process, taking a SymbolTable and logging the process
-    static void assemble(const SymbolTable &table);
+    // Function to perform the assembly process, taking a SymbolTable and logging the process. With optimize, the
+    // generated code goes through the peephole pass (see peephole.h). Returns whether code was generated.
+    static bool assemble(const SymbolTable &table, bool optimize = false);
 
     // Function to process the assemble language
-    static std::vector<std::string> processAssembleCode(SymbolTable table, std::vector<std::string> &log);
+    static std::vector<std::string> processAssembleCode(SymbolTable table, std::vector<std::string> &log,
+                                                        bool optimize = false);
+
+    // Function to process the assemble language read from a stream. Given a sourceMap, fills it with the source line
+    // of every word; it is left empty if the peephole pass changed the code.
+    static std::vector<std::string> processAssembleCode(SymbolTable table, std::istream &input,
+                                                        std::vector<std::string> &log, bool optimize = false,
+                                                        SourceMap *sourceMap = nullptr);
+
+    // Function to log an assembly error thrown by processAssembleCode, as assemble() writes it to the log file
+    static void logError(const std::invalid_argument &error, std::vector<std::string> &log);
+
+    // Function to run the peephole pass over generated code, given the labelled addresses, and log what it did
+    static void optimizeCode(std::vector<std::string> &binaryCode, const std::vector<int> &labels,
+                             std::vector<std::string> &log);
 
     // Function to export binary code to a file
     static void exportToFile(const std::vector<std::string> &binaryCode);
 
-    // Function to get the opcode corresponding to the instruction
+    // Function to get the opcode corresponding to the instruction, from the instruction table (see isa.h). VAR gives
+    // 0; anything else unknown throws std::runtime_error.
     static int getOpCode(const std::string &instruction);
 
     // Function to export log messages to a file
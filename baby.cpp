@@ -1,4 +1,7 @@
 #include "baby.h"
+#include "analysis.h"
+#include "probes.h"
+#include "shadow.h"
 
 // Constructor
 ManchesterBaby::ManchesterBaby() {
@@ -8,65 +11,116 @@ ManchesterBaby::ManchesterBaby() {
     loadProgram("output.txt");
 }
 
+// Constructor taking the machine code from a stream
+ManchesterBaby::ManchesterBaby(std::istream &program) {
+    memory.resize(SIZE_32_BIT);
+    pi.reset();
+    accumulator.reset();
+    loadProgram(program);
+}
+
 /* Classic Manchester Baby Instructions: */
 
+// Value an instruction works on
+uint32_t ManchesterBaby::sourceFor(int opcode, unsigned long operand) const {
+    const InstructionInfo &info = INSTRUCTIONS[opcode];
+    if (curImAddressing && info.immediate) {
+        return (uint32_t) operand;
+    }
+    if (info.operand == OperandUse::Read || info.operand == OperandUse::Exchange) {
+        if (trace) {
+            trace->record(MemoryAccess::Kind::Read, operand);
+        }
+        return reverseWord((uint32_t) memory[operand].to_ulong());
+    }
+    return 0;
+}
+
+// Run an instruction of the table on its source value
+void ManchesterBaby::apply(int opcode, unsigned long operand, uint32_t source) {
+    const InstructionInfo &info = INSTRUCTIONS[opcode];
+    const uint32_t acc = reverseWord((uint32_t) accumulator.to_ulong());
+    switch (info.effect) {
+        case Effect::Accumulator:
+            accumulator = reverseWord(info.compute(acc, source));
+            break;
+        case Effect::Jump:
+            ci = (int) info.compute((uint32_t) ci, source);
+            break;
+        case Effect::Skip:
+            if ((int32_t) acc < 0) {
+                ci++;
+            }
+            break;
+        case Effect::Stop:
+            stp();
+            break;
+        case Effect::Store:
+            sto(operand);
+            break;
+        case Effect::Exchange: {
+            const std::bitset<SIZE_32_BIT> old = memory[operand];
+            accumulator = reverseWord(info.compute(acc, source));
+            sto(operand);
+            accumulator = old;
+            break;
+        }
+    }
+}
+
 // 0-JMP: Set CI to content of Store location (CI = S)
 // Immediate Addressing is available for this opcode: CI = OPERAND
 void ManchesterBaby::jmp(unsigned long operand) {
-    if (curImAddressing) {
-        ci = (int) operand;
-    } else {
-        ci = (int) convertInstruction(memory[operand]);
-    }
+    apply(JMP, operand, sourceFor(JMP, operand));
 }
 
 // 1-JRP: Add content of Store location to CI (CI = CI + S)
 // Immediate Addressing is available for this opcode: CI = CI + OPERAND
 void ManchesterBaby::jrp(unsigned long operand) {
-    if (curImAddressing) {
-        ci += (int) operand;
-    } else {
-        ci += (int) convertInstruction(memory[operand]);
-    }
+    apply(JRP, operand, sourceFor(JRP, operand));
 }
 
 // 2-LDN: Load Accumulator with negative form of Store content (A = -S)
 // Immediate Addressing is available for this opcode: A = -OPERAND
 void ManchesterBaby::ldn(unsigned long operand) {
-    if (curImAddressing) {
-        accumulator = convertInstruction(std::bitset<SIZE_32_BIT>(-operand));
-    } else {
-        accumulator = convertInstruction(std::bitset<SIZE_32_BIT>(-convertInstruction(memory[operand])));
-    }
+    apply(LDN, operand, sourceFor(LDN, operand));
 }
 
 // 3-STO: Copy Accumulator to Store location (Location of S = A)
 void ManchesterBaby::sto(unsigned long operand) {
     memory[operand] = accumulator;
+    if (trace) {
+        trace->record(MemoryAccess::Kind::Write, operand);
+    }
+    if (fusion && !immutableCode) {
+        fuser.invalidate(operand);
+    }
+    if (observer) {
+        observer->onStore(*this, operand, accumulator);
+    }
 }
 
 // 4(5)-SUB: Subtract content of Store location from Accumulator (A = A - S)
 // Immediate Addressing is available for this opcode: A = A - OPERAND
 void ManchesterBaby::sub(unsigned long operand) {
-    if (curImAddressing) {
-        accumulator = convertInstruction(std::bitset<SIZE_32_BIT>(convertInstruction(accumulator) - operand));
-    } else {
-        accumulator = convertInstruction(
-                std::bitset<SIZE_32_BIT>(convertInstruction(accumulator) - convertInstruction(memory[operand])));
-    }
+    apply(SUB, operand, sourceFor(SUB, operand));
 }
 
 // 6-CMP: Increment CI if Accumulator value is negative, otherwise do nothing (A < 0 ? CI = CI + 1 : nothing)
 void ManchesterBaby::cmp() {
-    if (binToDec(convertInstruction(accumulator)) < 0) {
-        ci++;
-    }
+    apply(CMP, 0, 0);
 }
 
 // 7-STP: Set Stop lamp and halt machine (Program ends)
 void ManchesterBaby::stp() {
-    std::cout << "STOP!" << std::endl << std::endl;
+    BABY_PROBE2(baby, halt, ci, curRound);
     halted = true;
+    if (!devices.empty()) {
+        devices.flush();
+    }
+    if (observer) {
+        observer->onHalt(*this);
+    }
 }
 
 /* Additional Instructions: */
@@ -74,69 +128,62 @@ void ManchesterBaby::stp() {
 // 8-LDP: Load Accumulator with POSITIVE form of Store content (A = S)
 // Immediate Addressing is available for this opcode: A = OPERAND
 void ManchesterBaby::ldp(unsigned long operand) {
-    if (curImAddressing) {
-        accumulator = convertInstruction(std::bitset<SIZE_32_BIT>(operand));
-    } else {
-        accumulator = convertInstruction(std::bitset<SIZE_32_BIT>(convertInstruction(memory[operand])));
-    }
+    apply(LDP, operand, sourceFor(LDP, operand));
 }
 
 // 9-ADD: Add the content of Store location to Accumulator (A = A + S)
 // Immediate Addressing is available for this opcode: A = A + OPERAND
 void ManchesterBaby::add(unsigned long operand) {
-    if (curImAddressing) {
-        accumulator = convertInstruction(std::bitset<SIZE_32_BIT>(convertInstruction(accumulator) + operand));
-    } else {
-        accumulator = convertInstruction(
-                std::bitset<SIZE_32_BIT>(convertInstruction(accumulator) + convertInstruction(memory[operand])));
-    }
+    apply(ADD, operand, sourceFor(ADD, operand));
 }
 
 // 10-DIV: Divide Accumulator with the content of Store location (A = A / S)
 // Immediate Addressing is available for this opcode: A = A / OPERAND
 void ManchesterBaby::div(unsigned long operand) {
-    if (curImAddressing) {
-        accumulator = convertInstruction(std::bitset<SIZE_32_BIT>(convertInstruction(accumulator) / operand));
-    } else {
-        accumulator = convertInstruction(
-                std::bitset<SIZE_32_BIT>(convertInstruction(accumulator) / convertInstruction(memory[operand])));
-    }
+    apply(DIV, operand, sourceFor(DIV, operand));
 }
 
 // 11-MOD: Find the remainder in the DIV division (A = A % S)
 // Immediate Addressing is available for this opcode: A = A % OPERAND
 void ManchesterBaby::mod(unsigned long operand) {
-    if (curImAddressing) {
-        accumulator = convertInstruction(std::bitset<SIZE_32_BIT>(convertInstruction(accumulator) % operand));
-    } else {
-        accumulator = convertInstruction(
-                std::bitset<SIZE_32_BIT>(convertInstruction(accumulator) % convertInstruction(memory[operand])));
-    }
+    apply(MOD, operand, sourceFor(MOD, operand));
 }
 
 // 12-LAN: Logical AND operation between Accumulator and the content of Store location (A = A & S)
 void ManchesterBaby::lan(unsigned long operand) {
-    accumulator &= memory[operand];
+    apply(LAN, operand, sourceFor(LAN, operand));
 }
 
 // 13-LOR: Logical OR operation between Accumulator and the content of Store location (A = A | S)
 void ManchesterBaby::lor(unsigned long operand) {
-    accumulator |= memory[operand];
+    apply(LOR, operand, sourceFor(LOR, operand));
 }
 
 // 14-LNT: Logical NOT operation of the Accumulator (A = ~A)
 void ManchesterBaby::lnt() {
-    accumulator = ~accumulator;
+    apply(LNT, 0, 0);
 }
 
 // 15-SHL: Digits in Accumulator left shift by 1 digit (A <<= 1)
 void ManchesterBaby::shl() {
-    accumulator <<= 1;
+    apply(SHL, 0, 0);
 }
 
 // 16-SHR: Digits in Accumulator right shift by 1 digit (A >>= 1)
 void ManchesterBaby::shr() {
-    accumulator >>= 1;
+    apply(SHR, 0, 0);
+}
+
+/* Shared-Memory Instructions: */
+
+// 17-XCH: Exchange Accumulator and Store location (A, S = S, A)
+void ManchesterBaby::xch(unsigned long operand) {
+    apply(XCH, operand, sourceFor(XCH, operand));
+}
+
+// 18-XAD: Add Accumulator to Store location, loading its old content (A, S = S, S + A)
+void ManchesterBaby::xad(unsigned long operand) {
+    apply(XAD, operand, sourceFor(XAD, operand));
 }
 
 
@@ -153,26 +200,10 @@ int ManchesterBaby::binToDec(const std::bitset<SIZE_32_BIT> &binary) {
 // Load the machine code from the file.
 void ManchesterBaby::loadProgram(const std::string &filename) {
     std::ifstream file(filename);
-    std::string line;
-    int address = 0;
 
     if (file.is_open()) {
         // File open successful, read each line in the file
-        while (getline(file, line)) {
-            if (!line.empty() && line.back() == '\r') {
-                    line.pop_back();
-            }
-            // Detect if each line in the machine code file is in 32-bit
-            if (line.size() == SIZE_32_BIT) {
-                memory[address] = std::bitset<SIZE_32_BIT>(line);
-            } else {
-                std::cerr << "Error: line " << address + 1 << " in file does not have a valid number of bits."
-                          << std::endl;
-                throw std::runtime_error("Invalid line length in program file.");
-            }
-            ++address;
-        }
-        instruction_num = address + 1;
+        loadProgram(file);
         file.close();
     } else {
         // Something unusual happens during file opening
@@ -181,9 +212,56 @@ void ManchesterBaby::loadProgram(const std::string &filename) {
     }
 }
 
+// Load the machine code from a stream, one 32-bit line per word.
+void ManchesterBaby::loadProgram(std::istream &input) {
+    std::vector<std::bitset<SIZE_32_BIT>> image;
+    std::string line;
+
+    while (getline(input, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        // Detect if each line in the machine code file is in 32-bit
+        if (line.size() != SIZE_32_BIT) {
+            std::cerr << "Error: line " << image.size() + 1 << " in file does not have a valid number of bits."
+                      << std::endl;
+            throw std::runtime_error("Invalid line length in program file.");
+        }
+        image.emplace_back(line);
+    }
+    loadProgram(image);
+}
+
+// Load machine code words, as stored, from address 0.
+void ManchesterBaby::loadProgram(const std::vector<std::bitset<SIZE_32_BIT>> &image) {
+    BABY_PROBE0(baby, load_start);
+    // Words past the 32-word store are kept as data: CI wraps at 32, but operands can still address them
+    if (image.size() > memory.size()) {
+        memory.resize(image.size());
+    }
+    std::copy(image.begin(), image.end(), memory.begin());
+    instruction_num = (int) image.size() + 1;
+    fuser.clear();
+    immutableCode = false;
+    isa = narrowestIsa(memory);
+    if (shadow) {
+        shadow->load(memory, image.size());
+    }
+    BABY_PROBE1(baby, load_done, image.size());
+}
+
 // Fetch the current instruction.
 void ManchesterBaby::fetch() {
+    BABY_PROBE2(baby, fetch, ci, curRound);
+    // A jump through a negative word leaves CI below the store
+    if (ci < 0 || (size_t) ci >= memory.size()) {
+        halted = true;
+        throw std::runtime_error("Instruction address " + std::to_string(ci) + " is outside the store.");
+    }
     pi = memory[ci];
+    if (trace) {
+        trace->record(MemoryAccess::Kind::Fetch, ci);
+    }
 }
 
 // Decode and run the current instruction.
@@ -196,8 +274,8 @@ void ManchesterBaby::decodeAndExecute() {
     unsigned long immediate_addressing;
 
     pi_value = pi.to_ulong();                               // transform PI to unsigned long type
-    standard_operand = (pi_value & OPERAND_MASK) >> 19;     // Apply mask to get operand
-    standard_opcode_value = (pi_value & OPCODE_MASK) >> 14; // Apply mask to get opcode
+    standard_operand = (pi_value & OPERAND_MASK) >> Layout32::storedOperandShift;     // Apply mask to get operand
+    standard_opcode_value = (pi_value & OPCODE_MASK) >> Layout32::storedOpcodeShift; // Apply mask to get opcode
 
     // Their values in standard binary are what we actually need
     operand = convertOperand(standard_operand);
@@ -208,102 +286,398 @@ void ManchesterBaby::decodeAndExecute() {
     curOpCode = (int) opcode_value;             // Set the current opcode
     curOperand = operand;                       // ...as well as the current operand
 
-    // For opcode No. 0/1/2/4(5)/8/9/10/11, a addressing mode check is needed
-    if ((opcode_value <= 2) || (opcode_value == 4) ||
-        (opcode_value >= 8 && opcode_value <= 11)) {
-        immediate_addressing =
-                (pi_value & ADDRESSING_MASK) >> 1;   // Apply mask to check if using immediate addressing or not
+    // For opcodes with immediate addressing (see isa.h), a addressing mode check is needed
+    if (takesImmediate((int) opcode_value)) {
+        // Apply mask to check if using immediate addressing or not
+        immediate_addressing = (pi_value & ADDRESSING_MASK) >> Layout32::storedImmediateShift;
         curImAddressing = immediate_addressing == 1;
     }
 
-    // Do operations respectively
-    switch (opcode_value) { // Starts at digit No.14 in 32-bit machine code
-        case JMP: /* Classic Instructions */
-            jmp(operand);   // 0 (00000)
-            break;
-        case JRP:
-            jrp(operand);   // 1 (10000)
-            break;
-        case LDN:
-            ldn(operand);   // 2 (01000)
-            break;
-        case STO:
-            sto(operand);   // 3 (11000)
-            break;
-        case SUB:
-            sub(operand);   // 4 (00100) or 5 (10100)
-            break;
-        case CMP:
-            cmp();          // 6 (01100)
-            break;
-        case STP:
-            stp();          // 7 (11100)
-            break;
-        case LDP: /* Additional Instructions - Explained at their implementations */
-            ldp(operand);   // 8 (00010)
-            break;
-        case ADD:
-            add(operand);   // 9 (10010)
-            break;
-        case DIV:
-            div(operand);   // 10 (01010)
-            break;
-        case MOD:
-            mod(operand);   // 11 (11010)
-            break;
-        case LAN:
-            lan(operand);   // 12 (00110)
-            break;
-        case LOR:
-            lor(operand);   // 13 (10110)
-            break;
-        case LNT:
-            lnt();          // 14 (01110)
-            break;
-        case SHL:
-            shl();          // 15 (11110)
-            break;
-        case SHR:
-            shr();          // 16 (00001)
-            break;
-        default:
-            std::cerr << "Unknown opcode: " << standard_opcode_value << std::endl;
+    BABY_PROBE3(baby, execute, opcode_value, operand, curImAddressing);
+
+    // Operands past the store can be mapped devices; any other is an error
+    if (operand >= memory.size() && curOpCode <= XAD &&
+        (INSTRUCTIONS[curOpCode].operand == OperandUse::Write || INSTRUCTIONS[curOpCode].operand == OperandUse::Exchange ||
+         (INSTRUCTIONS[curOpCode].operand == OperandUse::Read && !(takesImmediate(curOpCode) && curImAddressing)))) {
+        Device *device = devices.find(operand);
+        if (device == nullptr) {
             halted = true;
-            break;
+            throw std::runtime_error("Address " + std::to_string(operand) + " is outside the store.");
+        }
+        executeOnDevice(*device);
+        clock.tick(curOpCode);
+        curRound++;
+        return;
+    }
+
+    // Do operations respectively, as the instruction table (isa.h) says
+    if (opcode_value < INSTRUCTIONS.size()) {
+        apply(curOpCode, operand, sourceFor(curOpCode, operand));
+    } else {
+        halted = true;
+        if (!devices.empty()) {
+            devices.flush();
+        }
+        if (observer) {
+            observer->onIllegalOpcode(*this, standard_opcode_value);
+        }
     }
+    clock.tick(curOpCode);
     curRound++;     // One more round!
 }
 
+// Run the current instruction with a device in place of its store operand
+void ManchesterBaby::executeOnDevice(Device &device) {
+    const InstructionInfo &info = INSTRUCTIONS[curOpCode];
+    if (info.effect == Effect::Store) {
+        device.write(*this, (uint32_t) convertInstruction(accumulator));
+        return;
+    }
+    if (info.effect == Effect::Exchange) {
+        const uint32_t old = device.read(*this);
+        device.write(*this, info.compute((uint32_t) convertInstruction(accumulator), old));
+        accumulator = reverseWord(old);
+        return;
+    }
+    apply(curOpCode, curOperand, device.read(*this));
+}
+
 // Increment CI
 void ManchesterBaby::increment_ci() {
     prev_ci = ci;
     ci = (ci + 1) % SIZE_32_BIT;
 }
 
+// Fetch, decode and execute one instruction, then move CI on.
+void ManchesterBaby::step() {
+    fetch();
+    decodeAndExecute();
+    increment_ci();
+    if (observer) {
+        observer->onStep(*this, 1);
+    }
+}
+
+// step() specialised for an instruction set. Returns false, having changed nothing, if step() must run the
+// instruction instead: it is outside the set (which is then widened) or its operand is past the store.
+template<class Isa, bool Instrumented>
+bool ManchesterBaby::stepAs() {
+    if (ci < 0 || ci >= (int) memory.size()) {
+        return false;
+    }
+    const auto word = (uint32_t) memory[ci].to_ulong();
+    const uint32_t field = (word >> OPCODE_SHIFT) & 31U;
+    const int opcode = opcodeTable<Isa>[field];
+    const bool immediateBit = ((word >> IMMEDIATE_SHIFT) & 1U) != 0;
+    if (opcode < 0 || (!Isa::immediate && immediateBit && takesImmediate(opcode))) {
+        isa = widerIsa(isa, narrowestIsaFor(opcodeTable<ExtendedIsa>[field], immediateBit));
+        return false;
+    }
+    const unsigned long operand = reverseWord(word) & VALUE_OPERAND_MASK;
+    const bool immediate = Isa::immediate && immediateBit && takesImmediate(opcode);
+    const OperandUse use = opcode <= XAD ? INSTRUCTIONS[opcode].operand : OperandUse::None;
+    const bool usesStore = use == OperandUse::Write || use == OperandUse::Exchange ||
+                           (use == OperandUse::Read && !immediate);
+    if (usesStore && operand >= memory.size()) {
+        return false;
+    }
+
+    // Fetch
+    BABY_PROBE2(baby, fetch, ci, curRound);
+    pi = memory[ci];
+    if constexpr (Instrumented) {
+        if (trace) {
+            trace->record(MemoryAccess::Kind::Fetch, ci);
+            if (usesStore && use != OperandUse::Write) {
+                trace->record(MemoryAccess::Kind::Read, operand);
+            }
+        }
+    }
+
+    // Decode
+    curOpCode = opcode;
+    curOperand = operand;
+    if (takesImmediate(opcode)) {
+        curImAddressing = immediate;
+    }
+    BABY_PROBE3(baby, execute, (unsigned long) opcode, operand, curImAddressing);
+
+    // Execute through the instruction table, on values rather than stored words
+    if (Isa::lastOpcode <= XAD || opcode <= XAD) {
+        const uint32_t source = immediate ? (uint32_t) operand :
+                                use == OperandUse::Read || use == OperandUse::Exchange ?
+                                reverseWord((uint32_t) memory[operand].to_ulong()) : 0;
+        apply(opcode, operand, source);
+    } else {
+        halted = true;
+        if (!devices.empty()) {
+            devices.flush();
+        }
+        if (observer) {
+            observer->onIllegalOpcode(*this, field);
+        }
+    }
+    clock.tick(curOpCode);
+    curRound++;
+
+    increment_ci();
+    if (observer) {
+        observer->onStep(*this, 1);
+    }
+    return true;
+}
+
+// run() specialised for an instruction set; returns early if the set had to be widened
+template<class Isa, bool Instrumented>
+int ManchesterBaby::runAs(int maxSteps) {
+    int steps = 0;
+    if constexpr (Instrumented) {
+        // Every instruction, one at a time: what fusion or loop acceleration run at once goes unchecked and untraced
+        int from = prev_ci;
+        while (!halted && steps < maxSteps) {
+            const int address = ci;
+            const int round = curRound;
+            if ((!shadow || checkStep(from)) && !stepAs<Isa, true>()) {
+                step();
+            }
+            from = address;
+            // A wild address halts the machine without running the instruction
+            steps += curRound - round;
+        }
+        return steps;
+    }
+    while (!halted && steps < maxSteps && isa == Isa::variant) {
+        int address = ci;
+        int executed = fusion ? fuser.execute(*this, maxSteps - steps) : 0;
+        if (executed == 0) {
+            if (!stepAs<Isa>()) {
+                step();
+            }
+            executed = 1;
+        } else if (observer) {
+            observer->onStep(*this, executed);
+        }
+        steps += executed;
+        // A backward JMP may have closed a loop that can be fast-forwarded
+        int last = address + executed - 1;
+        if (loopAcceleration && curOpCode == JMP && ci <= last && !halted) {
+            int skipped = accelerator.fastForward(*this, last, maxSteps - steps);
+            steps += skipped;
+            if (observer && skipped > 0) {
+                observer->onStep(*this, skipped);
+            }
+        }
+    }
+    return steps;
+}
+
+// Check the instruction at CI against the shadow memory before it runs
+bool ManchesterBaby::checkStep(int from) {
+    if (ci < 0 || ci >= (int) memory.size()) {
+        shadow->record(ShadowMemory::Kind::WildAddress, from, ci, curRound);
+        halted = true;
+        return false;
+    }
+    if (!shadow->isCode(ci)) {
+        shadow->record(ShadowMemory::Kind::JumpIntoData, from, ci, curRound);
+    }
+    const Instruction ins = decodeInstruction(memory[ci]);
+    const OperandUse use = ins.opcode <= XAD ? INSTRUCTIONS[ins.opcode].operand : OperandUse::None;
+    const bool writes = use == OperandUse::Write || use == OperandUse::Exchange;
+    const bool reads = use == OperandUse::Exchange ||
+                       (use == OperandUse::Read && !(ins.immediate && takesImmediate(ins.opcode)));
+    if (!reads && !writes) {
+        return true;
+    }
+    // Past the store only a device can answer
+    if (ins.operand >= memory.size()) {
+        if (devices.find(ins.operand) == nullptr) {
+            shadow->record(ShadowMemory::Kind::WildAddress, ci, (long long) ins.operand, curRound);
+            halted = true;
+            return false;
+        }
+        return true;
+    }
+    if (reads && !shadow->isInitialised(ins.operand)) {
+        shadow->record(ShadowMemory::Kind::UninitialisedRead, ci, (long long) ins.operand, curRound);
+    }
+    if (writes) {
+        if (ins.operand == (unsigned long) ci) {
+            shadow->record(ShadowMemory::Kind::SelfOverwrite, ci, (long long) ins.operand, curRound);
+        }
+        shadow->markWritten(ins.operand);
+    }
+    return true;
+}
+
+// Run until halted or until maxSteps instructions have been executed. Returns the number executed.
+int ManchesterBaby::run(int maxSteps) {
+    // Checked and traced mode have a loop of their own, so other runs pay nothing for them
+    if (shadow || trace) {
+        const int steps = runAs<ExtendedIsa, true>(maxSteps);
+        if (trace) {
+            trace->flush();
+        }
+        return steps;
+    }
+    int steps = 0;
+    while (!halted && steps < maxSteps) {
+        switch (isa) {
+            case IsaVariant::Classic:
+                steps += runAs<ClassicIsa>(maxSteps - steps);
+                break;
+            case IsaVariant::ClassicImmediate:
+                steps += runAs<ClassicImmediateIsa>(maxSteps - steps);
+                break;
+            default:
+                steps += runAs<ExtendedIsa>(maxSteps - steps);
+                break;
+        }
+    }
+    return steps;
+}
+
+// Run as above, keeping real time in step with the virtual clock as the pacing policy says.
+int ManchesterBaby::run(int maxSteps, PacingPolicy &pacing) {
+    if (!pacing.isThrottled()) {
+        return run(maxSteps);
+    }
+    const int slice = pacing.slice(clock.table());
+    int steps = 0;
+    pacing.start(clock);
+    while (!halted && steps < maxSteps) {
+        steps += run(std::min(slice, maxSteps - steps));
+        pacing.wait(clock);
+    }
+    return steps;
+}
+
+// Enable or disable fast-forwarding of simple counting loops in run().
+void ManchesterBaby::setLoopAcceleration(bool enabled) {
+    loopAcceleration = enabled;
+}
+
+// Statistics of the loop accelerator
+const LoopAccelerator &ManchesterBaby::loopAccelerator() const {
+    return accelerator;
+}
+
+// Enable or disable superinstruction fusion in run().
+void ManchesterBaby::setFusion(bool enabled) {
+    fusion = enabled;
+    fuser.clear();
+}
+
+// Statistics of the superinstruction fuser
+const InstructionFuser &ManchesterBaby::instructionFuser() const {
+    return fuser;
+}
+
+// Instruction set run() currently dispatches for
+IsaVariant ManchesterBaby::isaVariant() const {
+    return isa;
+}
+
+// Dispatch for another instruction set.
+void ManchesterBaby::setIsa(IsaVariant variant) {
+    isa = variant;
+}
+
+// Narrowest instruction set able to run the code reachable in an image
+IsaVariant ManchesterBaby::narrowestIsa(const std::vector<std::bitset<SIZE_32_BIT>> &image) {
+    ImageAnalysis analysis(image);
+    IsaVariant variant = IsaVariant::Classic;
+    for (int address = 0; address < SIZE_32_BIT; ++address) {
+        if (analysis.isCode(address)) {
+            Instruction ins = decodeInstruction(image[address]);
+            variant = widerIsa(variant, narrowestIsaFor(ins.opcode, ins.immediate));
+        }
+    }
+    return variant;
+}
+
+// Analyse the loaded program and turn on the fastest modes that are safe for it.
+void ManchesterBaby::selectFastestMode() {
+    ImageAnalysis analysis(memory);
+    fusion = true;
+    fuser.clear();
+    loopAcceleration = analysis.hasBackwardJumps();
+    immutableCode = !analysis.isSelfModifying();
+    codeCells = 0;
+    for (int address = 0; address < SIZE_32_BIT; ++address) {
+        if (analysis.isCode(address)) {
+            codeCells |= 1UL << address;
+        }
+    }
+}
+
+// Write a word to the store, keeping fused sequences in step.
+void ManchesterBaby::writeMemory(unsigned long address, const std::bitset<SIZE_32_BIT> &word) {
+    memory[address] = word;
+    if (fusion) {
+        fuser.invalidate(address);
+    }
+    // Code written from outside the program voids what the analysis proved
+    if (address < SIZE_32_BIT && ((codeCells >> address) & 1UL) != 0) {
+        immutableCode = false;
+    }
+    if (shadow) {
+        shadow->markWritten(address);
+    }
+    if (observer) {
+        observer->onStore(*this, address, word);
+    }
+}
+
+// Run in checked mode from now on; nullptr (the default) runs unchecked.
+void ManchesterBaby::setShadow(ShadowMemory *newShadow) {
+    shadow = newShadow;
+    if (shadow) {
+        shadow->load(memory, instruction_num > 0 ? instruction_num - 1 : 0);
+    }
+}
+
+// Record store accesses in trace from now on; nullptr (the default) records nothing.
+void ManchesterBaby::setAccessTrace(AccessTrace *newTrace) {
+    trace = newTrace;
+}
+
+// Report events to observer from now on; nullptr (the default) reports nothing.
+void ManchesterBaby::setObserver(MachineObserver *newObserver) {
+    observer = newObserver;
+}
+
 // Display the current state in the console.
 [[maybe_unused]] void ManchesterBaby::printState() {
-    std::cout << "Round:        " << curRound << std::endl;
-    std::cout << "CI:           " << prev_ci << std::endl;
-    std::cout << "PI:           " << pi << std::endl;
-    std::cout << "New CI:       " << ci << std::endl;
-    std::cout << "OPCODE:       " << curOpCode << std::endl;
-    std::cout << "OPERAND:      " << curOperand << std::endl;
-    std::cout << "Address Mode: ";
+    std::cout << stateText() << std::flush;
+}
+
+// The current state, as printState displays it.
+std::string ManchesterBaby::stateText() const {
+    std::ostringstream text;
+    text << "Round:        " << curRound << "\n";
+    text << "CI:           " << prev_ci << "\n";
+    text << "PI:           " << pi << "\n";
+    text << "New CI:       " << ci << "\n";
+    text << "OPCODE:       " << curOpCode << "\n";
+    text << "OPERAND:      " << curOperand << "\n";
+    text << "Address Mode: ";
     if (curImAddressing) {
-        std::cout << "Immediate Addressing" << std::endl << std::endl;
+        text << "Immediate Addressing" << "\n\n";
     } else {
-        std::cout << "Default" << std::endl << std::endl;
+        text << "Default" << "\n\n";
     }
-    std::cout << "Accumulator:  " << binToDec(convertInstruction(accumulator)) << std::endl;
-    std::cout << accumulator << std::endl << std::endl;
+    text << "Accumulator:  " << binToDec(convertInstruction(accumulator)) << "\n";
+    text << accumulator << "\n\n";
 
 
-    std::cout << "Memory:" << std::endl;
+    text << "Memory:" << "\n";
     for (int i = 0; i < instruction_num; ++i) {
-        std::cout << i << ": " << memory[i] << std::endl;
+        text << i << ": " << memory[i] << "\n";
     }
 
-    std::cout << "--------------------------------------------------------------" << std::endl;
+    text << "--------------------------------------------------------------" << "\n";
+    return text.str();
 }
 
 // Check the operational state.
@@ -318,33 +692,35 @@ void ManchesterBaby::setHalt(bool wannaStop) {
 
 // Convert opcode into standard binary bits.
 unsigned long ManchesterBaby::convertOpCode(unsigned long num) {
-    std::bitset<5> bits(num);
-    std::string str = bits.to_string();
-    std::reverse(str.begin(), str.end());
-    std::bitset<5> reversedBits(str);
-    return reversedBits.to_ulong();
+    return reverseBits((uint32_t) num, 5);
 }
 
 // Convert operand into standard binary bits.
 unsigned long ManchesterBaby::convertOperand(unsigned long num) {
-    std::bitset<13> bits(num);
-    std::string str = bits.to_string();
-    std::reverse(str.begin(), str.end());
-    std::bitset<13> reversedBits(str);
-    return reversedBits.to_ulong();
+    return reverseBits((uint32_t) num, 13);
 }
 
 // Convert Instruction (Accumulator or a specific one in memory) into standard binary bits.
 [[nodiscard]] unsigned long ManchesterBaby::convertInstruction(std::bitset<SIZE_32_BIT> ins) {
-    std::string str = ins.to_string();
-    std::reverse(str.begin(), str.end());
-    std::bitset<SIZE_32_BIT> reversedBits(str);
-    return reversedBits.to_ulong();
+    return reverseWord((uint32_t) ins.to_ulong());
+}
+
+// Decode an instruction word the same way decodeAndExecute does.
+ManchesterBaby::Instruction ManchesterBaby::decodeInstruction(const std::bitset<SIZE_32_BIT> &word) {
+    unsigned long value = convertInstruction(word);
+    Instruction ins{};
+    ins.operand = value & ((1UL << 13) - 1);
+    ins.opcode = (int) ((value >> 13) & 31UL);
+    if (ins.opcode == 5) ins.opcode--;
+    ins.immediate = ((value >> 30) & 1UL) == 1;
+    return ins;
 }
 
 // Reset the Manchester Baby - Used in GUI mode ("Stop" Button)
 void ManchesterBaby::reset() {
-    memory.resize(SIZE_32_BIT);
+    if (memory.size() < SIZE_32_BIT) {
+        memory.resize(SIZE_32_BIT);
+    }
     pi.reset();
     accumulator.reset();
     curOpCode = 0;
@@ -353,4 +729,8 @@ void ManchesterBaby::reset() {
     curRound = 0;
     prev_ci = 0;
     ci = 0;
+    clock.reset();
+    if (shadow) {
+        shadow->restart();
+    }
 }
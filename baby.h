@@ -9,43 +9,77 @@
 #include <chrono>
 #include <thread>
 #include <algorithm>
-#include <QApplication>
-
-const int SIZE_32_BIT = 32;
-
-// Defining operands as enums
-enum OpCode {   // Digit No.14 - No.19 in machine code
-    /* Classic Instructions */
-    JMP = 0,    // 00000
-    JRP = 1,    // 10000
-    LDN = 2,    // 01000
-    STO = 3,    // 11000
-    SUB = 4,    // 00100, or 5 10100
-    CMP = 6,    // 01100
-    STP = 7,    // 11100
-    /* Additional Instructions */
-    LDP = 8,    // 00010
-    ADD = 9,    // 10010
-    DIV = 10,   // 01010
-    MOD = 11,   // 11010
-    LAN = 12,   // 00110
-    LOR = 13,   // 10110
-    LNT = 14,   // 01110
-    SHL = 15,   // 11110
-    SHR = 16    // 00001
-};
+#include <sstream>
+
+#include "clock.h"
+#include "devices.h"
+#include "events.h"
+#include "isa.h"
+#include "memtrace.h"
+#include "word.h"
+#include "loopaccel.h"
+#include "fusion.h"
+
+class ShadowMemory;
+
+const int SIZE_32_BIT = Layout32::bits;
 
 // Class for simulating Manchester Baby
 class ManchesterBaby {
 private:
     int instruction_num{};
 
-    unsigned long OPERAND_MASK{((1UL << 13) - 1) << 19};    // Mask for obtaining operand in instruction
-    unsigned long OPCODE_MASK{31UL << 14};                  // Mask for obtaining opcode in instruction
-    unsigned long ADDRESSING_MASK{1UL << 1};                // Mask for obtaining address mode in instruction
+    // Masks for obtaining the operand, the opcode and the address mode in a stored instruction (see word.h)
+    static constexpr unsigned long OPERAND_MASK{Layout32::storedOperandMask};
+    static constexpr unsigned long OPCODE_MASK{Layout32::storedOpcodeMask};
+    static constexpr unsigned long ADDRESSING_MASK{Layout32::storedImmediateMask};
 
     bool halted{false};     // HALT mark
+
+    bool loopAcceleration{false};   // Whether run() fast-forwards simple counting loops
+    LoopAccelerator accelerator;    // Recognises and fast-forwards those loops
+    bool fusion{false};             // Whether run() executes common sequences as fused handlers
+    InstructionFuser fuser;         // Recognises and runs those sequences
+    bool immutableCode{false};      // Proven by analysis: no STO of the program writes into its code
+    unsigned long codeCells{0};     // Addresses found reachable as code by that analysis, one bit each
+    MachineObserver *observer{nullptr};     // Told about halts, unknown opcodes, stores and steps (see events.h)
+    IsaVariant isa{IsaVariant::Extended};   // Instruction set run() dispatches for (see isa.h)
+    ShadowMemory *shadow{nullptr};          // Checks run() makes in checked mode (see shadow.h)
+    AccessTrace *trace{nullptr};            // Store accesses run() records in traced mode (see memtrace.h)
+
+    // Run the current instruction with a device in place of its store operand
+    void executeOnDevice(Device &device);
+
+    // Value an instruction works on: the operand with immediate addressing, else the store word, or 0 if it has none
+    [[nodiscard]] uint32_t sourceFor(int opcode, unsigned long operand) const;
+
+    // Run an instruction of the table (isa.h) on its source value: the table's compute, applied as its Effect says
+    void apply(int opcode, unsigned long operand, uint32_t source);
+
+    // run() specialised for an instruction set; returns early if the set had to be widened. The Instrumented
+    // instantiation is the loop of checked and traced mode: it runs every instruction on its own, without fusion or
+    // loop acceleration, checks it against the shadow memory if there is one and records its accesses in the trace
+    // if there is one.
+    template<class Isa, bool Instrumented = false>
+    int runAs(int maxSteps);
+
+    // Check the instruction at CI against the shadow memory before it runs; from is the address of the one before.
+    // Returns false, having halted the machine, on a wild address.
+    bool checkStep(int from);
+
+    // step() specialised for an instruction set. Returns false, having changed nothing, if step() must run the
+    // instruction instead: it is outside the set (which is then widened) or its operand is past the store. The
+    // Instrumented instantiation records the accesses in the trace, if there is one.
+    template<class Isa, bool Instrumented = false>
+    bool stepAs();
 public:
+    // Decoded form of an instruction word
+    struct Instruction {
+        int opcode;                 // Opcode, with 5 folded into 4 (SUB)
+        unsigned long operand;      // Operand, in standard binary
+        bool immediate;             // Immediate addressing bit
+    };
+
     std::vector<std::bitset<SIZE_32_BIT>> memory;           // Memory
 
     int curOpCode{};                            // current opcode
@@ -57,10 +91,15 @@ public:
     std::bitset<SIZE_32_BIT> pi;                // Present instruction
     std::bitset<SIZE_32_BIT> accumulator;       // Accumulator
     bool inGuiMode{};                           // Whether in GUI mode or not
+    VirtualClock clock;                         // Simulated elapsed time (see clock.h)
+    DeviceBus devices;                          // Memory-mapped devices above the store (see devices.h)
 
     // Initialize ManchesterBaby
     ManchesterBaby();
 
+    // Initialize ManchesterBaby with the machine code read from a stream instead of "output.txt"
+    explicit ManchesterBaby(std::istream &program);
+
     /* Classic Manchester Baby Instructions: */
 
     // 0-JMP: Set CI to content of Store location (CI = S)
@@ -121,23 +160,96 @@ public:
     // 16-SHR: Digits in Accumulator right shift by 1 digit (A >>= 1)
     void shr();
 
+    /* Shared-Memory Instructions: */
+
+    // 17-XCH: Exchange Accumulator and Store location (A, S = S, A)
+    void xch(unsigned long operand);
+
+    // 18-XAD: Add Accumulator to Store location, loading its old content (A, S = S, S + A)
+    void xad(unsigned long operand);
+
     // Convert binary to decimal
     static int binToDec(const std::bitset<SIZE_32_BIT> &binary);
 
     // Load the machine code from the file.
     void loadProgram(const std::string &filename);
 
-    // Fetch the current instruction.
+    // Load the machine code from a stream, one 32-bit line per word.
+    void loadProgram(std::istream &input);
+
+    // Load machine code words, as stored, from address 0.
+    void loadProgram(const std::vector<std::bitset<SIZE_32_BIT>> &image);
+
+    // Fetch the current instruction. Throws std::runtime_error, and halts, if CI is outside the store.
     void fetch();
 
-    // Decode and run the current instruction.
+    // Decode and run the current instruction. Throws std::runtime_error, and halts, if its operand is outside the store
+    // and no device is mapped there.
     void decodeAndExecute();
 
     void increment_ci();
 
+    // Fetch, decode and execute one instruction, then move CI on.
+    void step();
+
+    // Run until halted or until maxSteps instructions have been executed. Returns the number executed.
+    // With loop acceleration on, instructions of fast-forwarded loops count as executed.
+    int run(int maxSteps);
+
+    // Run as above, keeping real time in step with the virtual clock as the pacing policy says.
+    int run(int maxSteps, PacingPolicy &pacing);
+
+    // Enable or disable fast-forwarding of simple counting loops in run(). Results are identical either way.
+    void setLoopAcceleration(bool enabled);
+
+    // Statistics of the loop accelerator
+    [[nodiscard]] const LoopAccelerator &loopAccelerator() const;
+
+    // Enable or disable superinstruction fusion in run(). Results are identical either way.
+    void setFusion(bool enabled);
+
+    // Statistics of the superinstruction fuser
+    [[nodiscard]] const InstructionFuser &instructionFuser() const;
+
+    // Instruction set run() currently dispatches for
+    [[nodiscard]] IsaVariant isaVariant() const;
+
+    // Dispatch for another instruction set. Results are identical whatever the choice: instructions outside the
+    // set widen it as they are met.
+    void setIsa(IsaVariant variant);
+
+    // Narrowest instruction set able to run the code reachable in an image (see analysis.h)
+    [[nodiscard]] static IsaVariant narrowestIsa(const std::vector<std::bitset<SIZE_32_BIT>> &image);
+
+    // Analyse the loaded program (see analysis.h) and turn on the fastest modes that are safe for it: fusion,
+    // loop acceleration when the program has loops, and no fused-sequence bookkeeping on STO when it never
+    // modifies its own code.
+    void selectFastestMode();
+
+    // Write a word to the store. Use this rather than assigning memory[] directly while fusion is on, so that
+    // fused sequences covering the address are recognised again.
+    void writeMemory(unsigned long address, const std::bitset<SIZE_32_BIT> &word);
+
+    // Run in checked mode from now on: run() keeps a shadow of which words hold values and which are code, and
+    // records suspect accesses in it (see shadow.h). Loading a program or reset() starts the shadow again;
+    // nullptr, the default, runs unchecked. The shadow isn't owned.
+    void setShadow(ShadowMemory *newShadow);
+
+    // Record every store access run() makes in trace from now on (see memtrace.h), flushing it at the end of each
+    // run(). Like checked mode, traced runs have a loop of their own. nullptr, the default, records nothing. The
+    // trace isn't owned.
+    void setAccessTrace(AccessTrace *newTrace);
+
+    // Report halts, unknown opcodes, stores and steps to observer from now on (see events.h). The engine writes
+    // nothing to the console itself; nullptr, the default, reports nothing. The observer isn't owned.
+    void setObserver(MachineObserver *newObserver);
+
     // Display the current state in the console. For debugging.
     [[maybe_unused]] void printState();
 
+    // The current state, as printState displays it.
+    [[nodiscard]] std::string stateText() const;
+
     // Check the operational state.
     [[nodiscard]] bool isHalted() const;
 
@@ -153,6 +265,9 @@ public:
     // Convert Instruction (Accumulator or a specific one in memory) into standard binary bits.
     [[nodiscard]] static unsigned long convertInstruction(std::bitset<SIZE_32_BIT> ins);
 
+    // Decode an instruction word the same way decodeAndExecute does.
+    [[nodiscard]] static Instruction decodeInstruction(const std::bitset<SIZE_32_BIT> &word);
+
     // Reset the Manchester Baby - Used in GUI mode ("Stop" Button)
     void reset();
 };
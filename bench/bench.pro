@@ -0,0 +1,52 @@
+# Benchmarks for the simulator and the assembler: qmake bench.pro && make && ./bench --json results.json
+
+TARGET = bench
+TEMPLATE = app
+CONFIG += console c++17 release thread
+CONFIG -= qt app_bundle
+
+INCLUDEPATH += ..
+
+SOURCES += \
+        main.cpp \
+        workload.cpp \
+        ../baby.cpp \
+        ../shadow.cpp \
+        ../pipeline.cpp \
+        ../memsys.cpp \
+        ../assembler.cpp \
+        ../compiler.cpp \
+        ../loopaccel.cpp \
+        ../fusion.cpp \
+        ../analysis.cpp \
+        ../stepbound.cpp \
+        ../clock.cpp \
+        ../events.cpp \
+        ../devices.cpp \
+        ../peephole.cpp \
+        ../lib/babyapi.cpp
+
+HEADERS += \
+        workload.h \
+        ../baby.h \
+        ../shadow.h \
+        ../pipeline.h \
+        ../memsys.h \
+        ../assembler.h \
+        ../compiler.h \
+        ../constasm.h \
+        ../probes.h \
+        ../loopaccel.h \
+        ../fusion.h \
+        ../analysis.h \
+        ../stepbound.h \
+        ../clock.h \
+        ../events.h \
+        ../devices.h \
+        ../peephole.h \
+        ../isa.h \
+        ../memtrace.h \
+        ../word.h \
+        ../widebaby.h \
+        ../lib/babyapi.h \
+        ../superopt/miniengine.h
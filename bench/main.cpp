@@ -0,0 +1,1491 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../baby.h"
+#include "../analysis.h"
+#include "../assembler.h"
+#include "../compiler.h"
+#include "../constasm.h"
+#include "../shadow.h"
+#include "../pipeline.h"
+#include "../memtrace.h"
+#include "../stepbound.h"
+#include "../widebaby.h"
+#include "../lib/babyapi.h"
+#include "../superopt/miniengine.h"
+#include "workload.h"
+
+/* Benchmarks for the simulator and the assembler.
+ *
+ * Usage:
+ *   bench [--json FILE] [--label TEXT] [--filter TEXT] [--samples DIR] [--quick]
+ *   bench --generate KIND [--iterations N] [--step N] [--labels N] [--vars N] [--seed N]
+ *   bench --verify [--samples DIR]
+ *
+ * Results are printed as a table on stderr and as JSON on stdout (or FILE), so that runs of different commits can be
+ * compared with any JSON tool. --generate prints a synthetic workload (see workload.h) instead of benchmarking.
+ * --verify runs the workloads and the samples with every optional engine mode, checked and traced mode included, and on
+ * the generic engine of widebaby.h, and checks, for a range of step budgets, that the final state is identical to plain
+ * interpretation. It also checks that the built-in programs, assembled at compile time (see constasm.h), have the words
+ * the assembler gives them, that the compiled programs (see compiler.h) get their answers, and that the devices (see
+ * devices.h) read only the input that has arrived, that programs leaving the store fail with an error, through the C
+ * interface (see babyapi.h) too, that step bounds (see stepbound.h) hold for real runs of small random programs, and
+ * that the generic engine runs every instruction of the table in isa.h as the engine does. It checks too that loop
+ * acceleration fast-forwards a long counting loop, that image analysis (see analysis.h) agrees with what the programs
+ * fetch and write when they run, that the virtual clock (see clock.h) charges the cycle table's costs, that the
+ * generic engine computes on 64-bit words, and that the superoptimiser's engine agrees with the real one. It exits
+ * with 1 on any difference.
+ */
+
+namespace {
+
+// Result of one benchmark
+struct Result {
+    std::string name;
+    long long operations;   // Operations timed in the best repetition
+    double nsPerOp;         // Best time per operation, in nanoseconds
+};
+
+// Options of a benchmark run
+struct Options {
+    std::string jsonFile;
+    std::string label;
+    std::string filter;
+    std::string samples{"Assembler_Sample"};
+    int repetitions{5};
+    long long scale{1};     // Divides the iteration counts in --quick mode
+};
+
+// Counts the accesses of a traced run, and can keep them as text for comparing two runs
+class AccessLog : public AccessSink {
+public:
+    explicit AccessLog(bool keep = false) : keep(keep) {}
+
+    void onAccesses(const MemoryAccess *accesses, size_t count) override {
+        total += (long long) count;
+        for (size_t index = 0; keep && index < count; ++index) {
+            text += "FRW"[(int) accesses[index].kind] + std::to_string(accesses[index].address) + " ";
+        }
+    }
+
+    long long total{0};
+    std::string text;
+
+private:
+    bool keep;
+};
+
+// Built-in programs, assembled at compile time (see constasm.h)
+
+// Every additional instruction, immediate operands, and an unknown opcode to end
+constexpr std::string_view EXTENDED_OPS_SOURCE = "          VAR 0\n"
+                                                 "          LDP #100\n"
+                                                 "          ADD NUM\n"
+                                                 "          DIV #7\n"
+                                                 "          STO OUT\n"
+                                                 "          LDP NUM\n"
+                                                 "          MOD #5\n"
+                                                 "          SHL\n"
+                                                 "          SHR\n"
+                                                 "          SHR\n"
+                                                 "          LNT\n"
+                                                 "          LAN MASK\n"
+                                                 "          LOR NUM\n"
+                                                 "          SUB #3\n"
+                                                 "          LDN #9\n"
+                                                 "          CMP\n"
+                                                 "          JRP #1\n"
+                                                 "          STO OUT\n"
+                                                 "          VAR 163840\n"
+                                                 "NUM:      VAR 1234\n"
+                                                 "MASK:     VAR 255\n"
+                                                 "OUT:      VAR 0\n";
+constexpr auto EXTENDED_OPS = BABY_PROGRAM(EXTENDED_OPS_SOURCE);
+
+// Classic code that writes an ADD #5 into its own path, so a classic instruction set has to widen
+constexpr std::string_view WIDENING_SOURCE = "          VAR 0\n"
+                                             "          LDN INS\n"
+                                             "          STO TMP\n"
+                                             "          LDN TMP\n"
+                                             "          STO SLOT\n"
+                                             "SLOT:     VAR 0\n"
+                                             "          STO OUT\n"
+                                             "          STP\n"
+                                             "INS:      VAR 1073815557\n"
+                                             "TMP:      VAR 0\n"
+                                             "OUT:      VAR 0\n";
+constexpr auto WIDENING = BABY_PROGRAM(WIDENING_SOURCE);
+
+// Straight-line code with something for most of the peephole patterns (see peephole.h) to remove or rewrite
+constexpr std::string_view PEEPHOLE_SOURCE = "          VAR 0\n"
+                                             "          JMP NEXT\n"
+                                             "          LDN A\n"
+                                             "          SUB B\n"
+                                             "          STO T\n"
+                                             "          LDN T\n"
+                                             "          STO T\n"
+                                             "          STO SUM\n"
+                                             "          LDP SUM\n"
+                                             "          STO SUM\n"
+                                             "          LNT\n"
+                                             "          LNT\n"
+                                             "          ADD #0\n"
+                                             "          SUB #0\n"
+                                             "          LDP A\n"
+                                             "          LDN B\n"
+                                             "          STO NEG\n"
+                                             "          JMP LAST\n"
+                                             "          STO SUM\n"
+                                             "          JMP HALT\n"
+                                             "          STO A\n"
+                                             "          STP\n"
+                                             "NEXT:     VAR 1\n"
+                                             "LAST:     VAR 18\n"
+                                             "HALT:     VAR 20\n"
+                                             "A:        VAR 1025\n"
+                                             "B:        VAR 621\n"
+                                             "T:        VAR 0\n"
+                                             "SUM:      VAR 0\n"
+                                             "NEG:      VAR 0\n";
+
+// Echo the input to the output through CHARIN and CHAROUT, until the end of the input
+constexpr std::string_view ECHO_SOURCE = "          VAR 0\n"
+                                         "LOOP:     LDN CHARIN\n"
+                                         "          CMP\n"
+                                         "          STP\n"
+                                         "          STO TMP\n"
+                                         "          LDN TMP\n"
+                                         "          STO CHAROUT\n"
+                                         "          JMP START\n"
+                                         "START:    VAR 0\n"
+                                         "TMP:      VAR 0\n";
+constexpr auto ECHO = BABY_PROGRAM(ECHO_SOURCE);
+
+// XAD and then XCH on the CYCLES port, where the check maps a device of its own
+constexpr std::string_view EXCHANGE_SOURCE = "          VAR 0\n"
+                                             "          LDN NEG\n"
+                                             "          XAD CYCLES\n"
+                                             "          XCH CYCLES\n"
+                                             "          STO OUT\n"
+                                             "          STP\n"
+                                             "NEG:      VAR -7\n"
+                                             "OUT:      VAR 0\n";
+constexpr auto EXCHANGE = BABY_PROGRAM(EXCHANGE_SOURCE);
+
+// Programs for the compiler (see compiler.h), most of them also among the samples, written by hand
+struct CompiledSample {
+    const char *name;
+    const char *sample;     // The hand-written program, or nullptr
+    const char *source;
+    const char *result;     // Variable holding the answer
+    int expected;
+};
+
+const CompiledSample COMPILED_SAMPLES[] = {
+        {"add", "add_1025_621.txt", "var a = 1025;\n"
+                                    "var b = 621;\n"
+                                    "var sum;\n"
+                                    "sum = a + b;\n", "sum", 1646},
+        {"multiply", "multiply_11_10.txt", "var a = 11;\n"
+                                           "var b = 10;\n"
+                                           "var product;\n"
+                                           "while (a != 0) {\n"
+                                           "    if (a & 1) {\n"
+                                           "        product = product + b;\n"
+                                           "    }\n"
+                                           "    b = b << 1;\n"
+                                           "    a = a >> 1;\n"
+                                           "}\n", "product", 110},
+        {"xor", "xor_-14_20.txt", "var a = -14;\n"
+                                  "var b = 20;\n"
+                                  "var x;\n"
+                                  "x = (a | b) & (~a | ~b);\n", "x", -26},
+        {"array-sum", nullptr, "var t[5] = {3, 1, 4, 1, 5};\n"
+                               "var i;\n"
+                               "var sum;\n"
+                               "while (i < 5) {\n"
+                               "    sum = sum + t[i];\n"
+                               "    i = i + 1;\n"
+                               "}\n", "sum", 14}};
+
+// Compile a program, for the classic instruction set or the additional instructions; false if it needs instructions
+// the set lacks
+bool compileSample(const CompiledSample &sample, bool classic, CompiledProgram &program) {
+    CompilerOptions compilerOptions;
+    compilerOptions.classic = classic;
+    try {
+        program = compileProgram(sample.source, compilerOptions);
+    } catch (const std::invalid_argument &) {
+        return false;
+    }
+    return true;
+}
+
+std::vector<Result> results;
+Options options;
+volatile unsigned long sink;    // Keeps computed values alive
+
+// Time `body`, which performs `operations` operations per call, and keep the best of the repetitions
+template<typename Body>
+void measure(const std::string &name, long long operations, Body body) {
+    if (!options.filter.empty() && name.find(options.filter) == std::string::npos) {
+        return;
+    }
+    operations = std::max(1LL, operations / options.scale);
+    double best = -1;
+    for (int repetition = 0; repetition < options.repetitions; ++repetition) {
+        auto start = std::chrono::steady_clock::now();
+        body(operations);
+        auto end = std::chrono::steady_clock::now();
+        double ns = (double) std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+        if (best < 0 || ns < best) {
+            best = ns;
+        }
+    }
+    results.push_back({name, operations, best / (double) operations});
+    std::cerr << name << std::string(name.size() < 40 ? 40 - name.size() : 1, ' ')
+              << results.back().nsPerOp << " ns/op" << std::endl;
+}
+
+// Assemble a source held in memory into machine code lines
+std::vector<std::string> assembleSource(const std::string &source) {
+    SymbolTable table;
+    std::vector<std::string> log;
+    std::istringstream input(source);
+    return Assembler::processAssembleCode(table, input, log);
+}
+
+// Join machine code lines into the contents of an "output.txt" file
+std::string joinLines(const std::vector<std::string> &lines) {
+    std::string text;
+    for (const std::string &line: lines) {
+        text += line + '\n';
+    }
+    return text;
+}
+
+// Read a file, returning an empty string if it can't be opened
+std::string readFile(const std::string &path) {
+    std::ifstream file(path);
+    std::stringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+}
+
+// Microbenchmarks for decodeAndExecute, one per opcode
+void benchDecodeAndExecute() {
+    const int DATA_ADDRESS = 5;
+    for (int opcode = 0; opcode < (int) INSTRUCTIONS.size(); ++opcode) {
+        const char *mnemonic = INSTRUCTIONS[opcode].mnemonic;
+        for (int immediate = 0; immediate <= 1; ++immediate) {
+            std::string name = std::string("decodeAndExecute/") + mnemonic + (immediate ? "/immediate" : "");
+            // 5 is SUB again
+            if (opcode == 5 || (immediate && !takesImmediate(opcode))) {
+                continue;
+            }
+            std::string data = translateInstruction("VAR", 3, 0);
+            std::istringstream image(joinLines(std::vector<std::string>(DATA_ADDRESS + 1, data)));
+            ManchesterBaby baby(image);
+            baby.pi = std::bitset<SIZE_32_BIT>(translateInstruction(mnemonic, DATA_ADDRESS, immediate));
+            measure(name, 2000000, [&](long long operations) {
+                for (long long i = 0; i < operations; ++i) {
+                    baby.ci = 0;
+                    baby.decodeAndExecute();
+                }
+            });
+        }
+    }
+}
+
+// Microbenchmark for convertInstruction over every word of a full store
+void benchConvertInstruction() {
+    std::vector<std::bitset<SIZE_32_BIT>> words;
+    for (int i = 0; i < SIZE_32_BIT; ++i) {
+        words.emplace_back(translateInstruction("VAR", i * 40503 - 600000, 0));
+    }
+    measure("convertInstruction", 1000000, [&](long long operations) {
+        unsigned long sum = 0;
+        for (long long i = 0; i < operations; ++i) {
+            sum += ManchesterBaby::convertInstruction(words[i % SIZE_32_BIT]);
+        }
+        sink = sum;
+    });
+}
+
+// Microbenchmark for loadProgram with a full store
+void benchLoadProgram() {
+    WorkloadParams params;
+    params.kind = WorkloadKind::SelfModifying;
+    std::string image = joinLines(assembleSource(generateWorkload(params)));
+    std::istringstream initial(image);
+    ManchesterBaby baby(initial);
+    measure("loadProgram/self-modifying", 20000, [&](long long operations) {
+        for (long long i = 0; i < operations; ++i) {
+            std::istringstream input(image);
+            baby.loadProgram(input);
+        }
+    });
+}
+
+// Starting a built-in program: assembling its source and loading it, against loading its compile-time image
+void benchBuiltInLoad() {
+    std::istringstream initial(machineCodeText(EXTENDED_OPS));
+    ManchesterBaby baby(initial);
+    measure("loadProgram/extended-ops/from-source", 20000, [&](long long operations) {
+        for (long long i = 0; i < operations; ++i) {
+            std::istringstream input(joinLines(assembleSource(std::string(EXTENDED_OPS_SOURCE))));
+            baby.loadProgram(input);
+        }
+    });
+    measure("loadProgram/extended-ops/compile-time", 20000, [&](long long operations) {
+        for (long long i = 0; i < operations; ++i) {
+            baby.loadProgram(storeImage(EXTENDED_OPS));
+        }
+    });
+}
+
+// Compiled programs against the same programs written by hand: the instructions they take and their words, and the
+// time of a run; an operation is one run of a program, loaded from its words
+void benchCompiled() {
+    for (const CompiledSample &sample: COMPILED_SAMPLES) {
+        std::vector<std::pair<std::string, std::string>> variants;
+        if (sample.sample != nullptr) {
+            std::string source = readFile(options.samples + "/" + sample.sample);
+            if (!source.empty()) {
+                variants.emplace_back("hand-written", source);
+            }
+        }
+        CompiledProgram program;
+        for (bool classic: {false, true}) {
+            if (compileSample(sample, classic, program)) {
+                variants.emplace_back(classic ? "compiled-classic" : "compiled", program.source);
+            }
+        }
+        for (const auto &variant: variants) {
+            const std::vector<std::string> machineCode = assembleSource(variant.second);
+            std::vector<std::bitset<32>> image;
+            for (const std::string &line: machineCode) {
+                image.emplace_back(line);
+            }
+            std::istringstream initial(joinLines(machineCode));
+            ManchesterBaby baby(initial);
+            baby.run(1 << 30);
+            std::cerr << "  " << sample.name << "/" << variant.first << ": " << baby.curRound << " instructions, "
+                      << image.size() << " words" << std::endl;
+            measure("compiled/" + std::string(sample.name) + "/" + variant.first, 20000, [&](long long operations) {
+                for (long long i = 0; i < operations; ++i) {
+                    baby.loadProgram(image);
+                    baby.reset();
+                    baby.setHalt(false);
+                    sink = (unsigned long) baby.run(1 << 30);
+                }
+            });
+        }
+    }
+}
+
+// Benchmarks for the assembler, on the samples and on generated sources
+void benchAssembler() {
+    for (const char *sample: {"add_1025_621.txt", "multiply_11_10.txt", "xor_-14_20.txt"}) {
+        std::string source = readFile(options.samples + "/" + sample);
+        if (source.empty()) {
+            std::cerr << "Skipping missing sample " << sample << std::endl;
+            continue;
+        }
+        measure(std::string("processAssembleCode/") + sample, 2000, [&](long long operations) {
+            for (long long i = 0; i < operations; ++i) {
+                assembleSource(source);
+            }
+        });
+    }
+
+    WorkloadParams labels;
+    labels.kind = WorkloadKind::LabelTable;
+    labels.labels = 2000;
+    labels.vars = 500;
+    std::string labelSource = generateWorkload(labels);
+    measure("processAssembleCode/label-table-2000", 20, [&](long long operations) {
+        for (long long i = 0; i < operations; ++i) {
+            assembleSource(labelSource);
+        }
+    });
+
+    WorkloadParams vars;
+    vars.kind = WorkloadKind::VarData;
+    vars.vars = 5000;
+    std::string varSource = generateWorkload(vars);
+    measure("processAssembleCode/var-data-5000", 20, [&](long long operations) {
+        for (long long i = 0; i < operations; ++i) {
+            assembleSource(varSource);
+        }
+    });
+}
+
+// Cells of the wide sum's counter and total, 2^36 words away
+const long long WIDE_COUNTER = 1LL << 36;
+const long long WIDE_TOTAL = WIDE_COUNTER + 1;
+
+// The 41-bit constant the wide sum adds
+const uint64_t WIDE_ADDEND = (1ULL << 40) + 12345;
+
+// A loop adding WIDE_ADDEND to the total until the counter, set before running, goes negative
+std::string wideSumImage() {
+    std::vector<std::string> code = {
+            translateInstruction<Layout64>("VAR", 0, 0),
+            translateInstruction<Layout64>("LDP", WIDE_COUNTER, 0),
+            translateInstruction<Layout64>("SUB", 1, 1),
+            translateInstruction<Layout64>("STO", WIDE_COUNTER, 0),
+            translateInstruction<Layout64>("LDP", WIDE_TOTAL, 0),
+            translateInstruction<Layout64>("ADD", 11, 0),
+            translateInstruction<Layout64>("STO", WIDE_TOTAL, 0),
+            translateInstruction<Layout64>("LDP", WIDE_COUNTER, 0),
+            translateInstruction<Layout64>("CMP", 0, 0),
+            translateInstruction<Layout64>("JMP", 0, 1),
+            translateInstruction<Layout64>("STP", 0, 0),
+            translateInstruction<Layout64>("VAR", (long long) WIDE_ADDEND, 0)};
+    return joinLines(code);
+}
+
+// The wide sum on 64-bit words over a sparse store; an operation is one executed instruction
+void benchWide() {
+    const std::string image = wideSumImage();
+    const long long iterations = 20000 / options.scale;
+    WideBaby baby;
+    auto load = [&]() {
+        std::istringstream input(image);
+        baby.store.clear();
+        baby.loadProgram(input);
+        baby.store.write(WIDE_COUNTER, (uint64_t) iterations - 1);
+        baby.reset();
+    };
+    load();
+    long long steps = baby.run(1LL << 40);
+    if (baby.store.read(WIDE_TOTAL) != (uint64_t) iterations * WIDE_ADDEND) {
+        std::cerr << "  wide-sum computed a wrong total" << std::endl;
+    }
+    measure("run/wide-sum/sparse-64", steps, [&](long long operations) {
+        for (long long done = 0; done < operations;) {
+            load();
+            done += baby.run(operations - done);
+        }
+    });
+}
+
+// End-to-end execution of the runnable workloads; an operation is one executed instruction
+void benchRun() {
+    for (WorkloadKind kind: {WorkloadKind::CountingLoop, WorkloadKind::SelfModifying}) {
+        WorkloadParams params;
+        params.kind = kind;
+        params.iterations = 20000;
+        std::string image = joinLines(assembleSource(generateWorkload(params)));
+        std::istringstream initial(image);
+        ManchesterBaby baby(initial);
+        baby.run(1 << 30);
+        long long steps = baby.curRound;
+        std::cerr << "  " << workloadKindName(kind) << ": " << steps << " instructions, "
+                  << baby.clock.elapsedSeconds() << " s on the original machine" << std::endl;
+        RingEventSink ring(1 << 16);
+        ShadowMemory shadow;
+        PipelineModel pipeline;
+        AccessLog accessLog;
+        AccessTrace trace(accessLog);
+        for (const char *mode: {"", "/loop-acceleration", "/fusion", "/selected", "/ring-events", "/checked",
+                                "/pipeline", "/traced"}) {
+            std::string name = "run/" + workloadKindName(kind) + mode;
+            bool selected = std::string(mode) == "/selected";
+            bool timed = std::string(mode) == "/pipeline";
+            baby.setLoopAcceleration(std::string(mode) == "/loop-acceleration");
+            baby.setFusion(std::string(mode) == "/fusion");
+            // Observer overhead: every event goes into a ring nobody reads, so most are dropped
+            baby.setObserver(std::string(mode) == "/ring-events" ? static_cast<MachineObserver *>(&ring) :
+                            timed ? &pipeline : nullptr);
+            baby.setShadow(std::string(mode) == "/checked" ? &shadow : nullptr);
+            baby.setAccessTrace(std::string(mode) == "/traced" ? &trace : nullptr);
+            measure(name, steps, [&](long long operations) {
+                for (long long done = 0; done < operations;) {
+                    std::istringstream input(image);
+                    baby.loadProgram(input);
+                    if (selected) {
+                        baby.selectFastestMode();
+                    }
+                    baby.reset();
+                    baby.setHalt(false);
+                    if (timed) {
+                        pipeline.restart();
+                    }
+                    done += baby.run((int) std::min<long long>(operations - done, 1 << 30));
+                }
+            });
+            if (timed && pipeline.instructions() > 0) {
+                std::cerr << "  pipeline model CPI: " << pipeline.cpi() << std::endl;
+            }
+            if (baby.instructionFuser().fusedExecuted > 0) {
+                const InstructionFuser &fuser = baby.instructionFuser();
+                std::cerr << "  fused handlers run: " << fuser.fusedExecuted << ", dispatches saved: "
+                          << fuser.instructionsFused - fuser.fusedExecuted << std::endl;
+            }
+        }
+        // The same program on the generic engine (widebaby.h)
+        Baby32 generic;
+        measure("run/" + workloadKindName(kind) + "/generic-32", steps, [&](long long operations) {
+            for (long long done = 0; done < operations;) {
+                std::istringstream input(image);
+                generic.loadProgram(input);
+                generic.reset();
+                done += generic.run(operations - done);
+            }
+        });
+    }
+    benchWide();
+}
+
+// Every observable part of a machine's state, for comparing two runs
+std::string machineState(const ManchesterBaby &baby) {
+    std::ostringstream state;
+    state << "round " << baby.curRound << " ci " << baby.ci << " prev_ci " << baby.prev_ci << " pi " << baby.pi
+          << " opcode " << baby.curOpCode << " operand " << baby.curOperand << " immediate " << baby.curImAddressing
+          << " accumulator " << baby.accumulator << " halted " << baby.isHalted() << " cycles " << baby.clock.cycles()
+          << "\n";
+    for (const std::bitset<SIZE_32_BIT> &word: baby.memory) {
+        state << word << "\n";
+    }
+    return state.str();
+}
+
+// State of the reference interpreter as values, to compare with the generic engine
+std::string valueState(const ManchesterBaby &baby) {
+    std::ostringstream state;
+    state << "round " << baby.curRound << " ci " << baby.ci << " prev_ci " << baby.prev_ci << " pi "
+          << ManchesterBaby::convertInstruction(baby.pi) << " opcode " << baby.curOpCode << " operand "
+          << baby.curOperand << " immediate " << baby.curImAddressing << " accumulator "
+          << ManchesterBaby::convertInstruction(baby.accumulator) << " halted " << baby.isHalted() << " cycles "
+          << baby.clock.cycles() << "\n";
+    for (const std::bitset<SIZE_32_BIT> &word: baby.memory) {
+        state << ManchesterBaby::convertInstruction(word) << "\n";
+    }
+    return state.str();
+}
+
+// State of the generic engine, in the same form, for the first words of its store
+std::string valueState(const Baby32 &baby, size_t words) {
+    std::ostringstream state;
+    state << "round " << baby.round << " ci " << baby.ci << " prev_ci " << baby.prevCi << " pi " << baby.pi
+          << " opcode " << baby.opcode << " operand " << baby.operand << " immediate " << baby.immediate
+          << " accumulator " << baby.accumulator << " halted " << baby.isHalted() << " cycles " << baby.clock.cycles()
+          << "\n";
+    for (size_t address = 0; address < words; ++address) {
+        state << baby.store.read(address) << "\n";
+    }
+    return state.str();
+}
+
+// Totals of the events of a run, which must not depend on the engine mode
+class EventTotals : public MachineObserver {
+public:
+    long long instructions{0};
+    int halts{0};
+    int illegalOpcodes{0};
+
+    void onStep(const ManchesterBaby &, int count) override {
+        instructions += count;
+    }
+
+    void onHalt(const ManchesterBaby &) override {
+        halts++;
+    }
+
+    void onIllegalOpcode(const ManchesterBaby &, unsigned long) override {
+        illegalOpcodes++;
+    }
+
+    [[nodiscard]] std::string text() const {
+        return "events " + std::to_string(instructions) + " " + std::to_string(halts) + " " +
+               std::to_string(illegalOpcodes) + "\n";
+    }
+};
+
+// A device holding one value, counting its writes
+class RegisterDevice : public Device {
+public:
+    explicit RegisterDevice(uint32_t value) : value(value) {}
+
+    uint32_t read(const ManchesterBaby &) override {
+        return value;
+    }
+
+    void write(const ManchesterBaby &, uint32_t written) override {
+        value = written;
+        writes++;
+    }
+
+    uint32_t value;
+    int writes{0};
+};
+
+// Input that arrives a piece at a time, like a console: asking for more than has arrived is an error, as it would
+// block a real caller
+class PieceBuffer : public std::streambuf {
+public:
+    void arrive(const std::string &piece) {
+        pieces.push_back(piece);
+    }
+
+    bool starved{false};
+
+protected:
+    int_type underflow() override {
+        if (next == pieces.size()) {
+            starved = true;
+            return traits_type::eof();
+        }
+        std::string &piece = pieces[next++];
+        setg(&piece[0], &piece[0], &piece[0] + piece.size());
+        return traits_type::to_int_type(piece[0]);
+    }
+
+private:
+    std::vector<std::string> pieces;
+    size_t next{0};
+};
+
+// Devices on their own: CHARIN takes only the input that has arrived, and XCH and XAD read and write a device
+int verifyDevices() {
+    int failures = 0;
+    std::istringstream image(std::string{});
+    ManchesterBaby idle(image);
+    PieceBuffer console;
+    std::istream consoleIn(&console);
+    CharInputDevice input(consoleIn, 4096);
+    std::string read;
+    for (const std::string piece: {"first\n", "\n", "second line\n"}) {
+        console.arrive(piece);
+        for (size_t i = 0; i < piece.size(); ++i) {
+            read += (char) input.read(idle);
+        }
+    }
+    if (console.starved || read != "first\n\nsecond line\n" || input.read(idle) != 0xFFFFFFFFU) {
+        std::cerr << "MISMATCH character input" << std::endl;
+        failures++;
+    }
+
+    std::istringstream exchangeImage(machineCodeText(EXCHANGE));
+    ManchesterBaby baby(exchangeImage);
+    auto device = std::make_unique<RegisterDevice>(5);
+    RegisterDevice &port = *device;
+    baby.devices.map(CYCLE_COUNTER_ADDRESS, std::move(device));
+    baby.run(100);
+    if (!baby.isHalted() || port.value != 5 || port.writes != 2 ||
+        (int32_t) ManchesterBaby::convertInstruction(baby.memory[7]) != 12) {
+        std::cerr << "MISMATCH exchange with a device" << std::endl;
+        failures++;
+    }
+    return failures;
+}
+
+// Programs that leave the store must fail with an error in every engine mode, however large the store
+int verifyLeavingStore() {
+    // A jump through a negative word takes CI below the store
+    const std::string jumpBelow = joinLines(assembleSource("          VAR 0\n"
+                                                           "          JMP NEG\n"
+                                                           "NEG:      VAR -3\n"));
+    int failures = 0;
+    for (size_t words: {(size_t) SIZE_32_BIT, (size_t) 1 << Layout32::operandBits}) {
+        for (int mode = 0; mode < 4; ++mode) {
+            std::istringstream image(jumpBelow);
+            ManchesterBaby baby(image);
+            baby.memory.resize(words);
+            baby.setLoopAcceleration(mode == 1);
+            baby.setFusion(mode == 2);
+            if (mode == 3) {
+                baby.selectFastestMode();
+            }
+            bool failed = false;
+            try {
+                baby.run(100);
+            } catch (const std::runtime_error &) {
+                failed = true;
+            }
+            if (!failed || !baby.isHalted()) {
+                std::cerr << "MISMATCH jump below the store (" << words << " words, mode " << mode << ")" << std::endl;
+                failures++;
+            }
+        }
+    }
+    return failures;
+}
+
+// The C interface (see babyapi.h): every error path gives its code, and no program, however wild, does worse
+int verifyLibrary() {
+    int failures = 0;
+    auto expect = [&failures](const char *check, int status, int expected) {
+        if (status != expected) {
+            std::cerr << "MISMATCH library " << check << ": status " << status << ", expected " << expected
+                      << std::endl;
+            failures++;
+        }
+    };
+    int64_t value = 0;
+    expect("version", baby_api_version(), BABY_API_VERSION);
+    expect("no machine", baby_run(nullptr, 1, nullptr), BABY_ERROR_ARGUMENT);
+    expect("no register", baby_get_register(nullptr, BABY_REG_CI, &value), BABY_ERROR_ARGUMENT);
+
+    baby_machine *machine = baby_create();
+    expect("no words", baby_load_words(machine, nullptr, 2), BABY_ERROR_ARGUMENT);
+    expect("short line", baby_load_image(machine, "0101\n", 5), BABY_ERROR_IMAGE);
+    expect("unknown register", baby_set_register(machine, 99, 0), BABY_ERROR_ARGUMENT);
+    expect("CI past the store", baby_set_register(machine, BABY_REG_CI, 32), BABY_ERROR_ARGUMENT);
+    expect("write past the store", baby_write_memory(machine, 32, 1), BABY_ERROR_ARGUMENT);
+
+    baby_assembly *assembly = nullptr;
+    const std::string unknown = "          VAR 0\n          FOO 3\n";
+    expect("unknown instruction", baby_assemble(unknown.data(), unknown.size(), &assembly), BABY_ERROR_ASSEMBLY);
+    baby_assembly_free(assembly);
+    const std::string divide = "          VAR 0\n          DIV #0\n          STP\n";
+    expect("assembly", baby_assemble(divide.data(), divide.size(), &assembly), BABY_OK);
+    size_t count = 0;
+    const int32_t *words = baby_assembly_words(assembly, &count);
+    expect("load", baby_load_words(machine, words, count), BABY_OK);
+    expect("division by zero", baby_run_to_halt(machine, nullptr), BABY_ERROR_RUNTIME);
+    baby_assembly_free(assembly);
+
+    // LDN 5000; STP, and a jump through a negative word: operand and CI outside the 32-word store
+    const int32_t loadPast[] = {(LDN << 13) | 5000, STP << 13};
+    const int32_t jumpBelow[] = {0, (JMP << 13) | 2, -3};
+    for (const auto &program: {std::vector<int32_t>(loadPast, loadPast + 2),
+                               std::vector<int32_t>(jumpBelow, jumpBelow + 3)}) {
+        expect("load", baby_load_words(machine, program.data(), program.size()), BABY_OK);
+        expect("run outside the store", baby_run(machine, 100, nullptr), BABY_ERROR_RUNTIME);
+        if (std::string(baby_last_error(machine)).find("outside the store") == std::string::npos ||
+            baby_get_register(machine, BABY_REG_HALTED, &value) != BABY_OK || value != 1) {
+            std::cerr << "MISMATCH library error: " << baby_last_error(machine) << std::endl;
+            failures++;
+        }
+        baby_job job{program.data(), program.size(), 100, nullptr, 0, 0, 0, 0, 0, 0, 0};
+        expect("batch", baby_run_batch(&job, 1, 1), BABY_OK);
+        expect("batch job outside the store", job.status, BABY_ERROR_RUNTIME);
+    }
+    baby_destroy(machine);
+    return failures;
+}
+
+// Run an image on a job server's store (an address for every operand) for up to maxSteps steps, counting the steps
+// as StepBoundAnalysis does. A run that fails, e.g. on a division by zero, stops there. Returns whether it stopped.
+bool runBounded(const std::vector<std::bitset<SIZE_32_BIT>> &image, long long maxSteps, long long &steps) {
+    std::istringstream noProgram;
+    ManchesterBaby baby(noProgram);
+    baby.memory.assign((size_t) 1 << Layout32::operandBits, std::bitset<SIZE_32_BIT>());
+    baby.loadProgram(image);
+    baby.reset();
+    baby.setHalt(false);
+    for (steps = 0; steps < maxSteps && !baby.isHalted(); ++steps) {
+        try {
+            baby.step();
+        } catch (const std::runtime_error &) {
+            // An instruction that fails is a step, a CI outside the store is not
+            steps += baby.ci >= 0 ? 1 : 0;
+            return true;
+        }
+    }
+    return baby.isHalted();
+}
+
+// Step bounds (see stepbound.h) against real runs: a bounded program halts within its bound, and one that never halts
+// doesn't halt. Programs that once got these wrong come first, then small random ones.
+int verifyStepBound() {
+    const std::vector<std::vector<int32_t>> known = {
+            {(SUB << 13) | 6, CMP << 13, (LDN << 13) | 3, CMP << 13, (JMP << 13) | 3, STP << 13, 24576, 10},
+            {(LDN << 13) | 5, (SUB << 13) | 4, CMP << 13, -3, CMP << 13, 9, 6}};
+    std::vector<std::vector<int32_t>> programs = known;
+    std::mt19937 random(2024);
+    while (programs.size() < 20000) {
+        std::vector<int32_t> program(3 + random() % 8);
+        for (int32_t &word: program) {
+            switch (random() % 4) {
+                case 0:
+                case 1:
+                    // An instruction on the program's cells, now and then immediate
+                    word = (int32_t) ((random() % (XAD + 1)) << 13 | random() % (program.size() + 1) |
+                                      (random() % 4 == 0 ? 1U << 30 : 0));
+                    break;
+                case 2:
+                    word = (int32_t) (random() % 41) - 20;
+                    break;
+                default:
+                    word = (int32_t) random();
+                    break;
+            }
+        }
+        programs.push_back(program);
+    }
+
+    int failures = 0;
+    const long long NEVER_STEPS = 20000;
+    for (size_t index = 0; index < programs.size(); ++index) {
+        std::vector<std::bitset<SIZE_32_BIT>> image;
+        for (int32_t value: programs[index]) {
+            image.emplace_back(reverseWord((uint32_t) value));
+        }
+        StepBoundAnalysis bound(image);
+        long long steps = 0;
+        bool wrong = false;
+        if (bound.neverHalts()) {
+            wrong = runBounded(image, NEVER_STEPS, steps);
+        } else if (bound.isBounded()) {
+            // Bounds too large to run are only checked as far as they can be
+            const long long worst = bound.worstCaseSteps();
+            const bool stopped = runBounded(image, std::min(worst + 1, 1000000LL), steps);
+            wrong = stopped ? steps > worst : worst <= 1000000;
+        }
+        if (wrong || (index < known.size() && !bound.isBounded() && !bound.neverHalts())) {
+            std::cerr << "MISMATCH step bound of";
+            for (int32_t value: programs[index]) {
+                std::cerr << " " << value;
+            }
+            std::cerr << ": " << bound.report().back() << ", ran " << steps << " steps" << std::endl;
+            failures++;
+        }
+    }
+    return failures;
+}
+
+// Every instruction of the table (see isa.h), with and without immediate addressing, on random values: the generic
+// engine's own copy of the semantics must agree with the table the engine runs
+int verifyInstructionSet() {
+    int failures = 0;
+    std::mt19937 random(45);
+    for (int opcode = 0; opcode < (int) INSTRUCTIONS.size(); ++opcode) {
+        for (bool immediate: {false, true}) {
+            if (immediate && !takesImmediate(opcode)) {
+                continue;
+            }
+            for (int trial = 0; trial < 64; ++trial) {
+                // CI is signed on the engine and unsigned on the generic engine, so jumps stay in the store
+                const bool jump = INSTRUCTIONS[opcode].effect == Effect::Jump;
+                const uint32_t accumulator = trial % 2 == 0 ? (uint32_t) random() : (uint32_t) (random() % 9) - 4;
+                const uint32_t word = jump ? (uint32_t) (random() % 24) : trial % 4 == 1 ? 0 : (uint32_t) random();
+                const uint32_t instruction = (uint32_t) opcode << 13 | 3 | (immediate ? 1U << 30 : 0);
+
+                std::vector<std::bitset<SIZE_32_BIT>> image(SIZE_32_BIT);
+                image[0] = reverseWord(instruction);
+                image[3] = reverseWord(word);
+                std::istringstream noProgram;
+                ManchesterBaby baby(noProgram);
+                baby.loadProgram(image);
+                baby.reset();
+                baby.setHalt(false);
+                baby.accumulator = reverseWord(accumulator);
+                Baby32 generic;
+                generic.store.write(0, instruction);
+                generic.store.write(3, word);
+                generic.accumulator = accumulator;
+                bool failed = false;
+                bool genericFailed = false;
+                try {
+                    baby.step();
+                } catch (const std::runtime_error &) {
+                    failed = true;
+                }
+                try {
+                    generic.step();
+                } catch (const std::runtime_error &) {
+                    genericFailed = true;
+                }
+                if (failed != genericFailed ||
+                    (!failed && valueState(baby) != valueState(generic, baby.memory.size()))) {
+                    std::cerr << "MISMATCH instruction " << INSTRUCTIONS[opcode].mnemonic
+                              << (immediate ? " (immediate)" : "") << " with A = " << (int32_t) accumulator
+                              << ", S = " << (int32_t) word << std::endl;
+                    failures++;
+                    break;
+                }
+            }
+        }
+        // The assembler knows every mnemonic by its opcode (5 is SUB again)
+        if (opcode != 5 && opcodeOf(INSTRUCTIONS[opcode].mnemonic) != opcode) {
+            std::cerr << "MISMATCH mnemonic " << INSTRUCTIONS[opcode].mnemonic << std::endl;
+            failures++;
+        }
+    }
+    return failures;
+}
+
+// Loop acceleration (see loopaccel.h) fast-forwards a long counting loop almost entirely, and leaves a loop that
+// rewrites its own code to the interpreter; the differential check makes sure the results are the same
+int verifyLoopAcceleration() {
+    int failures = 0;
+    for (WorkloadKind kind: {WorkloadKind::CountingLoop, WorkloadKind::SelfModifying}) {
+        WorkloadParams params;
+        params.kind = kind;
+        params.iterations = 100000;
+        std::istringstream image(joinLines(assembleSource(generateWorkload(params))));
+        ManchesterBaby baby(image);
+        baby.setLoopAcceleration(true);
+        const int steps = baby.run(1 << 30);
+        const LoopAccelerator &accelerator = baby.loopAccelerator();
+        const bool fastForwarded = kind == WorkloadKind::CountingLoop ?
+                                   accelerator.loopsAccelerated > 0 && accelerator.stepsSkipped * 100 >= steps * 99LL :
+                                   accelerator.loopsAccelerated == 0;
+        if (!baby.isHalted() || !fastForwarded) {
+            std::cerr << "MISMATCH loop acceleration of " << workloadKindName(kind) << ": "
+                      << accelerator.loopsAccelerated << " loops, " << accelerator.stepsSkipped << " of " << steps
+                      << " steps skipped" << std::endl;
+            failures++;
+        }
+    }
+    return failures;
+}
+
+// Addresses a run fetched from and wrote to
+class AccessSets : public AccessSink {
+public:
+    void onAccesses(const MemoryAccess *accesses, size_t count) override {
+        for (size_t index = 0; index < count; ++index) {
+            if (accesses[index].kind == MemoryAccess::Kind::Fetch) {
+                fetched.insert(accesses[index].address);
+            } else if (accesses[index].kind == MemoryAccess::Kind::Write) {
+                written.insert(accesses[index].address);
+            }
+        }
+    }
+
+    std::set<uint32_t> fetched;
+    std::set<uint32_t> written;
+};
+
+// Image analysis (see analysis.h) against real runs: every address fetched was found to be code, and a program found
+// not to modify itself writes no code. The workloads must also get the verdicts they were written to get.
+int verifyImageAnalysis(const std::vector<std::pair<std::string, std::string>> &programs) {
+    int failures = 0;
+    for (const auto &program: programs) {
+        std::istringstream image(joinLines(assembleSource(program.second)));
+        ManchesterBaby baby(image);
+        const ImageAnalysis analysis(baby.memory);
+        AccessSets accesses;
+        AccessTrace trace(accesses);
+        baby.setAccessTrace(&trace);
+        try {
+            baby.run(1 << 20);
+        } catch (const std::runtime_error &) {
+            // What ran before the failure is still checked
+        }
+        trace.flush();
+        bool sound = std::all_of(accesses.fetched.begin(), accesses.fetched.end(), [&analysis](uint32_t address) {
+            return analysis.isCode(address);
+        });
+        if (!analysis.isSelfModifying()) {
+            sound = sound && std::none_of(accesses.written.begin(), accesses.written.end(), [&](uint32_t address) {
+                return accesses.fetched.count(address) > 0 || analysis.isCode(address);
+            });
+        }
+        const bool expected = program.first.rfind("self-modifying/", 0) == 0 ? analysis.isSelfModifying() :
+                              program.first.rfind("counting-loop/", 0) != 0 ||
+                              (!analysis.isSelfModifying() && !analysis.isImprecise() && analysis.hasBackwardJumps());
+        if (!sound || !expected) {
+            std::cerr << "MISMATCH image analysis of " << program.first << std::endl;
+            failures++;
+        }
+    }
+    return failures;
+}
+
+// The virtual clock (see clock.h) charges what the cycle table says, whichever fast path runs the instructions, and
+// pacing turns those cycles into the wall time of the modelled machine
+int verifyClock() {
+    int failures = 0;
+    WorkloadParams params;
+    params.iterations = 1000;
+    // The counting loop has no division; the extended operations divide once and take one remainder
+    const std::pair<std::string, uint64_t> programs[] = {{generateWorkload(params), 0},
+                                                         {std::string(EXTENDED_OPS_SOURCE), 2 * 32}};
+    for (const auto &program: programs) {
+        for (bool fastest: {false, true}) {
+            std::istringstream image(joinLines(assembleSource(program.first)));
+            ManchesterBaby baby(image);
+            baby.clock.setTable(CycleTable::extended());
+            if (fastest) {
+                baby.selectFastestMode();
+            }
+            const int steps = baby.run(1 << 30);
+            const uint64_t expected = 4 * (uint64_t) steps + program.second;
+            if (!baby.isHalted() || baby.clock.cycles() != expected ||
+                std::abs(baby.clock.elapsedSeconds() - (double) expected * 0.0003) > 1e-9) {
+                std::cerr << "MISMATCH clock: " << baby.clock.cycles() << " cycles for " << steps
+                          << " steps, expected " << expected << std::endl;
+                failures++;
+            }
+        }
+    }
+    // An instruction of the original machine takes 1.2 ms, half that at twice the speed
+    const CycleTable original = CycleTable::original();
+    if (PacingPolicy::scaled(1).wallTime(4, original) != std::chrono::microseconds(1200) ||
+        PacingPolicy::scaled(2).wallTime(4, original) != std::chrono::microseconds(600) ||
+        PacingPolicy::unthrottled().wallTime(4, original) != std::chrono::nanoseconds(0)) {
+        std::cerr << "MISMATCH pacing" << std::endl;
+        failures++;
+    }
+    return failures;
+}
+
+// The generic engine on 64-bit words (see widebaby.h): the wide sum needs operands and values past 32 bits
+int verifyWideEngine() {
+    int failures = 0;
+    for (long long iterations: {1LL, 2LL, 1000LL}) {
+        std::istringstream image(wideSumImage());
+        WideBaby baby;
+        baby.loadProgram(image);
+        baby.store.write(WIDE_COUNTER, (uint64_t) iterations - 1);
+        // Nine instructions a trip, and the STP
+        const long long steps = baby.run(1LL << 40);
+        if (!baby.isHalted() || baby.haltedOnIllegalOpcode() || steps != 9 * iterations + 1 ||
+            baby.store.read(WIDE_TOTAL) != (uint64_t) iterations * WIDE_ADDEND ||
+            baby.store.read(WIDE_COUNTER) != ~0ULL) {
+            std::cerr << "MISMATCH wide sum of " << iterations << " after " << steps << " steps" << std::endl;
+            failures++;
+        }
+    }
+    return failures;
+}
+
+// The superoptimiser's engine (see superopt/miniengine.h) against the real one, on small random programs over data
+// cells after the code. Runs that fault on it are left out: the real engine carries on where it stops.
+int verifyMiniEngine() {
+    int failures = 0;
+    int halted = 0;
+    std::mt19937 random(38);
+    const int MAX_STEPS = 100;
+    for (int trial = 0; trial < 20000; ++trial) {
+        const int codeLength = 2 + (int) (random() % 6);
+        std::vector<MiniInstruction> code(codeLength);
+        for (MiniInstruction &ins: code) {
+            ins.opcode = (uint8_t) (random() % INSTRUCTIONS.size());
+            ins.immediate = takesImmediate(ins.opcode) && random() % 3 == 0;
+            ins.operand = (uint16_t) (ins.immediate ? random() % (codeLength + 2) :
+                                      codeLength + random() % (MINI_STORE_WORDS - codeLength));
+        }
+        uint32_t store[MINI_STORE_WORDS] = {};
+        for (int address = codeLength; address < MINI_STORE_WORDS; ++address) {
+            store[address] = random() % 2 == 0 ? (uint32_t) random() : (uint32_t) (random() % 9) - 4;
+        }
+        const uint32_t start = random() % 2 == 0 ? (uint32_t) random() : (uint32_t) (random() % 9) - 4;
+
+        std::vector<std::bitset<SIZE_32_BIT>> image(MINI_STORE_WORDS);
+        for (int address = 0; address < MINI_STORE_WORDS; ++address) {
+            const MiniInstruction &ins = code[std::min(address, codeLength - 1)];
+            image[address] = reverseWord(address < codeLength ?
+                                         (uint32_t) ins.opcode << 13 | ins.operand | (ins.immediate ? 1U << 30 : 0) :
+                                         store[address]);
+        }
+        uint32_t accumulator = start;
+        int steps = 0;
+        const MiniOutcome outcome = runMini(code.data(), codeLength, store, accumulator, MAX_STEPS, steps);
+        if (outcome == MiniOutcome::Fault) {
+            continue;
+        }
+        halted += outcome == MiniOutcome::Halted;
+
+        std::istringstream noProgram;
+        ManchesterBaby baby(noProgram);
+        baby.loadProgram(image);
+        baby.reset();
+        baby.setHalt(false);
+        baby.accumulator = reverseWord(start);
+        const int realSteps = baby.run(steps);
+        bool same = realSteps == steps && baby.isHalted() == (outcome == MiniOutcome::Halted) &&
+                    ManchesterBaby::convertInstruction(baby.accumulator) == accumulator;
+        for (int address = codeLength; address < MINI_STORE_WORDS; ++address) {
+            same = same && ManchesterBaby::convertInstruction(baby.memory[address]) == store[address];
+        }
+        if (!same) {
+            std::cerr << "MISMATCH superoptimiser engine on";
+            for (const MiniInstruction &ins: code) {
+                std::cerr << " " << INSTRUCTIONS[ins.opcode].mnemonic << (ins.immediate ? " #" : " ") << ins.operand;
+            }
+            std::cerr << " from A = " << (int32_t) start << std::endl;
+            failures++;
+        }
+    }
+    // Most programs fault, but enough must halt for the check to mean something
+    if (halted < 1000) {
+        std::cerr << "MISMATCH superoptimiser engine: only " << halted << " programs halted" << std::endl;
+        failures++;
+    }
+    return failures;
+}
+
+// The peephole pass (see peephole.h) against the unoptimised code: a program that halts must halt in no more steps,
+// with the same accumulator and the same values in the data after its code. Data holding addresses is relocated, so
+// only words that start the same are compared.
+int verifyPeephole(const std::vector<std::pair<std::string, std::string>> &programs) {
+    int failures = 0;
+    int changed = 0;
+    for (const auto &program: programs) {
+        std::vector<std::string> images[2];
+        for (bool optimize: {false, true}) {
+            SymbolTable table;
+            std::vector<std::string> log;
+            std::istringstream input(program.second);
+            images[optimize] = Assembler::processAssembleCode(table, input, log, optimize);
+        }
+        if (images[0] == images[1]) {
+            continue;
+        }
+        changed++;
+        std::unique_ptr<ManchesterBaby> babies[2];
+        long long steps[2] = {};
+        AccessSets accesses;
+        AccessTrace trace(accesses);
+        for (int optimized: {0, 1}) {
+            std::istringstream image(joinLines(images[optimized]));
+            babies[optimized] = std::make_unique<ManchesterBaby>(image);
+            if (optimized == 0) {
+                babies[optimized]->setAccessTrace(&trace);
+            }
+            try {
+                steps[optimized] = babies[optimized]->run(1 << 20);
+            } catch (const std::runtime_error &) {
+                steps[optimized] = -1;
+            }
+        }
+        const ManchesterBaby &plain = *babies[0];
+        const ManchesterBaby &optimized = *babies[1];
+        if (steps[0] < 0 || !plain.isHalted()) {
+            continue;
+        }
+        bool same = steps[1] >= 0 && optimized.isHalted() && steps[1] <= steps[0] &&
+                    optimized.curOpCode == plain.curOpCode && optimized.accumulator == plain.accumulator;
+        const size_t plainWords = images[0].size();
+        const size_t optimizedWords = images[1].size();
+        for (size_t back = 1; back <= std::min(plainWords, optimizedWords); ++back) {
+            const size_t address = plainWords - back;
+            if (accesses.fetched.count((uint32_t) address) != 0) {
+                break;
+            }
+            if (images[0][address] == images[1][optimizedWords - back]) {
+                same = same && plain.memory[address] == optimized.memory[optimizedWords - back];
+            }
+        }
+        if (!same) {
+            std::cerr << "MISMATCH peephole on " << program.first << ": " << steps[1] << " steps against "
+                      << steps[0] << std::endl;
+            failures++;
+        }
+    }
+    // The pass must have had something to do
+    if (changed == 0) {
+        std::cerr << "MISMATCH peephole changed no program" << std::endl;
+        failures++;
+    }
+    return failures;
+}
+
+// Differential check of the optional engine modes against plain interpretation
+int verify() {
+    std::vector<std::pair<std::string, std::string>> programs;
+    for (int iterations: {1, 2, 3, 17, 1000}) {
+        for (int step: {0, 3, -5, 1 << 30}) {
+            WorkloadParams params;
+            params.iterations = iterations;
+            params.step = step;
+            programs.emplace_back("counting-loop/" + std::to_string(iterations) + "/" + std::to_string(step),
+                                  generateWorkload(params));
+        }
+        WorkloadParams params;
+        params.kind = WorkloadKind::SelfModifying;
+        params.iterations = iterations;
+        programs.emplace_back("self-modifying/" + std::to_string(iterations), generateWorkload(params));
+    }
+    programs.emplace_back("extended-ops", std::string(EXTENDED_OPS_SOURCE));
+    programs.emplace_back("widening", std::string(WIDENING_SOURCE));
+    programs.emplace_back("peephole", std::string(PEEPHOLE_SOURCE));
+    for (const CompiledSample &sample: COMPILED_SAMPLES) {
+        CompiledProgram program;
+        for (bool classic: {false, true}) {
+            if (compileSample(sample, classic, program)) {
+                programs.emplace_back(std::string("compiled/") + sample.name + (classic ? "/classic" : ""),
+                                      program.source);
+            }
+        }
+    }
+    for (const char *sample: {"add_1025_621.txt", "multiply_11_10.txt", "xor_-14_20.txt"}) {
+        std::string source = readFile(options.samples + "/" + sample);
+        if (!source.empty()) {
+            programs.emplace_back(sample, source);
+        }
+    }
+
+    // Engine modes: the instruction set picked on loading alone, then forced to each variant, loop acceleration,
+    // fusion, both, and finally the modes selectFastestMode() picks
+    struct Mode {
+        bool loopAcceleration;
+        bool fusion;
+        int isa;    // -1 for the one picked on loading
+    };
+    const Mode modes[] = {{false, false, -1}, {false, false, (int) IsaVariant::Classic},
+                          {false, false, (int) IsaVariant::ClassicImmediate}, {false, false, (int) IsaVariant::Extended},
+                          {true, false, -1}, {false, true, -1}, {true, true, -1}, {true, true, (int) IsaVariant::Classic}};
+    // A different cost for every opcode, so that the virtual clock checks which instructions were charged
+    CycleTable costs = CycleTable::original();
+    for (size_t opcode = 0; opcode < costs.cycles.size(); ++opcode) {
+        costs.cycles[opcode] = 1U << (opcode % 16);
+    }
+    int failures = 0;
+    for (const auto &program: programs) {
+        std::string image = joinLines(assembleSource(program.second));
+        for (int budget: {1, 2, 3, 5, 8, 13, 21, 100, 1000, 1 << 30}) {
+            std::istringstream plainImage(image);
+            ManchesterBaby plain(plainImage);
+            EventTotals plainEvents;
+            plain.clock.setTable(costs);
+            plain.setObserver(&plainEvents);
+            // The reference interpreter: fetch, decodeAndExecute and increment_ci, one instruction at a time
+            for (int steps = 0; steps < budget && !plain.isHalted(); ++steps) {
+                plain.step();
+            }
+            const std::string expected = machineState(plain) + plainEvents.text();
+            for (const auto &mode: modes) {
+                std::istringstream modeImage(image);
+                ManchesterBaby baby(modeImage);
+                EventTotals events;
+                baby.clock.setTable(costs);
+                baby.setObserver(&events);
+                baby.setLoopAcceleration(mode.loopAcceleration);
+                baby.setFusion(mode.fusion);
+                if (mode.isa >= 0) {
+                    baby.setIsa((IsaVariant) mode.isa);
+                }
+                baby.run(budget);
+                if (expected != machineState(baby) + events.text()) {
+                    std::cerr << "MISMATCH " << program.first << " (loop acceleration " << mode.loopAcceleration
+                              << ", fusion " << mode.fusion << ", instruction set " << mode.isa << ", budget " << budget
+                              << ")" << std::endl;
+                    failures++;
+                }
+            }
+            std::istringstream selectedImage(image);
+            ManchesterBaby selected(selectedImage);
+            EventTotals selectedEvents;
+            selected.clock.setTable(costs);
+            selected.setObserver(&selectedEvents);
+            selected.selectFastestMode();
+            selected.run(budget);
+            if (expected != machineState(selected) + selectedEvents.text()) {
+                std::cerr << "MISMATCH " << program.first << " (selected modes, budget " << budget << ")" << std::endl;
+                failures++;
+            }
+            // Traced mode, which only watches too, and must see the same accesses as the reference interpreter
+            std::istringstream tracedImage(image);
+            ManchesterBaby traced(tracedImage);
+            EventTotals tracedEvents;
+            AccessLog tracedAccesses(true);
+            AccessTrace tracedTrace(tracedAccesses);
+            traced.clock.setTable(costs);
+            traced.setObserver(&tracedEvents);
+            traced.setAccessTrace(&tracedTrace);
+            traced.run(budget);
+            std::istringstream steppedImage(image);
+            ManchesterBaby stepped(steppedImage);
+            AccessLog steppedAccesses(true);
+            AccessTrace steppedTrace(steppedAccesses);
+            stepped.setAccessTrace(&steppedTrace);
+            for (int steps = 0; steps < budget && !stepped.isHalted(); ++steps) {
+                stepped.step();
+            }
+            steppedTrace.flush();
+            if (expected != machineState(traced) + tracedEvents.text() ||
+                tracedAccesses.text != steppedAccesses.text) {
+                std::cerr << "MISMATCH " << program.first << " (traced, budget " << budget << ")" << std::endl;
+                failures++;
+            }
+            // Checked mode, which only watches: none of these programs leaves the store
+            std::istringstream checkedImage(image);
+            ManchesterBaby checked(checkedImage);
+            EventTotals checkedEvents;
+            ShadowMemory shadow;
+            checked.clock.setTable(costs);
+            checked.setObserver(&checkedEvents);
+            checked.setShadow(&shadow);
+            checked.run(budget);
+            if (expected != machineState(checked) + checkedEvents.text()) {
+                std::cerr << "MISMATCH " << program.first << " (checked, budget " << budget << ")" << std::endl;
+                failures++;
+            }
+            // The generic engine on 32-bit words
+            std::istringstream genericImage(image);
+            Baby32 generic;
+            generic.clock.setTable(costs);
+            generic.loadProgram(genericImage);
+            generic.run(budget);
+            if (valueState(plain) != valueState(generic, plain.memory.size())) {
+                std::cerr << "MISMATCH " << program.first << " (generic engine, budget " << budget << ")" << std::endl;
+                failures++;
+            }
+        }
+    }
+    failures += verifyImageAnalysis(programs);
+    failures += verifyPeephole(programs);
+
+    // Memory-mapped devices: echo the input to the output through CHARIN and CHAROUT, until the end of the input
+    const std::string echo = machineCodeText(ECHO);
+    const std::string text = "The Manchester Baby\n";
+    for (const auto &mode: modes) {
+        std::istringstream modeImage(echo);
+        ManchesterBaby baby(modeImage);
+        std::istringstream in(text);
+        std::ostringstream out;
+        baby.devices.map(CHAR_INPUT_ADDRESS, std::make_unique<CharInputDevice>(in, 4));
+        baby.devices.map(CHAR_OUTPUT_ADDRESS, std::make_unique<CharOutputDevice>(out, 4));
+        baby.setLoopAcceleration(mode.loopAcceleration);
+        baby.setFusion(mode.fusion);
+        if (mode.isa >= 0) {
+            baby.setIsa((IsaVariant) mode.isa);
+        }
+        baby.run(1 << 30);
+        if (!baby.isHalted() || out.str() != text) {
+            std::cerr << "MISMATCH echo (loop acceleration " << mode.loopAcceleration << ", fusion " << mode.fusion
+                      << ", instruction set " << mode.isa << ")" << std::endl;
+            failures++;
+        }
+    }
+    programs.emplace_back("echo", echo);
+    failures += verifyDevices();
+    failures += verifyLeavingStore();
+    failures += verifyLibrary();
+    failures += verifyStepBound();
+    failures += verifyInstructionSet();
+    failures += verifyLoopAcceleration();
+    failures += verifyClock();
+    failures += verifyWideEngine();
+    failures += verifyMiniEngine();
+
+    // Compiled programs get their answers, with either instruction set
+    for (const CompiledSample &sample: COMPILED_SAMPLES) {
+        CompiledProgram program;
+        for (bool classic: {false, true}) {
+            if (!compileSample(sample, classic, program)) {
+                continue;
+            }
+            std::istringstream image(joinLines(assembleSource(program.source)));
+            ManchesterBaby baby(image);
+            baby.run(1 << 30);
+            for (const CompiledVariable &variable: program.variables) {
+                if (variable.name == sample.result && (!baby.isHalted() ||
+                    (int32_t) ManchesterBaby::convertInstruction(baby.memory[variable.address]) != sample.expected)) {
+                    std::cerr << "MISMATCH compiled " << sample.name << (classic ? " (classic)" : "") << std::endl;
+                    failures++;
+                }
+            }
+        }
+    }
+
+    // The compile-time assembler against the assembler
+    const std::pair<std::string_view, std::string> builtIns[] = {{EXTENDED_OPS_SOURCE, machineCodeText(EXTENDED_OPS)},
+                                                                 {WIDENING_SOURCE, machineCodeText(WIDENING)},
+                                                                 {ECHO_SOURCE, echo},
+                                                                 {EXCHANGE_SOURCE, machineCodeText(EXCHANGE)}};
+    for (const auto &builtIn: builtIns) {
+        if (joinLines(assembleSource(std::string(builtIn.first))) != builtIn.second) {
+            std::cerr << "MISMATCH compile-time assembly of" << std::endl << builtIn.first;
+            failures++;
+        }
+    }
+
+    std::cerr << programs.size() << " programs verified, " << failures << " mismatches" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
+
+// Write the results as JSON
+void writeJson(std::ostream &out) {
+    out << "{\n  \"label\": \"" << options.label << "\",\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        out << "    {\"name\": \"" << results[i].name << "\", \"operations\": " << results[i].operations
+            << ", \"ns_per_op\": " << results[i].nsPerOp << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+// Print the source of a generated workload
+int generate(int argc, char *argv[]) {
+    WorkloadParams params;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string option = argv[i];
+        std::string value = argv[i + 1];
+        if (option == "--generate") {
+            if (!parseWorkloadKind(value, params.kind)) {
+                std::cerr << "Unknown workload: " << value << std::endl;
+                return 1;
+            }
+        } else if (option == "--iterations") {
+            params.iterations = std::stoi(value);
+        } else if (option == "--step") {
+            params.step = std::stoi(value);
+        } else if (option == "--labels") {
+            params.labels = std::stoi(value);
+        } else if (option == "--vars") {
+            params.vars = std::stoi(value);
+        } else if (option == "--seed") {
+            params.seed = (unsigned) std::stoul(value);
+        } else {
+            std::cerr << "Unknown option: " << option << std::endl;
+            return 1;
+        }
+    }
+    std::cout << generateWorkload(params);
+    return 0;
+}
+
+}
+
+int main(int argc, char *argv[]) {
+    bool verifyOnly = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string option = argv[i];
+        if (option == "--generate") {
+            return generate(argc, argv);
+        } else if (option == "--verify") {
+            verifyOnly = true;
+        } else if (option == "--quick") {
+            options.repetitions = 1;
+            options.scale = 20;
+        } else if (i + 1 < argc && option == "--json") {
+            options.jsonFile = argv[++i];
+        } else if (i + 1 < argc && option == "--label") {
+            options.label = argv[++i];
+        } else if (i + 1 < argc && option == "--filter") {
+            options.filter = argv[++i];
+        } else if (i + 1 < argc && option == "--samples") {
+            options.samples = argv[++i];
+        } else {
+            std::cerr << "Unknown option: " << option << std::endl;
+            return 1;
+        }
+    }
+
+    if (verifyOnly) {
+        return verify();
+    }
+
+    benchDecodeAndExecute();
+    benchConvertInstruction();
+    benchLoadProgram();
+    benchBuiltInLoad();
+    benchCompiled();
+    benchAssembler();
+    benchRun();
+
+    if (options.jsonFile.empty()) {
+        writeJson(std::cout);
+    } else {
+        std::ofstream file(options.jsonFile);
+        writeJson(file);
+    }
+    return 0;
+}
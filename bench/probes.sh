@@ -0,0 +1,30 @@
+#!/bin/sh
+# Checks that a build kept its static tracepoints: every probe listed in probes.h must have a note in the
+# ".note.stapsdt" section of one of the given binaries. Run after a build, e.g.
+#     bench/probes.sh ManchesterBaby
+# Exits with 1, naming the missing probes, if any is gone.
+
+if [ $# -eq 0 ]; then
+    echo "Usage: probes.sh BINARY..." >&2
+    exit 1
+fi
+
+header="$(dirname "$0")/../probes.h"
+expected=$(sed -n '/^\/\/ Probes available/,/^\/\/$/p' "$header" | grep -o '[a-z_]*(' | tr -d '(')
+if [ -z "$expected" ]; then
+    echo "No probes listed in $header" >&2
+    exit 1
+fi
+notes=$(readelf -n "$@") || exit 1
+
+missing=0
+for name in $expected; do
+    if ! printf '%s\n' "$notes" | grep -q "^ *Name: $name\$"; then
+        echo "Missing probe: baby:$name" >&2
+        missing=1
+    fi
+done
+if [ $missing -eq 0 ]; then
+    echo "$(printf '%s\n' $expected | wc -l) probes found"
+fi
+exit $missing
@@ -0,0 +1,229 @@
+#include <map>
+#include <random>
+#include <sstream>
+#include <vector>
+
+#include "workload.h"
+
+namespace {
+
+// A source line under construction: optional label, mnemonic, operand and comment
+struct SourceLine {
+    std::string label;
+    std::string mnemonic;
+    std::string operand;
+    std::string comment;
+};
+
+// Helper collecting lines and resolving label addresses, so that generated programs can embed instruction words
+class SourceBuilder {
+public:
+    void add(const std::string &label, const std::string &mnemonic, const std::string &operand = "",
+             const std::string &comment = "") {
+        if (!label.empty()) {
+            addresses[label] = (int) lines.size();
+        }
+        lines.push_back({label, mnemonic, operand, comment});
+    }
+
+    void comment(const std::string &text) {
+        header.push_back("; " + text);
+    }
+
+    // Address a label will be assembled at. Only valid once the label has been added.
+    int addressOf(const std::string &label) const {
+        return addresses.at(label);
+    }
+
+    // Replace the operand of an already added line, used to patch in values known only at the end
+    void setOperand(const std::string &label, const std::string &operand) {
+        lines[addressOf(label)].operand = operand;
+    }
+
+    std::string str() const {
+        std::ostringstream out;
+        for (const std::string &line: header) {
+            out << line << '\n';
+        }
+        for (const SourceLine &line: lines) {
+            std::string prefix = line.label.empty() ? "" : line.label + ":";
+            prefix.resize(std::max<size_t>(prefix.size() + 1, 10), ' ');
+            std::string body = line.mnemonic + (line.operand.empty() ? "" : " " + line.operand);
+            if (!line.comment.empty()) {
+                body.resize(std::max<size_t>(body.size() + 1, 12), ' ');
+                body += "; " + line.comment;
+            }
+            out << prefix << body << '\n';
+        }
+        return out.str();
+    }
+
+private:
+    std::vector<std::string> header;
+    std::vector<SourceLine> lines;
+    std::map<std::string, int> addresses;
+};
+
+// Numeric value of a direct-addressing instruction, as it would be written with VAR
+long instructionValue(int opcode, int operand) {
+    return operand + ((long) opcode << 13);
+}
+
+// Classic-only loop: ACC += STEP, ITERATIONS times, result left in the accumulator
+std::string countingLoop(const WorkloadParams &params) {
+    SourceBuilder b;
+    b.comment("COUNTING LOOP: ADDS " + std::to_string(params.step) + " ON EACH OF " +
+              std::to_string(params.iterations) + " ITERATIONS");
+    b.add("HEAD", "VAR", "0", "Executed as JMP to itself, the loop restarts at address 1");
+    b.add("LOOP", "LDN", "ACC", "A = -ACC");
+    b.add("", "SUB", "STEP", "A = -ACC - STEP");
+    b.add("", "STO", "TMP");
+    b.add("", "LDN", "TMP", "A = ACC + STEP");
+    b.add("", "STO", "ACC");
+    b.add("", "LDN", "COUNT");
+    b.add("", "STO", "TMP");
+    b.add("", "LDN", "TMP", "A = COUNT");
+    b.add("", "SUB", "ONE");
+    b.add("", "STO", "COUNT", "COUNT = COUNT - 1");
+    b.add("", "CMP", "", "Leave the loop once COUNT is negative");
+    b.add("", "JMP", "HEAD");
+    b.add("", "LDN", "ACC");
+    b.add("", "STO", "TMP");
+    b.add("", "LDN", "TMP", "A = ACC");
+    b.add("END", "STP");
+    b.add("COUNT", "VAR", std::to_string(params.iterations - 1));
+    b.add("ACC", "VAR", "0");
+    b.add("STEP", "VAR", std::to_string(params.step));
+    b.add("ONE", "VAR", "1");
+    b.add("TMP", "VAR", "0");
+    return b.str();
+}
+
+// Loop rewriting its SLOT instruction twice per iteration: to "SUB ONE" before running it, then back to "SUB ZERO"
+std::string selfModifyingLoop(const WorkloadParams &params) {
+    SourceBuilder b;
+    b.comment("SELF-MODIFYING LOOP: REWRITES ITS OWN CODE ON EACH OF " + std::to_string(params.iterations) +
+              " ITERATIONS");
+    b.add("HEAD", "VAR", "0", "Executed as JMP to itself, the loop restarts at address 1");
+    b.add("LOOP", "LDN", "INS");
+    b.add("", "STO", "TMP");
+    b.add("", "LDN", "TMP", "A = SUB ONE");
+    b.add("", "STO", "SLOT", "Rewrite the slot");
+    b.add("", "LDN", "COUNT");
+    b.add("", "STO", "TMP");
+    b.add("", "LDN", "TMP", "A = COUNT");
+    b.add("SLOT", "VAR", "0", "Executed as SUB ONE");
+    b.add("", "STO", "COUNT");
+    b.add("", "LDN", "NOP");
+    b.add("", "STO", "TMP");
+    b.add("", "LDN", "TMP", "A = SUB ZERO");
+    b.add("", "STO", "SLOT", "Restore the slot");
+    b.add("", "LDN", "COUNT");
+    b.add("", "STO", "TMP");
+    b.add("", "LDN", "TMP", "A = COUNT");
+    b.add("", "CMP");
+    b.add("", "JMP", "HEAD");
+    b.add("END", "STP");
+    b.add("COUNT", "VAR", std::to_string(params.iterations - 1));
+    b.add("ONE", "VAR", "1");
+    b.add("ZERO", "VAR", "0");
+    b.add("INS", "VAR", "0");
+    b.add("NOP", "VAR", "0");
+    b.add("TMP", "VAR", "0");
+    const int SUB_OPCODE = 4;
+    std::string subOne = std::to_string(instructionValue(SUB_OPCODE, b.addressOf("ONE")));
+    std::string subZero = std::to_string(instructionValue(SUB_OPCODE, b.addressOf("ZERO")));
+    b.setOperand("INS", subOne);
+    b.setOperand("NOP", subZero);
+    b.setOperand("SLOT", subZero);
+    return b.str();
+}
+
+// Assembler-only source: many labelled instructions referring to many data labels
+std::string labelTable(const WorkloadParams &params) {
+    static const char *const MNEMONICS[] = {"LDN", "SUB", "STO", "LDP", "ADD", "LAN", "LOR", "JMP", "JRP"};
+    std::mt19937 random(params.seed);
+    int dataCount = std::max(params.vars, 1);
+    std::uniform_int_distribution<int> pickMnemonic(0, (int) (sizeof(MNEMONICS) / sizeof(*MNEMONICS)) - 1);
+    std::uniform_int_distribution<int> pickData(0, dataCount - 1);
+    std::uniform_int_distribution<int> pickValue(-100000, 100000);
+
+    SourceBuilder b;
+    b.comment("LABEL TABLE: " + std::to_string(params.labels) + " LABELLED INSTRUCTIONS, " +
+              std::to_string(dataCount) + " DATA LABELS");
+    b.add("", "VAR", "0");
+    for (int i = 0; i < params.labels; ++i) {
+        b.add("L" + std::to_string(i), MNEMONICS[pickMnemonic(random)], "D" + std::to_string(pickData(random)));
+        if (i % 16 == 15) {
+            b.add("", "CMP");
+        }
+    }
+    b.add("END", "STP");
+    for (int i = 0; i < dataCount; ++i) {
+        b.add("D" + std::to_string(i), "VAR", std::to_string(pickValue(random)));
+    }
+    return b.str();
+}
+
+// Assembler-only source: a short program followed by a sizable block of data
+std::string varData(const WorkloadParams &params) {
+    std::mt19937 random(params.seed);
+    std::uniform_int_distribution<long> pickValue(-2147483647L, 2147483647L);
+
+    SourceBuilder b;
+    b.comment("VAR DATA: " + std::to_string(params.vars) + " DECLARATIONS");
+    b.add("", "VAR", "0");
+    b.add("START", "LDN", "D0");
+    b.add("", "SUB", "D1");
+    b.add("", "STO", "D2");
+    b.add("END", "STP");
+    for (int i = 0; i < std::max(params.vars, 3); ++i) {
+        b.add("D" + std::to_string(i), "VAR", std::to_string(pickValue(random)),
+              i % 4 == 0 ? "Declare 32-bit variable" : "");
+    }
+    return b.str();
+}
+
+}
+
+// Generate the assembly source of a workload. Runnable kinds fit in the 32-word store.
+std::string generateWorkload(const WorkloadParams &params) {
+    switch (params.kind) {
+        case WorkloadKind::CountingLoop:
+            return countingLoop(params);
+        case WorkloadKind::SelfModifying:
+            return selfModifyingLoop(params);
+        case WorkloadKind::LabelTable:
+            return labelTable(params);
+        case WorkloadKind::VarData:
+            return varData(params);
+    }
+    return "";
+}
+
+// Parse a workload kind name ("counting-loop", "self-modifying", "label-table", "var-data")
+bool parseWorkloadKind(const std::string &name, WorkloadKind &kind) {
+    for (WorkloadKind candidate: {WorkloadKind::CountingLoop, WorkloadKind::SelfModifying,
+                                  WorkloadKind::LabelTable, WorkloadKind::VarData}) {
+        if (workloadKindName(candidate) == name) {
+            kind = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Name of a workload kind, as accepted by parseWorkloadKind
+std::string workloadKindName(WorkloadKind kind) {
+    switch (kind) {
+        case WorkloadKind::CountingLoop:
+            return "counting-loop";
+        case WorkloadKind::SelfModifying:
+            return "self-modifying";
+        case WorkloadKind::LabelTable:
+            return "label-table";
+        case WorkloadKind::VarData:
+            return "var-data";
+    }
+    return "";
+}
@@ -0,0 +1,33 @@
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+#include <string>
+
+// Kinds of synthetic programs the generator can produce
+enum class WorkloadKind {
+    CountingLoop,       // A classic-only counting loop summing a constant, runs for a given number of iterations
+    SelfModifying,      // A loop that rewrites one of its own instructions twice per iteration
+    LabelTable,         // A large source with many labels and label references, for the assembler only
+    VarData             // A large source dominated by VAR declarations, for the assembler only
+};
+
+// Parameters for the workload generator
+struct WorkloadParams {
+    WorkloadKind kind{WorkloadKind::CountingLoop};
+    int iterations{1000};   // Loop trip count (CountingLoop, SelfModifying)
+    int step{3};            // Value added on each iteration (CountingLoop)
+    int labels{1000};       // Number of labels (LabelTable)
+    int vars{1000};         // Number of VAR declarations (VarData, LabelTable)
+    unsigned seed{1};       // Seed for the randomised parts, so that the same parameters give the same program
+};
+
+// Generate the assembly source of a workload. Runnable kinds fit in the 32-word store.
+std::string generateWorkload(const WorkloadParams &params);
+
+// Parse a workload kind name ("counting-loop", "self-modifying", "label-table", "var-data")
+bool parseWorkloadKind(const std::string &name, WorkloadKind &kind);
+
+// Name of a workload kind, as accepted by parseWorkloadKind
+std::string workloadKindName(WorkloadKind kind);
+
+#endif //WORKLOAD_H
@@ -0,0 +1,39 @@
+# Checked runs of Baby programs: qmake check.pro && make && ./babycheck FILE
+
+TARGET = babycheck
+TEMPLATE = app
+CONFIG += console c++17 release thread
+CONFIG -= qt app_bundle
+
+INCLUDEPATH += ..
+
+SOURCES += \
+        main.cpp \
+        ../shadow.cpp \
+        ../baby.cpp \
+        ../assembler.cpp \
+        ../loopaccel.cpp \
+        ../fusion.cpp \
+        ../analysis.cpp \
+        ../stepbound.cpp \
+        ../clock.cpp \
+        ../events.cpp \
+        ../devices.cpp \
+        ../peephole.cpp
+
+HEADERS += \
+        ../shadow.h \
+        ../baby.h \
+        ../assembler.h \
+        ../probes.h \
+        ../loopaccel.h \
+        ../fusion.h \
+        ../analysis.h \
+        ../stepbound.h \
+        ../clock.h \
+        ../events.h \
+        ../devices.h \
+        ../peephole.h \
+        ../isa.h \
+        ../memtrace.h \
+        ../word.h
@@ -0,0 +1,131 @@
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../assembler.h"
+#include "../baby.h"
+#include "../shadow.h"
+
+/* Runs a program in checked mode (see shadow.h) and reports suspect accesses.
+ *
+ * Usage:
+ *   babycheck FILE [--max-steps N] [--runs N] [--devices]
+ *
+ * FILE is assembly source, or machine code if every line is 32 binary digits. Findings name the source lines when
+ * FILE is source. --runs runs the program again that many times on the same store, as the GUI's Run button does, so
+ * that reads of words only the previous run wrote are caught. --devices maps the standard ports (see devices.h) on
+ * the console. Exits with 2 if there were findings.
+ */
+
+// Whether text is machine code rather than assembly source
+static bool isMachineCode(const std::string &text) {
+    std::istringstream input(text);
+    std::string line;
+    bool any = false;
+    while (getline(input, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.size() != (size_t) SIZE_32_BIT || line.find_first_not_of("01") != std::string::npos) {
+            return false;
+        }
+        any = true;
+    }
+    return any;
+}
+
+int main(int argc, char *argv[]) {
+    std::string file;
+    long long maxSteps = 10000000;
+    int runs = 1;
+    bool withDevices = false;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string option = argv[i];
+            if (option == "--devices") {
+                withDevices = true;
+                continue;
+            } else if (option.rfind("--", 0) != 0) {
+                file = option;
+                continue;
+            }
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for " << option << std::endl;
+                return 1;
+            }
+            std::string value = argv[++i];
+            if (option == "--max-steps") {
+                maxSteps = std::stoll(value);
+            } else if (option == "--runs") {
+                runs = std::stoi(value);
+            } else {
+                std::cerr << "Unknown option: " << option << std::endl;
+                return 1;
+            }
+        }
+    } catch (const std::invalid_argument &e) {
+        std::cerr << "Invalid option value: " << e.what() << std::endl;
+        return 1;
+    } catch (const std::out_of_range &) {
+        std::cerr << "Number out of range in the options" << std::endl;
+        return 1;
+    }
+    if (file.empty() || maxSteps < 1 || runs < 1) {
+        std::cerr << "Usage: babycheck FILE [--max-steps N] [--runs N] [--devices]" << std::endl;
+        return 1;
+    }
+
+    std::ifstream input(file);
+    if (!input) {
+        std::cerr << "Cannot open " << file << std::endl;
+        return 1;
+    }
+    std::stringstream text;
+    text << input.rdbuf();
+    std::string machineCode = text.str();
+    SourceMap sourceMap;
+    if (!isMachineCode(machineCode)) {
+        std::vector<std::string> log;
+        std::istringstream source(text.str());
+        try {
+            machineCode.clear();
+            for (const std::string &line: Assembler::processAssembleCode(SymbolTable(), source, log, false,
+                                                                         &sourceMap)) {
+                machineCode += line + "\n";
+            }
+        } catch (const std::invalid_argument &e) {
+            Assembler::logError(e, log);
+            for (const std::string &line: log) {
+                std::cerr << line << std::endl;
+            }
+            return 1;
+        }
+    }
+
+    std::istringstream program(machineCode);
+    ManchesterBaby baby(program);
+    if (withDevices) {
+        baby.devices.mapStandard();
+    }
+    ShadowMemory shadow(sourceMap);
+    baby.setShadow(&shadow);
+    for (int run = 0; run < runs; ++run) {
+        baby.reset();
+        baby.setHalt(false);
+        long long steps = 0;
+        while (!baby.isHalted() && steps < maxSteps) {
+            steps += baby.run((int) std::min<long long>(maxSteps - steps, 1 << 30));
+        }
+        std::cout << "run " << run + 1 << ": " << steps << " steps, "
+                  << (baby.isHalted() ? "halted" : "out of steps") << ", A = "
+                  << ManchesterBaby::binToDec(ManchesterBaby::convertInstruction(baby.accumulator)) << std::endl;
+    }
+    for (const std::string &line: shadow.report()) {
+        std::cout << line << std::endl;
+    }
+    std::cout << shadow.findings().size() << " findings" << std::endl;
+    return shadow.findings().empty() ? 0 : 2;
+}
@@ -0,0 +1,101 @@
+#include <algorithm>
+#include <thread>
+
+#include "clock.h"
+
+// The original Baby: four beats of 0.3 ms per instruction.
+CycleTable CycleTable::original() {
+    CycleTable table;
+    table.name = "original";
+    table.cycles.fill(4);
+    table.secondsPerCycle = 0.0003;
+    return table;
+}
+
+// The original timing, with a serial DIV and MOD.
+CycleTable CycleTable::extended() {
+    CycleTable table = original();
+    table.name = "extended";
+    table.cycles[10] = 4 + 32;  // DIV
+    table.cycles[11] = 4 + 32;  // MOD
+    return table;
+}
+
+// Change the cost table.
+void VirtualClock::setTable(const CycleTable &newTable) {
+    costs = newTable;
+}
+
+const CycleTable &VirtualClock::table() const {
+    return costs;
+}
+
+// Account for cycles worked out elsewhere.
+void VirtualClock::advance(uint64_t cycles) {
+    cycleCount += cycles;
+}
+
+// Cycles since the last reset
+uint64_t VirtualClock::cycles() const {
+    return cycleCount;
+}
+
+// Simulated seconds since the last reset
+double VirtualClock::elapsedSeconds() const {
+    return (double) cycleCount * costs.secondsPerCycle;
+}
+
+void VirtualClock::reset() {
+    cycleCount = 0;
+}
+
+// As fast as the host allows
+PacingPolicy PacingPolicy::unthrottled() {
+    return {};
+}
+
+// A multiple of the modelled machine's speed
+PacingPolicy PacingPolicy::scaled(double speed) {
+    PacingPolicy policy;
+    policy.factor = std::max(speed, 0.0);
+    return policy;
+}
+
+bool PacingPolicy::isThrottled() const {
+    return factor > 0;
+}
+
+double PacingPolicy::speed() const {
+    return factor;
+}
+
+// Real time that cycles of the given table take at this speed
+std::chrono::nanoseconds PacingPolicy::wallTime(uint64_t cycles, const CycleTable &table) const {
+    if (!isThrottled()) {
+        return std::chrono::nanoseconds(0);
+    }
+    return std::chrono::nanoseconds((long long) ((double) cycles * table.secondsPerCycle / factor * 1e9));
+}
+
+// Instructions to run between two waits
+int PacingPolicy::slice(const CycleTable &table) const {
+    const uint32_t cheapest = std::max<uint32_t>(*std::min_element(table.cycles.begin(), table.cycles.end()), 1);
+    const long long perInstruction = wallTime(cheapest, table).count();
+    if (perInstruction <= 0) {
+        return 1 << 20;
+    }
+    return (int) std::clamp<long long>(1000000 / perInstruction, 1, 1 << 20);
+}
+
+// Take the clock's current time as the starting point
+void PacingPolicy::start(const VirtualClock &clock) {
+    startCycles = clock.cycles();
+    startTime = std::chrono::steady_clock::now();
+}
+
+// Sleep until real time has caught up with the clock
+void PacingPolicy::wait(const VirtualClock &clock) const {
+    if (isThrottled()) {
+        std::this_thread::sleep_until(startTime + wallTime(clock.cycles() - startCycles, clock.table()));
+    }
+}
@@ -0,0 +1,91 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Deterministic timing of the simulated machine.
+//
+// Every executed instruction advances a virtual clock by the cycle cost of its opcode, taken from a CycleTable, so a
+// run reports how long it would have taken on the modelled machine without ever looking at the wall clock. The
+// fast paths of run() (fusion, loop acceleration) charge exactly what interpreting the same instructions would.
+// A PacingPolicy turns virtual time back into real time when wanted: unthrottled, or at any multiple of the
+// modelled machine's speed.
+
+// Cycle costs of the instructions, indexed by opcode (all 32 five-bit opcodes, so unknown ones have a cost too)
+struct CycleTable {
+    std::string name;
+    std::array<uint32_t, 32> cycles{};      // Cycles per instruction, by opcode
+    double secondsPerCycle{0};              // Length of one cycle on the modelled machine
+
+    // The original Baby: every instruction takes four beats (two store scans, two actions) of 0.3 ms, 1.2 ms in all.
+    // The additional instructions are charged as if they were single passes too.
+    static CycleTable original();
+
+    // The original timing, with DIV and MOD charged one extra beat per bit of the word, as a serial divider would take.
+    static CycleTable extended();
+};
+
+// Simulated elapsed time of one machine
+class VirtualClock {
+public:
+    // Change the cost table. Cycles counted so far are kept, so change it before running.
+    void setTable(const CycleTable &newTable);
+
+    [[nodiscard]] const CycleTable &table() const;
+
+    // Account for one instruction
+    void tick(int opcode) {
+        cycleCount += costs.cycles[opcode & 31];
+    }
+
+    // Account for cycles worked out elsewhere (fused or fast-forwarded instructions)
+    void advance(uint64_t cycles);
+
+    // Cycles since the last reset
+    [[nodiscard]] uint64_t cycles() const;
+
+    // Simulated seconds since the last reset
+    [[nodiscard]] double elapsedSeconds() const;
+
+    void reset();
+
+private:
+    CycleTable costs{CycleTable::original()};
+    uint64_t cycleCount{0};
+};
+
+// How fast virtual time runs against real time
+class PacingPolicy {
+public:
+    // As fast as the host allows
+    static PacingPolicy unthrottled();
+
+    // speed times the modelled machine's speed: 1 is the real machine, 2 twice as fast, 0.001 a thousand times slower
+    static PacingPolicy scaled(double speed);
+
+    [[nodiscard]] bool isThrottled() const;
+
+    [[nodiscard]] double speed() const;
+
+    // Real time that cycles of the given table take at this speed (zero when unthrottled)
+    [[nodiscard]] std::chrono::nanoseconds wallTime(uint64_t cycles, const CycleTable &table) const;
+
+    // Instructions to run between two waits: about a millisecond of real time of the cheapest instruction, at least 1
+    [[nodiscard]] int slice(const CycleTable &table) const;
+
+    // Take the clock's current time as the starting point
+    void start(const VirtualClock &clock);
+
+    // Sleep until real time has caught up with the clock since start()
+    void wait(const VirtualClock &clock) const;
+
+private:
+    double factor{0};       // 0 when unthrottled
+    uint64_t startCycles{0};
+    std::chrono::steady_clock::time_point startTime;
+};
+
+#endif //CLOCK_H
@@ -0,0 +1,1264 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <utility>
+
+#include "compiler.h"
+#include "devices.h"
+#include "isa.h"
+#include "word.h"
+
+namespace {
+
+// Largest operand of an instruction, and so of an immediate
+const uint32_t MAX_OPERAND = Layout32::operandMask;
+
+// CI wraps at 32, so code can only run from the first 32 words
+const int CODE_WORDS = 32;
+
+[[noreturn]] void fail(int line, const std::string &message) {
+    throw std::invalid_argument("line " + std::to_string(line) + ": " + message);
+}
+
+enum class TokenKind {
+    Name,
+    Number,
+    Symbol,
+    End
+};
+
+struct Token {
+    TokenKind kind;
+    std::string text;
+    uint32_t value;
+    int line;
+};
+
+std::vector<Token> tokenize(const std::string &text) {
+    static const char *const PAIRS[] = {"==", "!=", "<=", ">=", "<<", ">>", "&&", "||"};
+    std::vector<Token> tokens;
+    int line = 1;
+    size_t i = 0;
+    while (i < text.size()) {
+        const char c = text[i];
+        if (c == '\n') {
+            line++;
+            i++;
+        } else if (std::isspace((unsigned char) c)) {
+            i++;
+        } else if (c == '/' && i + 1 < text.size() && text[i + 1] == '/') {
+            while (i < text.size() && text[i] != '\n') {
+                i++;
+            }
+        } else if (std::isalpha((unsigned char) c)) {
+            size_t end = i;
+            while (end < text.size() && (std::isalnum((unsigned char) text[end]) || text[end] == '_')) {
+                end++;
+            }
+            tokens.push_back({TokenKind::Name, text.substr(i, end - i), 0, line});
+            i = end;
+        } else if (std::isdigit((unsigned char) c)) {
+            size_t end = i;
+            uint64_t value = 0;
+            while (end < text.size() && std::isdigit((unsigned char) text[end])) {
+                value = value * 10 + (uint64_t) (text[end] - '0');
+                if (value > UINT32_MAX) {
+                    fail(line, "number too large for a word");
+                }
+                end++;
+            }
+            if (end < text.size() && (std::isalpha((unsigned char) text[end]) || text[end] == '_')) {
+                fail(line, "bad number " + text.substr(i, end + 1 - i));
+            }
+            tokens.push_back({TokenKind::Number, text.substr(i, end - i), (uint32_t) value, line});
+            i = end;
+        } else {
+            std::string symbol(1, c);
+            for (const char *pair: PAIRS) {
+                if (text.compare(i, 2, pair) == 0) {
+                    symbol = pair;
+                }
+            }
+            if (symbol.size() == 1 && std::string("(){}[];,=<>+-&|~/%!").find(c) == std::string::npos) {
+                fail(line, "unexpected character '" + symbol + "'");
+            }
+            tokens.push_back({TokenKind::Symbol, symbol, 0, line});
+            i += symbol.size();
+        }
+    }
+    tokens.push_back({TokenKind::End, "end of file", 0, line});
+    return tokens;
+}
+
+enum class Op {
+    Number,
+    Variable,       // A word, or a device port
+    Element,        // Of an array, the index in left
+    Temp,           // A temporary of the generator
+    Negate,
+    Complement,
+    Add,
+    Sub,
+    And,
+    Or,
+    Div,
+    Mod,
+    Shl,
+    Shr,
+    Less,
+    LessEqual,
+    Greater,
+    GreaterEqual,
+    Equal,
+    NotEqual,
+    LogicalNot,
+    LogicalAnd,
+    LogicalOr
+};
+
+struct Expr {
+    Op op;
+    int line;
+    uint32_t value{0};
+    std::string name;
+    std::unique_ptr<Expr> left;
+    std::unique_ptr<Expr> right;
+};
+
+using ExprPtr = std::unique_ptr<Expr>;
+
+struct Statement {
+    enum class Kind {
+        Assign,
+        If,
+        While,
+        Stop
+    };
+
+    Kind kind;
+    int line;
+    ExprPtr target;                     // Assign: a Variable or an Element
+    ExprPtr value;                      // Assign: the value; If, While: the condition
+    std::vector<Statement> body;
+    std::vector<Statement> orElse;
+};
+
+struct Symbol {
+    std::string name;
+    bool array;
+    std::vector<uint32_t> initial;      // A value for every word
+};
+
+ExprPtr makeNumber(uint32_t value, int line) {
+    auto expr = std::make_unique<Expr>();
+    expr->op = Op::Number;
+    expr->line = line;
+    expr->value = value;
+    return expr;
+}
+
+ExprPtr makeExpr(Op op, int line, ExprPtr left, ExprPtr right = nullptr) {
+    auto expr = std::make_unique<Expr>();
+    expr->op = op;
+    expr->line = line;
+    expr->left = std::move(left);
+    expr->right = std::move(right);
+    return expr;
+}
+
+class Parser {
+public:
+    explicit Parser(const std::string &text) : tokens(tokenize(text)) {}
+
+    void parse(std::vector<Symbol> &declared, std::vector<Statement> &program) {
+        while (peek().kind != TokenKind::End) {
+            if (accept("var")) {
+                declaration();
+            } else {
+                program.push_back(statement());
+            }
+        }
+        declared = symbols;
+    }
+
+private:
+    std::vector<Token> tokens;
+    size_t position{0};
+    std::vector<Symbol> symbols;
+    std::map<std::string, size_t> symbolIndex;
+
+    [[nodiscard]] const Token &peek() const {
+        return tokens[position];
+    }
+
+    // Take a symbol or keyword if it is next
+    bool accept(const std::string &text) {
+        if (peek().kind != TokenKind::Number && peek().kind != TokenKind::End && peek().text == text) {
+            position++;
+            return true;
+        }
+        return false;
+    }
+
+    void expect(const std::string &text) {
+        if (!accept(text)) {
+            fail(peek().line, "expected " + text + " before " + peek().text);
+        }
+    }
+
+    static bool isKeyword(const std::string &name) {
+        return name == "var" || name == "if" || name == "else" || name == "while" || name == "stop";
+    }
+
+    std::string name() {
+        const Token &token = peek();
+        if (token.kind != TokenKind::Name || isKeyword(token.text)) {
+            fail(token.line, "expected a name before " + token.text);
+        }
+        position++;
+        return token.text;
+    }
+
+    uint32_t constant() {
+        const int line = peek().line;
+        ExprPtr value = expression();
+        if (value->op != Op::Number) {
+            fail(line, "initial values must be constants");
+        }
+        return value->value;
+    }
+
+    // var NAME [= VALUE]; or var NAME[SIZE] [= {VALUE, ...}];
+    void declaration() {
+        const int line = peek().line;
+        Symbol symbol{name(), false, {0}};
+        if (symbolIndex.count(symbol.name) != 0) {
+            fail(line, symbol.name + " is already declared");
+        }
+        if (accept("[")) {
+            const Token &size = peek();
+            if (size.kind != TokenKind::Number || size.value < 1 || size.value > MAX_OPERAND) {
+                fail(line, "array sizes are numbers from 1 to " + std::to_string(MAX_OPERAND));
+            }
+            position++;
+            expect("]");
+            symbol.array = true;
+            symbol.initial.assign(size.value, 0);
+            if (accept("=")) {
+                expect("{");
+                size_t index = 0;
+                do {
+                    if (index == symbol.initial.size()) {
+                        fail(line, "too many initial values for " + symbol.name);
+                    }
+                    symbol.initial[index++] = constant();
+                } while (accept(","));
+                expect("}");
+            }
+        } else if (accept("=")) {
+            symbol.initial[0] = constant();
+        }
+        expect(";");
+        symbolIndex[symbol.name] = symbols.size();
+        symbols.push_back(symbol);
+    }
+
+    std::vector<Statement> block() {
+        std::vector<Statement> body;
+        expect("{");
+        while (!accept("}")) {
+            if (peek().kind == TokenKind::End) {
+                fail(peek().line, "missing }");
+            }
+            if (peek().text == "var") {
+                fail(peek().line, "variables are declared at the top level");
+            }
+            body.push_back(statement());
+        }
+        return body;
+    }
+
+    Statement statement() {
+        Statement statement{Statement::Kind::Stop, peek().line, nullptr, nullptr, {}, {}};
+        if (accept("if")) {
+            statement.kind = Statement::Kind::If;
+            expect("(");
+            statement.value = expression();
+            expect(")");
+            statement.body = block();
+            if (accept("else")) {
+                if (peek().text == "if") {
+                    statement.orElse.push_back(this->statement());
+                } else {
+                    statement.orElse = block();
+                }
+            }
+        } else if (accept("while")) {
+            statement.kind = Statement::Kind::While;
+            expect("(");
+            statement.value = expression();
+            expect(")");
+            statement.body = block();
+        } else if (accept("stop")) {
+            expect(";");
+        } else {
+            statement.kind = Statement::Kind::Assign;
+            statement.target = variable();
+            expect("=");
+            statement.value = expression();
+            expect(";");
+        }
+        return statement;
+    }
+
+    // A variable, an element of an array or a device port
+    ExprPtr variable() {
+        const int line = peek().line;
+        ExprPtr expr = makeExpr(Op::Variable, line, nullptr);
+        expr->name = name();
+        const auto symbol = symbolIndex.find(expr->name);
+        if (symbol == symbolIndex.end()) {
+            if (deviceAddress(expr->name) == -1) {
+                fail(line, expr->name + " is not declared");
+            }
+            return expr;
+        }
+        const Symbol &declared = symbols[symbol->second];
+        if (!declared.array) {
+            if (peek().text == "[") {
+                fail(line, expr->name + " is not an array");
+            }
+            return expr;
+        }
+        expect("[");
+        expr->op = Op::Element;
+        expr->left = expression();
+        expect("]");
+        if (expr->left->op == Op::Number && expr->left->value >= declared.initial.size()) {
+            fail(line, "index " + std::to_string(expr->left->value) + " is out of " + expr->name);
+        }
+        return expr;
+    }
+
+    ExprPtr expression() {
+        ExprPtr expr = conjunction();
+        while (peek().text == "||") {
+            const int line = tokens[position++].line;
+            expr = makeExpr(Op::LogicalOr, line, std::move(expr), conjunction());
+        }
+        return expr;
+    }
+
+    ExprPtr conjunction() {
+        ExprPtr expr = comparison();
+        while (peek().text == "&&") {
+            const int line = tokens[position++].line;
+            expr = makeExpr(Op::LogicalAnd, line, std::move(expr), comparison());
+        }
+        return expr;
+    }
+
+    ExprPtr comparison() {
+        static const std::map<std::string, Op> OPS = {{"==", Op::Equal}, {"!=", Op::NotEqual}, {"<", Op::Less},
+                                                      {"<=", Op::LessEqual}, {">", Op::Greater},
+                                                      {">=", Op::GreaterEqual}};
+        ExprPtr expr = sum();
+        const auto op = OPS.find(peek().text);
+        if (peek().kind == TokenKind::Symbol && op != OPS.end()) {
+            const int line = tokens[position++].line;
+            expr = makeExpr(op->second, line, std::move(expr), sum());
+        }
+        return expr;
+    }
+
+    ExprPtr sum() {
+        static const std::map<std::string, Op> OPS = {{"+", Op::Add}, {"-", Op::Sub}, {"|", Op::Or}};
+        ExprPtr expr = product();
+        for (auto op = OPS.find(peek().text); peek().kind == TokenKind::Symbol && op != OPS.end();
+             op = OPS.find(peek().text)) {
+            const int line = tokens[position++].line;
+            expr = binary(op->second, line, std::move(expr), product());
+        }
+        return expr;
+    }
+
+    ExprPtr product() {
+        static const std::map<std::string, Op> OPS = {{"/", Op::Div}, {"%", Op::Mod}, {"<<", Op::Shl},
+                                                      {">>", Op::Shr}, {"&", Op::And}};
+        ExprPtr expr = unary();
+        for (auto op = OPS.find(peek().text); peek().kind == TokenKind::Symbol && op != OPS.end();
+             op = OPS.find(peek().text)) {
+            const int line = tokens[position++].line;
+            expr = binary(op->second, line, std::move(expr), unary());
+        }
+        return expr;
+    }
+
+    ExprPtr unary() {
+        const int line = peek().line;
+        if (accept("-")) {
+            ExprPtr operand = unary();
+            return operand->op == Op::Number ? makeNumber(0U - operand->value, line) :
+                   makeExpr(Op::Negate, line, std::move(operand));
+        } else if (accept("~")) {
+            ExprPtr operand = unary();
+            return operand->op == Op::Number ? makeNumber(~operand->value, line) :
+                   makeExpr(Op::Complement, line, std::move(operand));
+        } else if (accept("!")) {
+            return makeExpr(Op::LogicalNot, line, unary());
+        }
+        return primary();
+    }
+
+    ExprPtr primary() {
+        const Token &token = peek();
+        if (token.kind == TokenKind::Number) {
+            position++;
+            return makeNumber(token.value, token.line);
+        } else if (accept("(")) {
+            ExprPtr expr = expression();
+            expect(")");
+            return expr;
+        }
+        return variable();
+    }
+
+    // An arithmetic operation, worked out now if both operands are constants
+    static ExprPtr binary(Op op, int line, ExprPtr left, ExprPtr right) {
+        if ((op == Op::Shl || op == Op::Shr) && (right->op != Op::Number || right->value > 31)) {
+            fail(line, "shift counts are constants from 0 to 31");
+        }
+        if ((op == Op::Div || op == Op::Mod) && right->op == Op::Number && right->value == 0) {
+            fail(line, "division by zero");
+        }
+        if (left->op != Op::Number || right->op != Op::Number) {
+            return makeExpr(op, line, std::move(left), std::move(right));
+        }
+        const uint32_t a = left->value;
+        const uint32_t b = right->value;
+        switch (op) {
+            case Op::Add:
+                return makeNumber(a + b, line);
+            case Op::Sub:
+                return makeNumber(a - b, line);
+            case Op::Or:
+                return makeNumber(a | b, line);
+            case Op::And:
+                return makeNumber(a & b, line);
+            case Op::Div:
+                return makeNumber(a / b, line);
+            case Op::Mod:
+                return makeNumber(a % b, line);
+            case Op::Shl:
+                return makeNumber(a << b, line);
+            default:
+                return makeNumber(a >> b, line);
+        }
+    }
+};
+
+// A line of code
+struct CodeLine {
+    std::string label;
+    std::string mnemonic;
+    std::string operand;
+    std::string comment;
+    int jumpTo{-1};         // For JMP: the label it goes to, resolved on layout
+};
+
+// A term of a sum: an expression and its sign
+struct Term {
+    const Expr *expr;
+    int sign;
+};
+
+// A test of the jumping code: whether the terms and the constant add up to less than 0
+struct Test {
+    std::vector<Term> terms;
+    uint32_t constant{0};
+};
+
+// Data word holding an instruction on the first element of an array, or its negation, for indexing
+struct Template {
+    int opcode;
+    std::string array;
+    bool negated;
+};
+
+// Code generation for the single accumulator.
+//
+// Every expression is evaluated into the accumulator, with a sign: evaluate() leaves the value or its negation there,
+// whichever is cheaper unless the caller needs one of them. Sums (+, -, unary minus and ~, being -x - 1) are
+// flattened into terms and a constant, so that a chain of loads, additions and subtractions works them out. On the
+// classic instruction set a chain is an LDN and SUBs, so the terms it would have to add are first negated into
+// temporaries, and the sign of the result is picked to need the fewest. Operands of other operations and terms that
+// need computing are held in temporaries, allocated as a stack.
+//
+// Conditions become jumping code: every comparison turns into tests of whether a sum is negative, each a CMP and a
+// JMP over the code to skip. An array element with an index only known at run time is reached by writing the
+// instruction that uses it, from a template, into the code just before it runs.
+class Generator {
+public:
+    Generator(const std::vector<Symbol> &symbols, const CompilerOptions &options) :
+            symbols(symbols), classic(options.classic) {
+        for (const Symbol &symbol: symbols) {
+            declared.insert(symbol.name);
+        }
+        zero = makeNumber(0, 0);
+    }
+
+    CompiledProgram generate(const std::vector<Statement> &program) {
+        statements(program);
+        comment = "end";
+        emit("STP");
+        return layout();
+    }
+
+private:
+    const std::vector<Symbol> &symbols;
+    std::set<std::string> declared;
+    bool classic;
+    ExprPtr zero;
+
+    std::vector<CodeLine> lines;
+    std::vector<int> labels;                        // Line of each label, -1 until placed
+    size_t labelledLine{SIZE_MAX};                  // Where the last label was placed
+    std::string comment;                            // For the next line
+    std::map<uint32_t, std::string> constants;
+    std::map<std::string, Template> templates;
+    int temps{0};
+    int maxTemps{0};
+    int slots{0};
+
+    void emit(const std::string &mnemonic, const std::string &operand = "") {
+        // A word just stored is still in the accumulator, unless it is a device port or the store was through a slot
+        if (mnemonic == "LDP" && labelledLine != lines.size() && !lines.empty() && lines.back().mnemonic == "STO" &&
+            lines.back().operand == operand && lines.back().label.empty() && !isDevice(operand)) {
+            return;
+        }
+        lines.push_back({"", mnemonic, operand, comment});
+        comment.clear();
+    }
+
+    int newLabel() {
+        labels.push_back(-1);
+        return (int) labels.size() - 1;
+    }
+
+    void place(int label) {
+        labels[label] = (int) lines.size();
+        labelledLine = lines.size();
+    }
+
+    void jump(int label) {
+        lines.push_back({"", "JMP", "", comment, label});
+        comment.clear();
+    }
+
+    std::string allocate() {
+        const std::string temp = "_T" + std::to_string(temps++);
+        maxTemps = std::max(maxTemps, temps);
+        return temp;
+    }
+
+    void release(int count = 1) {
+        temps -= count;
+    }
+
+    std::string constantName(uint32_t value) {
+        const auto signedValue = (int32_t) value;
+        std::string &name = constants[value];
+        if (name.empty()) {
+            name = signedValue < 0 ? "_CM" + std::to_string(-(int64_t) signedValue) : "_C" + std::to_string(value);
+        }
+        return name;
+    }
+
+    std::string templateName(int opcode, const std::string &array, bool negated) {
+        const std::string name = std::string("_") + INSTRUCTIONS[opcode].mnemonic + "_" + array + (negated ? "_M" : "");
+        templates[name] = {opcode, array, negated};
+        return name;
+    }
+
+    [[nodiscard]] bool isDevice(const std::string &name) const {
+        return declared.count(name) == 0 && deviceAddress(name) != -1;
+    }
+
+    // Whether an instruction can take an expression as its operand
+    static bool isDirect(const Expr &expr) {
+        return expr.op == Op::Variable || expr.op == Op::Temp ||
+               (expr.op == Op::Element && expr.left->op == Op::Number);
+    }
+
+    static std::string operandOf(const Expr &expr) {
+        if (expr.op == Op::Element) {
+            return expr.name + "[" + std::to_string(expr.left->value) + "]";
+        }
+        return expr.name;
+    }
+
+    // A value to read twice: a constant, or a word that isn't a device port
+    [[nodiscard]] bool isStable(const Expr &expr) const {
+        return expr.op == Op::Number || (isDirect(expr) && !isDevice(expr.name));
+    }
+
+    // Whether a value can't be negative, whatever its operands
+    static bool nonNegative(const Expr &expr) {
+        switch (expr.op) {
+            case Op::Number:
+                return (int32_t) expr.value >= 0;
+            case Op::And:
+                return nonNegative(*expr.left) || nonNegative(*expr.right);
+            case Op::Shr:
+                return expr.right->value >= 1;
+            case Op::Div:
+                return expr.right->op == Op::Number && expr.right->value >= 2;
+            case Op::Mod:
+                return expr.right->op == Op::Number && expr.right->value <= 0x80000000U;
+            default:
+                return false;
+        }
+    }
+
+    // Operand for a constant: an immediate where the instruction takes one, else a data word
+    std::string constantOperand(int opcode, uint32_t value) {
+        if (!classic && takesImmediate(opcode) && value <= MAX_OPERAND) {
+            return "#" + std::to_string(value);
+        }
+        return constantName(value);
+    }
+
+    // A = value
+    void load(uint32_t value) {
+        if (classic) {
+            emit("LDN", constantName(0U - value));
+        } else if (value <= MAX_OPERAND || 0U - value > MAX_OPERAND) {
+            emit("LDP", constantOperand(LDP, value));
+        } else {
+            emit("LDN", "#" + std::to_string(0U - value));
+        }
+    }
+
+    // A += value
+    void add(uint32_t value) {
+        if (value == 0) {
+            return;
+        } else if (classic) {
+            emit("SUB", constantName(0U - value));
+        } else if (value <= MAX_OPERAND || 0U - value > MAX_OPERAND) {
+            emit("ADD", constantOperand(ADD, value));
+        } else {
+            emit("SUB", "#" + std::to_string(0U - value));
+        }
+    }
+
+    // A = -A
+    void negate() {
+        if (classic) {
+            const std::string temp = allocate();
+            emit("STO", temp);
+            emit("LDN", temp);
+            release();
+        } else {
+            emit("LNT");
+            add(1);
+        }
+    }
+
+    // The accumulator with the sign wanted (0 for either), given the one it has
+    int fixSign(int sign, int wanted) {
+        if (wanted != 0 && sign != wanted) {
+            negate();
+            return wanted;
+        }
+        return sign;
+    }
+
+    void flatten(const Expr &expr, int sign, std::vector<Term> &terms, uint32_t &constant) {
+        switch (expr.op) {
+            case Op::Number:
+                constant += sign > 0 ? expr.value : 0U - expr.value;
+                break;
+            case Op::Add:
+            case Op::Sub:
+                flatten(*expr.left, sign, terms, constant);
+                flatten(*expr.right, expr.op == Op::Add ? sign : -sign, terms, constant);
+                break;
+            case Op::Negate:
+                flatten(*expr.left, -sign, terms, constant);
+                break;
+            case Op::Complement:
+                // ~x = -x - 1
+                flatten(*expr.left, -sign, terms, constant);
+                constant += sign > 0 ? 0xFFFFFFFFU : 1U;
+                break;
+            default:
+                terms.push_back({&expr, sign});
+        }
+    }
+
+    Test makeTest(const Expr &plus, const Expr &minus, uint32_t constant) {
+        Test test;
+        test.constant = constant;
+        flatten(plus, 1, test.terms, test.constant);
+        flatten(minus, -1, test.terms, test.constant);
+        return test;
+    }
+
+    // Evaluate a value into the accumulator, or its negation: returns 1 or -1 for which. wanted is the sign the caller
+    // needs, or 0 for either.
+    int evaluate(const Expr &expr, int wanted) {
+        switch (expr.op) {
+            case Op::Number: {
+                const int sign = wanted < 0 ? -1 : 1;
+                load(sign > 0 ? expr.value : 0U - expr.value);
+                return sign;
+            }
+            case Op::Element:
+                if (expr.left->op != Op::Number) {
+                    const int opcode = classic || wanted < 0 ? LDN : LDP;
+                    const std::string slot = prepareSlot(expr, opcode);
+                    emitSlot(slot, opcode, expr.name);
+                    return fixSign(opcode == LDN ? -1 : 1, wanted);
+                }
+                // A word like any other
+                [[fallthrough]];
+            case Op::Variable:
+            case Op::Temp:
+            case Op::Add:
+            case Op::Sub:
+            case Op::Negate:
+            case Op::Complement: {
+                std::vector<Term> terms;
+                uint32_t constant = 0;
+                flatten(expr, 1, terms, constant);
+                return evaluateSum(terms, constant, wanted, 0);
+            }
+            case Op::And:
+            case Op::Or:
+            case Op::Div:
+            case Op::Mod:
+                return fixSign(operation(expr), wanted);
+            case Op::Shl:
+            case Op::Shr:
+                return shift(expr, wanted);
+            default:
+                fail(expr.line, "comparisons can only be conditions of if and while");
+        }
+    }
+
+    // Evaluate terms and a constant: returns the sign as evaluate() does. negatedBias is added to the accumulator
+    // when it ends up negated. With no sign wanted, preferred is the sign to take if it costs no more.
+    int evaluateSum(const std::vector<Term> &terms, uint32_t constant, int wanted, uint32_t negatedBias,
+                    int preferred = 0) {
+        auto bias = [&](int sign) {
+            return sign > 0 ? constant : 0U - constant + negatedBias;
+        };
+        if (terms.empty()) {
+            const int sign = wanted < 0 ? -1 : 1;
+            load(bias(sign));
+            return sign;
+        }
+        std::vector<Term> computed;
+        std::vector<Term> direct;
+        for (const Term &term: terms) {
+            (isDirect(*term.expr) ? direct : computed).push_back(term);
+        }
+        std::vector<std::pair<std::string, int>> chain;     // Operands after the first, and their signs in the sum
+        int held = 0;
+        int sign;
+        // Words a sign costs beyond the terms: the constant, a sign not preferred, and on the classic instruction set
+        // the negation of terms to add and of the result
+        auto cost = [&](int candidate) {
+            int words = (bias(candidate) != 0 ? 1 : 0) + (preferred != 0 && candidate != preferred ? 1 : 0);
+            if (classic) {
+                words += wanted != 0 && candidate != wanted ? 2 : 0;
+                for (const Term &term: direct) {
+                    words += candidate * term.sign > 0 ? 2 : 0;
+                }
+                // An indexed load comes negated: the head is wanted as it is, the others negated
+                for (size_t index = 0; index < computed.size(); ++index) {
+                    const int needed = (index + 1 == computed.size() ? 1 : -1) * candidate * computed[index].sign;
+                    words += computed[index].expr->op == Op::Element && needed > 0 ? 2 : 0;
+                }
+            }
+            return words;
+        };
+        if (!classic) {
+            // Terms but the last to compute go to temporaries, that one is computed first, and the rest are added
+            for (size_t index = 0; index + 1 < computed.size(); ++index) {
+                const int termSign = evaluate(*computed[index].expr, 0);
+                chain.emplace_back(allocate(), computed[index].sign * termSign);
+                held++;
+                emit("STO", chain.back().first);
+            }
+            for (const Term &term: direct) {
+                chain.emplace_back(operandOf(*term.expr), term.sign);
+            }
+            if (!computed.empty()) {
+                sign = evaluate(*computed.back().expr, 0) * computed.back().sign;
+            } else {
+                sign = wanted != 0 ? wanted : preferred != 0 ? preferred : chain.front().second;
+                if (wanted == 0 && cost(-sign) < cost(sign)) {
+                    sign = -sign;
+                }
+                emit(sign * chain.front().second > 0 ? "LDP" : "LDN", chain.front().first);
+                chain.erase(chain.begin());
+            }
+            for (const auto &operand: chain) {
+                emit(sign * operand.second > 0 ? "ADD" : "SUB", operand.first);
+            }
+            release(held);
+            if (wanted != 0 && sign != wanted) {
+                // -x = ~x + 1
+                emit("LNT");
+                add(bias(wanted) + 1);
+                return wanted;
+            }
+            add(bias(sign));
+            return sign;
+        }
+
+        // Classic: LDN the first operand and SUB the others, so each term comes in negated. A term that must come in
+        // as it is goes through a temporary holding its negation: pick the sign of the result that needs the fewest.
+        sign = wanted != 0 ? wanted : preferred != 0 ? preferred : -1;
+        if (cost(-sign) < cost(sign)) {
+            sign = -sign;
+        }
+        for (size_t index = 0; index + 1 < computed.size(); ++index) {
+            evaluate(*computed[index].expr, -sign * computed[index].sign);
+            chain.emplace_back(allocate(), 0);
+            held++;
+            emit("STO", chain.back().first);
+        }
+        for (const Term &term: direct) {
+            if (sign * term.sign > 0) {
+                emit("LDN", operandOf(*term.expr));
+                chain.emplace_back(allocate(), 0);
+                held++;
+                emit("STO", chain.back().first);
+            } else {
+                chain.emplace_back(operandOf(*term.expr), 0);
+            }
+        }
+        if (!computed.empty()) {
+            evaluate(*computed.back().expr, sign * computed.back().sign);
+        } else {
+            emit("LDN", chain.front().first);
+            chain.erase(chain.begin());
+        }
+        for (const auto &operand: chain) {
+            emit("SUB", operand.first);
+        }
+        release(held);
+        add(bias(sign));
+        return fixSign(sign, wanted);
+    }
+
+    // &, |, / and %, with the additional instructions
+    int operation(const Expr &expr) {
+        static const std::map<Op, std::pair<int, const char *>> OPS = {{Op::And, {LAN, "&"}}, {Op::Or, {LOR, "|"}},
+                                                                       {Op::Div, {DIV, "/"}}, {Op::Mod, {MOD, "%"}}};
+        const auto &op = OPS.at(expr.op);
+        if (classic) {
+            fail(expr.line, std::string(op.second) + " needs the additional instructions");
+        }
+        const Expr *left = expr.left.get();
+        const Expr *right = expr.right.get();
+        auto ready = [](const Expr &operand) {
+            return operand.op == Op::Number || isDirect(operand);
+        };
+        if ((expr.op == Op::And || expr.op == Op::Or) && !ready(*right) && ready(*left)) {
+            std::swap(left, right);
+        }
+        std::string operand;
+        int held = 0;
+        if (right->op == Op::Number) {
+            operand = constantOperand(op.first, right->value);
+        } else if (isDirect(*right)) {
+            operand = operandOf(*right);
+        } else {
+            evaluate(*right, 1);
+            operand = allocate();
+            held++;
+            emit("STO", operand);
+        }
+        evaluate(*left, 1);
+        emit(INSTRUCTIONS[op.first].mnemonic, operand);
+        release(held);
+        return 1;
+    }
+
+    // << and >> by a constant. SHR doubles the value and SHL halves it: they are named for the bits as stored.
+    int shift(const Expr &expr, int wanted) {
+        const uint32_t count = expr.right->value;
+        if (count == 0) {
+            return evaluate(*expr.left, wanted);
+        }
+        if (!classic) {
+            evaluate(*expr.left, 1);
+            for (uint32_t bit = 0; bit < count; ++bit) {
+                emit(expr.op == Op::Shl ? "SHR" : "SHL");
+            }
+            return fixSign(1, wanted);
+        }
+        if (expr.op == Op::Shr) {
+            fail(expr.line, ">> needs the additional instructions");
+        }
+        // Doubling with LDN and SUB: A = -A - A
+        int sign = -1;
+        uint32_t done = 1;
+        if (isDirect(*expr.left)) {
+            emit("LDN", operandOf(*expr.left));
+            emit("SUB", operandOf(*expr.left));
+        } else {
+            sign = evaluate(*expr.left, 0);
+            done = 0;
+        }
+        for (; done < count; ++done) {
+            const std::string temp = allocate();
+            emit("STO", temp);
+            emit("LDN", temp);
+            emit("SUB", temp);
+            release();
+            sign = -sign;
+        }
+        return fixSign(sign, wanted);
+    }
+
+    // Index into an array: work out the instruction on the element and store it in a slot, to be emitted next
+    std::string prepareSlot(const Expr &element, int opcode) {
+        evaluate(*element.left, 1);
+        emit(classic ? "SUB" : "ADD", templateName(opcode, element.name, classic));
+        const std::string slot = "_S" + std::to_string(slots++);
+        emit("STO", slot);
+        return slot;
+    }
+
+    void emitSlot(const std::string &slot, int opcode, const std::string &array) {
+        lines.push_back({slot, INSTRUCTIONS[opcode].mnemonic, array + "[0]", comment});
+        comment.clear();
+    }
+
+    // Jump to a label if a condition is when
+    void branch(const Expr &condition, bool when, int label) {
+        switch (condition.op) {
+            case Op::LogicalNot:
+                branch(*condition.left, !when, label);
+                break;
+            case Op::LogicalAnd:
+            case Op::LogicalOr:
+                // Jumping when an && is false or an || is true: either side decides
+                if (when == (condition.op == Op::LogicalOr)) {
+                    branch(*condition.left, when, label);
+                    branch(*condition.right, when, label);
+                } else {
+                    const int skip = newLabel();
+                    branch(*condition.left, !when, skip);
+                    branch(*condition.right, when, label);
+                    place(skip);
+                }
+                break;
+            case Op::Less:
+                branchTest(makeTest(*condition.left, *condition.right, 0), when, label);
+                break;
+            case Op::Greater:
+                branchTest(makeTest(*condition.right, *condition.left, 0), when, label);
+                break;
+            case Op::LessEqual:
+                branchTest(makeTest(*condition.left, *condition.right, 0xFFFFFFFFU), when, label);
+                break;
+            case Op::GreaterEqual:
+                branchTest(makeTest(*condition.right, *condition.left, 0xFFFFFFFFU), when, label);
+                break;
+            case Op::Equal:
+            case Op::NotEqual:
+                branchEqual(*condition.left, *condition.right, condition.op == Op::Equal, when, label);
+                break;
+            default:
+                branchEqual(condition, *zero, false, when, label);
+        }
+    }
+
+    // Jump if a == b (or a != b) is when
+    void branchEqual(const Expr &a, const Expr &b, bool equal, bool when, int label) {
+        // Against 0, a value that can't be negative takes one test: whether it is positive
+        for (const auto &sides: {std::make_pair(&a, &b), std::make_pair(&b, &a)}) {
+            if (sides.second->op == Op::Number && sides.second->value == 0 && nonNegative(*sides.first)) {
+                branchTest(makeTest(*zero, *sides.first, 0), equal != when, label);
+                return;
+            }
+        }
+        if (!classic) {
+            // The difference d is 0 just when d | -d isn't negative
+            const Test test = makeTest(a, b, 0);
+            if (test.terms.empty()) {
+                if ((test.constant != 0) == (equal != when)) {
+                    jump(label);
+                }
+                return;
+            }
+            std::string difference;
+            int held = 0;
+            if (test.terms.size() == 1 && test.constant == 0 && isStable(*test.terms[0].expr)) {
+                difference = operandOf(*test.terms[0].expr);
+            } else {
+                evaluateSum(test.terms, test.constant, 0, 0);
+                difference = allocate();
+                held++;
+                emit("STO", difference);
+            }
+            emit("LDN", difference);
+            emit("LOR", difference);
+            release(held);
+            branchOnSign(1, equal != when, label);
+            return;
+        }
+        // Two tests: compute the difference once, unless both sides are words
+        const Expr *left = &a;
+        const Expr *right = &b;
+        Expr difference{Op::Temp, a.line, 0, "", nullptr, nullptr};
+        if (!isStable(a) || !isStable(b)) {
+            const Test test = makeTest(a, b, 0);
+            evaluateSum(test.terms, test.constant, 0, 0);
+            difference.name = allocate();
+            emit("STO", difference.name);
+            left = &difference;
+            right = zero.get();
+        }
+        if (equal) {
+            branchAll({makeTest(*left, *right, 0xFFFFFFFFU), makeTest(*right, *left, 0xFFFFFFFFU)}, when, label);
+        } else {
+            branchAny({makeTest(*left, *right, 0), makeTest(*right, *left, 0)}, when, label);
+        }
+        if (!difference.name.empty()) {
+            release();
+        }
+    }
+
+    // Jump if all the tests hold is when
+    void branchAll(const std::vector<Test> &tests, bool when, int label) {
+        if (!when) {
+            for (const Test &test: tests) {
+                branchTest(test, false, label);
+            }
+            return;
+        }
+        const int skip = newLabel();
+        for (size_t index = 0; index + 1 < tests.size(); ++index) {
+            branchTest(tests[index], false, skip);
+        }
+        branchTest(tests.back(), true, label);
+        place(skip);
+    }
+
+    // Jump if any of the tests holds is when
+    void branchAny(const std::vector<Test> &tests, bool when, int label) {
+        if (when) {
+            for (const Test &test: tests) {
+                branchTest(test, true, label);
+            }
+            return;
+        }
+        const int skip = newLabel();
+        for (size_t index = 0; index + 1 < tests.size(); ++index) {
+            branchTest(tests[index], true, skip);
+        }
+        branchTest(tests.back(), false, label);
+        place(skip);
+    }
+
+    // Jump if a test is when
+    void branchTest(const Test &test, bool when, int label) {
+        if (test.terms.empty()) {
+            if (((int32_t) test.constant < 0) == when) {
+                jump(label);
+            }
+            return;
+        }
+        branchOnSign(evaluateSum(test.terms, test.constant, 0, 0xFFFFFFFFU, when ? -1 : 1), when, label);
+    }
+
+    // Jump if a test is when, given the accumulator as evaluateSum() leaves a test's sum: the sum, negative when the
+    // test holds, or when negated, -sum - 1, negative when it fails. CMP skips the next instruction if the accumulator
+    // is negative, so the jump after it is taken on the second: else LNT changes one into the other, or without it,
+    // a jump over the jump is taken on the first.
+    void branchOnSign(int sign, bool when, int label) {
+        if ((sign < 0) != when && !classic) {
+            emit("LNT");
+            sign = -sign;
+        }
+        emit("CMP");
+        if ((sign < 0) == when) {
+            jump(label);
+        } else {
+            const int over = newLabel();
+            jump(over);
+            jump(label);
+            place(over);
+        }
+    }
+
+    void statements(const std::vector<Statement> &body) {
+        for (const Statement &statement: body) {
+            comment = "line " + std::to_string(statement.line);
+            switch (statement.kind) {
+                case Statement::Kind::Assign:
+                    assign(*statement.target, *statement.value);
+                    break;
+                case Statement::Kind::If: {
+                    const int otherwise = newLabel();
+                    branch(*statement.value, false, otherwise);
+                    statements(statement.body);
+                    if (statement.orElse.empty()) {
+                        place(otherwise);
+                        break;
+                    }
+                    const int end = newLabel();
+                    jump(end);
+                    place(otherwise);
+                    statements(statement.orElse);
+                    place(end);
+                    break;
+                }
+                case Statement::Kind::While: {
+                    // The test at the bottom, so that an iteration takes no jump back
+                    const int top = newLabel();
+                    const int test = newLabel();
+                    jump(test);
+                    place(top);
+                    statements(statement.body);
+                    place(test);
+                    branch(*statement.value, true, top);
+                    break;
+                }
+                case Statement::Kind::Stop:
+                    emit("STP");
+                    break;
+            }
+        }
+    }
+
+    void assign(const Expr &target, const Expr &value) {
+        if (target.op != Op::Element || target.left->op == Op::Number) {
+            evaluate(value, 1);
+            emit("STO", operandOf(target));
+            return;
+        }
+        // The value is kept aside while the store instruction is made, unless it can be loaded in one instruction
+        const bool ready = value.op == Op::Number || (!classic && isDirect(value));
+        std::string held;
+        if (!ready) {
+            evaluate(value, classic ? -1 : 1);
+            held = allocate();
+            emit("STO", held);
+        }
+        const std::string slot = prepareSlot(target, STO);
+        if (ready) {
+            evaluate(value, 1);
+        } else {
+            emit(classic ? "LDN" : "LDP", held);
+            release();
+        }
+        emitSlot(slot, STO, target.name);
+    }
+
+    static std::string formatLine(const std::string &label, const std::string &mnemonic, const std::string &operand,
+                                  const std::string &comment) {
+        std::string line = label.empty() ? "" : label + ":";
+        line.resize(std::max<size_t>(line.size() + 1, 10), ' ');
+        std::string body = mnemonic + (operand.empty() ? "" : " " + operand);
+        if (!comment.empty()) {
+            body.resize(std::max<size_t>(body.size() + 1, 12), ' ');
+            body += "; " + comment;
+        }
+        return line + body + "\n";
+    }
+
+    CompiledProgram layout() {
+        CompiledProgram program;
+        program.codeWords = (int) lines.size() + 1;
+        if (program.codeWords > CODE_WORDS) {
+            throw std::invalid_argument("the program needs " + std::to_string(program.codeWords) +
+                                        " words of code, but the Baby runs code from its first " +
+                                        std::to_string(CODE_WORDS) + " words only");
+        }
+
+        // Labels on the lines jumped to, and the jumps, to the word before as CI moves on after a jump
+        std::vector<bool> targets(lines.size(), false);
+        for (const CodeLine &line: lines) {
+            if (line.jumpTo >= 0) {
+                targets[labels[line.jumpTo]] = true;
+            }
+        }
+        int named = 0;
+        for (size_t index = 0; index < lines.size(); ++index) {
+            if (targets[index] && lines[index].label.empty()) {
+                lines[index].label = "_L" + std::to_string(++named);
+            }
+        }
+        for (CodeLine &line: lines) {
+            if (line.jumpTo >= 0) {
+                const int target = labels[line.jumpTo];
+                line.operand = classic ? constantName((uint32_t) target) : "#" + std::to_string(target);
+                line.comment += (line.comment.empty() ? "to " : ", to ") + lines[target].label;
+            }
+        }
+
+        std::string &source = program.source;
+        source = std::string("; Compiled by babyc, for ") +
+                 (classic ? "the classic instruction set\n" : "the additional instructions\n");
+        source += formatLine("", "VAR", "0", "Address 0 is a jump to 1, where the program starts");
+        for (const CodeLine &line: lines) {
+            source += formatLine(line.label, line.mnemonic, line.operand, line.comment);
+        }
+
+        int address = program.codeWords;
+        std::map<std::string, int> arrays;
+        for (const Symbol &symbol: symbols) {
+            program.variables.push_back({symbol.name, address, (int) symbol.initial.size()});
+            arrays[symbol.name] = address;
+            for (size_t index = 0; index < symbol.initial.size(); ++index) {
+                source += formatLine(symbol.array ? symbol.name + "[" + std::to_string(index) + "]" : symbol.name,
+                                     "VAR", std::to_string((int32_t) symbol.initial[index]), "");
+                address++;
+            }
+        }
+        for (int temp = 0; temp < maxTemps; ++temp) {
+            source += formatLine("_T" + std::to_string(temp), "VAR", "0", "");
+            address++;
+        }
+        for (const auto &entry: templates) {
+            const Template &instruction = entry.second;
+            const uint32_t value = (uint32_t) arrays.at(instruction.array) |
+                                   (uint32_t) instruction.opcode << Layout32::opcodeShift;
+            source += formatLine(entry.first, "VAR", std::to_string((int32_t) (instruction.negated ? 0U - value : value)),
+                                 std::string(instruction.negated ? "-" : "") + INSTRUCTIONS[instruction.opcode].mnemonic +
+                                 " " + instruction.array + "[0]");
+            address++;
+        }
+        for (const auto &constant: constants) {
+            source += formatLine(constant.second, "VAR", std::to_string((int32_t) constant.first), "");
+            address++;
+        }
+        program.dataWords = address - program.codeWords;
+        if (address > (int) CYCLE_COUNTER_ADDRESS) {
+            throw std::invalid_argument("the program needs " + std::to_string(address) +
+                                        " words, more than fit below the device ports");
+        }
+        return program;
+    }
+};
+
+} // namespace
+
+CompiledProgram compileProgram(const std::string &text, const CompilerOptions &options) {
+    std::vector<Symbol> symbols;
+    std::vector<Statement> program;
+    Parser(text).parse(symbols, program);
+    return Generator(symbols, options).generate(program);
+}
@@ -0,0 +1,64 @@
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include <string>
+#include <vector>
+
+// Compiler for a small structured language, emitting assembly source for Assembler::processAssembleCode.
+//
+//     var a = 11;                  // A word, 0 unless given
+//     var b = 10;
+//     var product;
+//     var t[4] = {3, 1, 4};        // A fixed array, each element a word of its own
+//     while (a != 0) {
+//         if (a & 1) {
+//             product = product + b;
+//         }
+//         b = b << 1;
+//         a = a >> 1;
+//     }
+//     t[a] = CHARIN;               // The device ports (see devices.h) are variables, unless declared
+//     stop;
+//
+// Variables are declared at the top level, before they are used. Statements are assignments, if/else, while and
+// stop; blocks need their braces. Operators, by precedence as in Go, lowest first:
+//     ||
+//     &&
+//     == != < <= > >=          only in conditions, with ! && ||; any other condition is compared with 0
+//     + - |
+//     / % << >> &
+//     - ~ !                    unary
+// Words wrap around as the machine's do. / and % divide the words as unsigned, like DIV and MOD, and >> is a logical
+// shift; shift counts are constants. Comparisons are signed, on the sign of the difference, so the difference must
+// not overflow. Array indexes are checked when they are constants; others index through self-modifying code.
+//
+// The program ends with STP after its last statement. Code starts at address 1 and must fit in the 32 words the
+// Baby runs code from; the variables, arrays, temporaries and constants follow it. With the classic option the code
+// keeps to the seven SSEM instructions with direct operands: sums are built from LDN and SUB, keeping track of the
+// sign of the accumulator, constants and jump addresses are data words, and &, |, >>, / and % can't be used.
+// Otherwise the code uses LDP, ADD and immediate operands, and the additional instructions.
+
+// Options of the compiler
+struct CompilerOptions {
+    bool classic{false};    // Only the seven SSEM instructions and direct operands
+};
+
+// A variable of a compiled program, where the assembler will put it
+struct CompiledVariable {
+    std::string name;
+    int address;
+    int size;               // 1 for a word, the length of an array
+};
+
+// What the compiler made of a program
+struct CompiledProgram {
+    std::string source;     // Assembly source
+    int codeWords{0};       // Address 0 included
+    int dataWords{0};
+    std::vector<CompiledVariable> variables;
+};
+
+// Compile a program. Throws std::invalid_argument("line N: ...") on an error in it, and if it doesn't fit.
+CompiledProgram compileProgram(const std::string &text, const CompilerOptions &options = {});
+
+#endif //COMPILER_H
@@ -0,0 +1,41 @@
+# Compiler for Baby programs: qmake compiler.pro && make && ./babyc FILE
+
+TARGET = babyc
+TEMPLATE = app
+CONFIG += console c++17 release thread
+CONFIG -= qt app_bundle
+
+INCLUDEPATH += ..
+
+SOURCES += \
+        main.cpp \
+        ../compiler.cpp \
+        ../shadow.cpp \
+        ../baby.cpp \
+        ../assembler.cpp \
+        ../loopaccel.cpp \
+        ../fusion.cpp \
+        ../analysis.cpp \
+        ../stepbound.cpp \
+        ../clock.cpp \
+        ../events.cpp \
+        ../devices.cpp \
+        ../peephole.cpp
+
+HEADERS += \
+        ../compiler.h \
+        ../shadow.h \
+        ../baby.h \
+        ../assembler.h \
+        ../probes.h \
+        ../loopaccel.h \
+        ../fusion.h \
+        ../analysis.h \
+        ../stepbound.h \
+        ../clock.h \
+        ../events.h \
+        ../devices.h \
+        ../peephole.h \
+        ../isa.h \
+        ../memtrace.h \
+        ../word.h
@@ -0,0 +1,120 @@
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../assembler.h"
+#include "../baby.h"
+#include "../compiler.h"
+
+/* Compiles a program in a small structured language (see compiler.h) to assembly source for the assembler.
+ *
+ * Usage:
+ *   babyc FILE [--classic] [--output FILE] [--run] [--max-steps N]
+ *
+ * The assembly goes to the console, or to the --output file, e.g. assemble.txt for the simulator. --classic keeps to
+ * the seven SSEM instructions. --run assembles the program and runs it too, with the standard ports (see devices.h)
+ * on the console, and then prints the instructions it took and the values of its variables.
+ */
+
+// Assemble and run a compiled program, and print what it left in its variables
+static bool runProgram(const CompiledProgram &program, long long maxSteps) {
+    std::vector<std::string> log;
+    std::istringstream source(program.source);
+    std::string machineCode;
+    try {
+        for (const std::string &line: Assembler::processAssembleCode(SymbolTable(), source, log)) {
+            machineCode += line + "\n";
+        }
+    } catch (const std::invalid_argument &e) {
+        Assembler::logError(e, log);
+        for (const std::string &line: log) {
+            std::cerr << line << std::endl;
+        }
+        return false;
+    }
+    std::istringstream image(machineCode);
+    ManchesterBaby baby(image);
+    baby.devices.mapStandard();
+    long long steps = 0;
+    while (!baby.isHalted() && steps < maxSteps) {
+        steps += baby.run((int) std::min<long long>(maxSteps - steps, 1 << 30));
+    }
+    std::cout << (baby.isHalted() ? "Halted after " : "Out of steps after ") << steps << " instructions" << std::endl;
+    for (const CompiledVariable &variable: program.variables) {
+        std::cout << "  " << variable.name << " =";
+        for (int index = 0; index < variable.size; ++index) {
+            std::cout << (index == 0 ? " " : ", ")
+                      << (int32_t) ManchesterBaby::convertInstruction(baby.memory[variable.address + index]);
+        }
+        std::cout << std::endl;
+    }
+    return baby.isHalted();
+}
+
+int main(int argc, char *argv[]) {
+    std::string file;
+    std::string output;
+    CompilerOptions options;
+    bool run = false;
+    long long maxSteps = 10000000;
+    for (int i = 1; i < argc; ++i) {
+        std::string option = argv[i];
+        if (option == "--classic") {
+            options.classic = true;
+        } else if (option == "--run") {
+            run = true;
+        } else if ((option == "--output" || option == "--max-steps") && i + 1 < argc) {
+            const std::string value = argv[++i];
+            if (option == "--output") {
+                output = value;
+                continue;
+            }
+            try {
+                maxSteps = std::stoll(value);
+            } catch (const std::exception &) {
+                maxSteps = 0;
+            }
+        } else if (option.rfind("--", 0) != 0 && file.empty()) {
+            file = option;
+        } else {
+            std::cerr << "Unknown option: " << option << std::endl;
+            return 1;
+        }
+    }
+    if (file.empty() || maxSteps < 1) {
+        std::cerr << "Usage: babyc FILE [--classic] [--output FILE] [--run] [--max-steps N]" << std::endl;
+        return 1;
+    }
+
+    std::ifstream input(file);
+    if (!input) {
+        std::cerr << "Cannot open " << file << std::endl;
+        return 1;
+    }
+    std::stringstream text;
+    text << input.rdbuf();
+    CompiledProgram program;
+    try {
+        program = compileProgram(text.str(), options);
+    } catch (const std::invalid_argument &e) {
+        std::cerr << file << ": " << e.what() << std::endl;
+        return 1;
+    }
+    if (output.empty()) {
+        std::cout << program.source;
+    } else {
+        std::ofstream out(output);
+        out << program.source;
+        if (!out) {
+            std::cerr << "Cannot write " << output << std::endl;
+            return 1;
+        }
+    }
+    std::cerr << program.codeWords << " words of code, " << program.dataWords << " of data" << std::endl;
+    return run && !runProgram(program, maxSteps) ? 1 : 0;
+}
@@ -0,0 +1,255 @@
+#ifndef CONSTASM_H
+#define CONSTASM_H
+
+#include <array>
+#include <bitset>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "devices.h"
+#include "isa.h"
+#include "word.h"
+
+// The assembler at compile time, for programs built into the tools.
+//
+//     constexpr auto image = BABY_PROGRAM("          LDN #5\n"
+//                                         "          STP\n");
+//
+// makes image a std::array<uint32_t, 2> of the words as stored (std::bitset<32>(word) is the word ManchesterBaby
+// loads), during compilation, so that a built-in program costs nothing to assemble when a tool starts. The source is
+// the language of Assembler::processAssembleCode, read the same way - labels, device names, #immediates, VAR and
+// comments - and gives the same words; there is no peephole pass. An error in the source throws
+// std::invalid_argument, which in a constexpr initialisation is a compile error pointing at the throw below.
+//
+// C++17 has no string literal template parameters, so the macro needs the source twice: once for the word count,
+// which sizes the array, and once for the words.
+#define BABY_PROGRAM(source) (assembleProgram<programWords(source)>(source))
+
+// A line of source, split as the assembler splits it
+struct SourceFields {
+    bool labelled{false};
+    std::string_view label;         // Everything before the first ':'
+    std::string_view mnemonic;
+    std::string_view operand;       // The word after the mnemonic, ";" when a comment follows straight away
+};
+
+// Take the next line off source, without its line ending
+constexpr std::string_view nextSourceLine(std::string_view &source) {
+    const size_t end = source.find('\n');
+    std::string_view line = source.substr(0, end);
+    source = end == std::string_view::npos ? std::string_view() : source.substr(end + 1);
+    if (!line.empty() && line.back() == '\r') {
+        line.remove_suffix(1);
+    }
+    return line;
+}
+
+// Whether a line assembles to a word: anything but empty lines and comments
+constexpr bool isCodeLine(std::string_view line) {
+    return !line.empty() && line[0] != ';';
+}
+
+constexpr SourceFields splitSourceLine(std::string_view line) {
+    SourceFields fields;
+    const size_t colon = line.find(':');
+    size_t start = 0;
+    if (colon != std::string_view::npos) {
+        fields.labelled = true;
+        fields.label = line.substr(0, colon);
+        start = colon + 1;
+    }
+    while (start < line.size() && (line[start] == ' ' || line[start] == '\t')) {
+        ++start;
+    }
+    size_t end = start;
+    while (end < line.size() && line[end] != ' ') {
+        ++end;
+    }
+    fields.mnemonic = line.substr(start, end - start);
+    start = end;
+    while (start < line.size() && line[start] == ' ') {
+        ++start;
+    }
+    end = start;
+    while (end < line.size() && line[end] != ' ') {
+        ++end;
+    }
+    fields.operand = line.substr(start, end - start);
+    return fields;
+}
+
+// Words a source assembles to
+constexpr size_t programWords(std::string_view source) {
+    size_t words = 0;
+    while (!source.empty()) {
+        words += isCodeLine(nextSourceLine(source)) ? 1 : 0;
+    }
+    return words;
+}
+
+// Address of a standard port known to the assembler by name, or -1 (see deviceAddress)
+constexpr long long constantDeviceAddress(std::string_view name) {
+    return name == "CHAROUT" ? (long long) CHAR_OUTPUT_ADDRESS :
+           name == "CHARIN" ? (long long) CHAR_INPUT_ADDRESS :
+           name == "CYCLES" ? (long long) CYCLE_COUNTER_ADDRESS : -1;
+}
+
+// Decimal digits, with a leading '-' if negative is allowed; throws std::invalid_argument if there are none, or the
+// number doesn't fit an int, as the assembler reads numbers into one
+constexpr long long parseConstantNumber(std::string_view text, bool negative) {
+    const bool minus = negative && !text.empty() && text[0] == '-';
+    if (minus) {
+        text.remove_prefix(1);
+    }
+    if (text.empty()) {
+        throw std::invalid_argument("102: a number is missing");
+    }
+    long long number = 0;
+    for (char digit: text) {
+        if (digit < '0' || digit > '9') {
+            throw std::invalid_argument("102: a number has something other than digits in it");
+        }
+        number = number * 10 + (digit - '0');
+        if (number > (long long) INT_MAX + (minus ? 1 : 0)) {
+            throw std::invalid_argument("102: a number doesn't fit 32 bits");
+        }
+    }
+    return minus ? -number : number;
+}
+
+// The stored word of an instruction, or of VAR with opcode -1, as translateInstruction<Layout32> encodes it
+constexpr uint32_t encodeStoredWord(int opcode, long long address, bool immediate) {
+    uint32_t value = (uint32_t) address;    // VAR: negative numbers in two's complement
+    if (opcode >= 0) {
+        value = (uint32_t) (address >= 0 ? address : -address);
+        value |= (uint32_t) opcode << Layout32::opcodeShift;
+        value = (value & ~Layout32::immediateMask) | ((uint32_t) immediate << Layout32::immediateBit);
+    }
+    return Layout32::reverse(value);
+}
+
+// Assemble source of N words (programWords) into its words as stored; throws std::invalid_argument on an error in
+// the source, the message starting with the assembler's error code (see Assembler::logError)
+template<size_t N>
+constexpr std::array<uint32_t, N> assembleProgram(std::string_view source) {
+    // First pass: the labels and their addresses
+    std::array<std::string_view, N> labels{};
+    std::array<bool, N> labelled{};
+    std::string_view rest = source;
+    size_t address = 0;
+    while (!rest.empty()) {
+        const std::string_view line = nextSourceLine(rest);
+        if (!isCodeLine(line)) {
+            continue;
+        }
+        if (address == N) {
+            throw std::invalid_argument("The program has more words than its array");
+        }
+        const SourceFields fields = splitSourceLine(line);
+        for (size_t other = 0; fields.labelled && other < address; ++other) {
+            if (labelled[other] && labels[other] == fields.label) {
+                throw std::invalid_argument("100: a label is defined twice");
+            }
+        }
+        labels[address] = fields.label;
+        labelled[address] = fields.labelled;
+        ++address;
+    }
+    if (address != N) {
+        throw std::invalid_argument("The program has fewer words than its array");
+    }
+
+    // Second pass: the words
+    std::array<uint32_t, N> words{};
+    rest = source;
+    address = 0;
+    while (!rest.empty()) {
+        const std::string_view line = nextSourceLine(rest);
+        if (!isCodeLine(line)) {
+            continue;
+        }
+        const SourceFields fields = splitSourceLine(line);
+        if (fields.mnemonic == "VAR") {
+            words[address++] = encodeStoredWord(-1, parseConstantNumber(fields.operand, true), false);
+            continue;
+        }
+        const int opcode = opcodeOf(fields.mnemonic);
+        if (opcode < 0) {
+            throw std::invalid_argument("103: unknown instruction");
+        }
+        long long operand = 0;
+        bool immediate = false;
+        if ((fields.operand == ";" || fields.operand.empty()) && INSTRUCTIONS[opcode].operand == OperandUse::None) {
+            // CMP, STP, LNT, SHL and SHR need no operand
+        } else if (!fields.operand.empty() && fields.operand[0] == '#') {
+            if (!takesImmediate(opcode)) {
+                throw std::invalid_argument("104: the instruction takes no immediate operand");
+            }
+            operand = fields.operand.size() == 1 ? 0 : parseConstantNumber(fields.operand.substr(1), false);
+            immediate = true;
+        } else {
+            // A label, else a device port by name
+            operand = -1;
+            for (size_t target = 0; target < N; ++target) {
+                if (labelled[target] && labels[target] == fields.operand) {
+                    operand = (long long) target;
+                    break;
+                }
+            }
+            if (operand < 0) {
+                operand = constantDeviceAddress(fields.operand);
+            }
+            if (operand < 0) {
+                throw std::invalid_argument("101: undefined label");
+            }
+        }
+        words[address++] = encodeStoredWord(opcode, operand, immediate);
+    }
+    return words;
+}
+
+// Words for ManchesterBaby::loadProgram
+template<size_t N>
+std::vector<std::bitset<32>> storeImage(const std::array<uint32_t, N> &words) {
+    return std::vector<std::bitset<32>>(words.begin(), words.end());
+}
+
+// Machine code, a line per word, as Assembler::exportToFile writes it
+template<size_t N>
+std::string machineCodeText(const std::array<uint32_t, N> &words) {
+    std::string text;
+    for (uint32_t word: words) {
+        text += std::bitset<32>(word).to_string() + '\n';
+    }
+    return text;
+}
+
+// Whether two programs have the same words, at compile time
+template<size_t N>
+constexpr bool sameWords(const std::array<uint32_t, N> &a, const std::array<uint32_t, N> &b) {
+    for (size_t address = 0; address < N; ++address) {
+        if (a[address] != b[address]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static_assert(sameWords(BABY_PROGRAM("; A comment, a blank line and a label\n"
+                                     "\n"
+                                     "START:    LDN #5\n"
+                                     "          STO CHAROUT\n"
+                                     "          JMP START ; back\n"
+                                     "          STP\n"
+                                     "          VAR -1\n"),
+                        std::array<uint32_t, 5>{Layout32::reverse(1U << 30 | LDN << 13 | 5),
+                                                Layout32::reverse(STO << 13 | 8191), Layout32::reverse(JMP << 13),
+                                                Layout32::reverse(STP << 13), 0xFFFFFFFFU}),
+              "the compile-time assembler must encode as translateInstruction does");
+
+#endif //CONSTASM_H
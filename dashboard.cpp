@@ -0,0 +1,232 @@
+#include <algorithm>
+#include <chrono>
+
+#include "dashboard.h"
+#include "widget.h"
+
+DashboardCanvas::DashboardCanvas(QWidget *parent) : QWidget(parent) {}
+
+// Show these tiles at the next repaint
+void DashboardCanvas::setTiles(const std::vector<DashboardTile> &newTiles) {
+    tiles = newTiles;
+    const int rows = ((int) tiles.size() + COLUMNS - 1) / COLUMNS;
+    setFixedSize(COLUMNS * TILE_WIDTH, std::max(rows, 1) * TILE_HEIGHT);
+    update();
+}
+
+// Every tile, in one pass: the store on the left, one bit a pixel scaled up, and the registers on the right
+void DashboardCanvas::paintEvent(QPaintEvent *) {
+    QPainter painter(this);
+    painter.setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    for (size_t lane = 0; lane < tiles.size(); ++lane) {
+        const DashboardTile &tile = tiles[lane];
+        const QRect frame(((int) lane % COLUMNS) * TILE_WIDTH, ((int) lane / COLUMNS) * TILE_HEIGHT,
+                          TILE_WIDTH - 4, TILE_HEIGHT - 4);
+        QColor background = tile.inFullView ? QColor(255, 244, 200) : tile.halted ? QColor(225, 225, 225) : Qt::white;
+        painter.fillRect(frame, background);
+        painter.setPen(Qt::gray);
+        painter.drawRect(frame);
+
+        // Bits in the order the machine code area shows them, most significant first
+        for (int row = 0; row < SIZE_32_BIT; ++row) {
+            auto *pixels = reinterpret_cast<QRgb *>(thumbnail.scanLine(row));
+            for (int column = 0; column < SIZE_32_BIT; ++column) {
+                const bool set = (tile.store[row] >> (SIZE_32_BIT - 1 - column)) & 1u;
+                pixels[column] = set ? qRgb(30, 30, 30) : qRgb(240, 240, 240);
+            }
+        }
+        const QRect store(frame.left() + 8, frame.top() + 8, THUMBNAIL_SIZE, THUMBNAIL_SIZE);
+        painter.drawImage(store, thumbnail);
+
+        // Lane, CI, accumulator, steps and state
+        painter.setPen(Qt::black);
+        const QRect text(store.right() + 8, frame.top() + 6, frame.right() - store.right() - 12, frame.height() - 12);
+        const QString state = tile.inFullView ? "full view" : tile.halted ? "halted" : "running";
+        painter.drawText(text, Qt::AlignLeft | Qt::AlignTop,
+                         QString("Lane %1\nCI %2\nA  %3\n%4 steps\n%5").arg(lane).arg(tile.ci).arg(tile.accumulator)
+                                 .arg(tile.steps).arg(state));
+    }
+}
+
+// Double-clicking a tile opens its lane
+void DashboardCanvas::mouseDoubleClickEvent(QMouseEvent *event) {
+    const int column = event->pos().x() / TILE_WIDTH;
+    const int lane = (event->pos().y() / TILE_HEIGHT) * COLUMNS + column;
+    if (column < COLUMNS && lane >= 0 && lane < (int) tiles.size()) {
+        emit tileActivated(lane);
+    }
+}
+
+// Constructor
+Dashboard::Dashboard(const std::vector<std::bitset<SIZE_32_BIT>> &image, int lanes, int sweepAddress,
+                     QWidget *parent)
+        : QWidget(parent), image(image), sweepAddress(sweepAddress) {
+    // Lanes
+    for (int lane = 0; lane < lanes; ++lane) {
+        this->lanes.push_back(std::make_unique<Lane>());
+        load(lane);
+    }
+    tiles.resize(this->lanes.size());
+
+    // Window: a summary line and the restart button above the tiles
+    summary = new QLabel();
+    restartButton = new QPushButton("Restart all");
+    scrollArea = new QScrollArea();
+    canvas = new DashboardCanvas();
+    auto *topLayout = new QHBoxLayout();
+    topLayout->addWidget(summary, 1);
+    topLayout->addWidget(restartButton);
+    auto *layout = new QVBoxLayout(this);
+    layout->addLayout(topLayout);
+    layout->addWidget(scrollArea);
+    scrollArea->setWidget(canvas);
+    setWindowTitle(QString("Manchester Baby - %1 lanes").arg(lanes));
+    resize(DashboardCanvas::COLUMNS * DashboardCanvas::TILE_WIDTH + 40, 600);
+
+    // Action Listeners
+    connect(restartButton, &QPushButton::pressed, this, &Dashboard::restart);
+    connect(canvas, &DashboardCanvas::tileActivated, this, &Dashboard::openLane);
+    connect(&frameTimer, &QTimer::timeout, this, &Dashboard::refresh);
+
+    // Workers: no more than there are cores or lanes
+    const size_t count = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(),
+                                                              this->lanes.size()));
+    for (size_t first = 0; first < count; ++first) {
+        workers.emplace_back(&Dashboard::work, this, first, count);
+    }
+
+    refresh();
+    sinceLastFrame.start();
+    frameTimer.start(FRAME_MS);
+}
+
+// Stops the workers, and closes any lane still in a full view
+Dashboard::~Dashboard() {
+    frameTimer.stop();
+    stopping = true;
+    for (std::thread &worker: workers) {
+        worker.join();
+    }
+    for (std::unique_ptr<Lane> &lane: lanes) {
+        delete lane->fullView;
+    }
+}
+
+// Load a lane with the program, and its number if sweeping. Call with its mutex held.
+void Dashboard::load(int lane) {
+    ManchesterBaby &baby = lanes[lane]->baby;
+    baby.loadProgram(image);
+    baby.reset();
+    baby.setHalt(false);
+    if (sweepAddress >= 0) {
+        baby.writeMemory(sweepAddress, std::bitset<SIZE_32_BIT>(reverseWord((uint32_t) lane)));
+    }
+    baby.selectFastestMode();
+    lanes[lane]->steps = 0;
+}
+
+// Run lanes first, first + stride, ... until stopping. A worker with nothing to run waits a frame before looking
+// again.
+void Dashboard::work(size_t first, size_t stride) {
+    while (!stopping.load(std::memory_order_relaxed)) {
+        bool ran = false;
+        for (size_t index = first; index < lanes.size() && !stopping.load(std::memory_order_relaxed);
+             index += stride) {
+            Lane &lane = *lanes[index];
+            std::lock_guard<std::mutex> lock(lane.mutex);
+            if (lane.inFullView || lane.baby.isHalted()) {
+                continue;
+            }
+            lane.steps += lane.baby.run(SLICE_STEPS);
+            ran = true;
+        }
+        if (!ran) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(FRAME_MS));
+        }
+    }
+}
+
+// Copy the lanes into the tiles and repaint them. Waits at most a slice for each lane.
+void Dashboard::refresh() {
+    long long totalSteps = 0;
+    int running = 0;
+    int inFullView = 0;
+    for (size_t index = 0; index < lanes.size(); ++index) {
+        Lane &lane = *lanes[index];
+        DashboardTile &tile = tiles[index];
+        {
+            std::lock_guard<std::mutex> lock(lane.mutex);
+            const ManchesterBaby &baby = lane.baby;
+            tile.ci = baby.ci;
+            tile.accumulator = ManchesterBaby::binToDec(ManchesterBaby::convertInstruction(baby.accumulator));
+            tile.steps = lane.steps;
+            tile.halted = baby.isHalted();
+            tile.inFullView = lane.inFullView;
+            for (int address = 0; address < SIZE_32_BIT; ++address) {
+                tile.store[address] = address < (int) baby.memory.size() ? baby.memory[address].to_ulong() : 0;
+            }
+        }
+        totalSteps += tile.steps;
+        running += !tile.halted && !tile.inFullView;
+        inFullView += tile.inFullView;
+    }
+    canvas->setTiles(tiles);
+
+    // Summary, with the rate over the last frame
+    const double seconds = std::max<qint64>(sinceLastFrame.restart(), 1) / 1000.0;
+    const double rate = std::max<long long>(totalSteps - lastSteps, 0) / seconds;
+    lastSteps = totalSteps;
+    summary->setText(QString("%1 lanes: %2 running, %3 halted, %4 in full view - %5 M steps/s")
+                             .arg(lanes.size()).arg(running).arg((int) lanes.size() - running - inFullView)
+                             .arg(inFullView).arg(rate / 1e6, 0, 'f', 1));
+}
+
+// Load every lane not in a full view with the program again
+void Dashboard::restart() {
+    for (size_t index = 0; index < lanes.size(); ++index) {
+        std::lock_guard<std::mutex> lock(lanes[index]->mutex);
+        if (!lanes[index]->inFullView) {
+            load((int) index);
+        }
+    }
+    lastSteps = 0;
+    refresh();
+}
+
+// Open the single-machine view on a lane. The workers leave it alone until the view is closed and gone, so that no
+// step the view has scheduled can run at the same time as theirs.
+void Dashboard::openLane(int lane) {
+    Lane &opened = *lanes[lane];
+    if (opened.fullView) {
+        opened.fullView->mainWindow.raise();
+        opened.fullView->mainWindow.activateWindow();
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(opened.mutex);
+        opened.inFullView = true;
+    }
+    opened.fullView = new Widget(&opened.baby);
+    opened.fullView->mainWindow.setWindowTitle(QString("Manchester Baby - lane %1").arg(lane));
+    opened.fullView->mainWindow.installEventFilter(this);
+    connect(opened.fullView, &QObject::destroyed, this, [&opened]() {
+        std::lock_guard<std::mutex> lock(opened.mutex);
+        opened.inFullView = false;
+    });
+    opened.fullView->mainWindow.show();
+    refresh();
+}
+
+// Closing a lane's full view gives the lane back to the workers
+bool Dashboard::eventFilter(QObject *watched, QEvent *event) {
+    if (event->type() == QEvent::Close) {
+        for (std::unique_ptr<Lane> &lane: lanes) {
+            if (lane->fullView && watched == &lane->fullView->mainWindow) {
+                lane->fullView->deleteLater();
+                lane->fullView = nullptr;
+                break;
+            }
+        }
+    }
+    return QWidget::eventFilter(watched, event);
+}
@@ -0,0 +1,130 @@
+#ifndef DASHBOARD_H
+#define DASHBOARD_H
+
+#include <QWidget>
+#include <QtWidgets>
+#include <QLabel>
+#include <QPushButton>
+#include <QScrollArea>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QImage>
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "baby.h"
+
+class Widget;
+
+// What a tile shows of its lane, copied once a frame
+struct DashboardTile {
+    int ci{0};
+    int accumulator{0};
+    long long steps{0};
+    bool halted{false};
+    bool inFullView{false};
+    std::array<uint32_t, SIZE_32_BIT> store{};    // The first 32 words, as stored
+};
+
+// The tiles of the dashboard, painted in one pass
+class DashboardCanvas : public QWidget {
+Q_OBJECT
+
+public:
+    explicit DashboardCanvas(QWidget *parent = 0);
+
+    // Show these tiles at the next repaint
+    void setTiles(const std::vector<DashboardTile> &newTiles);
+
+    static constexpr int TILE_WIDTH = 168;
+    static constexpr int TILE_HEIGHT = 88;
+    static constexpr int THUMBNAIL_SIZE = 64;    // Two pixels a bit
+    static constexpr int COLUMNS = 6;
+
+signals:
+
+    // A tile was double-clicked
+    void tileActivated(int lane);
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+
+    void mouseDoubleClickEvent(QMouseEvent *event) override;
+
+private:
+    std::vector<DashboardTile> tiles;
+    QImage thumbnail{SIZE_32_BIT, SIZE_32_BIT, QImage::Format_RGB32};  // Reused for every tile's store
+};
+
+// Many machines running the same program at once, e.g. the lanes of a sweep, each shown as a tile with its CI,
+// accumulator, steps and a thumbnail of the store.
+//
+// The lanes run unpaced on a few worker threads, a slice of steps at a time. The view doesn't follow them: a single
+// timer copies every lane into its tile at a fixed frame rate and repaints all the tiles at once, so drawing costs the
+// same however fast the engines run. Double-clicking a tile opens the lane in the single-machine view (Widget); the
+// workers leave the lane alone until that window is closed.
+class Dashboard : public QWidget {
+Q_OBJECT
+
+public:
+    // lanes copies of image. With sweepAddress at 0 or more, each lane starts with its number in that word.
+    Dashboard(const std::vector<std::bitset<SIZE_32_BIT>> &image, int lanes, int sweepAddress = -1,
+              QWidget *parent = 0);
+
+    ~Dashboard() override;
+
+    static constexpr int SLICE_STEPS = 4096;       // Steps a worker runs on a lane before moving to the next
+    static constexpr int FRAME_MS = 40;            // Time between repaints
+
+public slots:
+
+    // Copy the lanes into the tiles and repaint them
+    void refresh();
+
+    // Load every lane not in a full view with the program again
+    void restart();
+
+    // Open the single-machine view on a lane
+    void openLane(int lane);
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
+private:
+    // One machine. mutex is held while a worker runs a slice of it and while the view reads or drives it.
+    struct Lane {
+        ManchesterBaby baby;
+        std::mutex mutex;
+        long long steps{0};
+        bool inFullView{false};
+        Widget *fullView{nullptr};  // Only touched on the GUI thread
+    };
+
+    std::vector<std::bitset<SIZE_32_BIT>> image;
+    int sweepAddress;
+    std::vector<std::unique_ptr<Lane>> lanes;
+    std::vector<std::thread> workers;
+    std::atomic<bool> stopping{false};
+
+    QLabel *summary;
+    QPushButton *restartButton;
+    QScrollArea *scrollArea;
+    DashboardCanvas *canvas;
+    QTimer frameTimer;
+    QElapsedTimer sinceLastFrame;
+    long long lastSteps{0};
+    std::vector<DashboardTile> tiles;
+
+    // Load a lane with the program, and its number if sweeping. Call with its mutex held.
+    void load(int lane);
+
+    // Run lanes first, first + stride, ... until stopping
+    void work(size_t first, size_t stride);
+};
+
+#endif // DASHBOARD_H
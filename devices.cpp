@@ -0,0 +1,103 @@
+#include <algorithm>
+
+#include "baby.h"
+#include "devices.h"
+
+// Address of a standard port known to the assembler by name, or -1
+int deviceAddress(const std::string &name) {
+    if (name == "CHAROUT") {
+        return (int) CHAR_OUTPUT_ADDRESS;
+    } else if (name == "CHARIN") {
+        return (int) CHAR_INPUT_ADDRESS;
+    } else if (name == "CYCLES") {
+        return (int) CYCLE_COUNTER_ADDRESS;
+    }
+    return -1;
+}
+
+CharOutputDevice::CharOutputDevice(std::ostream &out, size_t blockSize) : out(out), blockSize(blockSize) {
+    buffer.reserve(blockSize);
+}
+
+CharOutputDevice::~CharOutputDevice() {
+    flush();
+}
+
+// Nothing to read back from an output port
+uint32_t CharOutputDevice::read(const ManchesterBaby &) {
+    return 0;
+}
+
+void CharOutputDevice::write(const ManchesterBaby &, uint32_t value) {
+    buffer += (char) (value & 0xFFU);
+    if (buffer.size() >= blockSize) {
+        flush();
+    }
+}
+
+void CharOutputDevice::flush() {
+    if (!buffer.empty()) {
+        out.write(buffer.data(), (std::streamsize) buffer.size());
+        out.flush();
+        buffer.clear();
+    }
+}
+
+CharInputDevice::CharInputDevice(std::istream &in, size_t blockSize) : in(in), blockSize(std::max<size_t>(blockSize, 1)) {}
+
+// The next character, or -1 at the end of the input
+uint32_t CharInputDevice::read(const ManchesterBaby &) {
+    if (next == buffer.size()) {
+        // Only what is already buffered, or else the next line: waiting for a full block would hold up an interactive
+        // caller, such as the GUI on the console, until the input is closed
+        next = 0;
+        buffer.resize(blockSize);
+        buffer.resize((size_t) std::max<std::streamsize>(in.readsome(&buffer[0], (std::streamsize) blockSize), 0));
+        if (buffer.empty() && std::getline(in, buffer) && !in.eof()) {
+            buffer += '\n';
+        }
+        if (buffer.empty()) {
+            return 0xFFFFFFFFU;
+        }
+    }
+    return (unsigned char) buffer[next++];
+}
+
+// Writing to an input port does nothing
+void CharInputDevice::write(const ManchesterBaby &, uint32_t) {}
+
+// Cycles since the counter was last written
+uint32_t CycleCounterDevice::read(const ManchesterBaby &baby) {
+    return (uint32_t) (baby.clock.cycles() - start);
+}
+
+// Restart the counter
+void CycleCounterDevice::write(const ManchesterBaby &baby, uint32_t) {
+    start = baby.clock.cycles();
+}
+
+// Map a device at an address, replacing any device already there.
+void DeviceBus::map(unsigned long address, std::unique_ptr<Device> device) {
+    unmap(address);
+    devices.emplace_back(address, std::move(device));
+}
+
+// Map the standard ports on host streams
+void DeviceBus::mapStandard(std::ostream &out, std::istream &in) {
+    map(CHAR_OUTPUT_ADDRESS, std::make_unique<CharOutputDevice>(out));
+    map(CHAR_INPUT_ADDRESS, std::make_unique<CharInputDevice>(in));
+    map(CYCLE_COUNTER_ADDRESS, std::make_unique<CycleCounterDevice>());
+}
+
+void DeviceBus::unmap(unsigned long address) {
+    devices.erase(std::remove_if(devices.begin(), devices.end(), [address](const auto &entry) {
+        return entry.first == address;
+    }), devices.end());
+}
+
+// Pass on everything buffered
+void DeviceBus::flush() {
+    for (const auto &entry: devices) {
+        entry.second->flush();
+    }
+}
@@ -0,0 +1,125 @@
+#ifndef DEVICES_H
+#define DEVICES_H
+
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+class ManchesterBaby;
+
+// Memory-mapped devices, at addresses above the store.
+//
+// Instructions whose operand is a mapped address read from or write to the device instead of the store: STO writes
+// the accumulator's value, every instruction reading the store (LDN, SUB, LDP, ADD, ...) reads the device's value,
+// and XCH and XAD read the device's value and then write the new one.
+// Only operands past the end of the store are looked up, on the engine's slow path, so ordinary accesses cost the
+// same whether devices are mapped or not. The standard ports, also known to the assembler by name:
+//     CHAROUT (8191)   - writing sends the low 8 bits of the value as one character
+//     CHARIN  (8190)   - reading takes the next character, or -1 at the end of the input (see CharInputDevice)
+//     CYCLES  (8189)   - reading gives the virtual clock's cycles (see clock.h) since it was last written
+const unsigned long CHAR_OUTPUT_ADDRESS = 8191;
+const unsigned long CHAR_INPUT_ADDRESS = 8190;
+const unsigned long CYCLE_COUNTER_ADDRESS = 8189;
+
+// Address of a standard port known to the assembler by name, or -1
+int deviceAddress(const std::string &name);
+
+// A device mapped at one address
+class Device {
+public:
+    virtual ~Device() = default;
+
+    // Value read by an instruction
+    virtual uint32_t read(const ManchesterBaby &baby) = 0;
+
+    // Value written by STO
+    virtual void write(const ManchesterBaby &baby, uint32_t value) = 0;
+
+    // Pass on anything buffered
+    virtual void flush() {}
+};
+
+// Characters out to a host stream, written in blocks
+class CharOutputDevice : public Device {
+public:
+    explicit CharOutputDevice(std::ostream &out, size_t blockSize = 4096);
+
+    ~CharOutputDevice() override;
+
+    uint32_t read(const ManchesterBaby &baby) override;
+
+    void write(const ManchesterBaby &baby, uint32_t value) override;
+
+    void flush() override;
+
+private:
+    std::ostream &out;
+    size_t blockSize;
+    std::string buffer;
+};
+
+// Characters in from a host stream. What the stream has buffered is taken in blocks; past that, one line is read at a
+// time, so a program reading the console waits for the next line rather than for the end of the input.
+class CharInputDevice : public Device {
+public:
+    explicit CharInputDevice(std::istream &in, size_t blockSize = 4096);
+
+    uint32_t read(const ManchesterBaby &baby) override;
+
+    void write(const ManchesterBaby &baby, uint32_t value) override;
+
+private:
+    std::istream &in;
+    size_t blockSize;
+    std::string buffer;
+    size_t next{0};
+};
+
+// The virtual clock, as a counter the program can read and restart
+class CycleCounterDevice : public Device {
+public:
+    uint32_t read(const ManchesterBaby &baby) override;
+
+    void write(const ManchesterBaby &baby, uint32_t value) override;
+
+private:
+    uint64_t start{0};
+};
+
+// The devices of one machine, by address
+class DeviceBus {
+public:
+    // Map a device at an address, replacing any device already there. Addresses inside the store are never looked
+    // up, so a device there is ignored.
+    void map(unsigned long address, std::unique_ptr<Device> device);
+
+    // Map the standard ports on host streams
+    void mapStandard(std::ostream &out = std::cout, std::istream &in = std::cin);
+
+    void unmap(unsigned long address);
+
+    // Device at an address, or nullptr
+    [[nodiscard]] Device *find(unsigned long address) const {
+        for (const auto &entry: devices) {
+            if (entry.first == address) {
+                return entry.second.get();
+            }
+        }
+        return nullptr;
+    }
+
+    [[nodiscard]] bool empty() const {
+        return devices.empty();
+    }
+
+    // Pass on everything buffered, e.g. when the machine halts
+    void flush();
+
+private:
+    std::vector<std::pair<unsigned long, std::unique_ptr<Device>>> devices;
+};
+
+#endif //DEVICES_H
@@ -311,6 +311,12 @@ public slots:
                 case 16:
                     expString = "SHR: A >>= 1";
                     break;
+                case 17:
+                    expString = "XCH: A, S = S, A";
+                    break;
+                case 18:
+                    expString = "XAD: A, S = S, S + A";
+                    break;
                 default:
                     expString = "Invalid OPCODE!";
                     break;
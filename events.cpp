@@ -0,0 +1,100 @@
+#include "baby.h"
+#include "events.h"
+
+namespace {
+
+// Buffered text is written out past this size
+const size_t TEXT_BUFFER_LIMIT = 1 << 16;
+
+}
+
+TextEventSink::TextEventSink(std::ostream &out, std::ostream &err, bool traceSteps)
+        : out(out), err(err), traceSteps(traceSteps) {}
+
+TextEventSink::~TextEventSink() {
+    flush();
+}
+
+void TextEventSink::onStep(const ManchesterBaby &baby, int) {
+    if (!traceSteps) {
+        return;
+    }
+    outBuffer += baby.stateText();
+    if (outBuffer.size() >= TEXT_BUFFER_LIMIT) {
+        flush();
+    }
+}
+
+void TextEventSink::onHalt(const ManchesterBaby &) {
+    outBuffer += "STOP!\n\n";
+    flush();
+}
+
+void TextEventSink::onIllegalOpcode(const ManchesterBaby &, unsigned long opcode) {
+    errBuffer += "Unknown opcode: " + std::to_string(opcode) + "\n";
+    flush();
+}
+
+// Write out everything buffered
+void TextEventSink::flush() {
+    if (!outBuffer.empty()) {
+        out << outBuffer << std::flush;
+        outBuffer.clear();
+    }
+    if (!errBuffer.empty()) {
+        err << errBuffer << std::flush;
+        errBuffer.clear();
+    }
+}
+
+// capacity is rounded up to a power of two
+RingEventSink::RingEventSink(size_t capacity) {
+    size_t size = 1;
+    while (size < capacity) {
+        size <<= 1;
+    }
+    events = std::make_unique<MachineEvent[]>(size);
+    mask = size - 1;
+}
+
+void RingEventSink::onStep(const ManchesterBaby &baby, int instructions) {
+    push(baby, MachineEvent::Kind::Step, (unsigned long) instructions, (uint32_t) baby.accumulator.to_ulong());
+}
+
+void RingEventSink::onStore(const ManchesterBaby &baby, unsigned long address, const std::bitset<32> &word) {
+    push(baby, MachineEvent::Kind::Store, address, (uint32_t) word.to_ulong());
+}
+
+void RingEventSink::onHalt(const ManchesterBaby &baby) {
+    push(baby, MachineEvent::Kind::Halt, 0, (uint32_t) baby.accumulator.to_ulong());
+}
+
+void RingEventSink::onIllegalOpcode(const ManchesterBaby &baby, unsigned long opcode) {
+    push(baby, MachineEvent::Kind::IllegalOpcode, opcode, (uint32_t) baby.accumulator.to_ulong());
+}
+
+// Take the oldest event, if any. Consumer side only.
+bool RingEventSink::pop(MachineEvent &event) {
+    const size_t read = head.load(std::memory_order_relaxed);
+    if (read == tail.load(std::memory_order_acquire)) {
+        return false;
+    }
+    event = events[read & mask];
+    head.store(read + 1, std::memory_order_release);
+    return true;
+}
+
+// Events dropped because the ring was full
+uint64_t RingEventSink::dropped() const {
+    return droppedEvents.load(std::memory_order_relaxed);
+}
+
+void RingEventSink::push(const ManchesterBaby &baby, MachineEvent::Kind kind, unsigned long detail, uint32_t word) {
+    const size_t write = tail.load(std::memory_order_relaxed);
+    if (write - head.load(std::memory_order_acquire) > mask) {
+        droppedEvents.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    events[write & mask] = {kind, baby.curRound, baby.ci, detail, word};
+    tail.store(write + 1, std::memory_order_release);
+}
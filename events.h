@@ -0,0 +1,113 @@
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include <atomic>
+#include <bitset>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+
+class ManchesterBaby;
+
+// Events reported by the engine, instead of writing to the console itself.
+//
+// A MachineObserver installed with ManchesterBaby::setObserver() is told about:
+//     step            - instructions executed: 1 for an interpreted instruction, more for a fused handler or a
+//                       fast-forwarded loop, which report their instructions at once
+//     store           - a word written to the store, by STO, a fused handler, loop acceleration or writeMemory()
+//                       (a fast-forwarded loop reports the final value of each cell it writes)
+//     halt            - STP was executed
+//     illegal opcode  - an unknown opcode was fetched; the machine halts without a halt event
+// The base class ignores everything, and no observer at all (the default) costs one pointer test per event.
+// Observers are called on the thread running the engine; see RingEventSink for consumers on other threads.
+class MachineObserver {
+public:
+    virtual ~MachineObserver() = default;
+
+    virtual void onStep(const ManchesterBaby & /*baby*/, int /*instructions*/) {}
+
+    virtual void onStore(const ManchesterBaby & /*baby*/, unsigned long /*address*/, const std::bitset<32> & /*word*/) {}
+
+    virtual void onHalt(const ManchesterBaby & /*baby*/) {}
+
+    // opcode is the opcode field as it appears in the instruction word
+    virtual void onIllegalOpcode(const ManchesterBaby & /*baby*/, unsigned long /*opcode*/) {}
+};
+
+// Writes the events as the engine used to: "STOP!" on halt, "Unknown opcode: N" on an unknown opcode, and
+// optionally the machine state (as printState) after every step. Text is buffered and written when the buffer
+// fills up, when the machine stops, on flush() and on destruction.
+class TextEventSink : public MachineObserver {
+public:
+    explicit TextEventSink(std::ostream &out = std::cout, std::ostream &err = std::cerr, bool traceSteps = false);
+
+    ~TextEventSink() override;
+
+    void onStep(const ManchesterBaby &baby, int instructions) override;
+
+    void onHalt(const ManchesterBaby &baby) override;
+
+    void onIllegalOpcode(const ManchesterBaby &baby, unsigned long opcode) override;
+
+    // Write out everything buffered
+    void flush();
+
+private:
+    std::ostream &out;
+    std::ostream &err;
+    bool traceSteps;
+    std::string outBuffer;
+    std::string errBuffer;
+};
+
+// One event, as stored by RingEventSink
+struct MachineEvent {
+    enum class Kind : uint8_t {
+        Step,
+        Store,
+        Halt,
+        IllegalOpcode
+    };
+
+    Kind kind;
+    int round;              // curRound after the event
+    int ci;                 // CI after the event
+    unsigned long detail;   // Step: instructions; Store: address; IllegalOpcode: the opcode field; Halt: 0
+    uint32_t word;          // Store: the word written; otherwise the accumulator. Bits as stored, so a value is
+                            // ManchesterBaby::convertInstruction(std::bitset<32>(word))
+};
+
+// Lock-free single-producer single-consumer ring of events. The engine's thread produces, any one other thread
+// consumes with pop(). When the ring is full new events are dropped and counted rather than waited for, so the
+// engine never blocks.
+class RingEventSink : public MachineObserver {
+public:
+    // capacity is rounded up to a power of two
+    explicit RingEventSink(size_t capacity = 4096);
+
+    void onStep(const ManchesterBaby &baby, int instructions) override;
+
+    void onStore(const ManchesterBaby &baby, unsigned long address, const std::bitset<32> &word) override;
+
+    void onHalt(const ManchesterBaby &baby) override;
+
+    void onIllegalOpcode(const ManchesterBaby &baby, unsigned long opcode) override;
+
+    // Take the oldest event, if any. Consumer side only.
+    bool pop(MachineEvent &event);
+
+    // Events dropped because the ring was full
+    [[nodiscard]] uint64_t dropped() const;
+
+private:
+    std::unique_ptr<MachineEvent[]> events;
+    size_t mask;
+    alignas(64) std::atomic<size_t> head{0};    // Next slot to read, written by the consumer
+    alignas(64) std::atomic<size_t> tail{0};    // Next slot to write, written by the producer
+    std::atomic<uint64_t> droppedEvents{0};
+
+    void push(const ManchesterBaby &baby, MachineEvent::Kind kind, unsigned long detail, uint32_t word);
+};
+
+#endif //EVENTS_H
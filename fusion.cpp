@@ -0,0 +1,144 @@
+#include <cstdint>
+
+#include "baby.h"
+#include "fusion.h"
+#include "probes.h"
+
+namespace {
+
+// Value of a store word as the engine sees it
+uint32_t wordValue(const std::bitset<SIZE_32_BIT> &word) {
+    return (uint32_t) ManchesterBaby::convertInstruction(word);
+}
+
+// Store word holding a value
+std::bitset<SIZE_32_BIT> valueWord(uint32_t value) {
+    return {ManchesterBaby::convertInstruction(std::bitset<SIZE_32_BIT>(value))};
+}
+
+}
+
+// Run the fused handler starting at CI, if there is one and it fits in budget instructions.
+// Returns the number of instructions executed (0 if the caller should run one instruction itself).
+int InstructionFuser::execute(ManchesterBaby &baby, int budget) {
+    const int address = baby.ci;
+    if (address < 0 || address >= SIZE_32_BIT) {
+        return 0;
+    }
+    if (entries[address].kind == Kind::Unknown) {
+        build(baby, address);
+    }
+    // A copy, as the handler's own store may forget the entry
+    const Entry entry = entries[address];
+    if (entry.kind == Kind::None) {
+        return 0;
+    }
+
+    // Instructions run: CMP; JMP is a single instruction when the CMP skips the JMP
+    bool skip = entry.kind == Kind::CmpJmp && (int32_t) wordValue(baby.accumulator) < 0;
+    int length = entry.kind == Kind::CmpJmp ? (skip ? 1 : 2) : 3;
+    if (budget < length) {
+        return 0;
+    }
+    const int last = length - 1;
+    baby.pi = baby.memory[address + last];      // PI, before a store can change it
+
+    auto operandValue = [&](int index) {
+        return entry.immediate[index] ? (uint32_t) entry.operand[index] : wordValue(baby.memory[entry.operand[index]]);
+    };
+    int prevCi = address + last;
+    int nextCi = (address + length) % SIZE_32_BIT;
+    switch (entry.kind) {
+        case Kind::LoadPositive: {
+            uint32_t value = operandValue(0);
+            baby.writeMemory(entry.operand[1], valueWord(0U - value));
+            baby.accumulator = valueWord(value);
+            baby.curImAddressing = false;
+            break;
+        }
+        case Kind::LoadOpStore: {
+            uint32_t acc = entry.opcode[0] == LDN ? 0U - operandValue(0) : operandValue(0);
+            acc = entry.opcode[1] == ADD ? acc + operandValue(1) : acc - operandValue(1);
+            baby.accumulator = valueWord(acc);
+            baby.writeMemory(entry.operand[2], baby.accumulator);
+            baby.curImAddressing = entry.immediate[1];  // STO doesn't change the addressing mode shown
+            break;
+        }
+        case Kind::CmpJmp:
+            if (skip) {
+                prevCi = address + 1;
+                nextCi = (address + 2) % SIZE_32_BIT;
+            } else {
+                prevCi = (int) operandValue(1);
+                nextCi = (prevCi + 1) % SIZE_32_BIT;
+                baby.curImAddressing = entry.immediate[1];
+            }
+            break;
+        default:
+            return 0;
+    }
+
+    baby.curOpCode = entry.opcode[last];
+    baby.curOperand = entry.operand[last];
+    baby.prev_ci = prevCi;
+    baby.ci = nextCi;
+    baby.curRound += length;
+    for (int i = 0; i < length; ++i) {
+        // The skipped JMP of a CmpJmp isn't charged: length is 1 then
+        baby.clock.tick(entry.opcode[i]);
+    }
+    fusedExecuted++;
+    instructionsFused += length;
+    BABY_PROBE2(baby, fused, (int) entry.kind, address);
+    return length;
+}
+
+// Forget the sequences covering address, which has just been written.
+void InstructionFuser::invalidate(unsigned long address) {
+    for (unsigned long start = address >= 2 ? address - 2 : 0; start <= address && start < entries.size(); ++start) {
+        entries[start].kind = Kind::Unknown;
+    }
+}
+
+// Forget every sequence, after the whole store has changed.
+void InstructionFuser::clear() {
+    for (Entry &entry: entries) {
+        entry.kind = Kind::Unknown;
+    }
+}
+
+// Look for a sequence starting at address. Sequences never wrap around the end of the store.
+void InstructionFuser::build(const ManchesterBaby &baby, int address) {
+    Entry &entry = entries[address];
+    entry.kind = Kind::None;
+    const unsigned long storeSize = baby.memory.size();
+    int count = std::min(3, SIZE_32_BIT - address);
+    ManchesterBaby::Instruction ins[3]{};
+    for (int i = 0; i < count; ++i) {
+        ins[i] = ManchesterBaby::decodeInstruction(baby.memory[address + i]);
+        entry.opcode[i] = ins[i].opcode;
+        entry.operand[i] = ins[i].operand;
+        entry.immediate[i] = ins[i].immediate;
+    }
+    // Operands the handlers can read without going past the store
+    auto readable = [&](int i) {
+        return ins[i].immediate || ins[i].operand < storeSize;
+    };
+
+    if (count >= 2 && ins[0].opcode == CMP && ins[1].opcode == JMP && readable(1)) {
+        entry.kind = Kind::CmpJmp;
+        return;
+    }
+    if (count < 3) {
+        return;
+    }
+    if (ins[0].opcode == LDN && readable(0) && ins[1].opcode == STO && ins[1].operand < storeSize &&
+        ins[2].opcode == LDN && !ins[2].immediate && ins[2].operand == ins[1].operand &&
+        ins[1].operand != (unsigned long) address + 2) {
+        entry.kind = Kind::LoadPositive;
+    } else if ((ins[0].opcode == LDN || ins[0].opcode == LDP) && readable(0) &&
+               (ins[1].opcode == ADD || ins[1].opcode == SUB) && readable(1) &&
+               ins[2].opcode == STO && ins[2].operand < storeSize) {
+        entry.kind = Kind::LoadOpStore;
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef FUSION_H
+#define FUSION_H
+
+#include <array>
+
+class ManchesterBaby;
+
+// Runs common Baby instruction sequences as single fused handlers (superinstructions).
+//
+// Sequences are recognised lazily, the first time CI reaches their first instruction, and remembered per address:
+//     LDN x; STO t; LDN t      - load the positive value of x (t is left holding -x)
+//     LDx a; ADD/SUB b; STO c  - LDN or LDP, then one operation, then a store
+//     CMP; JMP y               - conditional jump, run as one handler whichever way it goes
+// A handler leaves exactly the state the separate instructions would have left, including PI, the current
+// opcode/operand and curRound. Dispatch is by CI, so a jump into the middle of a sequence simply runs from there.
+// Any store into a sequence (made by STO, by a handler or through ManchesterBaby::writeMemory) forgets it, and
+// sequences whose own STO would rewrite a later instruction of the same sequence are never fused.
+class InstructionFuser {
+public:
+    // Run the fused handler starting at CI, if there is one and it fits in budget instructions.
+    // Returns the number of instructions executed (0 if the caller should run one instruction itself).
+    int execute(ManchesterBaby &baby, int budget);
+
+    // Forget the sequences covering address, which has just been written.
+    void invalidate(unsigned long address);
+
+    // Forget every sequence, after the whole store has changed.
+    void clear();
+
+    long long fusedExecuted{0};     // Fused handlers run
+    long long instructionsFused{0}; // Instructions those handlers covered; dispatches saved = this - fusedExecuted
+
+private:
+    enum class Kind : unsigned char {
+        Unknown,        // Not looked at yet
+        None,           // No sequence starts here
+        LoadPositive,   // LDN x; STO t; LDN t
+        LoadOpStore,    // LDx a; ADD/SUB b; STO c
+        CmpJmp          // CMP; JMP y
+    };
+
+    struct Entry {
+        Kind kind{Kind::Unknown};
+        int opcode[3]{};
+        unsigned long operand[3]{};
+        bool immediate[3]{};
+    };
+
+    std::array<Entry, 32> entries;
+
+    void build(const ManchesterBaby &baby, int address);
+};
+
+#endif //FUSION_H
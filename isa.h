@@ -0,0 +1,265 @@
+#ifndef ISA_H
+#define ISA_H
+
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "word.h"
+
+// Defining operands as enums
+enum OpCode {   // Digit No.14 - No.19 in machine code
+    /* Classic Instructions */
+    JMP = 0,    // 00000
+    JRP = 1,    // 10000
+    LDN = 2,    // 01000
+    STO = 3,    // 11000
+    SUB = 4,    // 00100, or 5 10100
+    CMP = 6,    // 01100
+    STP = 7,    // 11100
+    /* Additional Instructions */
+    LDP = 8,    // 00010
+    ADD = 9,    // 10010
+    DIV = 10,   // 01010
+    MOD = 11,   // 11010
+    LAN = 12,   // 00110
+    LOR = 13,   // 10110
+    LNT = 14,   // 01110
+    SHL = 15,   // 11110
+    SHR = 16,   // 00001
+    /* Shared-Memory Instructions (atomic when cores share a store, see smp.h) */
+    XCH = 17,   // 10001
+    XAD = 18    // 01001
+};
+
+// How an instruction uses its operand
+enum class OperandUse : unsigned char {
+    None,           // CMP, STP, LNT, SHL, SHR: no operand
+    Read,           // A store word, or with immediate addressing the operand itself
+    Write,          // STO
+    Exchange        // XCH, XAD: a store word is read, then written
+};
+
+// What an instruction changes
+enum class Effect : unsigned char {
+    Accumulator,    // A = compute(A, S)
+    Jump,           // CI = compute(CI, S)
+    Skip,           // CI += 1 if A < 0
+    Stop,           // The machine halts
+    Store,          // S = A
+    Exchange        // S = compute(A, S), and A takes the old S
+};
+
+// Divisor of DIV and MOD. Dividing by zero would kill the process, so it throws instead.
+inline uint32_t divisor(uint32_t value) {
+    if (value == 0) {
+        throw std::runtime_error("Division by zero.");
+    }
+    return value;
+}
+
+// One instruction of the set
+struct InstructionInfo {
+    const char *mnemonic;
+    OperandUse operand;
+    Effect effect;
+    bool immediate;                                 // Whether immediate addressing is available
+    uint32_t (*compute)(uint32_t, uint32_t);        // On values (see reverseWord), as Effect says; or nullptr
+    const char *explanation;                        // As the GUI shows it, S being the store word
+};
+
+// The instruction set, by opcode. This is the one place an instruction is defined: the assembler looks mnemonics
+// up here, the engine dispatches through it, and the GUI explains instructions from it. The engines that keep their
+// own copy of the semantics, for other word sizes or for speed (widebaby.h, stepbound.cpp, superopt/miniengine.h),
+// assert the size of the table, so that a new instruction doesn't compile until each of them handles it.
+inline constexpr std::array<InstructionInfo, XAD + 1> INSTRUCTIONS = {{
+        {"JMP", OperandUse::Read, Effect::Jump, true, [](uint32_t, uint32_t s) { return s; }, "CI = S"},
+        {"JRP", OperandUse::Read, Effect::Jump, true, [](uint32_t ci, uint32_t s) { return ci + s; }, "CI += S"},
+        {"LDN", OperandUse::Read, Effect::Accumulator, true, [](uint32_t, uint32_t s) { return 0U - s; }, "A = -S"},
+        {"STO", OperandUse::Write, Effect::Store, false, nullptr, "S = A"},
+        {"SUB", OperandUse::Read, Effect::Accumulator, true, [](uint32_t a, uint32_t s) { return a - s; }, "A -= S"},
+        // 5 is SUB too
+        {"SUB", OperandUse::Read, Effect::Accumulator, true, [](uint32_t a, uint32_t s) { return a - s; }, "A -= S"},
+        {"CMP", OperandUse::None, Effect::Skip, false, nullptr, "CI += 1 if A < 0"},
+        {"STP", OperandUse::None, Effect::Stop, false, nullptr, "stop"},
+        {"LDP", OperandUse::Read, Effect::Accumulator, true, [](uint32_t, uint32_t s) { return s; }, "A = S"},
+        {"ADD", OperandUse::Read, Effect::Accumulator, true, [](uint32_t a, uint32_t s) { return a + s; }, "A += S"},
+        {"DIV", OperandUse::Read, Effect::Accumulator, true,
+         [](uint32_t a, uint32_t s) { return a / divisor(s); }, "A /= S"},
+        {"MOD", OperandUse::Read, Effect::Accumulator, true,
+         [](uint32_t a, uint32_t s) { return a % divisor(s); }, "A %= S"},
+        {"LAN", OperandUse::Read, Effect::Accumulator, false, [](uint32_t a, uint32_t s) { return a & s; },
+         "A = A & S"},
+        {"LOR", OperandUse::Read, Effect::Accumulator, false, [](uint32_t a, uint32_t s) { return a | s; },
+         "A = A | S"},
+        {"LNT", OperandUse::None, Effect::Accumulator, false, [](uint32_t a, uint32_t) { return ~a; }, "A = ~A"},
+        // The stored bits move up, so the value halves
+        {"SHL", OperandUse::None, Effect::Accumulator, false, [](uint32_t a, uint32_t) { return a >> 1; },
+         "A <<= 1"},
+        {"SHR", OperandUse::None, Effect::Accumulator, false, [](uint32_t a, uint32_t) { return a << 1; },
+         "A >>= 1"},
+        {"XCH", OperandUse::Exchange, Effect::Exchange, false, [](uint32_t a, uint32_t) { return a; },
+         "A, S = S, A"},
+        {"XAD", OperandUse::Exchange, Effect::Exchange, false, [](uint32_t a, uint32_t s) { return s + a; },
+         "A, S = S, S + A"}
+}};
+
+// Whether an opcode uses immediate addressing when the bit is set: JMP, JRP, LDN, SUB, LDP, ADD, DIV, MOD
+constexpr bool takesImmediate(int opcode) {
+    return opcode >= 0 && opcode < (int) INSTRUCTIONS.size() && INSTRUCTIONS[opcode].immediate;
+}
+
+// Slot of a mnemonic in the lookup table: a hash of its three letters
+constexpr size_t mnemonicSlot(std::string_view mnemonic) {
+    return ((mnemonic[0] & 31U) * 1089U + (mnemonic[1] & 31U) * 33U + (mnemonic[2] & 31U)) % 64U;
+}
+
+// Mnemonic lookup table: opcodes by hash, open-addressed, -1 for empty slots
+constexpr std::array<int8_t, 64> makeMnemonicTable() {
+    std::array<int8_t, 64> table{};
+    for (int8_t &slot: table) {
+        slot = -1;
+    }
+    for (int opcode = 0; opcode < (int) INSTRUCTIONS.size(); ++opcode) {
+        if (opcode == 5) {
+            continue;
+        }
+        size_t slot = mnemonicSlot(INSTRUCTIONS[opcode].mnemonic);
+        while (table[slot] >= 0) {
+            slot = (slot + 1) % 64U;
+        }
+        table[slot] = (int8_t) opcode;
+    }
+    return table;
+}
+
+inline constexpr std::array<int8_t, 64> mnemonicTable = makeMnemonicTable();
+
+// Opcode of a mnemonic, or -1 if there is no such instruction
+constexpr int opcodeOf(std::string_view mnemonic) {
+    if (mnemonic.size() != 3) {
+        return -1;
+    }
+    for (size_t slot = mnemonicSlot(mnemonic); mnemonicTable[slot] >= 0; slot = (slot + 1) % 64U) {
+        if (mnemonic == INSTRUCTIONS[mnemonicTable[slot]].mnemonic) {
+            return mnemonicTable[slot];
+        }
+    }
+    return -1;
+}
+
+static_assert(opcodeOf("SUB") == SUB && opcodeOf("XAD") == XAD && opcodeOf("VAR") == -1,
+              "every mnemonic must be found at its own opcode");
+
+// What an instruction does, as the GUI shows it: "ADD: A += S", or "ADD: A += OPERAND" with immediate addressing
+inline std::string explainInstruction(int opcode, bool immediate) {
+    if (opcode < 0 || opcode >= (int) INSTRUCTIONS.size()) {
+        return "Invalid OPCODE!";
+    }
+    const InstructionInfo &info = INSTRUCTIONS[opcode];
+    std::string text = std::string(info.mnemonic) + ": " + info.explanation;
+    if (immediate && info.immediate) {
+        text.replace(text.rfind('S'), 1, "OPERAND");
+    }
+    return text;
+}
+
+// Instruction set variants the engine can be specialised for.
+//
+// ManchesterBaby::run() dispatches through a loop instantiated for one of these policies. A narrower policy has a
+// smaller decode table and compiles the handlers it can't reach out of its loop:
+//     Classic             - the seven SSEM instructions, no immediate addressing
+//     ClassicImmediate    - the same, with immediate addressing for JMP, JRP, LDN and SUB
+//     Extended            - every instruction, LDP to XAD included
+// loadProgram() picks the narrowest variant able to run the reachable code of the image (ManchesterBaby::narrowestIsa).
+// Code created at run time can still need more: an instruction outside the variant is run by the full interpreter
+// and the variant is widened for the rest of the run, so results never depend on the choice.
+enum class IsaVariant : unsigned char {
+    Classic,
+    ClassicImmediate,
+    Extended
+};
+
+// Reverse the low width bits of value: words are stored least significant bit first
+constexpr uint32_t reverseBits(uint32_t value, int width) {
+    uint32_t reversed = 0;
+    for (int i = 0; i < width; ++i) {
+        reversed = (reversed << 1) | ((value >> i) & 1U);
+    }
+    return reversed;
+}
+
+// Value of a whole stored word
+constexpr uint32_t reverseWord(uint32_t word) {
+    word = ((word >> 1) & 0x55555555U) | ((word & 0x55555555U) << 1);
+    word = ((word >> 2) & 0x33333333U) | ((word & 0x33333333U) << 2);
+    word = ((word >> 4) & 0x0F0F0F0FU) | ((word & 0x0F0F0F0FU) << 4);
+    word = ((word >> 8) & 0x00FF00FFU) | ((word & 0x00FF00FFU) << 8);
+    return (word >> 16) | (word << 16);
+}
+
+// Layout of an instruction word (see word.h)
+constexpr int OPCODE_SHIFT = Layout32::storedOpcodeShift;           // 5 bits as stored, most significant bit last
+constexpr uint32_t VALUE_OPERAND_MASK = Layout32::operandMask;      // Operand, in the value (see reverseWord)
+constexpr int IMMEDIATE_SHIFT = Layout32::storedImmediateShift;     // Immediate addressing bit as stored
+
+struct ClassicIsa {
+    static constexpr IsaVariant variant = IsaVariant::Classic;
+    static constexpr int lastOpcode = STP;
+    static constexpr bool immediate = false;
+};
+
+struct ClassicImmediateIsa {
+    static constexpr IsaVariant variant = IsaVariant::ClassicImmediate;
+    static constexpr int lastOpcode = STP;
+    static constexpr bool immediate = true;
+};
+
+struct ExtendedIsa {
+    static constexpr IsaVariant variant = IsaVariant::Extended;
+    static constexpr int lastOpcode = 31;   // Unknown opcodes too: they halt the machine
+    static constexpr bool immediate = true;
+};
+
+// Decode table of a variant: opcode field as stored to opcode (5 folded into 4), or -1 if the variant can't run it
+template<class Isa>
+constexpr std::array<int8_t, 32> makeOpcodeTable() {
+    std::array<int8_t, 32> table{};
+    for (uint32_t field = 0; field < 32; ++field) {
+        int opcode = (int) reverseBits(field, 5);
+        if (opcode == 5) opcode--;
+        table[field] = (int8_t) (opcode <= Isa::lastOpcode ? opcode : -1);
+    }
+    return table;
+}
+
+template<class Isa>
+inline constexpr std::array<int8_t, 32> opcodeTable = makeOpcodeTable<Isa>();
+
+// Narrowest variant able to run one instruction
+constexpr IsaVariant narrowestIsaFor(int opcode, bool immediate) {
+    if (opcode > ClassicIsa::lastOpcode) {
+        return IsaVariant::Extended;
+    }
+    return immediate && takesImmediate(opcode) ? IsaVariant::ClassicImmediate : IsaVariant::Classic;
+}
+
+// Narrowest variant able to run what both can
+constexpr IsaVariant widerIsa(IsaVariant a, IsaVariant b) {
+    return a > b ? a : b;
+}
+
+inline std::string isaName(IsaVariant variant) {
+    switch (variant) {
+        case IsaVariant::Classic:
+            return "classic";
+        case IsaVariant::ClassicImmediate:
+            return "classic-immediate";
+        default:
+            return "extended";
+    }
+}
+
+#endif //ISA_H
@@ -0,0 +1,360 @@
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "babyapi.h"
+#include "../assembler.h"
+#include "../baby.h"
+
+struct baby_machine {
+    std::istringstream noProgram;
+    ManchesterBaby baby{noProgram};
+    std::string error;
+};
+
+struct baby_assembly {
+    std::string image;
+    std::vector<int32_t> words;
+    std::string diagnostics;
+};
+
+// Run body on a machine, turning exceptions into error codes with their message kept on the machine
+template<class Body>
+static int guarded(baby_machine *machine, Body body) {
+    if (machine == nullptr) {
+        return BABY_ERROR_ARGUMENT;
+    }
+    machine->error.clear();
+    try {
+        return body(machine->baby);
+    } catch (const std::bad_alloc &) {
+        machine->error = "out of memory";
+        return BABY_ERROR_MEMORY;
+    } catch (const std::exception &e) {
+        machine->error = e.what();
+        return BABY_ERROR_RUNTIME;
+    }
+}
+
+// Store word of a value
+static std::bitset<SIZE_32_BIT> storedWord(int32_t value) {
+    return {reverseWord((uint32_t) value)};
+}
+
+// Value of a store word
+static int32_t wordValue(const std::bitset<SIZE_32_BIT> &word) {
+    return (int32_t) reverseWord((uint32_t) word.to_ulong());
+}
+
+// Replace the store with an image and get ready to run it
+static void load(ManchesterBaby &baby, const std::vector<std::bitset<SIZE_32_BIT>> &image) {
+    baby.memory.assign(SIZE_32_BIT, std::bitset<SIZE_32_BIT>());
+    baby.loadProgram(image);
+    baby.reset();
+    baby.setHalt(false);
+    baby.selectFastestMode();
+}
+
+// Run up to steps instructions, in slices run() can count
+static int64_t run(ManchesterBaby &baby, int64_t steps) {
+    int64_t executed = 0;
+    while (!baby.isHalted() && executed < steps) {
+        executed += baby.run((int) std::min<int64_t>(steps - executed, INT_MAX));
+    }
+    return executed;
+}
+
+int baby_api_version(void) {
+    return BABY_API_VERSION;
+}
+
+baby_machine *baby_create(void) {
+    try {
+        return new baby_machine();
+    } catch (const std::exception &) {
+        return nullptr;
+    }
+}
+
+void baby_destroy(baby_machine *machine) {
+    delete machine;
+}
+
+int baby_load_image(baby_machine *machine, const char *image, size_t length) {
+    if (image == nullptr && length > 0) {
+        return BABY_ERROR_ARGUMENT;
+    }
+    return guarded(machine, [&](ManchesterBaby &baby) {
+        std::vector<std::bitset<SIZE_32_BIT>> words;
+        std::istringstream input(std::string(image, length));
+        std::string line;
+        while (getline(input, line)) {
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            if (line.size() != SIZE_32_BIT || line.find_first_not_of("01") != std::string::npos) {
+                machine->error = "line " + std::to_string(words.size() + 1) + " is not a 32-bit word";
+                return BABY_ERROR_IMAGE;
+            }
+            words.emplace_back(line);
+        }
+        load(baby, words);
+        return BABY_OK;
+    });
+}
+
+int baby_load_words(baby_machine *machine, const int32_t *words, size_t count) {
+    if (words == nullptr && count > 0) {
+        return BABY_ERROR_ARGUMENT;
+    }
+    return guarded(machine, [&](ManchesterBaby &baby) {
+        std::vector<std::bitset<SIZE_32_BIT>> image;
+        image.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            image.push_back(storedWord(words[i]));
+        }
+        load(baby, image);
+        return BABY_OK;
+    });
+}
+
+int baby_run(baby_machine *machine, int64_t steps, int64_t *executed) {
+    return guarded(machine, [&](ManchesterBaby &baby) {
+        int64_t count = run(baby, steps);
+        if (executed != nullptr) {
+            *executed = count;
+        }
+        return BABY_OK;
+    });
+}
+
+int baby_run_to_halt(baby_machine *machine, int64_t *executed) {
+    return guarded(machine, [&](ManchesterBaby &baby) {
+        int64_t count = 0;
+        while (!baby.isHalted()) {
+            count += run(baby, INT_MAX);
+        }
+        if (executed != nullptr) {
+            *executed = count;
+        }
+        return BABY_OK;
+    });
+}
+
+void baby_reset(baby_machine *machine) {
+    if (machine != nullptr) {
+        machine->baby.reset();
+        machine->baby.setHalt(false);
+    }
+}
+
+size_t baby_memory_size(const baby_machine *machine) {
+    return machine == nullptr ? 0 : machine->baby.memory.size();
+}
+
+int baby_read_memory(const baby_machine *machine, size_t address, int32_t *value) {
+    if (machine == nullptr || value == nullptr || address >= machine->baby.memory.size()) {
+        return BABY_ERROR_ARGUMENT;
+    }
+    *value = wordValue(machine->baby.memory[address]);
+    return BABY_OK;
+}
+
+int baby_write_memory(baby_machine *machine, size_t address, int32_t value) {
+    if (machine != nullptr && address >= machine->baby.memory.size()) {
+        machine->error = "address " + std::to_string(address) + " is past the store";
+        return BABY_ERROR_ARGUMENT;
+    }
+    return guarded(machine, [&](ManchesterBaby &baby) {
+        baby.writeMemory(address, storedWord(value));
+        return BABY_OK;
+    });
+}
+
+int baby_get_register(const baby_machine *machine, int reg, int64_t *value) {
+    if (machine == nullptr || value == nullptr) {
+        return BABY_ERROR_ARGUMENT;
+    }
+    const ManchesterBaby &baby = machine->baby;
+    switch (reg) {
+        case BABY_REG_ACCUMULATOR:
+            *value = wordValue(baby.accumulator);
+            break;
+        case BABY_REG_CI:
+            *value = baby.ci;
+            break;
+        case BABY_REG_PI:
+            *value = wordValue(baby.pi);
+            break;
+        case BABY_REG_ROUND:
+            *value = baby.curRound;
+            break;
+        case BABY_REG_HALTED:
+            *value = baby.isHalted() ? 1 : 0;
+            break;
+        default:
+            return BABY_ERROR_ARGUMENT;
+    }
+    return BABY_OK;
+}
+
+int baby_set_register(baby_machine *machine, int reg, int64_t value) {
+    if (machine == nullptr) {
+        return BABY_ERROR_ARGUMENT;
+    }
+    ManchesterBaby &baby = machine->baby;
+    switch (reg) {
+        case BABY_REG_ACCUMULATOR:
+            baby.accumulator = storedWord((int32_t) value);
+            break;
+        case BABY_REG_CI:
+            if (value < 0 || value >= SIZE_32_BIT) {
+                machine->error = "CI must be an address of the first 32 words";
+                return BABY_ERROR_ARGUMENT;
+            }
+            baby.ci = (int) value;
+            break;
+        case BABY_REG_PI:
+            baby.pi = storedWord((int32_t) value);
+            break;
+        case BABY_REG_ROUND:
+            baby.curRound = (int) value;
+            break;
+        case BABY_REG_HALTED:
+            baby.setHalt(value != 0);
+            break;
+        default:
+            machine->error = "no register " + std::to_string(reg);
+            return BABY_ERROR_ARGUMENT;
+    }
+    return BABY_OK;
+}
+
+uint64_t baby_cycles(const baby_machine *machine) {
+    return machine == nullptr ? 0 : machine->baby.clock.cycles();
+}
+
+const char *baby_last_error(const baby_machine *machine) {
+    return machine == nullptr ? "" : machine->error.c_str();
+}
+
+int baby_assemble(const char *source, size_t length, baby_assembly **result) {
+    if (result == nullptr || (source == nullptr && length > 0)) {
+        return BABY_ERROR_ARGUMENT;
+    }
+    *result = nullptr;
+    try {
+        auto *assembly = new baby_assembly();
+        *result = assembly;
+        std::vector<std::string> log;
+        std::istringstream input(std::string(source, length));
+        int status = BABY_OK;
+        try {
+            for (const std::string &line: Assembler::processAssembleCode(SymbolTable(), input, log)) {
+                assembly->image += line + "\n";
+                assembly->words.push_back(wordValue(std::bitset<SIZE_32_BIT>(line)));
+            }
+        } catch (const std::invalid_argument &e) {
+            Assembler::logError(e, log);
+            assembly->image.clear();
+            assembly->words.clear();
+            status = BABY_ERROR_ASSEMBLY;
+        }
+        for (const std::string &message: log) {
+            assembly->diagnostics += message + "\n";
+        }
+        return status;
+    } catch (const std::bad_alloc &) {
+        delete *result;
+        *result = nullptr;
+        return BABY_ERROR_MEMORY;
+    }
+}
+
+const char *baby_assembly_image(const baby_assembly *assembly, size_t *length) {
+    if (assembly == nullptr) {
+        return nullptr;
+    }
+    if (length != nullptr) {
+        *length = assembly->image.size();
+    }
+    return assembly->image.c_str();
+}
+
+const int32_t *baby_assembly_words(const baby_assembly *assembly, size_t *count) {
+    if (assembly == nullptr) {
+        return nullptr;
+    }
+    if (count != nullptr) {
+        *count = assembly->words.size();
+    }
+    return assembly->words.data();
+}
+
+const char *baby_assembly_diagnostics(const baby_assembly *assembly) {
+    return assembly == nullptr ? "" : assembly->diagnostics.c_str();
+}
+
+void baby_assembly_free(baby_assembly *assembly) {
+    delete assembly;
+}
+
+// Run one job of a batch on a reused machine
+static void runJob(baby_machine &machine, baby_job &job) {
+    job.status = baby_load_words(&machine, job.words, job.count);
+    if (job.status == BABY_OK) {
+        job.status = baby_run(&machine, job.steps, &job.executed);
+    }
+    const ManchesterBaby &baby = machine.baby;
+    job.halted = baby.isHalted() ? 1 : 0;
+    job.accumulator = wordValue(baby.accumulator);
+    job.ci = baby.ci;
+    job.cycles = baby.clock.cycles();
+    if (job.memory_out != nullptr) {
+        for (size_t i = 0; i < job.memory_out_count; ++i) {
+            job.memory_out[i] = i < baby.memory.size() ? wordValue(baby.memory[i]) : 0;
+        }
+    }
+}
+
+int baby_run_batch(baby_job *jobs, size_t count, int threads) {
+    if (jobs == nullptr && count > 0) {
+        return BABY_ERROR_ARGUMENT;
+    }
+    size_t workers = threads > 0 ? (size_t) threads : std::max(1U, std::thread::hardware_concurrency());
+    workers = std::min(workers, count);
+    std::atomic<size_t> next{0};
+    auto work = [&]() {
+        try {
+            baby_machine machine;
+            for (size_t i = next++; i < count; i = next++) {
+                runJob(machine, jobs[i]);
+            }
+        } catch (const std::bad_alloc &) {
+            // The jobs this thread didn't get to keep the status set below
+        }
+    };
+    for (size_t i = 0; i < count; ++i) {
+        jobs[i].status = BABY_ERROR_MEMORY;
+    }
+    // This thread works too, so the batch runs even if no other thread can be started
+    std::vector<std::thread> pool;
+    for (size_t i = 1; i < workers; ++i) {
+        try {
+            pool.emplace_back(work);
+        } catch (const std::exception &) {
+            break;
+        }
+    }
+    work();
+    for (auto &thread: pool) {
+        thread.join();
+    }
+    return BABY_OK;
+}
@@ -0,0 +1,133 @@
+#ifndef BABYAPI_H
+#define BABYAPI_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* C interface of libbaby, the simulator and the assembler as a shared library without Qt.
+ *
+ * Values in the store and in registers are signed 32-bit numbers, as the program sees them (not bit-reversed as in
+ * machine code files). Functions returning int return BABY_OK or a negative error code; after an error on a
+ * machine, baby_last_error() describes it. No function throws or writes to the console. A machine may be used by one
+ * thread at a time; different machines, and baby_assemble() and baby_run_batch(), may be used from any number of
+ * threads at once.
+ *
+ * The interface only ever grows: BABY_API_VERSION is raised when functions are added, and existing functions and
+ * structures keep their meaning.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(_WIN32)
+#define BABY_API __declspec(dllexport)
+#else
+#define BABY_API __attribute__((visibility("default")))
+#endif
+
+#define BABY_API_VERSION 1
+
+enum {
+    BABY_OK = 0,
+    BABY_ERROR_ARGUMENT = -1,   /* A null pointer, or an address past the store */
+    BABY_ERROR_IMAGE = -2,      /* Machine code that isn't lines of 32 binary digits */
+    BABY_ERROR_ASSEMBLY = -3,   /* Source the assembler rejected; see the diagnostics */
+    BABY_ERROR_RUNTIME = -4,    /* The program failed while running, e.g. divided by zero or left the store */
+    BABY_ERROR_MEMORY = -5      /* Out of memory */
+};
+
+/* Registers for baby_get_register() and baby_set_register() */
+enum {
+    BABY_REG_ACCUMULATOR = 0,
+    BABY_REG_CI = 1,            /* Control instruction: address of the instruction last executed */
+    BABY_REG_PI = 2,            /* Present instruction, as a value */
+    BABY_REG_ROUND = 3,         /* Instructions executed since loading */
+    BABY_REG_HALTED = 4         /* 1 once the machine has stopped */
+};
+
+typedef struct baby_machine baby_machine;
+typedef struct baby_assembly baby_assembly;
+
+/* Version of the interface the library implements */
+BABY_API int baby_api_version(void);
+
+/* A machine with an empty 32-word store, or NULL if out of memory */
+BABY_API baby_machine *baby_create(void);
+
+BABY_API void baby_destroy(baby_machine *machine);
+
+/* Load machine code, one line of 32 binary digits per word (least significant bit first), from address 0. The store
+ * is cleared first and the registers are reset. */
+BABY_API int baby_load_image(baby_machine *machine, const char *image, size_t length);
+
+/* Load word values from address 0, as baby_load_image() */
+BABY_API int baby_load_words(baby_machine *machine, const int32_t *words, size_t count);
+
+/* Run up to steps instructions, stopping early if the machine halts. executed, if not NULL, receives the number run. */
+BABY_API int baby_run(baby_machine *machine, int64_t steps, int64_t *executed);
+
+/* Run until the machine halts. This never returns for a program that doesn't stop. */
+BABY_API int baby_run_to_halt(baby_machine *machine, int64_t *executed);
+
+/* Reset the registers and the clock; the store is kept */
+BABY_API void baby_reset(baby_machine *machine);
+
+/* Words in the store: at least 32, or more if the program was longer */
+BABY_API size_t baby_memory_size(const baby_machine *machine);
+
+BABY_API int baby_read_memory(const baby_machine *machine, size_t address, int32_t *value);
+
+BABY_API int baby_write_memory(baby_machine *machine, size_t address, int32_t value);
+
+BABY_API int baby_get_register(const baby_machine *machine, int reg, int64_t *value);
+
+BABY_API int baby_set_register(baby_machine *machine, int reg, int64_t value);
+
+/* Cycles of the original machine taken so far (see clock.h) */
+BABY_API uint64_t baby_cycles(const baby_machine *machine);
+
+/* Description of the last error on the machine, or "" */
+BABY_API const char *baby_last_error(const baby_machine *machine);
+
+/* Assemble source text. Returns BABY_OK or BABY_ERROR_ASSEMBLY; in both cases *result receives the assembly, with its
+ * diagnostics, and must be freed with baby_assembly_free(). *result is NULL only if out of memory. */
+BABY_API int baby_assemble(const char *source, size_t length, baby_assembly **result);
+
+/* Machine code, as baby_load_image() takes it, and its length; empty if assembly failed */
+BABY_API const char *baby_assembly_image(const baby_assembly *assembly, size_t *length);
+
+/* Word values of the machine code, and their count */
+BABY_API const int32_t *baby_assembly_words(const baby_assembly *assembly, size_t *count);
+
+/* The assembler's log, one message per line, including any error with its line number */
+BABY_API const char *baby_assembly_diagnostics(const baby_assembly *assembly);
+
+BABY_API void baby_assembly_free(baby_assembly *assembly);
+
+/* One image of a batch, and its outcome */
+typedef struct baby_job {
+    /* In */
+    const int32_t *words;       /* Word values loaded from address 0 */
+    size_t count;
+    int64_t steps;              /* Step budget */
+    int32_t *memory_out;        /* If not NULL, receives the first memory_out_count words of the final store */
+    size_t memory_out_count;
+    /* Out */
+    int status;                 /* BABY_OK or an error code */
+    int halted;
+    int64_t executed;
+    int32_t accumulator;
+    int32_t ci;
+    uint64_t cycles;
+} baby_job;
+
+/* Run every job, on up to threads threads (0 for one per processor), each reusing one machine for its share of the
+ * jobs. Returns BABY_OK once all have run; each job's own outcome is in its status. */
+BABY_API int baby_run_batch(baby_job *jobs, size_t count, int threads);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //BABYAPI_H
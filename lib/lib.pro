@@ -0,0 +1,43 @@
+# The simulator and the assembler as a shared library with a C interface (babyapi.h), without Qt:
+# qmake lib.pro && make builds libbaby.so
+
+TARGET = baby
+TEMPLATE = lib
+VERSION = 1.0.0
+CONFIG += shared c++17 release hide_symbols thread
+CONFIG -= qt
+
+INCLUDEPATH += ..
+
+SOURCES += \
+        babyapi.cpp \
+        ../baby.cpp \
+        ../shadow.cpp \
+        ../assembler.cpp \
+        ../loopaccel.cpp \
+        ../fusion.cpp \
+        ../analysis.cpp \
+        ../stepbound.cpp \
+        ../clock.cpp \
+        ../events.cpp \
+        ../devices.cpp \
+        ../peephole.cpp
+
+HEADERS += \
+        babyapi.h \
+        ../baby.h \
+        ../shadow.h \
+        ../assembler.h \
+        ../probes.h \
+        ../loopaccel.h \
+        ../fusion.h \
+        ../analysis.h \
+        ../stepbound.h \
+        ../clock.h \
+        ../events.h \
+        ../devices.h \
+        ../peephole.h \
+        ../isa.h \
+        ../memtrace.h \
+        ../word.h \
+        ../widebaby.h
@@ -0,0 +1,232 @@
+#include <cstdint>
+
+#include "baby.h"
+#include "loopaccel.h"
+
+namespace {
+
+// A value seen while analysing one iteration: coef * (value of cell at the start of the iteration) + constant.
+// coef is 0 for values that don't depend on the iteration. Arithmetic wraps like the 32-bit store.
+struct Affine {
+    int coef{0};
+    unsigned long cell{0};
+    uint32_t constant{0};
+};
+
+Affine constant(uint32_t value) {
+    return {0, 0, value};
+}
+
+Affine negate(const Affine &a) {
+    return {-a.coef, a.cell, (uint32_t) (0U - a.constant)};
+}
+
+// a + sign * b, failing if the result depends on two cells or on twice the same one
+bool combine(const Affine &a, const Affine &b, int sign, Affine &result) {
+    int coef = b.coef * sign;
+    if (a.coef != 0 && coef != 0) {
+        if (a.cell != b.cell || a.coef + coef != 0) {
+            return false;
+        }
+        result = constant(a.constant + (uint32_t) sign * b.constant);
+        return true;
+    }
+    result.coef = a.coef != 0 ? a.coef : coef;
+    result.cell = a.coef != 0 ? a.cell : b.cell;
+    result.constant = a.constant + (uint32_t) sign * b.constant;
+    return true;
+}
+
+// Value of a store word as the engine sees it
+uint32_t wordValue(const std::bitset<SIZE_32_BIT> &word) {
+    return (uint32_t) ManchesterBaby::convertInstruction(word);
+}
+
+// Store word holding a value
+std::bitset<SIZE_32_BIT> valueWord(uint32_t value) {
+    return {ManchesterBaby::convertInstruction(std::bitset<SIZE_32_BIT>(value))};
+}
+
+}
+
+// Try to fast-forward the loop whose head CI has just been reached by the backward JMP at address tail.
+// At most budget instructions may be skipped. Returns the number of instructions skipped (0 if none).
+int LoopAccelerator::fastForward(ManchesterBaby &baby, int tail, int budget) {
+    const int head = baby.ci;
+    const unsigned long storeSize = baby.memory.size();
+    if (head < 0 || head > tail || tail >= SIZE_32_BIT || isRejected(baby, head, tail)) {
+        return 0;
+    }
+
+    // First pass: the cells written by the body, and the body must be free of stores into itself
+    std::vector<bool> written(storeSize, false);
+    for (int pc = head; pc <= tail; ++pc) {
+        ManchesterBaby::Instruction ins = ManchesterBaby::decodeInstruction(baby.memory[pc]);
+        if (ins.opcode == STO) {
+            if (ins.operand >= storeSize || ((int) ins.operand >= head && (int) ins.operand <= tail)) {
+                reject(baby, head, tail);
+                return 0;
+            }
+            written[ins.operand] = true;
+        }
+    }
+
+    // Second pass: run one iteration symbolically, along the path that stays in the loop
+    std::vector<Affine> values(storeSize);      // Values of the written cells, once written in this iteration
+    std::vector<bool> assigned(storeSize, false);
+    std::vector<bool> readFirst(storeSize, false);
+    Affine acc;
+    Affine tested;                              // Accumulator seen by the CMP
+    bool haveCmp = false;
+    bool exitWhenNegative = false;              // Which sign of the tested value leaves the loop
+    int length = 0;                             // Instructions per iteration
+    uint64_t cycles = 0;                        // Virtual clock cycles per iteration
+    for (int pc = head; pc <= tail; ++pc, ++length) {
+        ManchesterBaby::Instruction ins = ManchesterBaby::decodeInstruction(baby.memory[pc]);
+        bool ok = true;
+        Affine operand;
+        cycles += baby.clock.table().cycles[ins.opcode & 31];
+        switch (ins.opcode) {
+            case LDN:
+            case LDP:
+            case ADD:
+            case SUB:
+                if (ins.immediate) {
+                    operand = constant((uint32_t) ins.operand);
+                } else if (ins.operand >= storeSize) {
+                    ok = false;
+                    break;
+                } else if (assigned[ins.operand]) {
+                    operand = values[ins.operand];
+                } else if (written[ins.operand]) {
+                    operand = {1, ins.operand, 0};
+                    readFirst[ins.operand] = true;
+                } else {
+                    operand = constant(wordValue(baby.memory[ins.operand]));
+                }
+                if (ins.opcode == LDN) {
+                    acc = negate(operand);
+                } else if (ins.opcode == LDP) {
+                    acc = operand;
+                } else {
+                    ok = combine(acc, operand, ins.opcode == ADD ? 1 : -1, acc);
+                }
+                break;
+            case STO:
+                values[ins.operand] = acc;
+                assigned[ins.operand] = true;
+                break;
+            case CMP:
+                ok = !haveCmp;
+                haveCmp = true;
+                tested = acc;
+                if (pc + 1 == tail) {
+                    // CMP; JMP back: a negative accumulator skips the JMP and leaves
+                    exitWhenNegative = true;
+                } else {
+                    // CMP; exit instruction: a negative accumulator skips the exit and stays
+                    exitWhenNegative = false;
+                    ++pc;
+                }
+                break;
+            case JMP:
+                // Only the back JMP, and it must not go through a cell the body changes
+                ok = pc == tail && (ins.immediate || (ins.operand < storeSize && !written[ins.operand]));
+                break;
+            default:
+                ok = false;
+                break;
+        }
+        if (!ok || (ins.opcode != JMP && pc >= tail)) {
+            reject(baby, head, tail);
+            return 0;
+        }
+    }
+    if (!haveCmp) {
+        reject(baby, head, tail);
+        return 0;
+    }
+
+    // Every cell read before being written must be an induction cell: cell = cell + delta
+    for (unsigned long cell = 0; cell < storeSize; ++cell) {
+        if (readFirst[cell] && (values[cell].coef != 1 || values[cell].cell != cell)) {
+            reject(baby, head, tail);
+            return 0;
+        }
+    }
+    if (tested.coef == 0) {
+        return 0;   // Either leaves now or never
+    }
+
+    // Iterations before the exit: the tested value moves by a constant step, which must reach the exit
+    // condition without wrapping around
+    int64_t start = (int32_t) ((uint32_t) tested.coef * wordValue(baby.memory[tested.cell]) + tested.constant);
+    int64_t step = (int32_t) ((uint32_t) tested.coef * values[tested.cell].constant);
+    int64_t iterations;
+    if (exitWhenNegative) {
+        if (start < 0 || step >= 0) {
+            return 0;
+        }
+        iterations = start / -step + 1;
+    } else {
+        if (start >= 0 || step <= 0) {
+            return 0;
+        }
+        iterations = (-start + step - 1) / step;
+    }
+    iterations = std::min<int64_t>(iterations, budget / length);
+    if (iterations <= 0) {
+        return 0;
+    }
+
+    // Apply the whole iterations: induction cells advance, other cells and the accumulator take the value
+    // computed in the last iteration, from the induction cells at its start
+    std::vector<uint32_t> entry(storeSize);
+    for (unsigned long cell = 0; cell < storeSize; ++cell) {
+        entry[cell] = wordValue(baby.memory[cell]);
+    }
+    auto lastValue = [&](const Affine &value) {
+        if (value.coef == 0) {
+            return value.constant;
+        }
+        uint32_t cellAtStart = entry[value.cell] + (uint32_t) (iterations - 1) * values[value.cell].constant;
+        return (uint32_t) value.coef * cellAtStart + value.constant;
+    };
+    for (unsigned long cell = 0; cell < storeSize; ++cell) {
+        if (!assigned[cell]) {
+            continue;
+        }
+        if (values[cell].coef == 1 && values[cell].cell == cell) {
+            baby.writeMemory(cell, valueWord(entry[cell] + (uint32_t) iterations * values[cell].constant));
+        } else {
+            baby.writeMemory(cell, valueWord(lastValue(values[cell])));
+        }
+    }
+    baby.accumulator = valueWord(lastValue(acc));
+
+    int skipped = (int) iterations * length;
+    baby.curRound += skipped;
+    baby.clock.advance((uint64_t) iterations * cycles);
+    loopsAccelerated++;
+    stepsSkipped += skipped;
+    return skipped;
+}
+
+bool LoopAccelerator::isRejected(const ManchesterBaby &baby, int head, int tail) const {
+    const Rejection &rejection = rejected[tail];
+    if (rejection.head != head) {
+        return false;
+    }
+    for (int pc = head; pc <= tail; ++pc) {
+        if (rejection.code[pc - head] != baby.memory[pc]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void LoopAccelerator::reject(const ManchesterBaby &baby, int head, int tail) {
+    Rejection &rejection = rejected[tail];
+    rejection.head = head;
+    rejection.code.assign(baby.memory.begin() + head, baby.memory.begin() + tail + 1);
+}
@@ -0,0 +1,44 @@
+#ifndef LOOPACCEL_H
+#define LOOPACCEL_H
+
+#include <array>
+#include <bitset>
+#include <vector>
+
+class ManchesterBaby;
+
+// Recognises simple counting loops at runtime and fast-forwards them in closed form.
+//
+// A loop qualifies when it is entered through a backward JMP and its body, read straight from the head to that JMP,
+// only uses LDN/LDP/ADD/SUB/STO, exactly one CMP, and the JMP itself. The CMP must either sit right before the
+// back JMP (loop while A >= 0) or guard an exit instruction that it skips (loop while A < 0). No STO may write into
+// the body or into the cell the back JMP goes through, so the code never changes while the loop runs.
+//
+// Every cell read before being written in the body must change by a constant on each iteration (an induction
+// cell). Other written cells and the accumulator are then a fixed function of one induction cell, and the value
+// tested by the CMP moves by a constant step. This is enough to compute how many whole iterations run before the
+// exit and the state after them. Those iterations are applied at once and the interpreter runs the final one,
+// so memory, accumulator, CI and curRound stay bit-identical to plain interpretation.
+class LoopAccelerator {
+public:
+    // Try to fast-forward the loop whose head CI has just been reached by the backward JMP at address tail.
+    // At most budget instructions may be skipped. Returns the number of instructions skipped (0 if none).
+    int fastForward(ManchesterBaby &baby, int tail, int budget);
+
+    long long loopsAccelerated{0};  // Number of times a loop was fast-forwarded
+    long long stepsSkipped{0};      // Instructions accounted for without being interpreted
+
+private:
+    // Loop bodies known not to qualify, by the address of their back JMP, to avoid analysing them again
+    struct Rejection {
+        int head{-1};
+        std::vector<std::bitset<32>> code;
+    };
+    std::array<Rejection, 32> rejected;
+
+    bool isRejected(const ManchesterBaby &baby, int head, int tail) const;
+
+    void reject(const ManchesterBaby &baby, int head, int tail);
+};
+
+#endif //LOOPACCEL_H
@@ -1,22 +1,108 @@
 #include <QApplication>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <thread>
 
 #include "baby.h"
 #include "widget.h"
+#include "dashboard.h"
 #include "assembler.h"
+#include "asmcache.h"
+#include "startup.h"
 
 /* main() function of the program */
-int main(int argc, char *argv[]) {   
-    // Assembler
-    Assembler assembler;
-    SymbolTable symbolTable;
-    Assembler::assemble(symbolTable);
+int main(int argc, char *argv[]) {
+    StartupProfile profile;
 
-    // MB Simulator
-    ManchesterBaby baby;    // Baby used
+    // Options: the peephole pass, a table of how long the start took, and the dashboard's lanes, with the word that
+    // holds each lane's number when they are a sweep
+    bool optimize = false;
+    bool profileStartup = false;
+    int dashboardLanes = 0;
+    int sweepAddress = -1;
+    for (int i = 1; i < argc; ++i) {
+        optimize = optimize || strcmp(argv[i], "--optimize") == 0;
+        profileStartup = profileStartup || strcmp(argv[i], "--startup-profile") == 0;
+        if (i + 1 < argc && strcmp(argv[i], "--dashboard") == 0) {
+            dashboardLanes = atoi(argv[++i]);
+        } else if (i + 1 < argc && strcmp(argv[i], "--sweep") == 0) {
+            sweepAddress = atoi(argv[++i]);
+        }
+    }
+    if (dashboardLanes < 0 || sweepAddress < -1 || sweepAddress >= SIZE_32_BIT) {
+        std::cerr << "Usage: ManchesterBaby [--optimize] [--startup-profile] [--dashboard LANES [--sweep ADDRESS]]"
+                  << std::endl;
+        return 1;
+    }
+
+    // Assembler: a source assembled before is restored from the cache, anything else is assembled in the background
+    // once the window is up
+    AssemblyCache cache;
+    std::string source;
+    const bool haveSource = readFile("assemble.txt", source);
+    const uint64_t key = AssemblyCache::key(source, optimize);
+    const bool cached = haveSource && cache.restore(key);
+    profile.mark("cache lookup", cached ? "hit" : "miss");
+
+    // MB Simulator, given its program once output.txt is ready
+    std::istringstream noProgram;
+    ManchesterBaby baby(noProgram);     // Baby used
+    TextEventSink console;  // Reports STOP! and unknown opcodes on the console
+    baby.setObserver(&console);
+    baby.devices.mapStandard();     // CHAROUT, CHARIN and CYCLES on the console
 
     // Call GUI
     QApplication a(argc, argv);
+    profile.mark("QApplication");
     Widget gui(&baby);
     gui.mainWindow.show();
-    return QApplication::exec();
+    profile.mark("window built");
+    QTimer::singleShot(0, &gui, [&profile]() { profile.mark("event loop"); });
+    QObject::connect(&gui, &Widget::programLoaded, &gui, [&profile, profileStartup]() {
+        profile.mark("program ready");
+        if (profileStartup) {
+            profile.report(std::cerr);
+        }
+    });
+
+    // Dashboard, once the program is loaded
+    std::unique_ptr<Dashboard> dashboard;
+    QObject::connect(&gui, &Widget::programLoaded, &gui, [&gui, &baby, &dashboard, dashboardLanes, sweepAddress]() {
+        if (dashboardLanes > 0 && !dashboard && gui.runButton->isEnabled()) {
+            dashboard = std::make_unique<Dashboard>(baby.memory, dashboardLanes, sweepAddress);
+            dashboard->show();
+        }
+    });
+
+    std::thread assembly;
+    if (cached) {
+        gui.programReady(true);
+    } else {
+        gui.setAssembling();
+        assembly = std::thread([&gui, &cache, &profile, key, optimize, haveSource]() {
+            bool assembled = false;
+            try {
+                SymbolTable symbolTable;
+                assembled = Assembler::assemble(symbolTable, optimize);
+                // Cache it only if the source didn't change while it was assembled
+                std::string source;
+                if (assembled && haveSource && readFile("assemble.txt", source) &&
+                    AssemblyCache::key(source, optimize) == key && !cache.save(key)) {
+                    std::cerr << "Could not write the assembly cache" << std::endl;
+                }
+            } catch (const std::runtime_error &e) {
+                std::cerr << "An error occurred: " << e.what() << std::endl;
+            }
+            profile.mark("assembled", assembled ? "" : "failed");
+            QMetaObject::invokeMethod(&gui, "programReady", Qt::QueuedConnection, Q_ARG(bool, assembled));
+        });
+    }
+
+    const int result = QApplication::exec();
+    if (assembly.joinable()) {
+        assembly.join();
+    }
+    return result;
 }
@@ -0,0 +1,250 @@
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+#include "memsys.h"
+
+namespace {
+
+const char *KIND_NAMES[] = {"fetch", "read", "write"};
+
+// "95.0%", or "-" with nothing to count
+std::string percent(long long part, long long whole) {
+    if (whole == 0) {
+        return "-";
+    }
+    std::ostringstream text;
+    text << std::fixed << std::setprecision(1) << 100.0 * (double) part / (double) whole << "%";
+    return text.str();
+}
+
+} // namespace
+
+// "sets=8,ways=2,line=4,write=back,latency=1"
+CacheConfig CacheConfig::parse(const std::string &text) {
+    CacheConfig config;
+    std::istringstream input(text);
+    std::string field;
+    while (getline(input, field, ',')) {
+        const size_t equals = field.find('=');
+        if (equals == std::string::npos) {
+            throw std::invalid_argument("Cache setting without a value: " + field);
+        }
+        const std::string key = field.substr(0, equals);
+        const std::string value = field.substr(equals + 1);
+        if (key == "write") {
+            if (value == "back") {
+                config.write = WritePolicy::WriteBack;
+            } else if (value == "through") {
+                config.write = WritePolicy::WriteThrough;
+            } else {
+                throw std::invalid_argument("Unknown write policy: " + value);
+            }
+            continue;
+        }
+        const int number = std::stoi(value);
+        if (key == "sets") {
+            config.sets = number;
+        } else if (key == "ways") {
+            config.ways = number;
+        } else if (key == "line") {
+            config.lineWords = number;
+        } else if (key == "latency") {
+            config.latency = number;
+        } else {
+            throw std::invalid_argument("Unknown cache setting: " + key);
+        }
+    }
+    if (config.sets < 1 || config.ways < 1 || config.lineWords < 1 || config.latency < 0) {
+        throw std::invalid_argument("A cache needs at least one set, way and word a line: " + text);
+    }
+    return config;
+}
+
+// "8 sets x 2 ways x 4 words, write-back, 1 cycle"
+std::string CacheConfig::describe() const {
+    return std::to_string(sets) + " sets x " + std::to_string(ways) + (ways == 1 ? " way" : " ways") + " x " +
+           std::to_string(lineWords) + (lineWords == 1 ? " word" : " words") + ", " +
+           (write == WritePolicy::WriteBack ? "write-back" : "write-through") + ", " + std::to_string(latency) +
+           (latency == 1 ? " cycle" : " cycles");
+}
+
+MemorySystem::MemorySystem(MemorySystemConfig config) : settings(std::move(config)) {
+    for (const CacheConfig &cache: settings.levels) {
+        if (cache.sets < 1 || cache.ways < 1 || cache.lineWords < 1 || cache.latency < 0) {
+            throw std::invalid_argument("A cache needs at least one set, way and word a line");
+        }
+        Level level;
+        level.config = cache;
+        level.lines.resize((size_t) cache.sets * cache.ways);
+        levels.push_back(level);
+    }
+    if (settings.readLatency < 0 || settings.writeLatency < 0) {
+        throw std::invalid_argument("The store can't take less than no time");
+    }
+}
+
+// A batch of accesses from the engine
+void MemorySystem::onAccesses(const MemoryAccess *accesses, size_t count) {
+    for (size_t index = 0; index < count; ++index) {
+        const MemoryAccess &access = accesses[index];
+        const auto kind = (size_t) access.kind;
+        made[kind]++;
+        latency[kind] += access.kind == Kind::Write ? write(0, access.address) : read(0, access.address, access.kind);
+    }
+}
+
+// Cycles to read a word from a level down
+long long MemorySystem::read(size_t level, uint32_t address, Kind kind) {
+    if (level == levels.size()) {
+        reads++;
+        return settings.readLatency;
+    }
+    Level &cache = levels[level];
+    cache.stats.accesses[(size_t) kind]++;
+    Line *line = find(cache, address);
+    if (line != nullptr) {
+        cache.stats.hits[(size_t) kind]++;
+        line->used = ++now;
+        return cache.config.latency;
+    }
+    const long long below = read(level + 1, address, kind);
+    allocate(level, address);
+    return cache.config.latency + below;
+}
+
+// Cycles to write a word from a level down
+long long MemorySystem::write(size_t level, uint32_t address) {
+    if (level == levels.size()) {
+        writes++;
+        return settings.writeLatency;
+    }
+    Level &cache = levels[level];
+    cache.stats.accesses[(size_t) Kind::Write]++;
+    Line *line = find(cache, address);
+    if (line != nullptr) {
+        cache.stats.hits[(size_t) Kind::Write]++;
+        line->used = ++now;
+    }
+    if (cache.config.write == CacheConfig::WritePolicy::WriteThrough) {
+        return cache.config.latency + write(level + 1, address);
+    }
+    // Write-back: a miss brings the line in first
+    long long below = 0;
+    if (line == nullptr) {
+        below = read(level + 1, address, Kind::Read);
+        line = &allocate(level, address);
+    }
+    line->dirty = true;
+    return cache.config.latency + below;
+}
+
+// The line of a level holding an address, or nullptr
+MemorySystem::Line *MemorySystem::find(Level &level, uint32_t address) {
+    const uint32_t lineAddress = address / (uint32_t) level.config.lineWords;
+    const uint32_t set = lineAddress % (uint32_t) level.config.sets;
+    const uint32_t tag = lineAddress / (uint32_t) level.config.sets;
+    Line *ways = &level.lines[(size_t) set * level.config.ways];
+    for (int way = 0; way < level.config.ways; ++way) {
+        if (ways[way].valid && ways[way].tag == tag) {
+            return &ways[way];
+        }
+    }
+    return nullptr;
+}
+
+// Make room for an address in its set: an empty way, or the least recently used, written back if dirty
+MemorySystem::Line &MemorySystem::allocate(size_t level, uint32_t address) {
+    Level &cache = levels[level];
+    const auto lineWords = (uint32_t) cache.config.lineWords;
+    const auto sets = (uint32_t) cache.config.sets;
+    const uint32_t lineAddress = address / lineWords;
+    const uint32_t set = lineAddress % sets;
+    Line *ways = &cache.lines[(size_t) set * cache.config.ways];
+    Line *victim = &ways[0];
+    for (int way = 0; way < cache.config.ways; ++way) {
+        if (!ways[way].valid) {
+            victim = &ways[way];
+            break;
+        }
+        if (ways[way].used < victim->used) {
+            victim = &ways[way];
+        }
+    }
+    if (victim->valid && victim->dirty) {
+        cache.stats.writeBacks++;
+        write(level + 1, (victim->tag * sets + set) * lineWords);
+    }
+    *victim = {lineAddress / sets, true, false, ++now};
+    return *victim;
+}
+
+const MemorySystemConfig &MemorySystem::config() const {
+    return settings;
+}
+
+long long MemorySystem::accesses(Kind kind) const {
+    return made[(size_t) kind];
+}
+
+long long MemorySystem::accesses() const {
+    return made[0] + made[1] + made[2];
+}
+
+long long MemorySystem::cycles() const {
+    return latency[0] + latency[1] + latency[2];
+}
+
+// Average cycles per access of one kind
+double MemorySystem::averageAccessTime(Kind kind) const {
+    const long long count = made[(size_t) kind];
+    return count == 0 ? 0 : (double) latency[(size_t) kind] / (double) count;
+}
+
+double MemorySystem::averageAccessTime() const {
+    return accesses() == 0 ? 0 : (double) cycles() / (double) accesses();
+}
+
+const MemorySystem::LevelStats &MemorySystem::levelStats(size_t level) const {
+    return levels.at(level).stats;
+}
+
+long long MemorySystem::storeReads() const {
+    return reads;
+}
+
+long long MemorySystem::storeWrites() const {
+    return writes;
+}
+
+// Human-readable summary: the levels, their hit rates and the effective access time
+std::vector<std::string> MemorySystem::report() const {
+    std::vector<std::string> lines;
+    for (size_t level = 0; level < levels.size(); ++level) {
+        const LevelStats &stats = levels[level].stats;
+        const long long all = stats.accesses[0] + stats.accesses[1] + stats.accesses[2];
+        std::string line = "L" + std::to_string(level + 1) + " (" + levels[level].config.describe() + "): " +
+                           std::to_string(all) + " accesses, " +
+                           percent(stats.hits[0] + stats.hits[1] + stats.hits[2], all) + " hits (";
+        for (size_t kind = 0; kind < 3; ++kind) {
+            line += std::string(kind == 0 ? "" : ", ") + KIND_NAMES[kind] + " " +
+                    percent(stats.hits[kind], stats.accesses[kind]);
+        }
+        line += "), " + std::to_string(stats.writeBacks) + " write-backs";
+        lines.push_back(line);
+    }
+    lines.push_back("Store (" + std::to_string(settings.readLatency) + " cycles to read, " +
+                    std::to_string(settings.writeLatency) + " to write): " + std::to_string(reads) + " reads, " +
+                    std::to_string(writes) + " writes");
+
+    std::ostringstream line;
+    line << std::fixed << std::setprecision(2) << "Effective access time: " << averageAccessTime() << " cycles over "
+         << accesses() << " accesses (";
+    for (size_t kind = 0; kind < 3; ++kind) {
+        line << (kind == 0 ? "" : ", ") << KIND_NAMES[kind] << " " << averageAccessTime((Kind) kind);
+    }
+    line << ")";
+    lines.push_back(line.str());
+    return lines;
+}
@@ -0,0 +1,120 @@
+#ifndef MEMSYS_H
+#define MEMSYS_H
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "memtrace.h"
+
+// Geometry, write policy and hit latency of one cache level
+struct CacheConfig {
+    enum class WritePolicy {
+        WriteBack,      // Writes stay in the cache, dirty lines go down when evicted; misses allocate
+        WriteThrough    // Writes go down at once; write misses don't allocate
+    };
+
+    int sets{8};
+    int ways{1};                // 1 is direct-mapped
+    int lineWords{4};
+    WritePolicy write{WritePolicy::WriteBack};
+    int latency{1};             // Cycles of a hit
+
+    // "sets=8,ways=2,line=4,write=back,latency=1", in any order, anything left out keeping its default.
+    // Throws std::invalid_argument on anything else.
+    static CacheConfig parse(const std::string &text);
+
+    // "8 sets x 2 ways x 4 words, write-back, 1 cycle"
+    [[nodiscard]] std::string describe() const;
+};
+
+// Caches in front of a slow store
+struct MemorySystemConfig {
+    std::vector<CacheConfig> levels;    // Nearest the machine first; none for the store alone
+    int readLatency{20};                // Cycles of the store
+    int writeLatency{20};
+};
+
+// Model of the memory system a run goes through, fed with its store accesses (see memtrace.h): each level of
+// cache is set-associative with least-recently-used replacement, and each access costs the latency of the levels it
+// reaches. A miss costs the level's latency plus that of the level below; a write-through write costs its level's
+// latency plus the write below. Write-backs of dirty lines are counted, but as a write buffer would, they cost the
+// access that evicts them nothing.
+//
+// Fetches, reads and writes share the levels, as they share the Baby's one store.
+class MemorySystem : public AccessSink {
+public:
+    using Kind = MemoryAccess::Kind;
+
+    // Counts of one level, by kind of access
+    struct LevelStats {
+        std::array<long long, 3> accesses{};
+        std::array<long long, 3> hits{};
+        long long writeBacks{0};
+    };
+
+    explicit MemorySystem(MemorySystemConfig config);
+
+    void onAccesses(const MemoryAccess *accesses, size_t count) override;
+
+    [[nodiscard]] const MemorySystemConfig &config() const;
+
+    // Accesses made by the machine, of one kind or all
+    [[nodiscard]] long long accesses(Kind kind) const;
+
+    [[nodiscard]] long long accesses() const;
+
+    // Cycles the accesses took, in all
+    [[nodiscard]] long long cycles() const;
+
+    // Effective access time: average cycles per access, of one kind or all
+    [[nodiscard]] double averageAccessTime(Kind kind) const;
+
+    [[nodiscard]] double averageAccessTime() const;
+
+    [[nodiscard]] const LevelStats &levelStats(size_t level) const;
+
+    // Accesses that reached the store
+    [[nodiscard]] long long storeReads() const;
+
+    [[nodiscard]] long long storeWrites() const;
+
+    // Human-readable summary: the levels, their hit rates and the effective access time
+    [[nodiscard]] std::vector<std::string> report() const;
+
+private:
+    struct Line {
+        uint32_t tag{0};
+        bool valid{false};
+        bool dirty{false};
+        uint64_t used{0};       // When it was last used, for LRU
+    };
+
+    struct Level {
+        CacheConfig config;
+        std::vector<Line> lines;    // sets x ways, a set's ways together
+        LevelStats stats;
+    };
+
+    MemorySystemConfig settings;
+    std::vector<Level> levels;
+    uint64_t now{0};
+    std::array<long long, 3> made{};
+    std::array<long long, 3> latency{};
+    long long reads{0};
+    long long writes{0};
+
+    // Cycles to read or write a word from a level down, the store being the level past the caches
+    long long read(size_t level, uint32_t address, Kind kind);
+
+    long long write(size_t level, uint32_t address);
+
+    // The line of a level holding an address, or nullptr
+    Line *find(Level &level, uint32_t address);
+
+    // Make room for an address in its set, writing back the line evicted if it is dirty
+    Line &allocate(size_t level, uint32_t address);
+};
+
+#endif //MEMSYS_H
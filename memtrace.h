@@ -0,0 +1,67 @@
+#ifndef MEMTRACE_H
+#define MEMTRACE_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// The store accesses of a run, for memory-system models (see memsys.h).
+//
+// With an AccessTrace installed (ManchesterBaby::setAccessTrace), the engine records every access to the store:
+//     fetch  - the instruction word at CI
+//     read   - the store word an instruction works on, JMP and JRP targets included
+//     write  - the word STO writes; XCH and XAD read their word, then write it
+// Immediate operands and device ports aren't store accesses. The accesses are handed to the sink in batches, when the
+// batch is full and at the end of each ManchesterBaby::run(), so the sink is called once per thousands of accesses.
+// Like checked mode, a traced run() runs one instruction at a time without fusion or loop acceleration, in a loop of
+// its own, so untraced runs pay nothing for it.
+
+// One access to the store
+struct MemoryAccess {
+    enum class Kind : uint8_t {
+        Fetch,
+        Read,
+        Write
+    };
+
+    Kind kind;
+    uint32_t address;
+};
+
+// Receives the accesses, a batch at a time, in the order they happened
+class AccessSink {
+public:
+    virtual ~AccessSink() = default;
+
+    virtual void onAccesses(const MemoryAccess *accesses, size_t count) = 0;
+};
+
+// A batch of accesses on its way to a sink
+class AccessTrace {
+public:
+    static constexpr size_t BATCH = 4096;
+
+    explicit AccessTrace(AccessSink &sink) : sink(sink) {}
+
+    void record(MemoryAccess::Kind kind, unsigned long address) {
+        batch[count++] = {kind, (uint32_t) address};
+        if (count == BATCH) {
+            flush();
+        }
+    }
+
+    // Hand what has been recorded to the sink
+    void flush() {
+        if (count > 0) {
+            sink.onAccesses(batch.data(), count);
+            count = 0;
+        }
+    }
+
+private:
+    AccessSink &sink;
+    std::array<MemoryAccess, BATCH> batch{};
+    size_t count{0};
+};
+
+#endif //MEMTRACE_H
@@ -0,0 +1,469 @@
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+#include "peephole.h"
+#include "analysis.h"
+#include "isa.h"
+
+// Step budget for measuring the steps saved
+static const int MEASURE_STEPS = 1000000;
+
+// Runs the patterns of peephole.h over one image
+class PeepholePass {
+public:
+    PeepholePass(const std::vector<std::bitset<SIZE_32_BIT>> &image, const std::vector<int> &labels, bool extended);
+
+    // Find the changes. Returns false, with a note, if the image must be left alone.
+    bool findChanges();
+
+    // The optimised image, or false with a note if an address can't be relocated
+    bool relocate(std::vector<std::bitset<SIZE_32_BIT>> &result);
+
+    // Whether a cell keeps its value when moved: neither code nor a jump cell
+    [[nodiscard]] bool isData(unsigned long address) const;
+
+    // Where an address of the original image ends up
+    [[nodiscard]] int newAddress(unsigned long address) const;
+
+    PeepholeReport report;
+    bool devices{false};                // Whether the code reads or writes device ports
+
+private:
+    std::vector<std::bitset<SIZE_32_BIT>> image;
+    ImageAnalysis analysis;
+    bool extended;
+    int codeEnd;                        // Instructions can only be at addresses below this
+    unsigned long storeSize;            // Operands at or past this are device ports
+    std::vector<uint32_t> values;       // Word values, as changed so far
+    std::vector<bool> removed;
+    std::vector<bool> target;           // Can be jumped to, is labelled or follows a CMP
+    std::vector<bool> skipped;          // Can be skipped by a CMP, so must stay where it is
+    std::vector<bool> jumpCells;
+    std::vector<int> shift;             // Instructions removed before each address
+
+    [[nodiscard]] bool isCode(int address) const;
+
+    [[nodiscard]] ManchesterBaby::Instruction decode(int address) const;
+
+    // Whether the instruction's operand is a store address rather than a number
+    [[nodiscard]] static bool isDirect(const ManchesterBaby::Instruction &ins);
+
+    // Whether the instruction reads or writes a device port
+    [[nodiscard]] bool usesDevice(const ManchesterBaby::Instruction &ins) const;
+
+    // Where a JMP or JRP at address goes, or -1
+    [[nodiscard]] int jumpTarget(int address) const;
+
+    // The next instruction run after the one at address, skipping removed ones, or -1 if there is none in line
+    [[nodiscard]] int next(int address) const;
+
+    [[nodiscard]] bool canRemove(int address) const;
+
+    void remove(int address, const std::string &note);
+
+    void setInstruction(int address, int opcode, bool immediate, unsigned long operand);
+
+    // Try each pattern at address. Returns whether anything changed.
+    bool match(int address);
+
+    // Cells the changed code jumps through
+    void findJumpCells();
+};
+
+PeepholePass::PeepholePass(const std::vector<std::bitset<SIZE_32_BIT>> &image, const std::vector<int> &labels,
+                           bool extended)
+        : image(image), analysis(image), extended(extended) {
+    codeEnd = (int) std::min<size_t>(image.size(), SIZE_32_BIT);
+    storeSize = std::max<size_t>(image.size(), SIZE_32_BIT);
+    for (const auto &word: image) {
+        values.push_back(reverseWord((uint32_t) word.to_ulong()));
+    }
+    removed.assign(image.size(), false);
+    target.assign(storeSize + 2, false);
+    skipped.assign(storeSize + 2, false);
+    for (int address: labels) {
+        if (address >= 0 && address < (int) image.size()) {
+            target[address] = true;
+        }
+    }
+}
+
+bool PeepholePass::isCode(int address) const {
+    return address >= 0 && address < codeEnd && analysis.isCode(address);
+}
+
+ManchesterBaby::Instruction PeepholePass::decode(int address) const {
+    return ManchesterBaby::decodeInstruction(std::bitset<SIZE_32_BIT>(reverseWord(values[address])));
+}
+
+bool PeepholePass::isDirect(const ManchesterBaby::Instruction &ins) {
+    switch (ins.opcode) {
+        case CMP:
+        case STP:
+        case LNT:
+        case SHL:
+        case SHR:
+            return false;
+        default:
+            return ins.opcode <= XAD && !(ins.immediate && takesImmediate(ins.opcode));
+    }
+}
+
+bool PeepholePass::usesDevice(const ManchesterBaby::Instruction &ins) const {
+    return isDirect(ins) && ins.operand >= storeSize;
+}
+
+int PeepholePass::jumpTarget(int address) const {
+    ManchesterBaby::Instruction ins = decode(address);
+    if (ins.opcode != JMP && ins.opcode != JRP) {
+        return -1;
+    }
+    long offset = (long) ins.operand;
+    if (isDirect(ins)) {
+        if (ins.operand >= image.size()) {
+            return -1;
+        }
+        offset = (int32_t) values[ins.operand];
+    }
+    // Same arithmetic as ImageAnalysis::successors()
+    long destination = ((ins.opcode == JRP ? address : 0) + offset + 1) % SIZE_32_BIT;
+    return destination < 0 ? -1 : (int) destination;
+}
+
+int PeepholePass::next(int address) const {
+    for (int following = address + 1; following < codeEnd && isCode(following); ++following) {
+        if (!removed[following]) {
+            return following;
+        }
+    }
+    return -1;
+}
+
+bool PeepholePass::canRemove(int address) const {
+    return address > 0 && isCode(address) && !removed[address] && !skipped[address];
+}
+
+void PeepholePass::remove(int address, const std::string &note) {
+    removed[address] = true;
+    report.removed++;
+    report.stepsSaved++;
+    report.notes.push_back("Removed " + note + " at address " + std::to_string(address));
+}
+
+void PeepholePass::setInstruction(int address, int opcode, bool immediate, unsigned long operand) {
+    uint32_t value = values[address] & ~(Layout32::opcodeMask | Layout32::immediateMask | Layout32::operandMask);
+    values[address] = value | ((uint32_t) opcode << Layout32::opcodeShift) |
+                      ((uint32_t) immediate << Layout32::immediateBit) | (uint32_t) operand;
+}
+
+bool PeepholePass::findChanges() {
+    if (analysis.isSelfModifying() || analysis.isImprecise()) {
+        report.notes.push_back("Left alone: the program can modify its own code or jump anywhere");
+        return false;
+    }
+    if (isCode(SIZE_32_BIT - 1)) {
+        report.notes.push_back("Left alone: the program runs into the end of the store");
+        return false;
+    }
+    std::vector<int> dataUses(storeSize, 0);
+    std::vector<bool> jumps(storeSize, false);
+    for (int address = 0; address < codeEnd; ++address) {
+        if (!isCode(address)) {
+            continue;
+        }
+        ManchesterBaby::Instruction ins = decode(address);
+        if (ins.opcode == CMP) {
+            skipped[address + 1] = true;
+            target[address + 1] = true;
+            target[address + 2] = true;
+        } else if ((ins.opcode == JMP || ins.opcode == JRP) && jumpTarget(address) >= 0) {
+            target[jumpTarget(address)] = true;
+        }
+        devices = devices || usesDevice(ins);
+        if (!isDirect(ins) || ins.operand >= storeSize) {
+            continue;
+        }
+        if (ins.opcode == JMP || ins.opcode == JRP) {
+            jumps[ins.operand] = true;
+        } else if (isCode((int) ins.operand)) {
+            report.notes.push_back("Left alone: the instruction at address " + std::to_string(address) +
+                                   " uses the code at address " + std::to_string(ins.operand) + " as data");
+            return false;
+        } else {
+            dataUses[ins.operand]++;
+        }
+    }
+    for (unsigned long address = 0; address < storeSize; ++address) {
+        if (jumps[address] && dataUses[address] > 0) {
+            report.notes.push_back("Left alone: cell " + std::to_string(address) +
+                                   " is used both as a jump target and as data");
+            return false;
+        }
+    }
+
+    // Changes can make more patterns appear, e.g. a load dropped between two stores
+    bool changed = true;
+    for (int round = 0; changed && round < SIZE_32_BIT; ++round) {
+        changed = false;
+        for (int address = 1; address < codeEnd; ++address) {
+            if (isCode(address) && !removed[address]) {
+                changed = match(address) || changed;
+            }
+        }
+    }
+    return report.removed > 0 || report.rewritten > 0;
+}
+
+bool PeepholePass::match(int address) {
+    const ManchesterBaby::Instruction a = decode(address);
+    const int second = next(address);
+    const ManchesterBaby::Instruction b = second >= 0 ? decode(second) : ManchesterBaby::Instruction{STP, 0, false};
+    const bool secondInLine = second >= 0 && !target[second];
+    const std::string at = std::to_string(address);
+
+    // ADD #0, SUB #0, JRP #0 and jumps to the next instruction do nothing
+    if ((a.opcode == ADD || a.opcode == SUB || a.opcode == JRP) && !isDirect(a) && a.operand == 0 &&
+        canRemove(address)) {
+        remove(address, "no-op");
+        return true;
+    }
+    if ((a.opcode == JMP || a.opcode == JRP) && canRemove(address)) {
+        int destination = jumpTarget(address);
+        bool toNext = destination > address;
+        for (int between = address + 1; toNext && between < destination; ++between) {
+            toNext = removed[between];
+        }
+        if (toNext && isCode(destination)) {
+            remove(address, "jump to the next instruction");
+            return true;
+        }
+    }
+    if (usesDevice(a) || usesDevice(b)) {
+        return false;
+    }
+    if (a.opcode == LNT && b.opcode == LNT && secondInLine && canRemove(address) && canRemove(second)) {
+        remove(address, "LNT");
+        remove(second, "LNT");
+        return true;
+    }
+    if (a.opcode == STO && (b.opcode == STO || (b.opcode == LDP && isDirect(b))) && b.operand == a.operand &&
+        secondInLine && canRemove(second)) {
+        remove(second, b.opcode == STO ? "repeated STO" : "LDP of the value just stored by " + at);
+        return true;
+    }
+    // A load whose value is replaced straight away. The first load need not be in line: entering at it or at
+    // the second load comes to the same.
+    if ((a.opcode == LDN || a.opcode == LDP) && (b.opcode == LDN || b.opcode == LDP) && second >= 0 &&
+        canRemove(address)) {
+        remove(address, "load overwritten by the next one");
+        return true;
+    }
+    // LDN a; SUB b...; STO t; LDN t; STO t computes a + b... the long way round
+    if (extended && a.opcode == LDN && second >= 0) {
+        std::vector<int> subtractions;
+        int position = second;
+        while (position >= 0 && !target[position] && decode(position).opcode == SUB &&
+               !usesDevice(decode(position))) {
+            subtractions.push_back(position);
+            position = next(position);
+        }
+        const int store = position;
+        const int reload = store >= 0 ? next(store) : -1;
+        const int overwrite = reload >= 0 ? next(reload) : -1;
+        if (overwrite >= 0 && !target[store] && !target[reload] && canRemove(store) && canRemove(reload)) {
+            ManchesterBaby::Instruction sto = decode(store);
+            ManchesterBaby::Instruction ldn = decode(reload);
+            ManchesterBaby::Instruction last = decode(overwrite);
+            if (sto.opcode == STO && ldn.opcode == LDN && last.opcode == STO && isDirect(ldn) &&
+                ldn.operand == sto.operand && last.operand == sto.operand && !usesDevice(sto)) {
+                setInstruction(address, LDP, !isDirect(a), a.operand);
+                for (int subtraction: subtractions) {
+                    ManchesterBaby::Instruction sub = decode(subtraction);
+                    setInstruction(subtraction, ADD, !isDirect(sub), sub.operand);
+                }
+                report.rewritten += 1 + (int) subtractions.size();
+                report.notes.push_back("Rewrote the negated sum at address " + at + " with LDP and ADD");
+                remove(store, "STO of a negated value");
+                remove(reload, "LDN of a negated value");
+                return true;
+            }
+        }
+    }
+    // Jumps to jumps go straight to the end of the chain, and jumps to STP stop where they are
+    if (a.opcode == JMP) {
+        const int destination = jumpTarget(address);
+        if (destination <= 0 || destination == address || !isCode(destination) || removed[destination]) {
+            return false;
+        }
+        const ManchesterBaby::Instruction there = decode(destination);
+        if (there.opcode == STP) {
+            setInstruction(address, STP, false, 0);
+            report.rewritten++;
+            report.stepsSaved++;
+            report.notes.push_back("Replaced the jump to STP at address " + at + " with STP");
+            return true;
+        }
+        const int final = jumpTarget(destination);
+        if (there.opcode != JMP || final <= 0 || final == destination || final == jumpTarget(address)) {
+            return false;
+        }
+        if (!isDirect(a)) {
+            setInstruction(address, JMP, true, (unsigned long) final - 1);
+        } else if (isDirect(there)) {
+            setInstruction(address, JMP, false, there.operand);
+        } else if (extended) {
+            setInstruction(address, JMP, true, there.operand);
+        } else {
+            return false;
+        }
+        report.rewritten++;
+        report.stepsSaved++;
+        report.notes.push_back("Sent the jump at address " + at + " straight to address " + std::to_string(final));
+        return true;
+    }
+    return false;
+}
+
+void PeepholePass::findJumpCells() {
+    jumpCells.assign(storeSize, false);
+    for (int address = 0; address < codeEnd; ++address) {
+        if (!isCode(address) || removed[address]) {
+            continue;
+        }
+        ManchesterBaby::Instruction ins = decode(address);
+        if ((ins.opcode == JMP || ins.opcode == JRP) && isDirect(ins) && ins.operand < storeSize) {
+            jumpCells[ins.operand] = true;
+        }
+    }
+}
+
+bool PeepholePass::isData(unsigned long address) const {
+    return !isCode((int) address) && !(address < jumpCells.size() && jumpCells[address]);
+}
+
+int PeepholePass::newAddress(unsigned long address) const {
+    return (int) address - shift[std::min<size_t>(address, shift.size() - 1)];
+}
+
+bool PeepholePass::relocate(std::vector<std::bitset<SIZE_32_BIT>> &result) {
+    shift.assign(storeSize + 1, 0);
+    for (unsigned long address = 1; address <= storeSize; ++address) {
+        shift[address] = shift[address - 1] + (address - 1 < removed.size() && removed[address - 1] ? 1 : 0);
+    }
+    findJumpCells();
+    std::vector<uint32_t> relocated = values;
+    // Required value of each jump cell, to check that every jump through it agrees
+    std::vector<long> cellValues(storeSize, 0);
+    std::vector<bool> cellKnown(storeSize, false);
+    auto fail = [this](int address) {
+        report.notes.push_back("Left alone: the jump at address " + std::to_string(address) + " can't be relocated");
+        return false;
+    };
+    for (int address = 0; address < codeEnd; ++address) {
+        if (!isCode(address) || removed[address]) {
+            continue;
+        }
+        ManchesterBaby::Instruction ins = decode(address);
+        const int destination = jumpTarget(address);
+        if (ins.opcode == JMP || ins.opcode == JRP) {
+            if (destination < 0) {
+                return fail(address);
+            }
+            const long offset = newAddress(destination) - 1 - (ins.opcode == JRP ? newAddress(address) : 0);
+            if (offset < 0 && !isDirect(ins)) {
+                return fail(address);
+            }
+            if (!isDirect(ins)) {
+                relocated[address] = (values[address] & ~Layout32::operandMask) | (uint32_t) offset;
+                continue;
+            }
+            if (ins.operand < storeSize) {
+                if (cellKnown[ins.operand] && cellValues[ins.operand] != offset) {
+                    return fail(address);
+                }
+                cellValues[ins.operand] = offset;
+                cellKnown[ins.operand] = true;
+            }
+        }
+        if (isDirect(ins) && ins.operand < storeSize) {
+            relocated[address] = (values[address] & ~Layout32::operandMask) | (uint32_t) newAddress(ins.operand);
+        }
+    }
+    for (unsigned long cell = 0; cell < storeSize; ++cell) {
+        if (!cellKnown[cell]) {
+            continue;
+        }
+        // Address 0 is both a jump cell and the first instruction: it must keep its value
+        const uint32_t value = (uint32_t) (int32_t) cellValues[cell];
+        if (cell >= image.size() ? value != 0 : isCode((int) cell) && value != relocated[cell]) {
+            report.notes.push_back("Left alone: jump cell " + std::to_string(cell) + " can't be relocated");
+            return false;
+        }
+        if (cell < image.size()) {
+            relocated[cell] = value;
+        }
+    }
+    result.clear();
+    for (size_t address = 0; address < image.size(); ++address) {
+        if (!removed[address]) {
+            result.emplace_back(reverseWord(relocated[address]));
+        }
+    }
+    return true;
+}
+
+// Run an image to the halt on a plain engine. Returns false if it doesn't halt in time or fails.
+static bool runToHalt(const std::vector<std::bitset<SIZE_32_BIT>> &image, ManchesterBaby &baby, int &steps) {
+    baby.memory.assign(SIZE_32_BIT, std::bitset<SIZE_32_BIT>());
+    baby.loadProgram(image);
+    baby.reset();
+    baby.setHalt(false);
+    try {
+        steps = baby.run(MEASURE_STEPS);
+    } catch (const std::runtime_error &) {
+        return false;
+    }
+    return baby.isHalted() && baby.curOpCode == STP;
+}
+
+// Optimise image in place
+PeepholeReport optimizeImage(std::vector<std::bitset<SIZE_32_BIT>> &image, const std::vector<int> &labels,
+                             bool extended) {
+    PeepholePass pass(image, labels, extended);
+    std::vector<std::bitset<SIZE_32_BIT>> optimized;
+    if (!pass.findChanges()) {
+        return pass.report;
+    }
+    if (!pass.relocate(optimized)) {
+        // Only the reason is kept: none of the changes were made
+        PeepholeReport unchanged;
+        unchanged.notes.push_back(pass.report.notes.back());
+        return unchanged;
+    }
+
+    // Programs without devices halt the same way every time, so running both gives the exact saving. The results
+    // must match too, cell by cell once relocated.
+    PeepholeReport report = pass.report;
+    std::istringstream noProgram;
+    ManchesterBaby before(noProgram);
+    ManchesterBaby after(noProgram);
+    int stepsBefore = 0;
+    int stepsAfter = 0;
+    if (!pass.devices && runToHalt(image, before, stepsBefore)) {
+        bool same = runToHalt(optimized, after, stepsAfter) && before.accumulator == after.accumulator;
+        for (size_t cell = 0; same && cell < before.memory.size(); ++cell) {
+            const size_t moved = pass.newAddress(cell);
+            same = !pass.isData(cell) || (moved < after.memory.size() && before.memory[cell] == after.memory[moved]);
+        }
+        if (!same) {
+            PeepholeReport unchanged;
+            unchanged.notes.emplace_back("Left alone: the optimised program gave a different result");
+            return unchanged;
+        }
+        report.stepsSaved = stepsBefore - stepsAfter;
+        report.measured = true;
+    }
+    image = optimized;
+    return report;
+}
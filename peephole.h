@@ -0,0 +1,38 @@
+#ifndef PEEPHOLE_H
+#define PEEPHOLE_H
+
+#include <bitset>
+#include <string>
+#include <vector>
+
+#include "baby.h"
+
+// Peephole optimisation of an assembled image, run by the assembler when asked to (Assembler::assemble).
+//
+// Patterns are looked for in straight-line code, never across an instruction that can be jumped to, that a label
+// names or that a CMP can skip or skip to:
+//     LDN a; SUB b...; STO t; LDN t     - when t is overwritten next: LDP a; ADD b... (extended instructions only)
+//     STO x; LDP x                     - the load is dropped: the accumulator already holds x
+//     STO x; STO x                     - the second store is dropped
+//     LDN/LDP x; LDN/LDP y             - the first load is dropped
+//     LNT; LNT                         - both are dropped
+//     ADD #0, SUB #0, JRP #0           - dropped
+//     JMP to the next instruction      - dropped
+//     JMP to a JMP or an STP           - goes to the final target, or becomes STP
+// Removing instructions moves everything after them, so every operand, jump cell and immediate jump target is
+// relocated. Programs that modify their own code, read their code as data, or use a jump cell as data too are left
+// alone, as are accesses to device ports.
+struct PeepholeReport {
+    int removed{0};                     // Instructions removed
+    int rewritten{0};                   // Instructions changed in place
+    long long stepsSaved{0};            // Steps saved by a run to the halt, or per pass through every change
+    bool measured{false};               // Whether stepsSaved comes from running both images to the halt
+    std::vector<std::string> notes;     // One line per change, or why the image was left alone
+};
+
+// Optimise image in place. labels are the addresses the source labels; extended allows rewriting classic
+// instructions into extended ones.
+PeepholeReport optimizeImage(std::vector<std::bitset<SIZE_32_BIT>> &image, const std::vector<int> &labels,
+                             bool extended);
+
+#endif //PEEPHOLE_H
@@ -0,0 +1,254 @@
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+#include "pipeline.h"
+#include "baby.h"
+
+namespace {
+
+// Cycle from which a word is ready, 0 if nothing wrote it
+long long readyAt(const std::vector<long long> &ready, long long address) {
+    return address >= 0 && address < (long long) ready.size() ? ready[address] : 0;
+}
+
+void setReady(std::vector<long long> &ready, long long address, long long cycle) {
+    if (address < 0) {
+        return;
+    }
+    if (address >= (long long) ready.size()) {
+        ready.resize(address + 1, 0);
+    }
+    ready[address] = cycle;
+}
+
+// "12 of 15"
+std::string ofTotal(const PipelineModel::Predictions &predictions) {
+    return std::to_string(predictions.right) + " of " + std::to_string(predictions.made);
+}
+
+} // namespace
+
+// Stages from fetch to write
+int PipelineConfig::depth() const {
+    return fetchStages + decodeStages + executeStages + writeStages;
+}
+
+// "not-taken", "bimodal" or "perfect"
+PipelineConfig::Predictor PipelineConfig::predictorNamed(const std::string &name) {
+    for (Predictor predictor: {Predictor::NotTaken, Predictor::Bimodal, Predictor::Perfect}) {
+        if (name == predictorName(predictor)) {
+            return predictor;
+        }
+    }
+    throw std::invalid_argument("Unknown predictor: " + name);
+}
+
+std::string PipelineConfig::predictorName(Predictor predictor) {
+    switch (predictor) {
+        case Predictor::NotTaken:
+            return "not-taken";
+        case Predictor::Bimodal:
+            return "bimodal";
+        case Predictor::Perfect:
+            return "perfect";
+    }
+    return "";
+}
+
+PipelineModel::PipelineModel(PipelineConfig config) : settings(config) {
+    if (settings.fetchStages < 1 || settings.decodeStages < 1 || settings.executeStages < 1 ||
+        settings.writeStages < 1) {
+        throw std::invalid_argument("Every pipeline part needs at least one stage");
+    }
+    if (settings.predictorEntries < 1) {
+        throw std::invalid_argument("The predictor needs at least one entry");
+    }
+    counters.assign(settings.predictorEntries, 1);
+    targets.assign(settings.predictorEntries, -1);
+}
+
+// Time one instruction, or count instructions reported at once
+void PipelineModel::onStep(const ManchesterBaby &baby, int instructions) {
+    if (instructions != 1) {
+        // Fused or fast-forwarded: only where they ended is known
+        bulk += instructions;
+        address = baby.ci;
+        return;
+    }
+    const int opcode = baby.curOpCode;
+    const int from = address;
+    const int actual = baby.ci;
+    address = actual;
+    timed++;
+
+    // What the instruction reads and writes, from the instruction table (isa.h)
+    const bool known = opcode >= 0 && opcode <= XAD;
+    const OperandUse use = known ? INSTRUCTIONS[opcode].operand : OperandUse::None;
+    const Effect effect = known ? INSTRUCTIONS[opcode].effect : Effect::Stop;
+    const bool immediate = takesImmediate(opcode) && baby.curImAddressing;
+    const bool readsWord = use == OperandUse::Exchange || (use == OperandUse::Read && !immediate);
+    const bool writesWord = use == OperandUse::Write || use == OperandUse::Exchange;
+    const bool readsAccumulator = known && opcode != LDN && opcode != LDP && effect != Effect::Jump &&
+                                  effect != Effect::Stop;
+    const bool writesAccumulator = effect == Effect::Accumulator || effect == Effect::Exchange;
+    const auto operand = (long long) baby.curOperand;
+
+    // Enter fetch as soon as nothing holds it back, the longest wait being the cause
+    long long start = issue;
+    Stall cause = Stall::Memory;
+    auto waitFor = [&start, &cause](long long ready, Stall kind) {
+        if (ready > start) {
+            start = ready;
+            cause = kind;
+        }
+    };
+    waitFor(readyAt(codeReady, from), Stall::CodeWrite);
+    if (readsAccumulator) {
+        waitFor(accumulatorReady, Stall::Accumulator);
+    }
+    if (readsWord) {
+        waitFor(readyAt(wordReady, operand), Stall::Memory);
+    }
+    stalled[(size_t) cause] += start - issue;
+    last = start;
+    issue = start + 1;
+
+    // A wrong prediction throws away what was fetched behind it, until it leaves execute
+    if (opcode == JMP || opcode == JRP || opcode == CMP) {
+        Predictions &predictions = predicted[opcode == JMP ? 0 : opcode == JRP ? 1 : 2];
+        predictions.made++;
+        if (predict(from, actual) == actual) {
+            predictions.right++;
+        } else {
+            const long long penalty = settings.fetchStages + settings.decodeStages + settings.executeStages - 1;
+            stalled[(size_t) Stall::Control] += penalty;
+            issue += penalty;
+        }
+        train(from, actual);
+    }
+
+    // Results: forwarded from the end of execute, or read once written
+    const long long ready = start + settings.executeStages + (settings.forwarding ? 0 : settings.writeStages);
+    if (writesAccumulator) {
+        accumulatorReady = ready;
+    }
+    if (writesWord) {
+        setReady(wordReady, operand, ready);
+        setReady(codeReady, operand, start + settings.depth());
+    }
+}
+
+// For a new run from address 0, once the last one has left the pipeline
+void PipelineModel::restart() {
+    address = 0;
+    issue = cycles();
+}
+
+// Next address the predictor expects after a control instruction at from
+int PipelineModel::predict(int from, int actual) const {
+    const int fallThrough = (from + 1) % SIZE_32_BIT;
+    switch (settings.predictor) {
+        case PipelineConfig::Predictor::NotTaken:
+            return fallThrough;
+        case PipelineConfig::Predictor::Perfect:
+            return actual;
+        case PipelineConfig::Predictor::Bimodal: {
+            const size_t entry = ((from % settings.predictorEntries) + settings.predictorEntries) %
+                                 settings.predictorEntries;
+            return counters[entry] >= 2 && targets[entry] >= 0 ? targets[entry] : fallThrough;
+        }
+    }
+    return fallThrough;
+}
+
+// Update the bimodal predictor with where a control instruction at from went
+void PipelineModel::train(int from, int actual) {
+    if (settings.predictor != PipelineConfig::Predictor::Bimodal) {
+        return;
+    }
+    const size_t entry = ((from % settings.predictorEntries) + settings.predictorEntries) % settings.predictorEntries;
+    if (actual != (from + 1) % SIZE_32_BIT) {
+        counters[entry] = (uint8_t) std::min(counters[entry] + 1, 3);
+        targets[entry] = actual;
+    } else if (counters[entry] > 0) {
+        counters[entry]--;
+    }
+}
+
+const PipelineConfig &PipelineModel::config() const {
+    return settings;
+}
+
+long long PipelineModel::instructions() const {
+    return timed;
+}
+
+// Cycles until the last instruction timed has left the pipeline
+long long PipelineModel::cycles() const {
+    return last < 0 ? 0 : last + settings.depth();
+}
+
+double PipelineModel::cpi() const {
+    return timed == 0 ? 0 : (double) cycles() / (double) timed;
+}
+
+long long PipelineModel::stalls(Stall kind) const {
+    return stalled[(size_t) kind];
+}
+
+// Predictions for JMP, JRP or CMP
+const PipelineModel::Predictions &PipelineModel::predictions(int opcode) const {
+    if (opcode != JMP && opcode != JRP && opcode != CMP) {
+        throw std::invalid_argument("Only JMP, JRP and CMP are predicted");
+    }
+    return predicted[opcode == JMP ? 0 : opcode == JRP ? 1 : 2];
+}
+
+long long PipelineModel::unmodelled() const {
+    return bulk;
+}
+
+// Human-readable summary: the pipeline, CPI, stalls and predictor accuracy
+std::vector<std::string> PipelineModel::report() const {
+    std::vector<std::string> lines;
+    std::ostringstream line;
+    line << "Pipeline: " << settings.fetchStages << " fetch, " << settings.decodeStages << " decode, "
+         << settings.executeStages << " execute and " << settings.writeStages << " write stages, forwarding "
+         << (settings.forwarding ? "on" : "off") << ", " << PipelineConfig::predictorName(settings.predictor)
+         << " predictor";
+    if (settings.predictor == PipelineConfig::Predictor::Bimodal) {
+        line << " (" << settings.predictorEntries << " entries)";
+    }
+    lines.push_back(line.str());
+
+    line.str("");
+    line << timed << " instructions in " << cycles() << " cycles: CPI " << std::fixed << std::setprecision(3)
+         << cpi();
+    lines.push_back(line.str());
+
+    lines.push_back("Stalls: " + std::to_string(stalls(Stall::Memory)) + " memory, " +
+                    std::to_string(stalls(Stall::Accumulator)) + " accumulator, " +
+                    std::to_string(stalls(Stall::Control)) + " control, " +
+                    std::to_string(stalls(Stall::CodeWrite)) + " code write");
+
+    Predictions all;
+    for (const Predictions &predictions: predicted) {
+        all.made += predictions.made;
+        all.right += predictions.right;
+    }
+    line.str("");
+    line << "Predictions: " << ofTotal(all) << " right";
+    if (all.made > 0) {
+        line << " (" << std::setprecision(1) << 100.0 * (double) all.right / (double) all.made << "%)";
+    }
+    line << "; JMP " << ofTotal(predicted[0]) << ", JRP " << ofTotal(predicted[1]) << ", CMP "
+         << ofTotal(predicted[2]);
+    lines.push_back(line.str());
+
+    if (bulk > 0) {
+        lines.push_back(std::to_string(bulk) + " instructions run by fusion or loop acceleration were not timed");
+    }
+    return lines;
+}
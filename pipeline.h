@@ -0,0 +1,115 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "events.h"
+
+// Shape of the modelled pipeline and the policies it applies
+struct PipelineConfig {
+    enum class Predictor {
+        NotTaken,       // Always the next address
+        Bimodal,        // Two-bit counters and the last target, per address modulo predictorEntries
+        Perfect         // Always right, for an upper bound
+    };
+
+    int fetchStages{1};
+    int decodeStages{1};
+    int executeStages{1};       // Operands are read in the first, results ready after the last
+    int writeStages{1};         // From execute until the result is in the accumulator or the store
+    bool forwarding{true};      // Results go straight from execute to the next reader, the store word included
+    Predictor predictor{Predictor::Bimodal};
+    int predictorEntries{32};
+
+    // Stages from fetch to write
+    [[nodiscard]] int depth() const;
+
+    // "not-taken", "bimodal" or "perfect"; throws std::invalid_argument for anything else
+    static Predictor predictorNamed(const std::string &name);
+
+    static std::string predictorName(Predictor predictor);
+};
+
+// Timing model of a pipelined Baby, run beside the functional engine as its observer (ManchesterBaby::setObserver).
+//
+// The engine runs the program as usual and the model times every instruction it reports in an in-order pipeline:
+// an instruction enters fetch a cycle after the one before unless it has to wait for
+//     memory       - a store word it reads (operand, or JMP/JRP target) that an earlier STO, XCH or XAD hasn't
+//                    written yet
+//     accumulator  - an accumulator an earlier instruction hasn't written yet
+//     control      - the right next address, when the predictor got a JMP, JRP or CMP wrong: the instructions
+//                    fetched behind it are thrown away and fetch starts again once it leaves execute
+//     code write   - its own word, when an instruction still in the pipeline is storing to it
+// With forwarding a reader waits only until the result leaves execute; without, until it has been written.
+//
+// The engine is untouched, so runs without the model cost nothing more. It must run one instruction at a time:
+// instructions reported at once by fusion or loop acceleration can't be timed, and are only counted as unmodelled.
+class PipelineModel : public MachineObserver {
+public:
+    enum class Stall {
+        Memory,
+        Accumulator,
+        Control,
+        CodeWrite
+    };
+
+    // Control instructions: JMP, JRP and CMP
+    struct Predictions {
+        long long made{0};
+        long long right{0};
+    };
+
+    explicit PipelineModel(PipelineConfig config = {});
+
+    void onStep(const ManchesterBaby &baby, int instructions) override;
+
+    // For a new run from address 0, after ManchesterBaby::reset(). The counts go on adding up.
+    void restart();
+
+    [[nodiscard]] const PipelineConfig &config() const;
+
+    [[nodiscard]] long long instructions() const;
+
+    // Cycles until the last instruction timed has left the pipeline
+    [[nodiscard]] long long cycles() const;
+
+    // Cycles per instruction
+    [[nodiscard]] double cpi() const;
+
+    [[nodiscard]] long long stalls(Stall kind) const;
+
+    // Predictions for JMP, JRP or CMP
+    [[nodiscard]] const Predictions &predictions(int opcode) const;
+
+    // Instructions reported at once, which weren't timed
+    [[nodiscard]] long long unmodelled() const;
+
+    // Human-readable summary: the pipeline, CPI, stalls and predictor accuracy
+    [[nodiscard]] std::vector<std::string> report() const;
+
+private:
+    PipelineConfig settings;
+    int address{0};                     // Of the next instruction, as far as the model knows
+    long long issue{0};                 // Cycle the next instruction can enter fetch, hazards aside
+    long long last{-1};                 // Cycle the last instruction timed entered fetch
+    long long accumulatorReady{0};      // Cycle from which an instruction can enter fetch and read the accumulator
+    std::vector<long long> wordReady;   // The same for each store word, as an operand
+    std::vector<long long> codeReady;   // The same for each store word, as an instruction
+    std::vector<uint8_t> counters;      // Bimodal predictor: two-bit counters
+    std::vector<int> targets;           // Bimodal predictor: last target, or -1
+
+    long long timed{0};
+    long long bulk{0};
+    std::array<long long, 4> stalled{};
+    std::array<Predictions, 3> predicted{};     // JMP, JRP, CMP
+
+    // Next address the predictor expects after a control instruction at from, and its update with the actual one
+    int predict(int from, int actual) const;
+
+    void train(int from, int actual);
+};
+
+#endif //PIPELINE_H
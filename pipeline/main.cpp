@@ -0,0 +1,178 @@
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../assembler.h"
+#include "../baby.h"
+#include "../pipeline.h"
+#include "../memsys.h"
+
+/* Times programs on a pipelined Baby (see pipeline.h) and reports CPI, stalls and predictor accuracy, and with
+ * --cache or --store-latency, the hit rates and access time of a memory system (see memsys.h).
+ *
+ * Usage:
+ *   babypipe FILE... [--fetch N] [--decode N] [--execute N] [--write N] [--no-forwarding]
+ *                    [--predictor not-taken|bimodal|perfect] [--entries N] [--max-steps N] [--devices]
+ *                    [--cache SETTINGS]... [--store-latency READ[,WRITE]]
+ *
+ * Each FILE is assembly source, or machine code if every line is 32 binary digits, and gets a report of its own.
+ * --fetch, --decode, --execute and --write give the stages of each part of the pipeline (1 each by default), and
+ * --entries the size of the bimodal predictor. The programs run on the plain interpreter, one instruction at a time,
+ * so that every instruction is timed. --devices maps the standard ports (see devices.h) on the console.
+ * Each --cache adds a level of cache below the ones before, e.g. --cache sets=8,ways=2,line=4,write=back,latency=1
+ * (see CacheConfig::parse); --store-latency gives the cycles of the store behind them, 20 by default.
+ */
+
+// Whether text is machine code rather than assembly source
+static bool isMachineCode(const std::string &text) {
+    std::istringstream input(text);
+    std::string line;
+    bool any = false;
+    while (getline(input, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.size() != (size_t) SIZE_32_BIT || line.find_first_not_of("01") != std::string::npos) {
+            return false;
+        }
+        any = true;
+    }
+    return any;
+}
+
+// Machine code of a file, assembled if it is source; empty if it can't be read or assembled
+static std::string machineCodeOf(const std::string &file) {
+    std::ifstream input(file);
+    if (!input) {
+        std::cerr << "Cannot open " << file << std::endl;
+        return "";
+    }
+    std::stringstream text;
+    text << input.rdbuf();
+    if (isMachineCode(text.str())) {
+        return text.str();
+    }
+    std::vector<std::string> log;
+    std::istringstream source(text.str());
+    std::string machineCode;
+    try {
+        for (const std::string &line: Assembler::processAssembleCode(SymbolTable(), source, log)) {
+            machineCode += line + "\n";
+        }
+    } catch (const std::invalid_argument &e) {
+        Assembler::logError(e, log);
+        for (const std::string &line: log) {
+            std::cerr << line << std::endl;
+        }
+        return "";
+    }
+    return machineCode;
+}
+
+int main(int argc, char *argv[]) {
+    std::vector<std::string> files;
+    PipelineConfig config;
+    long long maxSteps = 10000000;
+    bool withDevices = false;
+    MemorySystemConfig memory;
+    bool withMemory = false;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string option = argv[i];
+            if (option == "--no-forwarding") {
+                config.forwarding = false;
+                continue;
+            } else if (option == "--devices") {
+                withDevices = true;
+                continue;
+            } else if (option.rfind("--", 0) != 0) {
+                files.push_back(option);
+                continue;
+            }
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for " << option << std::endl;
+                return 1;
+            }
+            std::string value = argv[++i];
+            if (option == "--fetch") {
+                config.fetchStages = std::stoi(value);
+            } else if (option == "--decode") {
+                config.decodeStages = std::stoi(value);
+            } else if (option == "--execute") {
+                config.executeStages = std::stoi(value);
+            } else if (option == "--write") {
+                config.writeStages = std::stoi(value);
+            } else if (option == "--predictor") {
+                config.predictor = PipelineConfig::predictorNamed(value);
+            } else if (option == "--entries") {
+                config.predictorEntries = std::stoi(value);
+            } else if (option == "--max-steps") {
+                maxSteps = std::stoll(value);
+            } else if (option == "--cache") {
+                memory.levels.push_back(CacheConfig::parse(value));
+                withMemory = true;
+            } else if (option == "--store-latency") {
+                const size_t comma = value.find(',');
+                memory.readLatency = std::stoi(value.substr(0, comma));
+                memory.writeLatency = comma == std::string::npos ? memory.readLatency :
+                                      std::stoi(value.substr(comma + 1));
+                withMemory = true;
+            } else {
+                std::cerr << "Unknown option: " << option << std::endl;
+                return 1;
+            }
+        }
+        PipelineModel checkPipeline(config);
+        MemorySystem checkMemory(memory);
+    } catch (const std::invalid_argument &e) {
+        std::cerr << "Invalid option value: " << e.what() << std::endl;
+        return 1;
+    } catch (const std::out_of_range &) {
+        std::cerr << "Number out of range in the options" << std::endl;
+        return 1;
+    }
+    if (files.empty() || maxSteps < 1) {
+        std::cerr << "Usage: babypipe FILE... [--fetch N] [--decode N] [--execute N] [--write N] [--no-forwarding] "
+                     "[--predictor not-taken|bimodal|perfect] [--entries N] [--max-steps N] [--devices] "
+                     "[--cache SETTINGS]... [--store-latency READ[,WRITE]]" << std::endl;
+        return 1;
+    }
+
+    int failed = 0;
+    for (const std::string &file: files) {
+        std::string machineCode = machineCodeOf(file);
+        if (machineCode.empty()) {
+            failed++;
+            continue;
+        }
+        std::istringstream program(machineCode);
+        ManchesterBaby baby(program);
+        if (withDevices) {
+            baby.devices.mapStandard();
+        }
+        PipelineModel model(config);
+        baby.setObserver(&model);
+        MemorySystem memorySystem(memory);
+        AccessTrace trace(memorySystem);
+        if (withMemory) {
+            baby.setAccessTrace(&trace);
+        }
+        long long steps = 0;
+        while (!baby.isHalted() && steps < maxSteps) {
+            steps += baby.run((int) std::min<long long>(maxSteps - steps, 1 << 30));
+        }
+        std::cout << file << ": " << (baby.isHalted() ? "halted" : "out of steps") << std::endl;
+        for (const std::string &line: model.report()) {
+            std::cout << "  " << line << std::endl;
+        }
+        if (withMemory) {
+            for (const std::string &line: memorySystem.report()) {
+                std::cout << "  " << line << std::endl;
+            }
+        }
+    }
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,43 @@
+# Pipeline timing of Baby programs: qmake pipeline.pro && make && ./babypipe FILE...
+
+TARGET = babypipe
+TEMPLATE = app
+CONFIG += console c++17 release thread
+CONFIG -= qt app_bundle
+
+INCLUDEPATH += ..
+
+SOURCES += \
+        main.cpp \
+        ../pipeline.cpp \
+        ../memsys.cpp \
+        ../shadow.cpp \
+        ../baby.cpp \
+        ../assembler.cpp \
+        ../loopaccel.cpp \
+        ../fusion.cpp \
+        ../analysis.cpp \
+        ../stepbound.cpp \
+        ../clock.cpp \
+        ../events.cpp \
+        ../devices.cpp \
+        ../peephole.cpp
+
+HEADERS += \
+        ../pipeline.h \
+        ../memsys.h \
+        ../shadow.h \
+        ../baby.h \
+        ../assembler.h \
+        ../probes.h \
+        ../loopaccel.h \
+        ../fusion.h \
+        ../analysis.h \
+        ../stepbound.h \
+        ../clock.h \
+        ../events.h \
+        ../devices.h \
+        ../peephole.h \
+        ../isa.h \
+        ../memtrace.h \
+        ../word.h
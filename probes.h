@@ -0,0 +1,98 @@
+#ifndef PROBES_H
+#define PROBES_H
+
+#include <type_traits>
+
+// Static tracepoints (SystemTap-compatible USDT probes) for the simulator and the assembler.
+//
+// Every probe site compiles to a single NOP plus an entry in the ELF ".note.stapsdt" section, which is the
+// format understood by perf, bpftrace and SystemTap. Nothing is executed unless a tracer is attached, and no
+// header or library from systemtap-sdt-dev is needed. Probes are listed with:
+//     readelf -n ManchesterBaby | grep -A4 stapsdt
+//     bpftrace -l 'usdt:./ManchesterBaby:*'
+// and used, for example, with:
+//     bpftrace -e 'usdt:./ManchesterBaby:baby:execute { @[arg0] = count(); }'
+//
+// Probes available (provider "baby"):
+//     fetch(ci, round)                 - ManchesterBaby::fetch, before PI is loaded
+//     execute(opcode, operand, imm)    - ManchesterBaby::decodeAndExecute, at the opcode dispatch
+//     halt(ci, round)                  - ManchesterBaby::stp
+//     fused(kind, ci)                  - a fused handler ran instead of fetch/execute (see fusion.h)
+//     load_start(), load_done(words)   - ManchesterBaby::loadProgram
+//     asm_start(), asm_done(lines)     - Assembler::assemble
+//     asm_preprocess(lines)            - end of the label scanning phase
+//     asm_parse(lines)                 - end of the parsing phase
+//     asm_codegen(lines)               - end of the code generating phase
+//     startup(phase, microseconds)     - StartupProfile::mark, a step of the GUI's start (see startup.h)
+//
+// Define BABY_NO_PROBES to compile every probe out. Targets other than ELF on x86-64/AArch64 get empty probes.
+
+#if !defined(BABY_NO_PROBES) && defined(__GNUC__) && defined(__ELF__) && \
+    (defined(__x86_64__) || defined(__aarch64__))
+#define BABY_PROBES_ENABLED 1
+#else
+#define BABY_PROBES_ENABLED 0
+#endif
+
+#if BABY_PROBES_ENABLED
+
+// Size of a probe argument as written into the note: negative for signed types.
+#define BABY_PROBE_ARG_SIZE_(x) \
+    ((std::is_signed<typename std::decay<decltype(x)>::type>::value ? -1 : 1) * (int) sizeof(x))
+
+// Operands of argument No.n: its size (printed through "%n", which negates it) and its location.
+#define BABY_PROBE_OPERAND_(n, x) [baby_s##n] "n" (-BABY_PROBE_ARG_SIZE_(x)), [baby_a##n] "nor" (x)
+#define BABY_PROBE_FORMAT_(n) "%n[baby_s" #n "]@%[baby_a" #n "]"
+
+// The note itself: the address of the NOP, the address of the base symbol (lets tools correct for
+// prelinking), no semaphore, then provider, name and the argument description.
+#define BABY_PROBE_ASM_(provider, name, format)                                  \
+    "990:\tnop\n"                                                                \
+    "\t.pushsection .note.stapsdt,\"?\",\"note\"\n"                              \
+    "\t.balign 4\n"                                                              \
+    "\t.4byte 992f-991f, 994f-993f, 3\n"                                         \
+    "991:\t.asciz \"stapsdt\"\n"                                                 \
+    "992:\t.balign 4\n"                                                          \
+    "993:\t.8byte 990b\n"                                                        \
+    "\t.8byte _.stapsdt.base\n"                                                  \
+    "\t.8byte 0\n"                                                               \
+    "\t.asciz \"" #provider "\"\n"                                               \
+    "\t.asciz \"" #name "\"\n"                                                   \
+    "\t.asciz \"" format "\"\n"                                                  \
+    "994:\t.balign 4\n"                                                          \
+    "\t.popsection\n"                                                            \
+    "\t.ifndef _.stapsdt.base\n"                                                 \
+    "\t.pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n"    \
+    "\t.weak _.stapsdt.base\n"                                                   \
+    "\t.hidden _.stapsdt.base\n"                                                 \
+    "_.stapsdt.base:\t.space 1\n"                                                \
+    "\t.size _.stapsdt.base, 1\n"                                                \
+    "\t.popsection\n"                                                            \
+    "\t.endif\n"
+
+#define BABY_PROBE0(provider, name) \
+    __asm__ __volatile__ (BABY_PROBE_ASM_(provider, name, ""))
+
+#define BABY_PROBE1(provider, name, a1) \
+    __asm__ __volatile__ (BABY_PROBE_ASM_(provider, name, BABY_PROBE_FORMAT_(1)) \
+                          :: BABY_PROBE_OPERAND_(1, a1))
+
+#define BABY_PROBE2(provider, name, a1, a2) \
+    __asm__ __volatile__ (BABY_PROBE_ASM_(provider, name, BABY_PROBE_FORMAT_(1) " " BABY_PROBE_FORMAT_(2)) \
+                          :: BABY_PROBE_OPERAND_(1, a1), BABY_PROBE_OPERAND_(2, a2))
+
+#define BABY_PROBE3(provider, name, a1, a2, a3) \
+    __asm__ __volatile__ (BABY_PROBE_ASM_(provider, name, BABY_PROBE_FORMAT_(1) " " BABY_PROBE_FORMAT_(2) \
+                                          " " BABY_PROBE_FORMAT_(3)) \
+                          :: BABY_PROBE_OPERAND_(1, a1), BABY_PROBE_OPERAND_(2, a2), BABY_PROBE_OPERAND_(3, a3))
+
+#else
+
+#define BABY_PROBE0(provider, name) do {} while (0)
+#define BABY_PROBE1(provider, name, a1) do { (void) (a1); } while (0)
+#define BABY_PROBE2(provider, name, a1, a2) do { (void) (a1); (void) (a2); } while (0)
+#define BABY_PROBE3(provider, name, a1, a2, a3) do { (void) (a1); (void) (a2); (void) (a3); } while (0)
+
+#endif
+
+#endif //PROBES_H
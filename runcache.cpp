@@ -0,0 +1,246 @@
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "runcache.h"
+
+// How the file is laid out, written once when it is created
+struct Geometry {
+    char magic[8];
+    uint32_t version;
+    uint32_t storeWords;        // Room for store words in each slot
+    uint64_t sets;              // A power of two
+    uint64_t slotBytes;
+};
+
+// The file starts with a header, the geometry and shared counters, followed by the slots set by set
+struct RunCache::Header {
+    Geometry geometry;
+    alignas(64) std::atomic<uint64_t> clock;    // Ticks on every use, for the LRU order
+    std::atomic<uint64_t> hits;
+    std::atomic<uint64_t> misses;
+    std::atomic<uint64_t> stores;
+    std::atomic<uint64_t> evictions;
+};
+
+// A slot, followed by its storeWords store words (std::atomic<uint32_t> each)
+struct RunCache::Slot {
+    std::atomic<uint32_t> sequence;     // Odd while a writer is at work
+    std::atomic<uint32_t> halt;
+    std::atomic<uint64_t> lastUse;
+    std::atomic<uint64_t> key;          // Both halves zero in an empty slot
+    std::atomic<uint64_t> check;
+    std::atomic<uint64_t> steps;
+    std::atomic<uint64_t> cycles;
+    std::atomic<uint32_t> accumulator;
+    std::atomic<uint32_t> ci;
+    std::atomic<uint32_t> words;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free,
+              "the cache is shared between processes, so its atomics must not hide a lock");
+
+static const char MAGIC[8] = {'B', 'A', 'B', 'Y', 'R', 'U', 'N', 0};
+static const uint32_t VERSION = 1;
+static const uint64_t HEADER_BYTES = 256;
+
+// Store words of a slot
+static std::atomic<uint32_t> *storeOf(void *slot, size_t slotHeaderBytes) {
+    return reinterpret_cast<std::atomic<uint32_t> *>(static_cast<char *>(slot) + slotHeaderBytes);
+}
+
+// Open the cache file, creating it if need be
+RunCache::RunCache(const std::string &path, uint64_t sizeBytes, uint32_t storeWords) {
+    static_assert(sizeof(Header) <= HEADER_BYTES, "header too large");
+    fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        std::cerr << "Error: can't open the run cache " << path << ": " << std::strerror(errno) << std::endl;
+        throw std::runtime_error("Failed to open the run cache.");
+    }
+    // One process at a time checks the file and makes it if it isn't there yet
+    flock(fd, LOCK_EX);
+    Geometry existing{};
+    struct stat status{};
+    fstat(fd, &status);
+    bool valid = (uint64_t) status.st_size >= HEADER_BYTES &&
+                 pread(fd, &existing, sizeof existing, 0) == (ssize_t) sizeof existing &&
+                 std::memcmp(existing.magic, MAGIC, sizeof MAGIC) == 0 && existing.version == VERSION &&
+                 existing.sets > 0 && (existing.sets & (existing.sets - 1)) == 0 &&
+                 (uint64_t) status.st_size == HEADER_BYTES + existing.sets * WAYS * existing.slotBytes;
+    if (!valid) {
+        Geometry fresh{};
+        std::memcpy(fresh.magic, MAGIC, sizeof MAGIC);
+        fresh.version = VERSION;
+        fresh.storeWords = storeWords;
+        fresh.slotBytes = (sizeof(Slot) + (uint64_t) storeWords * sizeof(uint32_t) + 63) / 64 * 64;
+        fresh.sets = 1;
+        while (fresh.sets * 2 * WAYS * fresh.slotBytes <= sizeBytes) {
+            fresh.sets *= 2;
+        }
+        // Truncating to nothing first leaves every slot zero: empty, with an even sequence number
+        if (ftruncate(fd, 0) != 0 ||
+            ftruncate(fd, (off_t) (HEADER_BYTES + fresh.sets * WAYS * fresh.slotBytes)) != 0 ||
+            pwrite(fd, &fresh, sizeof fresh, 0) != (ssize_t) sizeof fresh) {
+            std::cerr << "Error: can't create the run cache " << path << ": " << std::strerror(errno) << std::endl;
+            flock(fd, LOCK_UN);
+            close(fd);
+            throw std::runtime_error("Failed to create the run cache.");
+        }
+        existing = fresh;
+    }
+    mappedBytes = HEADER_BYTES + existing.sets * WAYS * existing.slotBytes;
+    mapping = mmap(nullptr, mappedBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    flock(fd, LOCK_UN);
+    if (mapping == MAP_FAILED) {
+        std::cerr << "Error: can't map the run cache " << path << ": " << std::strerror(errno) << std::endl;
+        close(fd);
+        throw std::runtime_error("Failed to map the run cache.");
+    }
+    header = static_cast<Header *>(mapping);
+}
+
+RunCache::~RunCache() {
+    munmap(mapping, mappedBytes);
+    close(fd);
+}
+
+RunCache::Slot *RunCache::slot(uint64_t index) const {
+    return reinterpret_cast<Slot *>(static_cast<char *>(mapping) + HEADER_BYTES +
+                                    index * header->geometry.slotBytes);
+}
+
+// Key of a run
+std::pair<uint64_t, uint64_t> RunCache::key(const std::vector<uint32_t> &image,
+                                            const std::vector<std::pair<unsigned long, uint32_t>> &patches,
+                                            uint64_t budget) {
+    // Two independent hashes of the same values: FNV-1a, which picks the set, and a multiply-xorshift chain
+    uint64_t fnv = 14695981039346656037ULL;
+    uint64_t chain = 0x9e3779b97f4a7c15ULL;
+    auto mix = [&fnv, &chain](uint64_t value) {
+        for (int i = 0; i < 8; ++i) {
+            fnv = (fnv ^ ((value >> (8 * i)) & 0xff)) * 1099511628211ULL;
+        }
+        chain = (chain ^ value) * 0xbf58476d1ce4e5b9ULL;
+        chain ^= chain >> 31;
+    };
+    mix(image.size());
+    for (uint32_t word: image) {
+        mix(word);
+    }
+    mix(patches.size());
+    for (const auto &patch: patches) {
+        mix(patch.first);
+        mix(patch.second);
+    }
+    mix(budget);
+    // Both halves zero marks an empty slot
+    return {fnv == 0 && chain == 0 ? 1 : fnv, chain};
+}
+
+// Function to find the outcome of a run
+bool RunCache::lookup(const std::pair<uint64_t, uint64_t> &key, RunOutcome &outcome) {
+    const uint64_t first = (key.first & (header->geometry.sets - 1)) * WAYS;
+    for (uint32_t way = 0; way < WAYS; ++way) {
+        Slot *candidate = slot(first + way);
+        const uint32_t before = candidate->sequence.load(std::memory_order_acquire);
+        if ((before & 1) != 0 || candidate->key.load(std::memory_order_relaxed) != key.first ||
+            candidate->check.load(std::memory_order_relaxed) != key.second) {
+            continue;
+        }
+        outcome.halt = (RunHalt) candidate->halt.load(std::memory_order_relaxed);
+        outcome.steps = candidate->steps.load(std::memory_order_relaxed);
+        outcome.cycles = candidate->cycles.load(std::memory_order_relaxed);
+        outcome.accumulator = candidate->accumulator.load(std::memory_order_relaxed);
+        outcome.ci = candidate->ci.load(std::memory_order_relaxed);
+        const uint32_t words = std::min(candidate->words.load(std::memory_order_relaxed),
+                                        header->geometry.storeWords);
+        const std::atomic<uint32_t> *store = storeOf(candidate, sizeof(Slot));
+        outcome.store.resize(words);
+        for (uint32_t i = 0; i < words; ++i) {
+            outcome.store[i] = store[i].load(std::memory_order_relaxed);
+        }
+        // A writer got in while we copied: the copy may be torn
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (candidate->sequence.load(std::memory_order_relaxed) != before) {
+            continue;
+        }
+        candidate->lastUse.store(header->clock.fetch_add(1, std::memory_order_relaxed) + 1,
+                                 std::memory_order_relaxed);
+        header->hits.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    header->misses.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+// Function to remember the outcome of a run
+bool RunCache::store(const std::pair<uint64_t, uint64_t> &key, const RunOutcome &outcome) {
+    if (outcome.store.size() > header->geometry.storeWords) {
+        return false;
+    }
+    // The slot already holding the key, else an empty one, else the least recently used
+    const uint64_t first = (key.first & (header->geometry.sets - 1)) * WAYS;
+    Slot *victim = nullptr;
+    Slot *empty = nullptr;
+    Slot *oldest = nullptr;
+    for (uint32_t way = 0; way < WAYS && victim == nullptr; ++way) {
+        Slot *candidate = slot(first + way);
+        const uint64_t slotKey = candidate->key.load(std::memory_order_relaxed);
+        const uint64_t slotCheck = candidate->check.load(std::memory_order_relaxed);
+        if (slotKey == key.first && slotCheck == key.second) {
+            victim = candidate;
+        } else if (slotKey == 0 && slotCheck == 0) {
+            empty = empty != nullptr ? empty : candidate;
+        } else if (oldest == nullptr || candidate->lastUse.load(std::memory_order_relaxed) <
+                                        oldest->lastUse.load(std::memory_order_relaxed)) {
+            oldest = candidate;
+        }
+    }
+    const bool evicting = victim == nullptr && empty == nullptr;
+    victim = victim != nullptr ? victim : empty != nullptr ? empty : oldest;
+
+    // Claim the slot: a writer already at work keeps it
+    uint32_t sequence = victim->sequence.load(std::memory_order_relaxed);
+    if ((sequence & 1) != 0 ||
+        !victim->sequence.compare_exchange_strong(sequence, sequence + 1, std::memory_order_acquire,
+                                                  std::memory_order_relaxed)) {
+        return false;
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    victim->key.store(key.first, std::memory_order_relaxed);
+    victim->check.store(key.second, std::memory_order_relaxed);
+    victim->halt.store((uint32_t) outcome.halt, std::memory_order_relaxed);
+    victim->steps.store(outcome.steps, std::memory_order_relaxed);
+    victim->cycles.store(outcome.cycles, std::memory_order_relaxed);
+    victim->accumulator.store(outcome.accumulator, std::memory_order_relaxed);
+    victim->ci.store(outcome.ci, std::memory_order_relaxed);
+    victim->words.store((uint32_t) outcome.store.size(), std::memory_order_relaxed);
+    std::atomic<uint32_t> *store = storeOf(victim, sizeof(Slot));
+    for (size_t i = 0; i < outcome.store.size(); ++i) {
+        store[i].store(outcome.store[i], std::memory_order_relaxed);
+    }
+    victim->lastUse.store(header->clock.fetch_add(1, std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    victim->sequence.store(sequence + 2, std::memory_order_release);
+
+    header->stores.fetch_add(1, std::memory_order_relaxed);
+    if (evicting) {
+        header->evictions.fetch_add(1, std::memory_order_relaxed);
+    }
+    return true;
+}
+
+// Counts since the file was created
+RunCache::Statistics RunCache::statistics() const {
+    return {header->hits.load(std::memory_order_relaxed), header->misses.load(std::memory_order_relaxed),
+            header->stores.load(std::memory_order_relaxed), header->evictions.load(std::memory_order_relaxed),
+            header->geometry.sets * WAYS, header->geometry.storeWords};
+}
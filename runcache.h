@@ -0,0 +1,92 @@
+#ifndef RUNCACHE_H
+#define RUNCACHE_H
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Memoised results of runs: the same image, patched the same way and run with the same step budget, always ends the
+// same way, so its outcome can be looked up instead of simulated again.
+//
+// The cache is a file mapped into memory, shared by every thread and process that opens it. It is set-associative:
+// a key picks a set of a few slots, and a full set drops its least recently used slot. Every slot has a fixed room
+// for store words, chosen when the file is created, and a result with more words than that is not cached. The file
+// never grows past the size it was created with.
+//
+// Readers take no lock. Each slot has a sequence number (a seqlock): a writer makes it odd while it writes and even
+// again when done, and a reader that sees it odd or changed across its copy treats the slot as a miss. Writers claim
+// the slot by making the number odd, so a second writer gives up instead of waiting. Every field is an atomic, so a
+// reader racing a writer reads a torn copy that it throws away, never undefined behaviour. A process killed while
+// writing leaves its slot odd, and the slot is lost until the file is recreated.
+
+// How a run ended
+enum class RunHalt : uint32_t {
+    Stopped,            // STP
+    IllegalOpcode,      // An unknown opcode halted the machine
+    Budget              // The step budget ran out
+};
+
+// The outcome of a run: everything needed to answer without running again
+struct RunOutcome {
+    RunHalt halt{RunHalt::Stopped};
+    uint64_t steps{0};
+    uint64_t cycles{0};
+    uint32_t accumulator{0};
+    uint32_t ci{0};
+    std::vector<uint32_t> store;    // Word values (see isa.h), from address 0
+};
+
+class RunCache {
+public:
+    static constexpr uint32_t WAYS = 8;
+
+    // Open the cache file at path, creating it with room for about sizeBytes of slots, each holding up to
+    // storeWords words. A file made before, by any process, is used with its own geometry. Throws
+    // std::runtime_error if the file can't be opened or mapped.
+    RunCache(const std::string &path, uint64_t sizeBytes, uint32_t storeWords = 256);
+
+    ~RunCache();
+
+    RunCache(const RunCache &) = delete;
+
+    RunCache &operator=(const RunCache &) = delete;
+
+    // Key of a run: the image's word values, the patches applied after loading it (address and value) and the
+    // step budget
+    static std::pair<uint64_t, uint64_t> key(const std::vector<uint32_t> &image,
+                                             const std::vector<std::pair<unsigned long, uint32_t>> &patches,
+                                             uint64_t budget);
+
+    // Function to find the outcome of a run. Returns false on a miss.
+    bool lookup(const std::pair<uint64_t, uint64_t> &key, RunOutcome &outcome);
+
+    // Function to remember the outcome of a run. Returns false if it was not stored: too many store words, or
+    // another writer holds the slot.
+    bool store(const std::pair<uint64_t, uint64_t> &key, const RunOutcome &outcome);
+
+    struct Statistics {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t stores;
+        uint64_t evictions;
+        uint64_t slots;
+        uint32_t storeWords;
+    };
+
+    // Counts since the file was created, over every process using it
+    [[nodiscard]] Statistics statistics() const;
+
+private:
+    struct Header;
+    struct Slot;
+
+    int fd{-1};
+    void *mapping{nullptr};
+    uint64_t mappedBytes{0};
+    Header *header{nullptr};
+
+    [[nodiscard]] Slot *slot(uint64_t index) const;
+};
+
+#endif //RUNCACHE_H
@@ -0,0 +1,339 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "jobserver.h"
+#include "../assembler.h"
+#include "../stepbound.h"
+
+// Words in a job's store: every address an operand can name. A CI outside it, after a jump through a negative word,
+// fails the job (see ManchesterBaby::fetch).
+const size_t STORE_WORDS = (size_t) 1 << Layout32::operandBits;
+
+// Instructions run between checks of a job's deadline
+const int SLICE_STEPS = 1 << 16;
+
+JobServer::Connection::~Connection() {
+    close(fd);
+}
+
+JobServer::JobServer(std::string socketPath, ServerLimits limits)
+        : socketPath(std::move(socketPath)), limits(limits) {}
+
+// Accept clients until stop() is called.
+void JobServer::serve() {
+    sockaddr_un address{};
+    if (socketPath.size() >= sizeof address.sun_path) {
+        std::cerr << "Error: socket path " << socketPath << " is too long." << std::endl;
+        throw std::runtime_error("Socket path too long.");
+    }
+    address.sun_family = AF_UNIX;
+    std::strcpy(address.sun_path, socketPath.c_str());
+    listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(socketPath.c_str());
+    if (listenFd < 0 || bind(listenFd, (sockaddr *) &address, sizeof address) != 0 || listen(listenFd, 128) != 0) {
+        std::cerr << "Error: can't listen on " << socketPath << ": " << std::strerror(errno) << std::endl;
+        if (listenFd >= 0) {
+            close(listenFd);
+        }
+        throw std::runtime_error("Failed to open the server socket.");
+    }
+
+    for (int i = 0; i < limits.workers; ++i) {
+        workers.emplace_back(&JobServer::work, this);
+    }
+    while (!stopping) {
+        pollfd listening{listenFd, POLLIN, 0};
+        if (poll(&listening, 1, 200) <= 0) {
+            continue;
+        }
+        int fd = accept(listenFd, nullptr, nullptr);
+        if (fd < 0) {
+            continue;
+        }
+        auto connection = std::make_shared<Connection>(fd);
+        {
+            std::lock_guard<std::mutex> lock(connectionsLock);
+            connections.push_back(connection);
+        }
+        std::thread(&JobServer::readClient, this, connection).detach();
+    }
+
+    // Shut down: drop the waiting jobs, let the running ones finish, then disconnect the clients
+    {
+        std::lock_guard<std::mutex> lock(queueLock);
+        queue.clear();
+    }
+    queueReady.notify_all();
+    for (auto &worker: workers) {
+        worker.join();
+    }
+    workers.clear();
+    {
+        std::unique_lock<std::mutex> lock(connectionsLock);
+        for (const auto &connection: connections) {
+            shutdown(connection->fd, SHUT_RDWR);
+        }
+        readersDone.wait(lock, [this]() {
+            return connections.empty();
+        });
+    }
+    close(listenFd);
+    listenFd = -1;
+    unlink(socketPath.c_str());
+}
+
+// Make serve() return.
+void JobServer::stop() {
+    {
+        std::lock_guard<std::mutex> lock(queueLock);
+        stopping = true;
+    }
+    queueReady.notify_all();
+}
+
+// Answer runs seen before from a result cache
+void JobServer::setRunCache(RunCache *cache) {
+    runCache = cache;
+}
+
+// Parse a client's jobs into the queue until it disconnects
+void JobServer::readClient(const std::shared_ptr<Connection> &connection) {
+    LineReader reader(connection->fd);
+    JobParser parser;
+    std::string line;
+    Job job;
+    while (!stopping && reader.next(line)) {
+        JobResult refused;
+        try {
+            if (!parser.feed(line, job)) {
+                continue;
+            }
+        } catch (const std::invalid_argument &e) {
+            refused.id = parser.currentId().empty() ? "-" : parser.currentId();
+            refused.error = e.what();
+            reply(*connection, refused);
+            continue;
+        }
+        if (connection->queued >= limits.maxQueuedPerClient) {
+            refused.id = job.id;
+            refused.error = "too many jobs queued";
+            reply(*connection, refused);
+            continue;
+        }
+        connection->queued++;
+        {
+            std::lock_guard<std::mutex> lock(queueLock);
+            queue.push_back(QueuedJob{std::move(job), connection, sequence++, Clock::now()});
+            std::push_heap(queue.begin(), queue.end(), LaterFirst());
+        }
+        queueReady.notify_one();
+    }
+
+    // The socket stays open for the results of the jobs still queued
+    std::lock_guard<std::mutex> lock(connectionsLock);
+    connections.erase(std::find(connections.begin(), connections.end(), connection));
+    readersDone.notify_all();
+}
+
+// Run jobs from the queue on this thread's engine until the server stops
+void JobServer::work() {
+    std::istringstream noProgram;
+    ManchesterBaby baby(noProgram);
+    baby.memory.resize(STORE_WORDS);
+    while (true) {
+        QueuedJob next;
+        {
+            std::unique_lock<std::mutex> lock(queueLock);
+            queueReady.wait(lock, [this]() {
+                return stopping || !queue.empty();
+            });
+            if (stopping) {
+                return;
+            }
+            std::pop_heap(queue.begin(), queue.end(), LaterFirst());
+            next = std::move(queue.back());
+            queue.pop_back();
+        }
+        const Clock::time_point start = Clock::now();
+        JobResult result = runJob(baby, next.job);
+        result.queuedUs = std::chrono::duration_cast<std::chrono::microseconds>(start - next.arrival).count();
+        result.runUs = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+        next.connection->queued--;
+        reply(*next.connection, result);
+    }
+}
+
+// Load and run one job on a warm engine
+JobResult JobServer::runJob(ManchesterBaby &baby, const Job &job) {
+    JobResult result;
+    result.id = job.id;
+    if (job.program.size() > limits.maxProgramLines) {
+        result.error = "program longer than " + std::to_string(limits.maxProgramLines) + " lines";
+        return result;
+    }
+
+    // Machine code, assembled if need be
+    std::vector<std::string> image = job.program;
+    if (job.source) {
+        std::string source;
+        for (const auto &line: job.program) {
+            source += line + "\n";
+        }
+        std::istringstream input(source);
+        std::vector<std::string> log;
+        try {
+            image = Assembler::processAssembleCode(SymbolTable(), input, log);
+        } catch (const std::invalid_argument &e) {
+            // Error code, then the line number with its digits reversed, then the offending text (see assemble())
+            const std::string s = e.what();
+            result.error = "assembly error " + s.substr(0, 3);
+            if (s.size() >= 6) {
+                int line = (s[5] - '0') * 100 + (s[4] - '0') * 10 + (s[3] - '0');
+                result.error += " on line " + std::to_string(line) + ": " + s.substr(6);
+            }
+            return result;
+        }
+    }
+    if (image.size() > STORE_WORDS) {
+        result.error = "program larger than the store";
+        return result;
+    }
+    std::string machineCode;
+    for (size_t i = 0; i < image.size(); ++i) {
+        if (image[i].size() != (size_t) SIZE_32_BIT || image[i].find_first_not_of("01") != std::string::npos) {
+            result.error = "line " + std::to_string(i + 1) + " is not a 32-bit word";
+            return result;
+        }
+        machineCode += image[i] + "\n";
+    }
+    size_t words = std::max(image.size(), (size_t) SIZE_32_BIT);
+    for (const auto &patch: job.patches) {
+        if (patch.first >= STORE_WORDS) {
+            result.error = "patch address " + std::to_string(patch.first) + " past the store";
+            return result;
+        }
+        words = std::max(words, (size_t) patch.first + 1);
+    }
+    long long budget = std::min(job.steps, limits.maxSteps);
+
+    // A program that can't halt is refused without running, and one that must halt runs no further than it can
+    if (limits.boundSteps) {
+        std::vector<std::bitset<SIZE_32_BIT>> patched;
+        for (const auto &line: image) {
+            patched.emplace_back(line);
+        }
+        patched.resize(std::max(patched.size(), (size_t) SIZE_32_BIT));
+        for (const auto &patch: job.patches) {
+            if (patch.first < patched.size()) {
+                patched[patch.first] = std::bitset<SIZE_32_BIT>(reverseWord((uint32_t) patch.second));
+            }
+        }
+        StepBoundAnalysis bound(patched);
+        if (bound.neverHalts()) {
+            result.error = "never halts: " + bound.reason();
+            return result;
+        }
+        if (bound.isBounded()) {
+            budget = std::min(budget, bound.worstCaseSteps());
+        }
+    }
+
+    // A run seen before, by this server or any other sharing the cache, is answered without running it
+    std::pair<uint64_t, uint64_t> key;
+    if (runCache != nullptr) {
+        std::vector<uint32_t> values(image.size(), 0);
+        for (size_t i = 0; i < image.size(); ++i) {
+            for (int bit = 0; bit < SIZE_32_BIT; ++bit) {
+                values[i] |= (uint32_t) (image[i][bit] == '1') << bit;
+            }
+        }
+        std::vector<std::pair<unsigned long, uint32_t>> patches;
+        for (const auto &patch: job.patches) {
+            patches.emplace_back(patch.first, (uint32_t) patch.second);
+        }
+        key = RunCache::key(values, patches, (uint64_t) budget);
+        RunOutcome outcome;
+        if (runCache->lookup(key, outcome) && outcome.store.size() == words) {
+            result.status = outcome.halt == RunHalt::Stopped ? "halted" :
+                            outcome.halt == RunHalt::IllegalOpcode ? "illegal" : "budget";
+            result.steps = (long long) outcome.steps;
+            result.cycles = outcome.cycles;
+            result.accumulator = (int32_t) outcome.accumulator;
+            result.ci = (int) outcome.ci;
+            result.store.assign(outcome.store.begin(), outcome.store.end());
+            for (long long &value: result.store) {
+                value = (int32_t) value;
+            }
+            return result;
+        }
+    }
+
+    // Load into a cleared store, patch, and run in slices until halted, out of steps or out of time
+    std::fill(baby.memory.begin(), baby.memory.end(), std::bitset<SIZE_32_BIT>());
+    std::istringstream input(machineCode);
+    baby.loadProgram(input);
+    for (const auto &patch: job.patches) {
+        baby.writeMemory(patch.first, std::bitset<SIZE_32_BIT>(reverseWord((uint32_t) patch.second)));
+    }
+    baby.reset();
+    baby.setHalt(false);
+    baby.selectFastestMode();
+    const long long timeoutMs = std::min(job.timeoutMs > 0 ? job.timeoutMs : limits.maxTimeoutMs, limits.maxTimeoutMs);
+    const Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeoutMs);
+    bool timedOut = false;
+    try {
+        while (!baby.isHalted() && result.steps < budget) {
+            result.steps += baby.run((int) std::min<long long>(budget - result.steps, SLICE_STEPS));
+            if (!baby.isHalted() && result.steps < budget && Clock::now() >= deadline) {
+                timedOut = true;
+                break;
+            }
+        }
+    } catch (const std::runtime_error &e) {
+        result.error = e.what();
+        return result;
+    }
+
+    if (baby.isHalted()) {
+        // An unknown opcode halts the machine with that opcode as the current one
+        result.status = baby.curOpCode == STP ? "halted" : "illegal";
+    } else {
+        result.status = timedOut ? "timeout" : "budget";
+    }
+    result.cycles = baby.clock.cycles();
+    result.accumulator = (int32_t) ManchesterBaby::convertInstruction(baby.accumulator);
+    result.ci = baby.ci;
+    result.store.reserve(words);
+    for (size_t i = 0; i < words; ++i) {
+        result.store.push_back((int32_t) ManchesterBaby::convertInstruction(baby.memory[i]));
+    }
+
+    // A timeout depends on the host, not the program, so it is not remembered
+    if (runCache != nullptr && !timedOut) {
+        RunOutcome outcome;
+        outcome.halt = result.status == "halted" ? RunHalt::Stopped :
+                       result.status == "illegal" ? RunHalt::IllegalOpcode : RunHalt::Budget;
+        outcome.steps = (uint64_t) result.steps;
+        outcome.cycles = result.cycles;
+        outcome.accumulator = (uint32_t) result.accumulator;
+        outcome.ci = (uint32_t) result.ci;
+        outcome.store.assign(result.store.begin(), result.store.end());
+        runCache->store(key, outcome);
+    }
+    return result;
+}
+
+// Send a result to its client, unless the client is gone
+void JobServer::reply(Connection &connection, const JobResult &result) {
+    const std::string text = formatResult(result);
+    std::lock_guard<std::mutex> lock(connection.writeLock);
+    writeAll(connection.fd, text);
+}
@@ -0,0 +1,100 @@
+#ifndef JOBSERVER_H
+#define JOBSERVER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../baby.h"
+#include "../runcache.h"
+#include "protocol.h"
+
+// Limits applied to every job, whatever it asks for
+struct ServerLimits {
+    int workers{4};                     // Engines kept warm, one per worker thread
+    long long maxSteps{100000000};      // Step budget
+    long long maxTimeoutMs{10000};      // Wall-clock time per job, and the default
+    size_t maxProgramLines{4096};       // Lines of source or machine code
+    size_t maxQueuedPerClient{1024};    // Jobs a client may have waiting; more are refused
+    bool boundSteps{false};             // Refuse jobs that never halt, and cap the budget at the static bound
+};
+
+// Runs jobs sent over a Unix domain socket (see protocol.h) on a pool of warm engines.
+//
+// Every worker thread constructs its ManchesterBaby once and reuses it, so a job costs its assembly, loading and run
+// only. A reader thread per client parses jobs into one shared queue, ordered by priority, and the workers write
+// results back to the client that sent them as they finish.
+class JobServer {
+public:
+    JobServer(std::string socketPath, ServerLimits limits);
+
+    // Accept clients until stop() is called. Throws std::runtime_error if the socket can't be opened.
+    void serve();
+
+    // Make serve() return: stops accepting, disconnects the clients and drops the jobs not yet started.
+    // Safe to call from any thread.
+    void stop();
+
+    // Answer runs seen before from a result cache (see runcache.h), and remember new ones in it. Call before serve().
+    void setRunCache(RunCache *cache);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    // A connected client. The socket stays open, for results, until the client's last job is done.
+    struct Connection {
+        int fd;
+        std::mutex writeLock;           // Workers write whole lines under it
+        std::atomic<size_t> queued{0};  // Jobs waiting in the queue
+
+        explicit Connection(int fd) : fd(fd) {}
+
+        ~Connection();
+    };
+
+    struct QueuedJob {
+        Job job;
+        std::shared_ptr<Connection> connection;
+        uint64_t sequence;
+        Clock::time_point arrival;
+    };
+
+    // Highest priority first, then first come first served
+    struct LaterFirst {
+        bool operator()(const QueuedJob &a, const QueuedJob &b) const {
+            return a.job.priority != b.job.priority ? a.job.priority < b.job.priority : a.sequence > b.sequence;
+        }
+    };
+
+    std::string socketPath;
+    ServerLimits limits;
+    int listenFd{-1};
+    std::atomic<bool> stopping{false};
+    RunCache *runCache{nullptr};
+
+    std::mutex queueLock;
+    std::condition_variable queueReady;
+    std::vector<QueuedJob> queue;       // A heap, ordered by LaterFirst
+    uint64_t sequence{0};
+
+    std::mutex connectionsLock;
+    std::condition_variable readersDone;
+    std::vector<std::shared_ptr<Connection>> connections;   // One reader thread each
+    std::vector<std::thread> workers;
+
+    void readClient(const std::shared_ptr<Connection> &connection);
+
+    void work();
+
+    // Load and run one job on a warm engine
+    JobResult runJob(ManchesterBaby &baby, const Job &job);
+
+    static void reply(Connection &connection, const JobResult &result);
+};
+
+#endif //JOBSERVER_H
@@ -0,0 +1,169 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "loadgen.h"
+#include "protocol.h"
+#include "../assembler.h"
+#include "../baby.h"
+#include "../bench/workload.h"
+
+// A program sent by the load generator, with the accumulator it must end with
+struct LoadProgram {
+    std::vector<std::string> source;
+    std::vector<std::string> image;
+    long long accumulator;
+};
+
+// Totals of one client
+struct ClientTotals {
+    std::vector<long long> latenciesUs;
+    long long serverQueuedUs{0};
+    long long serverRunUs{0};
+    int failures{0};
+};
+
+// Split text into lines
+static std::vector<std::string> splitLines(const std::string &text) {
+    std::vector<std::string> lines;
+    std::istringstream input(text);
+    std::string line;
+    while (getline(input, line)) {
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+// Counting loops of random lengths, run here once for their expected results
+static std::vector<LoadProgram> makePrograms(const LoadOptions &options) {
+    std::mt19937 random(options.seed);
+    std::vector<LoadProgram> programs;
+    for (int i = 0; i < 16; ++i) {
+        WorkloadParams params;
+        params.iterations = 1 + (int) (random() % (unsigned) std::max(options.iterations, 1));
+        params.step = 1 + (int) (random() % 7);
+        LoadProgram program;
+        program.source = splitLines(generateWorkload(params));
+        std::istringstream source(generateWorkload(params));
+        std::vector<std::string> log;
+        program.image = Assembler::processAssembleCode(SymbolTable(), source, log);
+        std::string machineCode;
+        for (const auto &line: program.image) {
+            machineCode += line + "\n";
+        }
+        std::istringstream image(machineCode);
+        ManchesterBaby baby(image);
+        baby.run(1 << 30);
+        program.accumulator = (int32_t) ManchesterBaby::convertInstruction(baby.accumulator);
+        programs.push_back(program);
+    }
+    return programs;
+}
+
+// One client: send jobs in batches and time each until its result comes back
+static void runClient(const LoadOptions &options, const std::vector<LoadProgram> &programs, int client,
+                      ClientTotals &totals) {
+    using Clock = std::chrono::steady_clock;
+    int fd = connectTo(options.socketPath);
+    if (fd < 0) {
+        std::cerr << "Error: can't connect to " << options.socketPath << std::endl;
+        totals.failures = options.jobs;
+        return;
+    }
+    std::mt19937 random(options.seed + (unsigned) client);
+    LineReader reader(fd);
+    std::map<std::string, std::pair<Clock::time_point, const LoadProgram *>> pending;
+    for (int sent = 0; sent < options.jobs;) {
+        std::string batch;
+        for (int i = 0; i < options.batch && sent < options.jobs; ++i, ++sent) {
+            const LoadProgram &program = programs[random() % programs.size()];
+            Job job;
+            job.id = std::to_string(client) + "." + std::to_string(sent);
+            job.priority = (int) (random() % 3);
+            job.source = sent % 2 == 0;
+            job.program = job.source ? program.source : program.image;
+            batch += formatJob(job);
+            pending[job.id] = {Clock::now(), &program};
+        }
+        if (!writeAll(fd, batch)) {
+            break;
+        }
+        std::string line;
+        while (!pending.empty() && reader.next(line)) {
+            const Clock::time_point received = Clock::now();
+            JobResult result;
+            auto job = parseResult(line, result) ? pending.find(result.id) : pending.end();
+            if (job == pending.end()) {
+                continue;
+            }
+            totals.latenciesUs.push_back(
+                    std::chrono::duration_cast<std::chrono::microseconds>(received - job->second.first).count());
+            totals.serverQueuedUs += result.queuedUs;
+            totals.serverRunUs += result.runUs;
+            if (result.status != "halted" || result.accumulator != job->second.second->accumulator) {
+                if (totals.failures++ == 0) {
+                    std::cerr << "Unexpected result: " << line << std::endl;
+                }
+            }
+            pending.erase(job);
+        }
+        if (!pending.empty()) {
+            std::cerr << "Error: the server closed the connection" << std::endl;
+            totals.failures += (int) pending.size() + options.jobs - sent;
+            break;
+        }
+    }
+    close(fd);
+}
+
+// Send counting loops from several clients at once and print the latency percentiles.
+int runLoad(const LoadOptions &options) {
+    const std::vector<LoadProgram> programs = makePrograms(options);
+    std::vector<ClientTotals> totals((size_t) options.clients);
+    std::vector<std::thread> clients;
+    const auto start = std::chrono::steady_clock::now();
+    for (int client = 0; client < options.clients; ++client) {
+        clients.emplace_back(runClient, std::cref(options), std::cref(programs), client, std::ref(totals[client]));
+    }
+    for (auto &client: clients) {
+        client.join();
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<long long> latencies;
+    long long queuedUs = 0;
+    long long runUs = 0;
+    int failures = 0;
+    for (const auto &client: totals) {
+        latencies.insert(latencies.end(), client.latenciesUs.begin(), client.latenciesUs.end());
+        queuedUs += client.serverQueuedUs;
+        runUs += client.serverRunUs;
+        failures += client.failures;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) {
+        return latencies.empty() ? 0 : latencies[std::min(latencies.size() - 1, (size_t) (p * latencies.size()))];
+    };
+    const size_t jobs = std::max<size_t>(latencies.size(), 1);
+
+    std::cerr << "jobs " << latencies.size() << ", failures " << failures << ", " << latencies.size() / seconds
+              << " jobs/s" << std::endl;
+    std::cerr << "latency us: p50 " << percentile(0.50) << ", p90 " << percentile(0.90) << ", p99 "
+              << percentile(0.99) << ", max " << (latencies.empty() ? 0 : latencies.back()) << std::endl;
+    std::cerr << "server us per job: queued " << queuedUs / (long long) jobs << ", run " << runUs / (long long) jobs
+              << std::endl;
+    std::cout << "{\"clients\": " << options.clients << ", \"batch\": " << options.batch << ", \"jobs\": "
+              << latencies.size() << ", \"failures\": " << failures << ", \"jobs_per_s\": "
+              << latencies.size() / seconds << ", \"p50_us\": " << percentile(0.50) << ", \"p90_us\": "
+              << percentile(0.90) << ", \"p99_us\": " << percentile(0.99) << ", \"max_us\": "
+              << (latencies.empty() ? 0 : latencies.back()) << "}" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
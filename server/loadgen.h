@@ -0,0 +1,21 @@
+#ifndef LOADGEN_H
+#define LOADGEN_H
+
+#include <string>
+
+// Parameters of a load run against a job server
+struct LoadOptions {
+    std::string socketPath;
+    int clients{4};         // Concurrent connections
+    int jobs{1000};         // Jobs per client
+    int batch{16};          // Jobs sent at once before waiting for their results
+    int iterations{1000};   // Largest trip count of the counting loops sent
+    unsigned seed{1};
+};
+
+// Send counting loops from several clients at once, as source and as machine code with mixed priorities, and print
+// the latency from sending a job to receiving its result: p50, p90, p99 and the maximum, as a table on stderr and as
+// JSON on stdout. Returns 0 if every job halted as expected.
+int runLoad(const LoadOptions &options);
+
+#endif //LOADGEN_H
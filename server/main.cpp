@@ -0,0 +1,132 @@
+#include <csignal>
+#include <memory>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "jobserver.h"
+#include "loadgen.h"
+
+/* Job server for the simulator, and a load generator for it.
+ *
+ * Usage:
+ *   babyd --serve SOCKET [--workers N] [--max-steps N] [--max-timeout MS] [--max-lines N] [--max-queued N]
+ *         [--run-cache FILE] [--run-cache-mb N] [--bound-steps on]
+ *   babyd --load SOCKET [--clients N] [--jobs N] [--batch N] [--iterations N] [--seed N]
+ *
+ * --serve listens on a Unix domain socket for jobs (see protocol.h) and runs them on --workers warm engines until
+ * SIGINT or SIGTERM. With --run-cache, results are memoised in FILE (see runcache.h), shared with any other server
+ * using it: a job whose program, patches and step budget were run before is answered without running. With
+ * --bound-steps on, each program is analysed first (see stepbound.h): one that can never halt is refused with an
+ * error, and one that must halt gets no more steps than its worst case. --load connects --clients clients to a
+ * server, each sending --jobs counting loops in batches of --batch, and prints the latency percentiles (see
+ * loadgen.h).
+ */
+
+// Run a server until SIGINT or SIGTERM
+static int serve(const std::string &socketPath, const ServerLimits &limits, const std::string &runCachePath,
+                 uint64_t runCacheBytes) {
+    // The signals are taken by a thread of their own, so that stop() runs outside a signal handler
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+    JobServer server(socketPath, limits);
+    std::unique_ptr<RunCache> runCache;
+    if (!runCachePath.empty()) {
+        try {
+            runCache.reset(new RunCache(runCachePath, runCacheBytes));
+        } catch (const std::runtime_error &) {
+            return 1;
+        }
+        server.setRunCache(runCache.get());
+    }
+    std::thread([&server, signals]() {
+        int signal;
+        sigwait(&signals, &signal);
+        server.stop();
+    }).detach();
+    try {
+        server.serve();
+    } catch (const std::runtime_error &) {
+        return 1;
+    }
+    if (runCache) {
+        const RunCache::Statistics statistics = runCache->statistics();
+        std::cerr << "Run cache: " << statistics.hits << " hits, " << statistics.misses << " misses, "
+                  << statistics.stores << " stored, " << statistics.evictions << " evicted, " << statistics.slots
+                  << " slots of " << statistics.storeWords << " words" << std::endl;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    std::string mode;
+    std::string socketPath;
+    ServerLimits limits;
+    LoadOptions load;
+    std::string runCachePath;
+    uint64_t runCacheBytes = 64 << 20;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string option = argv[i];
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for " << option << std::endl;
+                return 1;
+            }
+            std::string value = argv[++i];
+            if (option == "--serve" || option == "--load") {
+                mode = option;
+                socketPath = value;
+            } else if (option == "--workers") {
+                limits.workers = std::stoi(value);
+            } else if (option == "--max-steps") {
+                limits.maxSteps = std::stoll(value);
+            } else if (option == "--max-timeout") {
+                limits.maxTimeoutMs = std::stoll(value);
+            } else if (option == "--max-lines") {
+                limits.maxProgramLines = std::stoul(value);
+            } else if (option == "--max-queued") {
+                limits.maxQueuedPerClient = std::stoul(value);
+            } else if (option == "--run-cache") {
+                runCachePath = value;
+            } else if (option == "--run-cache-mb") {
+                runCacheBytes = std::stoull(value) << 20;
+            } else if (option == "--bound-steps") {
+                limits.boundSteps = value == "on";
+            } else if (option == "--clients") {
+                load.clients = std::stoi(value);
+            } else if (option == "--jobs") {
+                load.jobs = std::stoi(value);
+            } else if (option == "--batch") {
+                load.batch = std::stoi(value);
+            } else if (option == "--iterations") {
+                load.iterations = std::stoi(value);
+            } else if (option == "--seed") {
+                load.seed = (unsigned) std::stoul(value);
+            } else {
+                std::cerr << "Unknown option: " << option << std::endl;
+                return 1;
+            }
+        }
+    } catch (const std::logic_error &) {
+        std::cerr << "Invalid number in the options" << std::endl;
+        return 1;
+    }
+
+    if (limits.workers < 1 || load.clients < 1 || load.batch < 1 || load.jobs < 0) {
+        std::cerr << "--workers, --clients and --batch must be at least 1" << std::endl;
+        return 1;
+    }
+
+    if (mode == "--serve") {
+        return serve(socketPath, limits, runCachePath, runCacheBytes);
+    } else if (mode == "--load") {
+        load.socketPath = socketPath;
+        return runLoad(load);
+    }
+    std::cerr << "Usage: babyd --serve SOCKET [options] | babyd --load SOCKET [options]" << std::endl;
+    return 1;
+}
@@ -0,0 +1,206 @@
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "protocol.h"
+
+// Largest program a job may carry, in lines; the server can set a lower limit
+const size_t MAX_PROGRAM_LINES = 8192;
+
+void JobParser::fail(const std::string &message) {
+    state = State::Header;
+    skipping = true;
+    throw std::invalid_argument(message);
+}
+
+bool JobParser::feed(const std::string &line, Job &job) {
+    std::istringstream words(line);
+    std::string keyword;
+    switch (state) {
+        case State::Header: {
+            words >> keyword;
+            if (keyword.empty()) {
+                return false;   // Blank lines between jobs
+            }
+            if (keyword != "JOB" && skipping) {
+                return false;   // The rest of a job already reported as malformed
+            }
+            skipping = false;
+            current = Job();
+            if (keyword != "JOB" || !(words >> current.id)) {
+                fail("expected JOB <id>");
+            }
+            std::string option;
+            while (words >> option) {
+                size_t equals = option.find('=');
+                std::string name = option.substr(0, equals);
+                bool valid = equals != std::string::npos;
+                long long value = 0;
+                if (valid) {
+                    try {
+                        value = std::stoll(option.substr(equals + 1));
+                    } catch (const std::logic_error &) {
+                        valid = false;
+                    }
+                }
+                if (valid && name == "priority") {
+                    current.priority = (int) value;
+                } else if (valid && name == "steps" && value > 0) {
+                    current.steps = value;
+                } else if (valid && name == "timeout" && value > 0) {
+                    current.timeoutMs = value;
+                } else {
+                    fail("bad option " + option);
+                }
+            }
+            state = State::Program;
+            return false;
+        }
+        case State::Program: {
+            long long count = -1;
+            words >> keyword >> count;
+            if ((keyword != "SOURCE" && keyword != "IMAGE") || count < 0 || count > (long long) MAX_PROGRAM_LINES) {
+                fail("expected SOURCE <lines> or IMAGE <lines>");
+            }
+            current.source = keyword == "SOURCE";
+            lines = (size_t) count;
+            current.program.reserve(lines);
+            state = lines > 0 ? State::Lines : State::Patches;
+            return false;
+        }
+        case State::Lines:
+            current.program.push_back(line);
+            if (current.program.size() == lines) {
+                state = State::Patches;
+            }
+            return false;
+        case State::Patches: {
+            words >> keyword;
+            if (keyword == "RUN") {
+                state = State::Header;
+                job = std::move(current);
+                return true;
+            }
+            unsigned long address;
+            long long value;
+            if (keyword != "PATCH" || !(words >> address >> value)) {
+                fail("expected PATCH <address> <value> or RUN");
+            }
+            current.patches.emplace_back(address, value);
+            return false;
+        }
+    }
+    return false;
+}
+
+// Text of a job, as JobParser reads it
+std::string formatJob(const Job &job) {
+    std::string text = "JOB " + job.id + " priority=" + std::to_string(job.priority) + " steps=" +
+                       std::to_string(job.steps);
+    if (job.timeoutMs > 0) {
+        text += " timeout=" + std::to_string(job.timeoutMs);
+    }
+    text += (job.source ? "\nSOURCE " : "\nIMAGE ") + std::to_string(job.program.size()) + "\n";
+    for (const auto &line: job.program) {
+        text += line + "\n";
+    }
+    for (const auto &patch: job.patches) {
+        text += "PATCH " + std::to_string(patch.first) + " " + std::to_string(patch.second) + "\n";
+    }
+    return text + "RUN\n";
+}
+
+// Text of a result, RESULT or ERROR line
+std::string formatResult(const JobResult &result) {
+    if (result.status.empty()) {
+        return "ERROR " + result.id + " " + result.error + "\n";
+    }
+    std::string text = "RESULT " + result.id + " " + result.status + " " + std::to_string(result.steps) + " " +
+                       std::to_string(result.cycles) + " " + std::to_string(result.accumulator) + " " +
+                       std::to_string(result.ci) + " " + std::to_string(result.queuedUs) + " " +
+                       std::to_string(result.runUs);
+    for (long long word: result.store) {
+        text += " " + std::to_string(word);
+    }
+    return text + "\n";
+}
+
+// Read a RESULT or ERROR line. Returns false if it is neither.
+bool parseResult(const std::string &line, JobResult &result) {
+    std::istringstream words(line);
+    std::string keyword;
+    result = JobResult();
+    words >> keyword >> result.id;
+    if (keyword == "ERROR") {
+        getline(words >> std::ws, result.error);
+        return !result.id.empty();
+    }
+    if (keyword != "RESULT" || !(words >> result.status >> result.steps >> result.cycles >> result.accumulator >>
+                                 result.ci >> result.queuedUs >> result.runUs)) {
+        return false;
+    }
+    long long word;
+    while (words >> word) {
+        result.store.push_back(word);
+    }
+    return true;
+}
+
+// Next line, without its end of line. Returns false at the end of the stream or on an error.
+bool LineReader::next(std::string &line) {
+    while (true) {
+        size_t end = buffer.find('\n', start);
+        if (end != std::string::npos) {
+            line.assign(buffer, start, end - start);
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            start = end + 1;
+            return true;
+        }
+        buffer.erase(0, start);
+        start = 0;
+        char chunk[65536];
+        ssize_t received = read(fd, chunk, sizeof chunk);
+        if (received <= 0) {
+            return false;
+        }
+        buffer.append(chunk, (size_t) received);
+    }
+}
+
+// Write all of text to a socket. Returns false if the peer is gone.
+bool writeAll(int fd, const std::string &text) {
+    size_t written = 0;
+    while (written < text.size()) {
+        ssize_t sent = send(fd, text.data() + written, text.size() - written, MSG_NOSIGNAL);
+        if (sent <= 0) {
+            return false;
+        }
+        written += (size_t) sent;
+    }
+    return true;
+}
+
+// Connect to the server's socket. Returns -1 on failure.
+int connectTo(const std::string &path) {
+    sockaddr_un address{};
+    if (path.size() >= sizeof address.sun_path) {
+        return -1;
+    }
+    address.sun_family = AF_UNIX;
+    std::strcpy(address.sun_path, path.c_str());
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (connect(fd, (sockaddr *) &address, sizeof address) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
@@ -0,0 +1,104 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+/* Wire format of the job server: lines of text over a Unix domain socket.
+ *
+ * A client sends any number of jobs without waiting for results (a batch), each as
+ *     JOB <id> [priority=N] [steps=N] [timeout=MS]
+ *     SOURCE <lines> | IMAGE <lines>      - the program, as assembly source or as 32-digit machine code lines
+ *     <the program's lines>
+ *     PATCH <address> <value>             - optional and repeatable: a store word overwritten after loading
+ *     RUN
+ * and the server streams back one line per job, in the order the jobs finish:
+ *     RESULT <id> <status> <steps> <cycles> <accumulator> <ci> <queued us> <run us> <store words...>
+ *     ERROR <id> <message>
+ * Status is halted, illegal (an unknown opcode halted the machine), budget (the step budget ran out) or timeout.
+ * Values are signed decimal. Higher priorities run first, jobs of equal priority in the order they arrived.
+ */
+
+// A job, as sent by a client
+struct Job {
+    std::string id;
+    int priority{0};
+    long long steps{1000000};       // Step budget
+    long long timeoutMs{0};         // Wall-clock limit, 0 for the server's
+    bool source{true};              // Whether the program is assembly source or machine code
+    std::vector<std::string> program;
+    std::vector<std::pair<unsigned long, long long>> patches;
+};
+
+// Outcome of a job, as sent back by the server
+struct JobResult {
+    std::string id;
+    std::string status;             // halted, illegal, budget or timeout; empty for an error
+    std::string error;
+    long long steps{0};
+    unsigned long long cycles{0};
+    long long accumulator{0};
+    int ci{0};
+    long long queuedUs{0};          // Time between arrival and the start of the run
+    long long runUs{0};             // Time to load and run
+    std::vector<long long> store;
+};
+
+// Reads jobs line by line. feed() returns true when a line completes a job, and throws std::invalid_argument on a
+// malformed line; the rest of that job is then skipped, up to the next JOB line.
+class JobParser {
+public:
+    bool feed(const std::string &line, Job &job);
+
+    // Id of the job being read, for error replies
+    [[nodiscard]] const std::string &currentId() const {
+        return current.id;
+    }
+
+private:
+    enum class State {
+        Header,
+        Program,
+        Lines,
+        Patches
+    };
+
+    State state{State::Header};
+    bool skipping{false};
+    size_t lines{0};
+    Job current;
+
+    void fail(const std::string &message);
+};
+
+// Text of a job, as JobParser reads it
+std::string formatJob(const Job &job);
+
+// Text of a result, RESULT or ERROR line
+std::string formatResult(const JobResult &result);
+
+// Read a RESULT or ERROR line. Returns false if it is neither.
+bool parseResult(const std::string &line, JobResult &result);
+
+// Reads lines from a socket
+class LineReader {
+public:
+    explicit LineReader(int fd) : fd(fd) {}
+
+    // Next line, without its end of line. Returns false at the end of the stream or on an error.
+    bool next(std::string &line);
+
+private:
+    int fd;
+    std::string buffer;
+    size_t start{0};
+};
+
+// Write all of text to a socket. Returns false if the peer is gone.
+bool writeAll(int fd, const std::string &text);
+
+// Connect to the server's socket. Returns -1 on failure.
+int connectTo(const std::string &path);
+
+#endif //PROTOCOL_H
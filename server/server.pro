@@ -0,0 +1,50 @@
+# Job server for the simulator: qmake server.pro && make && ./babyd --serve /tmp/baby.sock
+
+TARGET = babyd
+TEMPLATE = app
+CONFIG += console c++17 release thread
+CONFIG -= qt app_bundle
+
+INCLUDEPATH += ..
+
+SOURCES += \
+        main.cpp \
+        protocol.cpp \
+        jobserver.cpp \
+        loadgen.cpp \
+        ../bench/workload.cpp \
+        ../baby.cpp \
+        ../shadow.cpp \
+        ../runcache.cpp \
+        ../assembler.cpp \
+        ../loopaccel.cpp \
+        ../fusion.cpp \
+        ../analysis.cpp \
+        ../stepbound.cpp \
+        ../clock.cpp \
+        ../events.cpp \
+        ../devices.cpp \
+        ../peephole.cpp
+
+HEADERS += \
+        protocol.h \
+        jobserver.h \
+        loadgen.h \
+        ../bench/workload.h \
+        ../baby.h \
+        ../shadow.h \
+        ../runcache.h \
+        ../assembler.h \
+        ../probes.h \
+        ../loopaccel.h \
+        ../fusion.h \
+        ../analysis.h \
+        ../stepbound.h \
+        ../clock.h \
+        ../events.h \
+        ../devices.h \
+        ../peephole.h \
+        ../isa.h \
+        ../memtrace.h \
+        ../word.h \
+        ../widebaby.h
@@ -0,0 +1,100 @@
+#include <algorithm>
+#include <sstream>
+#include <utility>
+
+#include "shadow.h"
+#include "analysis.h"
+
+ShadowMemory::ShadowMemory(SourceMap sourceMap) : sourceMap(std::move(sourceMap)) {}
+
+// Start again on a store just loaded with a program
+void ShadowMemory::load(const std::vector<std::bitset<SIZE_32_BIT>> &memory, size_t loadedWords) {
+    loaded.assign(memory.size(), false);
+    std::fill(loaded.begin(), loaded.begin() + (long) std::min(loadedWords, memory.size()), true);
+    initialised = loaded;
+    code.assign(memory.size(), false);
+    if (!sourceMap.empty()) {
+        for (size_t address = 0; address < sourceMap.size() && address < code.size(); ++address) {
+            code[address] = !sourceMap[address].data;
+        }
+    } else {
+        ImageAnalysis analysis(memory);
+        for (size_t address = 0; address < code.size(); ++address) {
+            code[address] = analysis.isCode(address);
+        }
+    }
+    // The padding word at address 0 of most programs is a VAR, but every run starts there
+    if (!code.empty()) {
+        code[0] = true;
+    }
+    found.clear();
+}
+
+// Back to the words as loaded
+void ShadowMemory::restart() {
+    initialised = loaded;
+}
+
+// Note a finding, or count it again
+void ShadowMemory::record(Kind kind, int address, long long target, int round) {
+    for (Finding &finding: found) {
+        if (finding.kind == kind && finding.address == address && finding.target == target) {
+            finding.count++;
+            return;
+        }
+    }
+    found.push_back({kind, address, target, round, 1});
+}
+
+const std::vector<ShadowMemory::Finding> &ShadowMemory::findings() const {
+    return found;
+}
+
+// "address N (line L: TEXT)"
+std::string ShadowMemory::where(long long address) const {
+    std::string text = "address " + std::to_string(address);
+    if (address >= 0 && address < (long long) sourceMap.size()) {
+        // The line without its comment, one space between words
+        std::string line = sourceMap[address].text;
+        const size_t comment = line.find(';');
+        if (comment != std::string::npos) {
+            line.erase(comment);
+        }
+        std::string words;
+        std::istringstream input(line);
+        std::string word;
+        while (input >> word) {
+            words += (words.empty() ? "" : " ") + word;
+        }
+        text += " (line " + std::to_string(sourceMap[address].line) + ": " + words + ")";
+    }
+    return text;
+}
+
+// One line per finding
+std::vector<std::string> ShadowMemory::report() const {
+    std::vector<std::string> lines;
+    for (const Finding &finding: found) {
+        std::string line = "Round " + std::to_string(finding.round) + ", ";
+        switch (finding.kind) {
+            case Kind::UninitialisedRead:
+                line += where(finding.address) + " reads " + where(finding.target) + ", which was never written";
+                break;
+            case Kind::JumpIntoData:
+                line += where(finding.address) + " goes on to " + where(finding.target) + ", which is data";
+                break;
+            case Kind::SelfOverwrite:
+                line += where(finding.address) + " overwrites its own instruction";
+                break;
+            case Kind::WildAddress:
+                line += where(finding.address) + " reaches address " + std::to_string(finding.target) +
+                        ", outside the store";
+                break;
+        }
+        if (finding.count > 1) {
+            line += " (" + std::to_string(finding.count) + " times)";
+        }
+        lines.push_back(line);
+    }
+    return lines;
+}
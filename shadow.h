@@ -0,0 +1,83 @@
+#ifndef SHADOW_H
+#define SHADOW_H
+
+#include <bitset>
+#include <string>
+#include <vector>
+
+#include "assembler.h"
+#include "baby.h"
+
+// Shadow memory for checked runs (ManchesterBaby::setShadow): a bit per store word saying whether it holds a value,
+// and a bit per word saying whether it is code.
+//
+// The store is zero-filled once and reused: reset() leaves what the last run wrote, and words past the program keep
+// whatever an earlier program left there. A checked run reports:
+//     uninitialised read  - an operand read from a word neither loaded with the program nor written since
+//     jump into data      - an instruction fetched from a word that isn't code: a VAR of the source, or, without a
+//                           source map, a word the load-time analysis (analysis.h) can't reach
+//     self-overwrite      - STO, XCH or XAD writing the word of the instruction itself
+//     wild address        - an operand past the store with no device there, or a CI outside it; the machine halts
+//                           instead of running the instruction
+// Address 0, where every run starts, is always code. Each finding is kept once per kind and address, with a count.
+class ShadowMemory {
+public:
+    enum class Kind {
+        UninitialisedRead,
+        JumpIntoData,
+        SelfOverwrite,
+        WildAddress
+    };
+
+    struct Finding {
+        Kind kind;
+        int address;            // CI of the instruction, or for a jump into data the address it came from
+        long long target;       // The word read, written or fetched, or the wild address
+        int round;              // curRound when first seen
+        long long count;
+    };
+
+    // A source map from the assembler (Assembler::processAssembleCode) tells code from data and names the lines
+    explicit ShadowMemory(SourceMap sourceMap = {});
+
+    // Start again on a store just loaded with a program of loadedWords words: those words hold values and the
+    // rest don't. Forgets the findings.
+    void load(const std::vector<std::bitset<SIZE_32_BIT>> &memory, size_t loadedWords);
+
+    // Back to the words as loaded, for a new run on the same store. Keeps the findings.
+    void restart();
+
+    [[nodiscard]] bool isInitialised(unsigned long address) const {
+        return address < initialised.size() && initialised[address];
+    }
+
+    [[nodiscard]] bool isCode(unsigned long address) const {
+        return address < code.size() && code[address];
+    }
+
+    void markWritten(unsigned long address) {
+        if (address < initialised.size()) {
+            initialised[address] = true;
+        }
+    }
+
+    // Note a finding, or count it again
+    void record(Kind kind, int address, long long target, int round);
+
+    [[nodiscard]] const std::vector<Finding> &findings() const;
+
+    // One line per finding, with the source line of the instruction when there is a source map
+    [[nodiscard]] std::vector<std::string> report() const;
+
+private:
+    SourceMap sourceMap;
+    std::vector<bool> loaded;
+    std::vector<bool> initialised;
+    std::vector<bool> code;
+    std::vector<Finding> found;
+
+    // "address N (line L: TEXT)"
+    [[nodiscard]] std::string where(long long address) const;
+};
+
+#endif //SHADOW_H
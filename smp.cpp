@@ -0,0 +1,203 @@
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#include "smp.h"
+
+// Model of a name
+MemoryModel parseMemoryModel(const std::string &name) {
+    if (name == "sc") {
+        return MemoryModel::SequentiallyConsistent;
+    } else if (name == "release-acquire") {
+        return MemoryModel::ReleaseAcquire;
+    } else if (name == "relaxed") {
+        return MemoryModel::Relaxed;
+    } else if (name == "tso") {
+        return MemoryModel::StoreBuffered;
+    }
+    throw std::invalid_argument("unknown memory model '" + name + "'");
+}
+
+SharedStore::SharedStore(MemoryModel model) : cells(new std::atomic<uint32_t>[words]), memoryModel(model) {
+    for (uint64_t i = 0; i < words; ++i) {
+        cells[i].store(0, std::memory_order_relaxed);
+    }
+    switch (model) {
+        case MemoryModel::SequentiallyConsistent:
+            loadOrder = std::memory_order_seq_cst;
+            storeOrder = std::memory_order_seq_cst;
+            exchangeOrder = std::memory_order_seq_cst;
+            break;
+        case MemoryModel::ReleaseAcquire:
+            loadOrder = std::memory_order_acquire;
+            storeOrder = std::memory_order_release;
+            exchangeOrder = std::memory_order_acq_rel;
+            break;
+        case MemoryModel::Relaxed:
+            loadOrder = std::memory_order_relaxed;
+            storeOrder = std::memory_order_relaxed;
+            exchangeOrder = std::memory_order_relaxed;
+            break;
+        case MemoryModel::StoreBuffered:
+            // Drains happen in program order and XCH and XAD are full fences, as on a TSO machine
+            loadOrder = std::memory_order_acquire;
+            storeOrder = std::memory_order_release;
+            exchangeOrder = std::memory_order_seq_cst;
+            break;
+    }
+}
+
+MemoryModel SharedStore::model() const {
+    return memoryModel;
+}
+
+// Attach to the store, buffering up to depth stores if its model is StoreBuffered
+void SharedStoreView::attach(SharedStore *store, int depth) {
+    shared = store;
+    pending = 0;
+    buffer.assign(store->model() == MemoryModel::StoreBuffered ? (size_t) std::max(depth, 1) : 0, {});
+}
+
+// Make every buffered store visible to the other cores
+void SharedStoreView::drain() {
+    for (size_t i = 0; i < pending; ++i) {
+        shared->store(buffer[i].address, buffer[i].value);
+    }
+    pending = 0;
+}
+
+void SharedStoreView::drainOldest() {
+    shared->store(buffer[0].address, buffer[0].value);
+    for (size_t i = 1; i < pending; ++i) {
+        buffer[i - 1] = buffer[i];
+    }
+    pending--;
+}
+
+SmpMachine::SmpMachine(const SmpOptions &options) : options(options), store(options.model) {
+    if (options.cores < 1 || options.quantum < 1) {
+        throw std::invalid_argument("an SMP machine needs at least one core and a quantum of at least 1");
+    }
+    for (int i = 0; i < options.cores; ++i) {
+        cores.push_back(std::make_unique<CoreSlot>());
+        cores.back()->core.store.attach(&store, options.storeBuffer);
+    }
+}
+
+// Load machine code from address 0
+void SmpMachine::loadProgram(std::istream &input) {
+    SmpCore &loader = cores[0]->core;
+    loader.loadProgram(input);
+    loader.store.drain();
+}
+
+// Value of a word of the shared store
+uint32_t SmpMachine::read(uint64_t address) const {
+    return store.load(address);
+}
+
+// Run up to steps instructions of a core and note how it stands
+bool SmpMachine::runSlice(int core, long long steps, CoreResult &result) {
+    SmpCore &baby = cores[core]->core;
+    bool failed = false;
+    try {
+        baby.run(std::min(steps, options.maxSteps - baby.round));
+    } catch (const std::runtime_error &e) {
+        result.error = e.what();
+        failed = true;
+    }
+    // Whatever happens, this core's stores become visible before another core takes its turn
+    baby.store.drain();
+    result.steps = baby.round;
+    result.halted = baby.isHalted();
+    result.illegalOpcode = baby.haltedOnIllegalOpcode();
+    result.accumulator = baby.accumulator;
+    result.ci = baby.ci;
+    return failed || baby.isHalted() || baby.round >= options.maxSteps;
+}
+
+// Deterministic run: each thread waits for its core's turn
+void SmpMachine::runRoundRobin(std::vector<CoreResult> &results) {
+    std::mutex lock;
+    std::condition_variable turnPassed;
+    int turn = 0;
+    int running = options.cores;
+    std::vector<bool> finished((size_t) options.cores, false);
+    auto work = [&](int core) {
+        std::unique_lock<std::mutex> guard(lock);
+        while (true) {
+            turnPassed.wait(guard, [&]() { return turn == core || running == 0; });
+            if (running == 0) {
+                return;
+            }
+            // The baton is held, so the core can run without the lock
+            guard.unlock();
+            bool done = runSlice(core, options.quantum, results[core]);
+            guard.lock();
+            if (done) {
+                finished[core] = true;
+                running--;
+            }
+            // Pass to the next core still running
+            for (int i = 1; running > 0 && i <= options.cores; ++i) {
+                if (!finished[(core + i) % options.cores]) {
+                    turn = (core + i) % options.cores;
+                    break;
+                }
+            }
+            turnPassed.notify_all();
+            if (done) {
+                return;
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int i = 1; i < options.cores; ++i) {
+        threads.emplace_back(work, i);
+    }
+    work(0);
+    for (auto &thread: threads) {
+        thread.join();
+    }
+}
+
+// Free run: every thread runs its core flat out
+void SmpMachine::runFree(std::vector<CoreResult> &results) {
+    auto work = [&](int core) {
+        while (!runSlice(core, options.quantum, results[core])) {
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int i = 1; i < options.cores; ++i) {
+        threads.emplace_back(work, i);
+    }
+    work(0);
+    for (auto &thread: threads) {
+        thread.join();
+    }
+}
+
+// Run every core from CI 0 until it halts or has run maxSteps instructions
+SmpResult SmpMachine::run() {
+    for (int i = 0; i < options.cores; ++i) {
+        SmpCore &baby = cores[i]->core;
+        baby.reset();
+        baby.accumulator = (uint32_t) i;
+    }
+    SmpResult result;
+    result.cores.resize((size_t) options.cores);
+    const auto start = std::chrono::steady_clock::now();
+    if (options.deterministic) {
+        runRoundRobin(result.cores);
+    } else {
+        runFree(result.cores);
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    for (const CoreResult &core: result.cores) {
+        result.totalSteps += core.steps;
+    }
+    return result;
+}
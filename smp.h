@@ -0,0 +1,195 @@
+#ifndef SMP_H
+#define SMP_H
+
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "widebaby.h"
+
+// Shared-memory multiprocessing: several Baby cores, each on a host thread of its own, running one program over one
+// store.
+//
+// A core is a BasicBaby (widebaby.h) whose store is a view of a SharedStore: all 8192 addressable words as atomics,
+// so no lock is ever taken on a memory access and XCH and XAD are single atomic read-modify-writes. Every core
+// starts at CI 0 with its number in the accumulator, which is how one program divides the work. Device ports are
+// plain words here.
+//
+// The memory model says how the accesses of different cores may be reordered:
+//     SequentiallyConsistent  - one global order of every access
+//     ReleaseAcquire          - stores release and loads acquire: a flag written after data publishes the data, but a
+//                               load may be ordered before an earlier store to another word (on weakly ordered hosts)
+//     Relaxed                 - only the order of each word's own accesses is kept
+//     StoreBuffered           - total store order, simulated: a core's stores wait in a FIFO buffer of its own, seen
+//                               at once by its own loads and by the other cores only when drained (when the buffer is
+//                               full, before XCH and XAD, at the end of a quantum and at the halt). Store-load
+//                               reordering then shows up on any host, and reproducibly in deterministic runs.
+// Deterministic runs pass a baton round-robin: core 0 runs a quantum of instructions, then core 1, and so on, so a
+// run repeats to the instruction. Free runs let every core run at once, for throughput.
+
+enum class MemoryModel {
+    SequentiallyConsistent,
+    ReleaseAcquire,
+    Relaxed,
+    StoreBuffered
+};
+
+// Model of a name: "sc", "release-acquire", "relaxed" or "tso". Throws std::invalid_argument for anything else.
+MemoryModel parseMemoryModel(const std::string &name);
+
+// The store of all cores
+class SharedStore {
+public:
+    static constexpr uint64_t words = Layout32::operandMask + 1;
+
+    explicit SharedStore(MemoryModel model);
+
+    [[nodiscard]] uint32_t load(uint64_t address) const {
+        return cells[address % words].load(loadOrder);
+    }
+
+    void store(uint64_t address, uint32_t value) {
+        cells[address % words].store(value, storeOrder);
+    }
+
+    uint32_t exchange(uint64_t address, uint32_t value) {
+        return cells[address % words].exchange(value, exchangeOrder);
+    }
+
+    uint32_t fetchAdd(uint64_t address, uint32_t value) {
+        return cells[address % words].fetch_add(value, exchangeOrder);
+    }
+
+    [[nodiscard]] MemoryModel model() const;
+
+private:
+    std::unique_ptr<std::atomic<uint32_t>[]> cells;
+    MemoryModel memoryModel;
+    std::memory_order loadOrder;
+    std::memory_order storeOrder;
+    std::memory_order exchangeOrder;
+};
+
+// One core's access to the shared store, with its store buffer (see widebaby.h for the interface)
+class SharedStoreView {
+public:
+    using Value = uint32_t;
+
+    static constexpr uint64_t defaultCodeWords = 32;
+
+    // Attach to the store, buffering up to depth stores if its model is StoreBuffered
+    void attach(SharedStore *store, int depth);
+
+    [[nodiscard]] Value read(uint64_t address) const {
+        // The newest buffered store to the address wins
+        for (size_t i = pending; i > 0; --i) {
+            if (buffer[i - 1].address == address) {
+                return buffer[i - 1].value;
+            }
+        }
+        return shared->load(address);
+    }
+
+    void write(uint64_t address, Value value) {
+        if (buffer.empty()) {
+            shared->store(address, value);
+            return;
+        }
+        if (pending == buffer.size()) {
+            drainOldest();
+        }
+        buffer[pending++] = {address, value};
+    }
+
+    Value exchange(uint64_t address, Value value) {
+        drain();
+        return shared->exchange(address, value);
+    }
+
+    Value fetchAdd(uint64_t address, Value value) {
+        drain();
+        return shared->fetchAdd(address, value);
+    }
+
+    // Make every buffered store visible to the other cores
+    void drain();
+
+private:
+    struct PendingStore {
+        uint64_t address;
+        Value value;
+    };
+
+    SharedStore *shared{nullptr};
+    std::vector<PendingStore> buffer;   // Empty unless the model is StoreBuffered
+    size_t pending{0};
+
+    void drainOldest();
+};
+
+using SmpCore = BasicBaby<Layout32, SharedStoreView>;
+
+struct SmpOptions {
+    int cores{2};
+    MemoryModel model{MemoryModel::SequentiallyConsistent};
+    bool deterministic{true};               // Round-robin in quanta, or every core at once
+    long long quantum{64};                  // Instructions per turn; free runs drain store buffers this often too
+    long long maxSteps{10000000};           // Per core
+    int storeBuffer{4};                     // Stores each core's buffer holds, with StoreBuffered
+};
+
+// How one core ended
+struct CoreResult {
+    long long steps{0};
+    bool halted{false};
+    bool illegalOpcode{false};
+    uint32_t accumulator{0};
+    uint64_t ci{0};
+    std::string error;                      // What the core threw, e.g. division by zero
+};
+
+struct SmpResult {
+    std::vector<CoreResult> cores;
+    long long totalSteps{0};
+    double seconds{0};
+};
+
+// A shared store and its cores
+class SmpMachine {
+public:
+    explicit SmpMachine(const SmpOptions &options);
+
+    // Load machine code, one line of 32 binary digits per word, from address 0. Throws std::runtime_error on a bad
+    // line.
+    void loadProgram(std::istream &input);
+
+    // Run every core from CI 0 until it halts or has run maxSteps instructions
+    SmpResult run();
+
+    // Value of a word of the shared store
+    [[nodiscard]] uint32_t read(uint64_t address) const;
+
+private:
+    // A core on cache lines of its own, so that cores running at once don't slow each other down
+    struct alignas(64) CoreSlot {
+        SmpCore core;
+    };
+
+    SmpOptions options;
+    SharedStore store;
+    std::vector<std::unique_ptr<CoreSlot>> cores;
+
+    // Run up to steps instructions of a core and note how it stands. Returns whether it is finished.
+    bool runSlice(int core, long long steps, CoreResult &result);
+
+    // Deterministic run: each thread waits for its core's turn
+    void runRoundRobin(std::vector<CoreResult> &results);
+
+    // Free run: every thread runs its core flat out
+    void runFree(std::vector<CoreResult> &results);
+};
+
+#endif //SMP_H
@@ -0,0 +1,136 @@
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../assembler.h"
+#include "../baby.h"
+#include "../smp.h"
+
+/* Runs one program on several Baby cores sharing a store (see smp.h).
+ *
+ * Usage:
+ *   babysmp FILE [--cores N] [--model sc|release-acquire|relaxed|tso] [--free] [--quantum N] [--max-steps N]
+ *           [--store-buffer N] [--show ADDRESS,...]
+ *
+ * FILE is assembly source, or machine code if every line is 32 binary digits. Every core starts at CI 0 with its
+ * number in the accumulator. Runs are deterministic (round-robin, --quantum instructions per turn) unless --free lets
+ * the cores run at once. Prints how each core ended, the throughput, and the words at the --show addresses.
+ */
+
+// Whether text is machine code rather than assembly source
+static bool isMachineCode(const std::string &text) {
+    std::istringstream input(text);
+    std::string line;
+    bool any = false;
+    while (getline(input, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.size() != (size_t) SIZE_32_BIT || line.find_first_not_of("01") != std::string::npos) {
+            return false;
+        }
+        any = true;
+    }
+    return any;
+}
+
+int main(int argc, char *argv[]) {
+    std::string file;
+    std::vector<unsigned long> shown;
+    SmpOptions options;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string option = argv[i];
+            if (option == "--free") {
+                options.deterministic = false;
+                continue;
+            } else if (option.rfind("--", 0) != 0) {
+                file = option;
+                continue;
+            }
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for " << option << std::endl;
+                return 1;
+            }
+            std::string value = argv[++i];
+            if (option == "--cores") {
+                options.cores = std::stoi(value);
+            } else if (option == "--model") {
+                options.model = parseMemoryModel(value);
+            } else if (option == "--quantum") {
+                options.quantum = std::stoll(value);
+            } else if (option == "--max-steps") {
+                options.maxSteps = std::stoll(value);
+            } else if (option == "--store-buffer") {
+                options.storeBuffer = std::stoi(value);
+            } else if (option == "--show") {
+                std::istringstream list(value);
+                std::string address;
+                while (getline(list, address, ',')) {
+                    shown.push_back(std::stoul(address));
+                }
+            } else {
+                std::cerr << "Unknown option: " << option << std::endl;
+                return 1;
+            }
+        }
+    } catch (const std::invalid_argument &e) {
+        std::cerr << "Invalid option value: " << e.what() << std::endl;
+        return 1;
+    } catch (const std::out_of_range &) {
+        std::cerr << "Number out of range in the options" << std::endl;
+        return 1;
+    }
+    if (file.empty() || options.cores < 1 || options.quantum < 1) {
+        std::cerr << "Usage: babysmp FILE [--cores N] [--model MODEL] [--free] [--quantum N] [options]" << std::endl;
+        return 1;
+    }
+
+    std::ifstream input(file);
+    if (!input) {
+        std::cerr << "Cannot open " << file << std::endl;
+        return 1;
+    }
+    std::stringstream text;
+    text << input.rdbuf();
+    std::string machineCode = text.str();
+    if (!isMachineCode(machineCode)) {
+        std::vector<std::string> log;
+        std::istringstream source(text.str());
+        try {
+            machineCode.clear();
+            for (const std::string &line: Assembler::processAssembleCode(SymbolTable(), source, log)) {
+                machineCode += line + "\n";
+            }
+        } catch (const std::invalid_argument &e) {
+            Assembler::logError(e, log);
+            for (const std::string &line: log) {
+                std::cerr << line << std::endl;
+            }
+            return 1;
+        }
+    }
+
+    SmpMachine machine(options);
+    std::istringstream image(machineCode);
+    machine.loadProgram(image);
+    SmpResult result = machine.run();
+    for (size_t i = 0; i < result.cores.size(); ++i) {
+        const CoreResult &core = result.cores[i];
+        std::cout << "core " << i << ": " << core.steps << " steps, "
+                  << (!core.error.empty() ? core.error : core.illegalOpcode ? "illegal opcode" :
+                                                         core.halted ? "halted" : "out of steps")
+                  << ", A = " << (int32_t) core.accumulator << ", CI = " << core.ci << std::endl;
+    }
+    std::cout << result.totalSteps << " steps in " << std::fixed << std::setprecision(3) << result.seconds << " s ("
+              << std::setprecision(1) << (double) result.totalSteps / std::max(result.seconds, 1e-9) / 1e6
+              << " million per second)" << std::endl;
+    for (unsigned long address: shown) {
+        std::cout << "[" << address << "] = " << (int32_t) machine.read(address) << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,32 @@
+#include <iomanip>
+
+#include "startup.h"
+#include "probes.h"
+
+StartupProfile::StartupProfile() : start(std::chrono::steady_clock::now()) {}
+
+// Function to note that a step of the start has been reached
+void StartupProfile::mark(const std::string &phase, const std::string &detail) {
+    const double milliseconds =
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    BABY_PROBE2(baby, startup, phase.c_str(), (unsigned long long) (milliseconds * 1000));
+    std::lock_guard<std::mutex> guard(lock);
+    noted.push_back({phase, milliseconds, detail});
+}
+
+std::vector<StartupProfile::Mark> StartupProfile::marks() const {
+    std::lock_guard<std::mutex> guard(lock);
+    return noted;
+}
+
+// Function to print every mark, with the time since the one before
+void StartupProfile::report(std::ostream &out) const {
+    double previous = 0;
+    out << "Startup profile (ms since main, ms for the step):" << std::endl;
+    for (const Mark &mark: marks()) {
+        out << "  " << std::left << std::setw(20) << mark.phase << std::right << std::fixed << std::setprecision(2)
+            << std::setw(10) << mark.milliseconds << std::setw(10) << mark.milliseconds - previous
+            << (mark.detail.empty() ? "" : "  " + mark.detail) << std::endl;
+        previous = mark.milliseconds;
+    }
+}
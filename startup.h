@@ -0,0 +1,40 @@
+#ifndef STARTUP_H
+#define STARTUP_H
+
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Startup-time instrumentation.
+//
+// The program marks the steps of its start (assembly or the cache lookup, the window, the first frame, the program
+// being ready); each mark is the time since the profile was created, at the top of main(). Marks fire the
+// startup(phase, microseconds) tracepoint (see probes.h), so cold starts can be followed with the usual tools, and
+// can be printed as a table with --startup-profile. Marks may come from any thread.
+class StartupProfile {
+public:
+    struct Mark {
+        std::string phase;
+        double milliseconds;        // Since the profile was created
+        std::string detail;         // Optional, e.g. "cache hit"
+    };
+
+    StartupProfile();
+
+    // Function to note that a step of the start has been reached
+    void mark(const std::string &phase, const std::string &detail = "");
+
+    [[nodiscard]] std::vector<Mark> marks() const;
+
+    // Function to print every mark, with the time since the one before
+    void report(std::ostream &out) const;
+
+private:
+    std::chrono::steady_clock::time_point start;
+    mutable std::mutex lock;
+    std::vector<Mark> noted;
+};
+
+#endif //STARTUP_H
@@ -0,0 +1,796 @@
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <stdexcept>
+
+#include "stepbound.h"
+#include "analysis.h"
+
+namespace {
+
+// A value, if the analysis knows it
+struct Known {
+    bool known;
+    uint32_t value;
+};
+
+const Known UNKNOWN{false, 0};
+
+// What the analysis knows of the machine when an instruction is reached
+struct State {
+    std::map<unsigned long, Known> cells;   // Cells whose value may differ from the image's
+    Known accumulator{true, 0};
+};
+
+// Stand-in for the accumulator where expressions name a value by its location
+const unsigned long ACCUMULATOR = ~0UL;
+
+// A value in a trip of a loop, in terms of the values at the start of the trip: k, or coefficient * var + k, with
+// 32-bit wrap-around as on the machine
+struct Expression {
+    enum Kind {
+        Constant,
+        Linear,
+        Unknown
+    } kind;
+    unsigned long var;
+    uint32_t coefficient;
+    uint32_t k;
+
+    static Expression constant(uint32_t value) {
+        return {Constant, 0, 0, value};
+    }
+
+    static Expression unknown() {
+        return {Unknown, 0, 0, 0};
+    }
+
+    static Expression of(const Known &value) {
+        return value.known ? constant(value.value) : unknown();
+    }
+
+    bool operator==(const Expression &other) const {
+        return kind == other.kind && (kind == Unknown || (var == other.var && coefficient == other.coefficient &&
+                                                          k == other.k)) && (kind != Constant || k == other.k);
+    }
+
+    Expression operator-() const {
+        return {kind, var, (uint32_t) -coefficient, (uint32_t) -k};
+    }
+
+    Expression operator+(const Expression &other) const {
+        if (kind == Unknown || other.kind == Unknown) {
+            return unknown();
+        }
+        if (kind == Constant || other.kind == Constant) {
+            const Expression &linear = kind == Constant ? other : *this;
+            return {linear.kind, linear.var, linear.coefficient, k + other.k};
+        }
+        if (var != other.var) {
+            return unknown();
+        }
+        const uint32_t sum = coefficient + other.coefficient;
+        return sum == 0 ? constant(k + other.k) : Expression{Linear, var, sum, k + other.k};
+    }
+};
+
+// Value of a stored word (see isa.h)
+uint32_t valueOf(const std::bitset<SIZE_32_BIT> &word) {
+    return reverseWord((uint32_t) word.to_ulong());
+}
+
+// Whether a CMP skips the next instruction with this accumulator
+bool skips(uint32_t accumulator) {
+    return (int32_t) accumulator < 0;
+}
+
+// Result of an instruction other than a load, store, add or subtract, on known values, as the engine computes it.
+// Returns false if the machine would stop instead (division by zero).
+bool compute(int opcode, uint32_t accumulator, uint32_t operand, uint32_t &result) {
+    try {
+        result = INSTRUCTIONS[opcode].compute(accumulator, operand);
+    } catch (const std::runtime_error &) {
+        return false;
+    }
+    return true;
+}
+
+static_assert(INSTRUCTIONS.size() == 19,
+              "Walker::execute() and Walker::walkTrip() have a case for every instruction of isa.h: add the new one");
+
+// The analysis proper: a walk of the strongly connected components of the control-flow graph in topological order
+class Walker {
+public:
+    explicit Walker(const std::vector<std::bitset<SIZE_32_BIT>> &image) : image(image) {}
+
+    bool bounded{true};
+    bool halts{false};
+    long long worst{0};
+    std::string why;
+    std::string endless;    // A reached loop that is never left, if any
+    std::vector<StepBoundAnalysis::Loop> loops;
+
+    void run();
+
+private:
+    struct Arrival {
+        bool reached{false};
+        long long steps{0};     // Most steps run before the instruction
+        State state;
+    };
+
+    // A CMP that can leave a loop, as met on one way round it
+    struct Exit {
+        int address;
+        int position;           // In the trip
+        int target;             // Where it goes
+        Expression tested;
+        bool onNegative;        // Whether the loop is left when the accumulator is negative
+        std::map<unsigned long, Expression> cells;
+        Expression accumulator;
+    };
+
+    // One way round a loop: its exits, and what the cells and the accumulator are at the end
+    struct Trip {
+        std::vector<Exit> exits;
+        std::map<unsigned long, Expression> cells;
+        Expression accumulator;
+        bool mayStop{false};    // Whether a division on the way can be by zero, which stops the machine
+    };
+
+    // A value that changes by delta on every trip
+    struct Induction {
+        Known start;
+        uint32_t delta;
+    };
+
+    static const size_t MAX_WAYS = 256;
+    static const long long NEVER = -1;
+    static const long long UNTOLD = -2;
+
+    const std::vector<std::bitset<SIZE_32_BIT>> &image;
+    std::vector<std::vector<int>> next;     // Successors of each address
+    std::vector<int> component;             // Strongly connected component of each address
+    std::vector<Arrival> arrivals;
+
+    [[nodiscard]] Known read(const State &state, unsigned long address) const;
+
+    void join(Arrival &into, long long steps, const State &state) const;
+
+    [[nodiscard]] std::vector<int> successors(int address) const;
+
+    // Run one instruction on a state; returns false if it halts the machine for certain
+    bool execute(int address, State &state) const;
+
+    void arrive(int address, long long steps, const State &state);
+
+    void visitLoop(const std::vector<int> &members, int entry);
+
+    [[nodiscard]] Trip walkTrip(const std::vector<int> &way, std::map<unsigned long, Expression> cells,
+                                const State &entry, const std::function<bool(int)> &inLoop) const;
+
+    [[nodiscard]] Known evaluateAt(const Expression &expression, long long tripNumber,
+                                   const std::map<unsigned long, Induction> &inductions, const State &entry) const;
+
+    long long firstFiring(const Exit &exit, const std::map<unsigned long, Induction> &inductions,
+                          const State &entry, bool &wraps) const;
+
+    void fail(const std::string &reason);
+};
+
+Known Walker::read(const State &state, unsigned long address) const {
+    // Cells past the image can be device ports, or a store the loader never filled
+    if (address >= image.size()) {
+        return UNKNOWN;
+    }
+    auto cell = state.cells.find(address);
+    return cell != state.cells.end() ? cell->second : Known{true, valueOf(image[address])};
+}
+
+// Merge a path into what is known on arrival at an instruction: the most steps, and the values all paths agree on
+void Walker::join(Arrival &into, long long steps, const State &state) const {
+    if (!into.reached) {
+        into = {true, steps, state};
+        return;
+    }
+    into.steps = std::max(into.steps, steps);
+    std::map<unsigned long, Known> merged;
+    auto mergeCell = [&](unsigned long address) {
+        Known a = read(into.state, address);
+        Known b = read(state, address);
+        merged[address] = a.known && b.known && a.value == b.value ? a : UNKNOWN;
+    };
+    for (const auto &cell: into.state.cells) {
+        mergeCell(cell.first);
+    }
+    for (const auto &cell: state.cells) {
+        mergeCell(cell.first);
+    }
+    into.state.cells = merged;
+    const Known &a = into.state.accumulator;
+    const Known &b = state.accumulator;
+    into.state.accumulator = a.known && b.known && a.value == b.value ? a : UNKNOWN;
+}
+
+// Successors of the instruction at address, as ImageAnalysis finds them
+std::vector<int> Walker::successors(int address) const {
+    ManchesterBaby::Instruction ins = ManchesterBaby::decodeInstruction(image[address]);
+    switch (ins.opcode) {
+        case JMP:
+        case JRP: {
+            // Reachable jumps always have a target in the store (ImageAnalysis checks), other cells may not
+            if (!ins.immediate && ins.operand >= image.size()) {
+                return {};
+            }
+            int value = ins.immediate ? (int) ins.operand : (int) valueOf(image[ins.operand]);
+            int target = ((ins.opcode == JRP ? address : 0) + value + 1) % SIZE_32_BIT;
+            return target >= 0 ? std::vector<int>{target} : std::vector<int>{};
+        }
+        case CMP:
+            return {(address + 1) % SIZE_32_BIT, (address + 2) % SIZE_32_BIT};
+        case STP:
+            return {};
+        default:
+            if (ins.opcode > XAD) {
+                return {};
+            }
+            return {(address + 1) % SIZE_32_BIT};
+    }
+}
+
+// Run one instruction on a state
+bool Walker::execute(int address, State &state) const {
+    ManchesterBaby::Instruction ins = ManchesterBaby::decodeInstruction(image[address]);
+    const Known operand = takesImmediate(ins.opcode) && ins.immediate ? Known{true, (uint32_t) ins.operand}
+                                                                       : read(state, ins.operand);
+    Known &a = state.accumulator;
+    switch (ins.opcode) {
+        case LDN:
+            a = operand.known ? Known{true, (uint32_t) -operand.value} : UNKNOWN;
+            break;
+        case LDP:
+            a = operand;
+            break;
+        case ADD:
+        case SUB:
+            a = a.known && operand.known ? Known{true, ins.opcode == ADD ? a.value + operand.value
+                                                                          : a.value - operand.value} : UNKNOWN;
+            break;
+        case STO:
+            state.cells[ins.operand] = a;
+            break;
+        case XCH:
+        case XAD: {
+            const Known old = read(state, ins.operand);
+            state.cells[ins.operand] = ins.opcode == XCH ? a : a.known && old.known ?
+                                                               Known{true, a.value + old.value} : UNKNOWN;
+            a = old;
+            break;
+        }
+        case DIV:
+        case MOD:
+        case LAN:
+        case LOR:
+        case LNT:
+        case SHL:
+        case SHR: {
+            const bool unary = ins.opcode >= LNT;
+            uint32_t result = 0;
+            if (a.known && (unary || operand.known)) {
+                if (!compute(ins.opcode, a.value, operand.value, result)) {
+                    return false;
+                }
+                a = {true, result};
+            } else {
+                a = UNKNOWN;
+            }
+            break;
+        }
+        default:
+            break;
+    }
+    return true;
+}
+
+void Walker::fail(const std::string &reason) {
+    if (bounded) {
+        bounded = false;
+        why = reason;
+    }
+}
+
+// A path arrives at an instruction
+void Walker::arrive(int address, long long steps, const State &state) {
+    join(arrivals[address], steps, state);
+}
+
+void Walker::run() {
+    next.resize(SIZE_32_BIT);
+    for (int address = 0; address < SIZE_32_BIT; ++address) {
+        next[address] = successors(address);
+    }
+
+    // Tarjan's algorithm numbers the components in reverse topological order
+    component.assign(SIZE_32_BIT, -1);
+    std::vector<int> index(SIZE_32_BIT, -1);
+    std::vector<int> low(SIZE_32_BIT, 0);
+    std::vector<bool> onStack(SIZE_32_BIT, false);
+    std::vector<int> stack;
+    std::vector<std::vector<int>> components;
+    int counter = 0;
+    std::function<void(int)> connect = [&](int v) {
+        index[v] = low[v] = counter++;
+        stack.push_back(v);
+        onStack[v] = true;
+        for (int w: next[v]) {
+            if (index[w] < 0) {
+                connect(w);
+                low[v] = std::min(low[v], low[w]);
+            } else if (onStack[w]) {
+                low[v] = std::min(low[v], index[w]);
+            }
+        }
+        if (low[v] == index[v]) {
+            components.emplace_back();
+            int w;
+            do {
+                w = stack.back();
+                stack.pop_back();
+                onStack[w] = false;
+                component[w] = (int) components.size() - 1;
+                components.back().push_back(w);
+            } while (w != v);
+        }
+    };
+    connect(0);
+
+    arrivals.assign(SIZE_32_BIT, Arrival());
+    arrive(0, 0, State());
+    for (auto members = components.rbegin(); members != components.rend() && bounded; ++members) {
+        const int address = members->front();
+        const bool cyclic = members->size() > 1 ||
+                            std::find(next[address].begin(), next[address].end(), address) != next[address].end();
+        if (cyclic) {
+            for (int entry: *members) {
+                if (arrivals[entry].reached && bounded) {
+                    visitLoop(*members, entry);
+                }
+            }
+            continue;
+        }
+        Arrival &arrival = arrivals[address];
+        if (!arrival.reached) {
+            continue;
+        }
+        State state = arrival.state;
+        const long long steps = arrival.steps + 1;
+        if (!execute(address, state) || next[address].empty()) {
+            halts = true;
+            worst = std::max(worst, steps);
+            continue;
+        }
+        // The machine stops on a division by zero whenever the divisor isn't known to be something else
+        ManchesterBaby::Instruction ins = ManchesterBaby::decodeInstruction(image[address]);
+        if ((ins.opcode == DIV || ins.opcode == MOD) && !state.accumulator.known) {
+            halts = true;
+            worst = std::max(worst, steps);
+        }
+        if (ins.opcode == CMP && state.accumulator.known) {
+            arrive(next[address][skips(state.accumulator.value) ? 1 : 0], steps, state);
+        } else {
+            for (int target: next[address]) {
+                arrive(target, steps, state);
+            }
+        }
+    }
+}
+
+// Bound a loop entered at entry, and pass its exits on
+void Walker::visitLoop(const std::vector<int> &members, int entry) {
+    auto inLoop = [&](int address) {
+        return component[address] == component[entry];
+    };
+    const std::string loopName = "the loop at address " + std::to_string(entry);
+
+    // Every way round the loop, from the entry back to it. A way that comes back to anything else is an inner loop.
+    std::vector<std::vector<int>> ways;
+    std::vector<int> way;
+    std::vector<bool> onWay(SIZE_32_BIT, false);
+    bool nested = false;
+    std::function<void(int)> follow = [&](int address) {
+        way.push_back(address);
+        onWay[address] = true;
+        for (int target: next[address]) {
+            if (nested || ways.size() > MAX_WAYS || !inLoop(target)) {
+                continue;
+            }
+            if (target == entry) {
+                ways.push_back(way);
+            } else if (onWay[target]) {
+                nested = true;
+            } else {
+                follow(target);
+            }
+        }
+        onWay[address] = false;
+        way.pop_back();
+    };
+    follow(entry);
+    if (nested) {
+        fail(loopName + " has a loop inside it (nested loops are not bounded)");
+        return;
+    } else if (ways.size() > MAX_WAYS) {
+        fail(loopName + " has more than " + std::to_string(MAX_WAYS) + " ways round it");
+        return;
+    }
+
+    // Cells the loop writes: within a trip their values are expressions in their values at the start of the trip
+    const Arrival &arrival = arrivals[entry];
+    std::map<unsigned long, Expression> start;
+    for (int address: members) {
+        ManchesterBaby::Instruction ins = ManchesterBaby::decodeInstruction(image[address]);
+        if (ins.opcode == STO || ins.opcode == XCH || ins.opcode == XAD) {
+            start[ins.operand] = ins.operand < image.size() ? Expression{Expression::Linear, ins.operand, 1, 0}
+                                                            : Expression::unknown();
+        }
+    }
+    std::vector<Trip> trips;
+    size_t longest = 0;
+    for (const std::vector<int> &trip: ways) {
+        trips.push_back(walkTrip(trip, start, arrival.state, inLoop));
+        longest = std::max(longest, trip.size());
+    }
+
+    // Induction values: those that end every trip as themselves plus the same constant
+    std::map<unsigned long, Induction> inductions;
+    auto addInduction = [&](unsigned long var, const Known &entryValue) {
+        uint32_t delta = 0;
+        for (size_t i = 0; i < trips.size(); ++i) {
+            const Expression &end = var == ACCUMULATOR ? trips[i].accumulator : trips[i].cells.at(var);
+            if (end.kind != Expression::Linear || end.var != var || end.coefficient != 1 ||
+                (i > 0 && end.k != delta)) {
+                return;
+            }
+            delta = end.k;
+        }
+        inductions[var] = {entryValue, delta};
+    };
+    for (const auto &cell: start) {
+        addInduction(cell.first, read(arrival.state, cell.first));
+    }
+    addInduction(ACCUMULATOR, arrival.state.accumulator);
+    auto evaluate = [&](const Expression &expression, long long tripNumber) {
+        return evaluateAt(expression, tripNumber, inductions, arrival.state);
+    };
+
+    // The guard: an exit every way round passes, testing the same value, that fires on a trip worked out in closed
+    // form. The earliest such exit bounds the loop.
+    struct Guard {
+        int address;
+        long long trip;
+        bool wraps;
+        const Expression *tested;
+    };
+    // A CMP every way round passes, testing a different value on different ways, still bounds the loop if each of them
+    // fires on the first trip: the values on entry are the same whichever way is taken.
+    Guard guard{-1, -1, false, nullptr};
+    for (const Exit &exit: trips.front().exits) {
+        bool everyWay = true;
+        bool sameTest = true;
+        bool firstTrip = true;
+        for (const Trip &trip: trips) {
+            auto same = std::find_if(trip.exits.begin(), trip.exits.end(), [&exit](const Exit &other) {
+                return other.address == exit.address;
+            });
+            everyWay = everyWay && same != trip.exits.end();
+            if (same != trip.exits.end()) {
+                bool wraps = false;
+                sameTest = sameTest && same->tested == exit.tested;
+                firstTrip = firstTrip && firstFiring(*same, inductions, arrival.state, wraps) == 0;
+            }
+        }
+        bool wraps = false;
+        long long tripNumber = UNTOLD;
+        if (everyWay && sameTest) {
+            tripNumber = firstFiring(exit, inductions, arrival.state, wraps);
+        } else if (everyWay && firstTrip) {
+            tripNumber = 0;
+        }
+        if (tripNumber >= 0 && (guard.tested == nullptr || tripNumber < guard.trip)) {
+            guard = {exit.address, tripNumber, wraps, &exit.tested};
+        }
+    }
+    if (guard.tested == nullptr) {
+        // The loop is never left if none of its exits can fire, whichever way round it goes
+        for (const Trip &trip: trips) {
+            for (const Exit &exit: trip.exits) {
+                bool wraps = false;
+                if (firstFiring(exit, inductions, arrival.state, wraps) != NEVER) {
+                    fail(loopName + " has no exit testing a constant, or an induction cell with a known start");
+                    return;
+                }
+            }
+        }
+        if (std::any_of(trips.begin(), trips.end(), [](const Trip &trip) { return trip.mayStop; })) {
+            fail(loopName + " can only be left by a division by zero, on a trip that can't be told");
+        } else if (endless.empty()) {
+            endless = loopName;
+        }
+        return;
+    }
+
+    // Steps up to and including the guard on the trip it fires, the longest way round
+    long long guardSteps = 0;
+    for (const Trip &trip: trips) {
+        for (const Exit &exit: trip.exits) {
+            if (exit.address == guard.address) {
+                guardSteps = std::max(guardSteps, (long long) exit.position + 1);
+            }
+        }
+    }
+    const long long steps = guard.trip * (long long) longest + guardSteps;
+    // A division by zero stops the machine on the way, by the end of the guard's trip at the latest
+    if (std::any_of(trips.begin(), trips.end(), [](const Trip &trip) { return trip.mayStop; })) {
+        halts = true;
+        worst = std::max(worst, arrival.steps + (guard.trip + 1) * (long long) longest);
+    }
+    std::string counter = "a constant";
+    if (guard.tested->kind == Expression::Linear) {
+        counter = guard.tested->var == ACCUMULATOR ? "the accumulator" : "cell " + std::to_string(guard.tested->var);
+    }
+    loops.push_back({entry, (int) longest, guard.address, guard.trip, steps, counter, guard.wraps});
+
+    // The state on leaving by the guard: what the trip computed, where every way round agrees
+    State leaving = arrival.state;
+    const Exit *first = nullptr;
+    for (const Trip &trip: trips) {
+        for (const Exit &exit: trip.exits) {
+            if (exit.address != guard.address) {
+                continue;
+            }
+            if (first == nullptr) {
+                first = &exit;
+                for (const auto &cell: exit.cells) {
+                    leaving.cells[cell.first] = evaluate(cell.second, guard.trip);
+                }
+                leaving.accumulator = evaluate(exit.accumulator, guard.trip);
+                continue;
+            }
+            for (const auto &cell: exit.cells) {
+                if (!(cell.second == first->cells.at(cell.first))) {
+                    leaving.cells[cell.first] = UNKNOWN;
+                }
+            }
+            if (!(exit.accumulator == first->accumulator)) {
+                leaving.accumulator = UNKNOWN;
+            }
+        }
+    }
+    arrive(first->target, arrival.steps + steps, leaving);
+
+    // Any other exit may fire before the guard, though it can't be told when: at the latest on the same trip. One that
+    // is known not to fire by then is never taken.
+    State forgotten = arrival.state;
+    for (const auto &cell: start) {
+        forgotten.cells[cell.first] = UNKNOWN;
+    }
+    forgotten.accumulator = UNKNOWN;
+    for (const Trip &trip: trips) {
+        int guardPosition = 0;
+        for (const Exit &exit: trip.exits) {
+            guardPosition = exit.address == guard.address ? exit.position : guardPosition;
+        }
+        for (const Exit &exit: trip.exits) {
+            const long long lastTrip = exit.position < guardPosition ? guard.trip : guard.trip - 1;
+            bool wraps = false;
+            const long long firing = firstFiring(exit, inductions, arrival.state, wraps);
+            if (exit.address != guard.address && lastTrip >= 0 && firing != NEVER && firing <= lastTrip) {
+                arrive(exit.target, arrival.steps + lastTrip * (long long) longest + exit.position + 1, forgotten);
+            }
+        }
+    }
+}
+
+// One trip round a loop, following the given way
+Walker::Trip Walker::walkTrip(const std::vector<int> &way, std::map<unsigned long, Expression> cells,
+                              const State &entry, const std::function<bool(int)> &inLoop) const {
+    Trip trip;
+    Expression accumulator{Expression::Linear, ACCUMULATOR, 1, 0};
+    auto value = [&](const ManchesterBaby::Instruction &ins) {
+        if (takesImmediate(ins.opcode) && ins.immediate) {
+            return Expression::constant((uint32_t) ins.operand);
+        }
+        auto cell = cells.find(ins.operand);
+        return cell != cells.end() ? cell->second : Expression::of(read(entry, ins.operand));
+    };
+    for (size_t position = 0; position < way.size(); ++position) {
+        const int at = way[position];
+        ManchesterBaby::Instruction ins = ManchesterBaby::decodeInstruction(image[at]);
+        switch (ins.opcode) {
+            case LDN:
+                accumulator = -value(ins);
+                break;
+            case LDP:
+                accumulator = value(ins);
+                break;
+            case ADD:
+                accumulator = accumulator + value(ins);
+                break;
+            case SUB:
+                accumulator = accumulator + -value(ins);
+                break;
+            case STO:
+                cells[ins.operand] = ins.operand < image.size() ? accumulator : Expression::unknown();
+                break;
+            case XCH:
+            case XAD: {
+                const Expression old = value(ins);
+                const Expression stored = ins.opcode == XCH ? accumulator : accumulator + old;
+                cells[ins.operand] = ins.operand < image.size() ? stored : Expression::unknown();
+                accumulator = old;
+                break;
+            }
+            case CMP: {
+                // A way out of the loop, unless both sides stay in it
+                const int stay = way[(position + 1) % way.size()];
+                const int other = next[at][0] == stay ? next[at][1] : next[at][0];
+                if (!inLoop(other)) {
+                    trip.exits.push_back({at, (int) position, other, accumulator, next[at][1] == other, cells,
+                                          accumulator});
+                }
+                break;
+            }
+            case DIV:
+            case MOD:
+            case LAN:
+            case LOR:
+            case LNT:
+            case SHL:
+            case SHR: {
+                const Expression operand = value(ins);
+                uint32_t result = 0;
+                const bool unary = ins.opcode >= LNT;
+                if ((ins.opcode == DIV || ins.opcode == MOD) && (operand.kind != Expression::Constant || operand.k == 0)) {
+                    trip.mayStop = true;
+                }
+                accumulator = accumulator.kind == Expression::Constant &&
+                              (unary || operand.kind == Expression::Constant) &&
+                              compute(ins.opcode, accumulator.k, operand.k, result) ? Expression::constant(result)
+                                                                                      : Expression::unknown();
+                break;
+            }
+            default:
+                break;
+        }
+    }
+    trip.cells = cells;
+    trip.accumulator = accumulator;
+    return trip;
+}
+
+// Value of an expression on a given trip, from the values at the start of that trip
+Known Walker::evaluateAt(const Expression &expression, long long tripNumber,
+                         const std::map<unsigned long, Induction> &inductions, const State &entry) const {
+    if (expression.kind != Expression::Linear) {
+        return expression.kind == Expression::Constant ? Known{true, expression.k} : UNKNOWN;
+    }
+    Known start = UNKNOWN;
+    auto induction = inductions.find(expression.var);
+    if (induction != inductions.end()) {
+        if (induction->second.start.known) {
+            start = {true, induction->second.start.value + (uint32_t) tripNumber * induction->second.delta};
+        }
+    } else if (tripNumber == 0) {
+        start = expression.var == ACCUMULATOR ? entry.accumulator : read(entry, expression.var);
+    }
+    return start.known ? Known{true, expression.coefficient * start.value + expression.k} : UNKNOWN;
+}
+
+// The trip on which an exit first fires, NEVER, or UNTOLD if it can't be worked out
+long long Walker::firstFiring(const Exit &exit, const std::map<unsigned long, Induction> &inductions,
+                              const State &entry, bool &wraps) const {
+    const Known first = evaluateAt(exit.tested, 0, inductions, entry);
+    if (first.known && skips(first.value) == exit.onNegative) {
+        return 0;
+    }
+    if (exit.tested.kind == Expression::Constant) {
+        return NEVER;
+    }
+    auto induction = inductions.find(exit.tested.var);
+    if (!first.known || exit.tested.kind != Expression::Linear || induction == inductions.end()) {
+        return UNTOLD;
+    }
+    // The tested value on trip n is e + s * n, modulo 2^32
+    const long long twoTo31 = 1LL << 31;
+    const long long e = (int32_t) first.value;
+    const long long s = (int32_t) (exit.tested.coefficient * induction->second.delta);
+    if (s == 0) {
+        return NEVER;
+    }
+    if (exit.onNegative) {
+        // From e >= 0: down through zero, or up past 2^31 - 1, which wraps round to negative
+        wraps = s > 0;
+        return s < 0 ? e / -s + 1 : (twoTo31 - e + s - 1) / s;
+    }
+    // From e < 0: up through zero, or down past -2^31, which wraps round to positive
+    wraps = s < 0;
+    return s > 0 ? (-e + s - 1) / s : (e + twoTo31) / -s + 1;
+}
+
+}
+
+// Analyse an image, as loaded into the store
+StepBoundAnalysis::StepBoundAnalysis(const std::vector<std::bitset<SIZE_32_BIT>> &image) : image(image) {
+    if (this->image.size() < SIZE_32_BIT) {
+        this->image.resize(SIZE_32_BIT);
+    }
+    analyse();
+}
+
+void StepBoundAnalysis::analyse() {
+    // Code that can change, or jumps whose targets can, leave the graph unknown
+    ImageAnalysis analysis(image);
+    if (analysis.isSelfModifying() || analysis.isImprecise()) {
+        std::vector<std::string> warnings = analysis.report();
+        why = warnings.empty() ? "the program can modify its own code" : warnings.front().substr(9);
+        return;
+    }
+
+    Walker walker(image);
+    walker.run();
+    boundedLoops = walker.loops;
+    if (!walker.bounded) {
+        why = walker.why;
+    } else if (!walker.halts) {
+        infinite = true;
+        why = "no path reaches STP";
+    } else if (!walker.endless.empty()) {
+        why = walker.endless + " can be entered and never left";
+    } else {
+        bounded = true;
+        worst = walker.worst;
+    }
+}
+
+// Whether every run halts within worstCaseSteps()
+bool StepBoundAnalysis::isBounded() const {
+    return bounded;
+}
+
+// Steps of the longest run
+long long StepBoundAnalysis::worstCaseSteps() const {
+    return worst;
+}
+
+// Whether no run can ever halt
+bool StepBoundAnalysis::neverHalts() const {
+    return infinite;
+}
+
+// Why the program is unbounded
+const std::string &StepBoundAnalysis::reason() const {
+    return why;
+}
+
+const std::vector<StepBoundAnalysis::Loop> &StepBoundAnalysis::loops() const {
+    return boundedLoops;
+}
+
+// Human-readable summary
+std::vector<std::string> StepBoundAnalysis::report() const {
+    std::vector<std::string> lines;
+    for (const Loop &loop: boundedLoops) {
+        lines.push_back("Loop at address " + std::to_string(loop.head) + " (" + std::to_string(loop.length) +
+                        " instructions) leaves by the CMP at address " + std::to_string(loop.exit) + " after " +
+                        std::to_string(loop.trips) + " trips, counting on " + loop.counter +
+                        (loop.wraps ? " (only once it wraps around 32 bits)" : ""));
+    }
+    if (bounded) {
+        lines.push_back("Worst case: " + std::to_string(worst) + " steps");
+    } else if (infinite) {
+        lines.push_back("Never halts: " + why);
+    } else {
+        lines.push_back("Steps unbounded: " + why);
+    }
+    return lines;
+}
@@ -0,0 +1,66 @@
+#ifndef STEPBOUND_H
+#define STEPBOUND_H
+
+#include <bitset>
+#include <string>
+#include <vector>
+
+#include "baby.h"
+
+// Worst-case number of steps a program runs before it halts, found without running it.
+//
+// The control-flow graph is the one ImageAnalysis walks: the next address, both sides of a CMP, and JMP/JRP targets
+// read through their cells. Values are followed through the code where they are known, so a CMP on a known
+// accumulator has one side only. Cells past the image (device ports, or a store the image doesn't fill) are never
+// known. Each cycle of the graph is a loop, and a loop is bounded when a CMP on it tests an induction value: a cell,
+// or the accumulator, that changes by the same constant on every trip and whose value on entry is known. The trip on
+// which the exit fires then follows in closed form, 32-bit wrap-around included, and so does the state on exit.
+//
+// The result is unbounded, with the reason, for programs that modify their own code or jump through written cells,
+// for loops that branch inside (nested loops included), for loops whose exit tests anything else, and for programs
+// that can enter a loop no exit of which ever fires but may also halt. A division that can be by zero stops the
+// machine, wherever it is. A program none of whose paths can reach a halt never halts.
+class StepBoundAnalysis {
+public:
+    // A loop bounded on the way
+    struct Loop {
+        int head;                   // Where the loop is entered
+        int length;                 // Instructions in one trip
+        int exit;                   // The CMP it leaves by
+        long long trips;            // Whole trips run before the one it leaves on
+        long long steps;            // Steps from entering the loop to leaving it, the CMP included
+        std::string counter;        // What the CMP tests: "cell N" or "the accumulator"
+        bool wraps;                 // Whether the exit only fires after the counter wraps around 32 bits
+    };
+
+    explicit StepBoundAnalysis(const std::vector<std::bitset<SIZE_32_BIT>> &image);
+
+    // Whether every run halts within worstCaseSteps()
+    [[nodiscard]] bool isBounded() const;
+
+    // Steps of the longest run, STP included, as counted by ManchesterBaby::run(). Only meaningful if bounded.
+    [[nodiscard]] long long worstCaseSteps() const;
+
+    // Whether no run can ever halt
+    [[nodiscard]] bool neverHalts() const;
+
+    // Why the program is unbounded; empty if it is bounded
+    [[nodiscard]] const std::string &reason() const;
+
+    [[nodiscard]] const std::vector<Loop> &loops() const;
+
+    // Human-readable summary, one line per loop and one for the result
+    [[nodiscard]] std::vector<std::string> report() const;
+
+private:
+    std::vector<std::bitset<SIZE_32_BIT>> image;
+    std::vector<Loop> boundedLoops;
+    std::string why;
+    long long worst{0};
+    bool bounded{false};
+    bool infinite{false};
+
+    void analyse();
+};
+
+#endif //STEPBOUND_H
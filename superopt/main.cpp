@@ -0,0 +1,276 @@
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "search.h"
+#include "../assembler.h"
+
+/* Superoptimizer: searches for the shortest program that behaves like a reference program, or that matches a list of
+ * examples.
+ *
+ * Usage:
+ *   superopt --reference FILE --inputs CELLS --outputs CELLS [--tests N] [--range LO:HI] [options]
+ *   superopt --io FILE [--accumulator] [options]
+ *
+ * Options:
+ *   [--max-length N] [--temps N] [--constants N,N,...] [--classic] [--stochastic SECONDS] [--fastest] [--threads N]
+ *   [--seed N] [--max-steps N]
+ *
+ * CELLS are labels or addresses of the reference, separated by commas; "acc" as an output stands for the final
+ * accumulator. The reference is run on --tests inputs from --range, plus edge values, to make the examples. An --io
+ * file has one example per line: the input values, "->" and the output values (the last being the accumulator with
+ * --accumulator). Every program of up to --max-length instructions is tried, shortest first, on all threads, unless
+ * --stochastic asks for random walks for a number of seconds instead. --classic keeps to the seven SSEM instructions
+ * and direct operands. The winners are printed as assembly source, after being checked on the full simulator.
+ */
+
+// Split a list separated by commas
+static std::vector<std::string> splitList(const std::string &list) {
+    std::vector<std::string> items;
+    std::istringstream input(list);
+    std::string item;
+    while (getline(input, item, ',')) {
+        items.push_back(item);
+    }
+    return items;
+}
+
+// Address of a label or an address in the source, counting lines as the assembler's first pass does
+static unsigned long resolveCell(const std::string &source, const std::string &cell) {
+    if (!cell.empty() && cell.find_first_not_of("0123456789") == std::string::npos) {
+        return std::stoul(cell);
+    }
+    std::istringstream input(source);
+    std::string line;
+    unsigned long address = 0;
+    while (getline(input, line)) {
+        const size_t start = line.find_first_not_of(" \t\r");
+        if (start == std::string::npos || line[start] == ';') {
+            continue;
+        }
+        const std::string code = line.substr(start, line.find(';') - start);
+        const size_t colon = code.find(':');
+        if (colon != std::string::npos && code.substr(0, code.find_last_not_of(" \t", colon - 1) + 1) == cell) {
+            return address;
+        }
+        address++;
+    }
+    throw std::invalid_argument("no label " + cell + " in the reference");
+}
+
+// Check a candidate on the full simulator. Returns false if it differs from an example.
+static bool confirm(const Target &target, const SearchOptions &options, const Candidate &candidate) {
+    std::istringstream source(candidateSource(target, options, candidate));
+    std::vector<std::string> log;
+    std::vector<std::bitset<SIZE_32_BIT>> image;
+    for (const std::string &line: Assembler::processAssembleCode(SymbolTable(), source, log)) {
+        image.emplace_back(line);
+    }
+    std::istringstream noProgram;
+    ManchesterBaby baby(noProgram);
+    const size_t inputs = target.inputNames.size();
+    const size_t cells = target.outputNames.size();
+    for (const Example &example: target.examples) {
+        baby.memory.assign(SIZE_32_BIT, std::bitset<SIZE_32_BIT>());
+        baby.loadProgram(image);
+        baby.reset();
+        baby.setHalt(false);
+        for (size_t i = 0; i < inputs; ++i) {
+            baby.writeMemory(dataAddress(candidate, (int) i),
+                             std::bitset<SIZE_32_BIT>(reverseWord(example.inputs[i])));
+        }
+        baby.run(options.maxSteps);
+        if (!baby.isHalted()) {
+            return false;
+        }
+        for (size_t i = 0; i < cells; ++i) {
+            const auto &word = baby.memory[dataAddress(candidate, (int) (inputs + i))];
+            if (reverseWord((uint32_t) word.to_ulong()) != example.outputs[i]) {
+                return false;
+            }
+        }
+        if (target.accumulator && reverseWord((uint32_t) baby.accumulator.to_ulong()) != example.outputs[cells]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Print one winner
+static void report(const char *title, const Target &target, const SearchOptions &options,
+                   const Candidate &candidate) {
+    const double perExample = (double) candidate.steps / (double) target.examples.size();
+    std::cout << "; " << title << ": " << candidate.code.size() << " instructions, " << std::fixed
+              << std::setprecision(2) << perExample << " steps per example"
+              << (confirm(target, options, candidate) ? "" : " (DIFFERS ON THE SIMULATOR)") << "\n"
+              << candidateSource(target, options, candidate) << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+    std::string referenceFile;
+    std::string ioFile;
+    std::string inputList;
+    std::string outputList;
+    bool accumulator = false;
+    int tests = 64;
+    int32_t low = -1000;
+    int32_t high = 1000;
+    SearchOptions options;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string option = argv[i];
+            if (option == "--classic") {
+                options.classic = true;
+                continue;
+            } else if (option == "--fastest") {
+                options.fastest = true;
+                continue;
+            } else if (option == "--accumulator") {
+                accumulator = true;
+                continue;
+            }
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for " << option << std::endl;
+                return 1;
+            }
+            std::string value = argv[++i];
+            if (option == "--reference") {
+                referenceFile = value;
+            } else if (option == "--io") {
+                ioFile = value;
+            } else if (option == "--inputs") {
+                inputList = value;
+            } else if (option == "--outputs") {
+                outputList = value;
+            } else if (option == "--tests") {
+                tests = std::stoi(value);
+            } else if (option == "--range") {
+                const size_t colon = value.find(':', 1);
+                if (colon == std::string::npos) {
+                    std::cerr << "--range takes LO:HI" << std::endl;
+                    return 1;
+                }
+                low = std::stoi(value.substr(0, colon));
+                high = std::stoi(value.substr(colon + 1));
+            } else if (option == "--max-length") {
+                options.maxLength = std::stoi(value);
+            } else if (option == "--temps") {
+                options.temps = std::stoi(value);
+            } else if (option == "--constants") {
+                options.constants.clear();
+                for (const std::string &constant: splitList(value)) {
+                    options.constants.push_back((uint16_t) std::stoul(constant));
+                }
+            } else if (option == "--stochastic") {
+                options.seconds = std::stod(value);
+            } else if (option == "--threads") {
+                options.threads = std::stoi(value);
+            } else if (option == "--seed") {
+                options.seed = (unsigned) std::stoul(value);
+            } else if (option == "--max-steps") {
+                options.maxSteps = std::stoi(value);
+            } else {
+                std::cerr << "Unknown option: " << option << std::endl;
+                return 1;
+            }
+        }
+    } catch (const std::logic_error &) {
+        std::cerr << "Invalid number in the options" << std::endl;
+        return 1;
+    }
+    if (referenceFile.empty() == ioFile.empty()) {
+        std::cerr << "Usage: superopt --reference FILE --inputs CELLS --outputs CELLS [options] | "
+                     "superopt --io FILE [options]" << std::endl;
+        return 1;
+    }
+    if (options.maxLength < 1 || options.temps < 0 || options.maxSteps < 1 || tests < 1 || low > high) {
+        std::cerr << "--max-length, --max-steps and --tests must be at least 1, and LO at most HI" << std::endl;
+        return 1;
+    }
+
+    Target target;
+    try {
+        if (!referenceFile.empty()) {
+            std::ifstream file(referenceFile);
+            if (!file) {
+                std::cerr << "Cannot open " << referenceFile << std::endl;
+                return 1;
+            }
+            std::stringstream source;
+            source << file.rdbuf();
+            std::vector<unsigned long> inputs;
+            std::vector<unsigned long> outputs;
+            std::vector<std::string> inputNames = splitList(inputList);
+            std::vector<std::string> outputNames;
+            for (const std::string &cell: inputNames) {
+                inputs.push_back(resolveCell(source.str(), cell));
+            }
+            for (const std::string &cell: splitList(outputList)) {
+                if (cell == "acc") {
+                    accumulator = true;
+                } else {
+                    outputs.push_back(resolveCell(source.str(), cell));
+                    outputNames.push_back(cell);
+                }
+            }
+            if (outputs.empty() && !accumulator) {
+                std::cerr << "--outputs needs at least one cell or acc" << std::endl;
+                return 1;
+            }
+            target = targetFromReference(source.str(), inputs, outputs, accumulator, tests, low, high, options.seed,
+                                         options.maxSteps * 64);
+            // Keep the reference's names where they are labels
+            for (size_t i = 0; i < inputNames.size(); ++i) {
+                if (!isdigit((unsigned char) inputNames[i][0])) {
+                    target.inputNames[i] = inputNames[i];
+                }
+            }
+            for (size_t i = 0; i < outputNames.size(); ++i) {
+                if (!isdigit((unsigned char) outputNames[i][0])) {
+                    target.outputNames[i] = outputNames[i];
+                }
+            }
+        } else {
+            std::ifstream file(ioFile);
+            if (!file) {
+                std::cerr << "Cannot open " << ioFile << std::endl;
+                return 1;
+            }
+            target = targetFromExamples(file, accumulator);
+        }
+    } catch (const std::invalid_argument &e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    if (target.examples.empty()) {
+        std::cerr << "No examples: the reference didn't halt on any input" << std::endl;
+        return 1;
+    }
+
+    std::cout << "; " << target.examples.size() << " examples";
+    if (!referenceFile.empty()) {
+        std::cout << "; reference: " << target.referenceLength << " instructions, " << std::fixed
+                  << std::setprecision(2) << (double) target.referenceSteps / (double) target.examples.size()
+                  << " steps per example";
+    }
+    std::cout << std::endl;
+
+    SearchResult result = options.seconds > 0 ? stochasticSearch(target, options) : enumerate(target, options);
+    std::cerr << result.tested << " candidates in " << std::fixed << std::setprecision(2) << result.seconds
+              << " s on " << result.threads << " threads ("
+              << (double) result.tested / std::max(result.seconds, 1e-9) / result.threads / 1e6
+              << " million per second per thread)" << std::endl;
+    if (result.shortest.steps < 0) {
+        std::cout << "; nothing found up to " << options.maxLength << " instructions" << std::endl;
+        return 2;
+    }
+    report("shortest", target, options, result.shortest);
+    if (!(result.fastest.code == result.shortest.code)) {
+        report("fastest", target, options, result.fastest);
+    }
+    return 0;
+}
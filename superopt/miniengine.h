@@ -0,0 +1,107 @@
+#ifndef MINIENGINE_H
+#define MINIENGINE_H
+
+#include <cstdint>
+
+#include "../baby.h"
+
+// A stripped-down engine for testing candidate programs, many millions of times a second.
+//
+// Code is kept decoded and never changes: candidates only store to data cells, which must be inside the store, so
+// there is no self-modifying code to follow, and the store holds values rather than bit-reversed words. Nothing is
+// allocated. Instructions have the semantics of ManchesterBaby::stepAs(), including CI wrapping at 32, except that
+// running into the data, a negative CI and dividing by zero are faults.
+
+const int MINI_STORE_WORDS = SIZE_32_BIT;
+
+// A decoded instruction
+struct MiniInstruction {
+    uint8_t opcode;
+    bool immediate;
+    uint16_t operand;
+
+    bool operator==(const MiniInstruction &other) const {
+        return opcode == other.opcode && immediate == other.immediate && operand == other.operand;
+    }
+};
+
+enum class MiniOutcome {
+    Halted,
+    OutOfSteps,
+    Fault
+};
+
+static_assert(INSTRUCTIONS.size() == 19, "runMini has a case for every instruction of isa.h: add the new one");
+
+// Run code at addresses 0 to codeLength - 1 over store, from CI 0 and the given accumulator, for at most maxSteps
+// instructions. steps receives the number executed, STP included.
+inline MiniOutcome runMini(const MiniInstruction *code, int codeLength, uint32_t *store, uint32_t &acc, int maxSteps,
+                           int &steps) {
+    int ci = 0;
+    for (steps = 0; steps < maxSteps;) {
+        if (ci < 0 || ci >= codeLength) {
+            return MiniOutcome::Fault;
+        }
+        const MiniInstruction ins = code[ci];
+        const uint32_t source = ins.immediate ? ins.operand : store[ins.operand];
+        steps++;
+        switch (ins.opcode) {
+            case JMP:
+                ci = (int) source;
+                break;
+            case JRP:
+                ci += (int) source;
+                break;
+            case LDN:
+                acc = 0U - source;
+                break;
+            case STO:
+                store[ins.operand] = acc;
+                break;
+            case SUB:
+                acc -= source;
+                break;
+            case CMP:
+                if ((int32_t) acc < 0) {
+                    ci++;
+                }
+                break;
+            case STP:
+                return MiniOutcome::Halted;
+            case LDP:
+                acc = source;
+                break;
+            case ADD:
+                acc += source;
+                break;
+            case DIV:
+            case MOD:
+                if (source == 0) {
+                    return MiniOutcome::Fault;
+                }
+                acc = ins.opcode == DIV ? acc / source : acc % source;
+                break;
+            case LAN:
+                acc &= store[ins.operand];
+                break;
+            case LOR:
+                acc |= store[ins.operand];
+                break;
+            case LNT:
+                acc = ~acc;
+                break;
+            case SHL:   // The stored bits move up, so the value halves
+                acc >>= 1;
+                break;
+            case SHR:
+                acc <<= 1;
+                break;
+            default:
+                return MiniOutcome::Fault;
+        }
+        ci = (ci + 1) % MINI_STORE_WORDS;
+    }
+    return MiniOutcome::OutOfSteps;
+}
+
+#endif //MINIENGINE_H
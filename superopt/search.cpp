@@ -0,0 +1,479 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include "search.h"
+#include "../analysis.h"
+#include "../assembler.h"
+
+// Candidates are laid out as: VAR 0 at address 0, their instructions, STP, then the inputs, the outputs and the
+// scratch cells
+static int dataStart(int length) {
+    return length + 2;
+}
+
+int dataAddress(const Candidate &candidate, int cell) {
+    return dataStart((int) candidate.code.size()) + cell;
+}
+
+static int threadCount(const SearchOptions &options) {
+    return options.threads > 0 ? options.threads : (int) std::max(1U, std::thread::hardware_concurrency());
+}
+
+// Instructions a candidate of a given length is made of
+static std::vector<MiniInstruction> makeAlphabet(const Target &target, const SearchOptions &options, int length) {
+    std::vector<MiniInstruction> alphabet;
+    const int data = dataStart(length);
+    const int cells = (int) (target.inputNames.size() + target.outputNames.size()) + options.temps;
+    const std::vector<int> loads = options.classic ? std::vector<int>{LDN, SUB}
+                                                   : std::vector<int>{LDN, SUB, LDP, ADD, DIV, MOD, LAN, LOR};
+    for (int cell = data; cell < data + cells; ++cell) {
+        for (int opcode: loads) {
+            alphabet.push_back({(uint8_t) opcode, false, (uint16_t) cell});
+        }
+        alphabet.push_back({STO, false, (uint16_t) cell});
+    }
+    alphabet.push_back({CMP, false, 0});
+    alphabet.push_back({STP, false, 0});
+    if (options.classic) {
+        return alphabet;
+    }
+    for (uint16_t constant: options.constants) {
+        for (int opcode: {LDN, SUB, LDP, ADD, DIV, MOD}) {
+            // Adding, subtracting or dividing by 0 is never useful
+            if (constant != 0 || opcode == LDN || opcode == LDP) {
+                alphabet.push_back({(uint8_t) opcode, true, constant});
+            }
+        }
+    }
+    for (int opcode: {LNT, SHL, SHR}) {
+        alphabet.push_back({(uint8_t) opcode, false, 0});
+    }
+    // Jumps within the code: JMP #a continues at a + 1, JRP #k skips k instructions
+    for (int address = 0; address <= length; ++address) {
+        alphabet.push_back({JMP, true, (uint16_t) address});
+    }
+    for (int skip = 1; skip < length; ++skip) {
+        alphabet.push_back({JRP, true, (uint16_t) skip});
+    }
+    return alphabet;
+}
+
+// Runs candidates of one length on the examples. One per thread.
+class Evaluator {
+public:
+    Evaluator(const Target &target, const SearchOptions &options, int length)
+            : target(target), maxSteps(options.maxSteps), length(length) {
+        const int data = dataStart(length);
+        code[0] = {JMP, false, 0};          // VAR 0
+        code[length + 1] = {STP, false, 0};
+        for (const Example &example: target.examples) {
+            std::array<uint32_t, MINI_STORE_WORDS> store{};
+            std::copy(example.inputs.begin(), example.inputs.end(), store.begin() + data);
+            std::copy(target.initialOutputs.begin(), target.initialOutputs.end(),
+                      store.begin() + data + (long) example.inputs.size());
+            stores.push_back(store);
+            order.push_back(order.size());
+        }
+        outputStart = data + (int) target.inputNames.size();
+    }
+
+    // Steps over all examples if the candidate matches every one, or -1. The example that failed is tried first
+    // next time, as the next candidate is likely to fail it too.
+    long long test(const MiniInstruction *candidate) {
+        std::copy(candidate, candidate + length, code + 1);
+        long long total = 0;
+        for (size_t i = 0; i < order.size(); ++i) {
+            const size_t example = order[i];
+            int steps;
+            if (run(example, steps) != 0) {
+                std::swap(order[0], order[i]);
+                return -1;
+            }
+            total += steps;
+        }
+        return total;
+    }
+
+    // Output bits wrong over all examples, with every output of an example that faults or runs out of steps wrong;
+    // total steps in steps
+    long long cost(const MiniInstruction *candidate, long long &steps) {
+        std::copy(candidate, candidate + length, code + 1);
+        long long wrong = 0;
+        steps = 0;
+        for (size_t example = 0; example < stores.size(); ++example) {
+            int exampleSteps;
+            wrong += run(example, exampleSteps);
+            steps += exampleSteps;
+        }
+        return wrong;
+    }
+
+private:
+    const Target &target;
+    int maxSteps;
+    int length;
+    int outputStart;
+    MiniInstruction code[MINI_STORE_WORDS]{};
+    std::vector<std::array<uint32_t, MINI_STORE_WORDS>> stores;     // Initial store of each example
+    std::vector<size_t> order;
+
+    // Output bits wrong on one example
+    int run(size_t example, int &steps) {
+        std::array<uint32_t, MINI_STORE_WORDS> store = stores[example];
+        uint32_t acc = 0;
+        const std::vector<uint32_t> &expected = target.examples[example].outputs;
+        if (runMini(code, length + 2, store.data(), acc, maxSteps, steps) != MiniOutcome::Halted) {
+            return 32 * (int) expected.size();
+        }
+        int wrong = 0;
+        const size_t cells = target.outputNames.size();
+        for (size_t i = 0; i < cells; ++i) {
+            wrong += __builtin_popcount(store[outputStart + i] ^ expected[i]);
+        }
+        if (target.accumulator) {
+            wrong += __builtin_popcount(acc ^ expected[cells]);
+        }
+        return wrong;
+    }
+};
+
+// Keep a program if it beats what was found so far
+static void consider(SearchResult &result, const MiniInstruction *code, int length, long long steps) {
+    auto better = [&](const Candidate &best, bool byLength) {
+        if (best.steps < 0) {
+            return true;
+        }
+        if (byLength && length != (int) best.code.size()) {
+            return length < (int) best.code.size();
+        }
+        return steps < best.steps || (steps == best.steps && length < (int) best.code.size());
+    };
+    if (better(result.shortest, true)) {
+        result.shortest = {std::vector<MiniInstruction>(code, code + length), steps};
+    }
+    if (better(result.fastest, false)) {
+        result.fastest = {std::vector<MiniInstruction>(code, code + length), steps};
+    }
+}
+
+// Whether the store can hold the candidates of a length
+static bool fits(const Target &target, const SearchOptions &options, int length) {
+    return dataStart(length) + (int) (target.inputNames.size() + target.outputNames.size()) + options.temps <=
+           MINI_STORE_WORDS;
+}
+
+// Try every program up to maxLength instructions, shortest first, on all threads
+SearchResult enumerate(const Target &target, const SearchOptions &options) {
+    const auto start = std::chrono::steady_clock::now();
+    SearchResult result;
+    result.threads = threadCount(options);
+    std::atomic<uint64_t> tested{0};
+    std::mutex resultLock;
+    for (int length = 1; length <= options.maxLength && fits(target, options, length); ++length) {
+        const std::vector<MiniInstruction> alphabet = makeAlphabet(target, options, length);
+        const size_t letters = alphabet.size();
+        // Threads take the candidates starting with each instruction in turn
+        std::atomic<size_t> nextFirst{0};
+        auto work = [&]() {
+            Evaluator evaluator(target, options, length);
+            SearchResult found;
+            std::vector<size_t> digits((size_t) length);
+            std::vector<MiniInstruction> candidate((size_t) length);
+            uint64_t count = 0;
+            for (size_t first = nextFirst++; first < letters; first = nextFirst++) {
+                std::fill(digits.begin(), digits.end(), 0);
+                digits[0] = first;
+                while (true) {
+                    for (int i = 0; i < length; ++i) {
+                        candidate[i] = alphabet[digits[i]];
+                    }
+                    // A last STP repeats the one after the code; a last CMP could only skip it into the data
+                    const uint8_t last = candidate[length - 1].opcode;
+                    if (last != STP && last != CMP) {
+                        count++;
+                        long long steps = evaluator.test(candidate.data());
+                        if (steps >= 0) {
+                            consider(found, candidate.data(), length, steps);
+                        }
+                    }
+                    int position = length - 1;
+                    while (position > 0 && ++digits[position] == letters) {
+                        digits[position--] = 0;
+                    }
+                    if (position == 0) {
+                        break;
+                    }
+                }
+            }
+            tested += count;
+            std::lock_guard<std::mutex> lock(resultLock);
+            for (const Candidate *candidate: {&found.shortest, &found.fastest}) {
+                if (candidate->steps >= 0) {
+                    consider(result, candidate->code.data(), length, candidate->steps);
+                }
+            }
+        };
+        std::vector<std::thread> pool;
+        for (int i = 1; i < result.threads; ++i) {
+            pool.emplace_back(work);
+        }
+        work();
+        for (auto &thread: pool) {
+            thread.join();
+        }
+        if (result.shortest.steps >= 0 && !options.fastest) {
+            break;
+        }
+    }
+    result.tested = tested;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+// Random walks over programs of each length up to maxLength, one per thread
+SearchResult stochasticSearch(const Target &target, const SearchOptions &options) {
+    const auto start = std::chrono::steady_clock::now();
+    const auto deadline = start + std::chrono::duration<double>(options.seconds);
+    SearchResult result;
+    result.threads = threadCount(options);
+    std::atomic<uint64_t> tested{0};
+    std::mutex resultLock;
+    int lengths = 1;
+    while (lengths < options.maxLength && fits(target, options, lengths + 1)) {
+        lengths++;
+    }
+    if (!fits(target, options, lengths)) {
+        return result;
+    }
+    auto work = [&](int thread) {
+        std::mt19937 random(options.seed + (unsigned) thread);
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        SearchResult found;
+        uint64_t count = 0;
+        // Each walk restarts from a random program after a while, at the next length
+        for (int walk = thread; std::chrono::steady_clock::now() < deadline; walk += result.threads) {
+            const int length = 1 + walk % lengths;
+            const std::vector<MiniInstruction> alphabet = makeAlphabet(target, options, length);
+            Evaluator evaluator(target, options, length);
+            std::vector<MiniInstruction> current((size_t) length);
+            for (auto &instruction: current) {
+                instruction = alphabet[random() % alphabet.size()];
+            }
+            long long currentSteps;
+            long long currentCost = evaluator.cost(current.data(), currentSteps) * 16;
+            std::vector<MiniInstruction> proposal = current;
+            for (int move = 0; move < 20000; ++move) {
+                if ((move & 4095) == 0 && std::chrono::steady_clock::now() >= deadline) {
+                    break;
+                }
+                proposal = current;
+                if (length > 1 && random() % 4 == 0) {
+                    std::swap(proposal[random() % length], proposal[random() % length]);
+                } else {
+                    proposal[random() % length] = alphabet[random() % alphabet.size()];
+                }
+                long long steps;
+                const long long wrong = evaluator.cost(proposal.data(), steps);
+                count++;
+                // Wrong bits first; once right, fewer steps
+                const long long cost = wrong * 16 + (wrong == 0 ? steps / (long long) target.examples.size() : 0);
+                if (cost <= currentCost || uniform(random) < std::exp((double) (currentCost - cost) / 32.0)) {
+                    current.swap(proposal);
+                    currentCost = cost;
+                    if (wrong == 0) {
+                        consider(found, current.data(), length, steps);
+                    }
+                }
+            }
+        }
+        tested += count;
+        std::lock_guard<std::mutex> lock(resultLock);
+        for (const Candidate *candidate: {&found.shortest, &found.fastest}) {
+            if (candidate->steps >= 0) {
+                consider(result, candidate->code.data(), (int) candidate->code.size(), candidate->steps);
+            }
+        }
+    };
+    std::vector<std::thread> pool;
+    for (int i = 1; i < result.threads; ++i) {
+        pool.emplace_back(work, i);
+    }
+    work(0);
+    for (auto &thread: pool) {
+        thread.join();
+    }
+    result.tested = tested;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+// Assembly source of a candidate, with the target's cells as labelled VARs after the code
+std::string candidateSource(const Target &target, const SearchOptions &options, const Candidate &candidate) {
+    std::vector<std::string> names = target.inputNames;
+    names.insert(names.end(), target.outputNames.begin(), target.outputNames.end());
+    for (int i = 0; i < options.temps; ++i) {
+        names.push_back("TEMP" + std::to_string(i));
+    }
+    const int data = dataAddress(candidate, 0);
+    std::string source = "          VAR 0\n";
+    for (const MiniInstruction &ins: candidate.code) {
+        source += "          " + std::string(INSTRUCTIONS[ins.opcode].mnemonic);
+        if (ins.immediate) {
+            source += " #" + std::to_string(ins.operand);
+        } else if (ins.opcode != CMP && ins.opcode != STP && ins.opcode < LNT) {
+            source += " " + names[ins.operand - data];
+        }
+        source += "\n";
+    }
+    source += "          STP\n";
+    for (size_t i = 0; i < names.size(); ++i) {
+        uint32_t value = 0;
+        if (i < target.inputNames.size() && !target.examples.empty()) {
+            value = target.examples[0].inputs[i];
+        } else if (i >= target.inputNames.size() && i < target.inputNames.size() + target.outputNames.size()) {
+            value = target.initialOutputs[i - target.inputNames.size()];
+        }
+        std::string label = names[i] + ":";
+        label.resize(std::max<size_t>(label.size() + 1, 10), ' ');
+        source += label + "VAR " + std::to_string((int32_t) value) + "\n";
+    }
+    return source;
+}
+
+// Value of a store word
+static uint32_t wordValue(const std::bitset<SIZE_32_BIT> &word) {
+    return reverseWord((uint32_t) word.to_ulong());
+}
+
+// Run a reference program on random inputs to make the examples of a target.
+Target targetFromReference(const std::string &source, const std::vector<unsigned long> &inputs,
+                           const std::vector<unsigned long> &outputs, bool accumulator, int count, int32_t low,
+                           int32_t high, unsigned seed, int maxSteps) {
+    std::istringstream input(source);
+    std::vector<std::string> log;
+    std::vector<std::bitset<SIZE_32_BIT>> image;
+    for (const std::string &line: Assembler::processAssembleCode(SymbolTable(), input, log)) {
+        image.emplace_back(line);
+    }
+    for (unsigned long address: inputs) {
+        if (address >= image.size()) {
+            throw std::invalid_argument("input address " + std::to_string(address) + " is past the program");
+        }
+    }
+    Target target;
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        target.inputNames.push_back("IN" + std::to_string(i));
+    }
+    for (size_t i = 0; i < outputs.size(); ++i) {
+        if (outputs[i] >= image.size()) {
+            throw std::invalid_argument("output address " + std::to_string(outputs[i]) + " is past the program");
+        }
+        target.outputNames.push_back("OUT" + std::to_string(i));
+        target.initialOutputs.push_back(wordValue(image[outputs[i]]));
+    }
+    target.accumulator = accumulator;
+    ImageAnalysis analysis(image);
+    for (int address = 1; address < (int) std::min<size_t>(image.size(), SIZE_32_BIT); ++address) {
+        if (analysis.isCode(address) && ManchesterBaby::decodeInstruction(image[address]).opcode != STP) {
+            target.referenceLength++;
+        }
+    }
+
+    // Edge values first, then random ones
+    std::vector<int32_t> values = {0, 1, -1, low, high, low + 1, high - 1};
+    values.erase(std::remove_if(values.begin(), values.end(), [&](int32_t value) {
+        return value < low || value > high;
+    }), values.end());
+    std::mt19937 random(seed);
+    std::uniform_int_distribution<int32_t> distribution(low, high);
+    std::istringstream noProgram;
+    ManchesterBaby baby(noProgram);
+    for (int n = 0; (int) target.examples.size() < count && n < count * 4; ++n) {
+        Example example;
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            const size_t pick = (size_t) n * inputs.size() + i;
+            example.inputs.push_back((uint32_t) (pick < values.size() * inputs.size() && n < (int) values.size()
+                                                 ? values[n] : distribution(random)));
+        }
+        baby.memory.assign(SIZE_32_BIT, std::bitset<SIZE_32_BIT>());
+        baby.loadProgram(image);
+        baby.reset();
+        baby.setHalt(false);
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            baby.writeMemory(inputs[i], std::bitset<SIZE_32_BIT>(reverseWord(example.inputs[i])));
+        }
+        int steps;
+        try {
+            steps = baby.run(maxSteps);
+        } catch (const std::runtime_error &) {
+            continue;   // Divided by zero
+        }
+        if (!baby.isHalted()) {
+            continue;
+        }
+        for (unsigned long address: outputs) {
+            example.outputs.push_back(wordValue(baby.memory[address]));
+        }
+        if (accumulator) {
+            example.outputs.push_back(wordValue(baby.accumulator));
+        }
+        target.examples.push_back(example);
+        target.referenceSteps += steps;
+    }
+    return target;
+}
+
+// Read examples, one per line: the input values, "->", then the output values.
+Target targetFromExamples(std::istream &input, bool accumulator) {
+    Target target;
+    target.accumulator = accumulator;
+    std::string line;
+    size_t inputs = 0;
+    size_t outputs = 0;
+    while (getline(input, line)) {
+        if (line.empty() || line[0] == ';' || line.find_first_not_of(" \t\r") == std::string::npos) {
+            continue;
+        }
+        std::istringstream words(line);
+        Example example;
+        std::vector<uint32_t> *values = &example.inputs;
+        std::string word;
+        while (words >> word) {
+            if (word == "->") {
+                values = &example.outputs;
+                continue;
+            }
+            try {
+                values->push_back((uint32_t) std::stoll(word));
+            } catch (const std::logic_error &) {
+                throw std::invalid_argument("'" + word + "' is not a value");
+            }
+        }
+        if (target.examples.empty()) {
+            inputs = example.inputs.size();
+            outputs = example.outputs.size();
+            if (outputs == 0 || (accumulator && outputs < 1)) {
+                throw std::invalid_argument("an example has no outputs");
+            }
+        } else if (example.inputs.size() != inputs || example.outputs.size() != outputs) {
+            throw std::invalid_argument("every example needs the same number of inputs and outputs");
+        }
+        target.examples.push_back(example);
+    }
+    for (size_t i = 0; i < inputs; ++i) {
+        target.inputNames.push_back("IN" + std::to_string(i));
+    }
+    for (size_t i = 0; i + (accumulator ? 1 : 0) < outputs; ++i) {
+        target.outputNames.push_back("OUT" + std::to_string(i));
+        target.initialOutputs.push_back(0);
+    }
+    return target;
+}
@@ -0,0 +1,78 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "miniengine.h"
+
+// Input values of one test, and the outputs expected: the output cells, then the accumulator if it is an output
+struct Example {
+    std::vector<uint32_t> inputs;
+    std::vector<uint32_t> outputs;
+};
+
+// The behaviour a candidate must reproduce
+struct Target {
+    std::vector<std::string> inputNames;    // Labels of the input cells in the programs written out
+    std::vector<std::string> outputNames;   // Labels of the output cells
+    std::vector<uint32_t> initialOutputs;   // Values of the output cells before the program runs
+    bool accumulator{false};                // Whether the final accumulator is an output
+    std::vector<Example> examples;
+    long long referenceSteps{0};            // Steps the reference program takes over all examples, if there is one
+    int referenceLength{0};                 // Instructions of the reference program
+};
+
+// Run a reference program (assembly source) on count random inputs in [low, high], plus edge values, to make the
+// examples of a target. Inputs and outputs are store addresses. Inputs on which the reference doesn't halt within
+// maxSteps are left out. Throws std::invalid_argument if the source doesn't assemble.
+Target targetFromReference(const std::string &source, const std::vector<unsigned long> &inputs,
+                           const std::vector<unsigned long> &outputs, bool accumulator, int count, int32_t low,
+                           int32_t high, unsigned seed, int maxSteps);
+
+// Read examples, one per line: the input values, "->", then the output values. Throws std::invalid_argument on a
+// malformed line or on lines with different numbers of values.
+Target targetFromExamples(std::istream &input, bool accumulator);
+
+struct SearchOptions {
+    int maxLength{4};                       // Instructions, STP at the end not counted
+    int temps{1};                           // Scratch cells a candidate may use
+    int maxSteps{64};                       // Per example; candidates taking longer fail
+    int threads{0};                         // 0 for one per processor
+    bool classic{false};                    // Only the seven SSEM instructions, without immediate addressing
+    std::vector<uint16_t> constants{0, 1, 2};   // Immediate operands tried
+    double seconds{0};                      // Search stochastically for this long instead of enumerating
+    bool fastest{false};                    // Enumerate every length up to maxLength for the fewest steps
+    unsigned seed{1};
+};
+
+// A program found: its instructions (after the VAR 0 at address 0, before the final STP) and its steps over all
+// examples
+struct Candidate {
+    std::vector<MiniInstruction> code;
+    long long steps{-1};
+};
+
+struct SearchResult {
+    Candidate shortest;                     // Fewest instructions, then fewest steps
+    Candidate fastest;                      // Fewest steps
+    uint64_t tested{0};                     // Candidates run
+    double seconds{0};
+    int threads{1};
+};
+
+// Try every program up to maxLength instructions, shortest first, on all threads
+SearchResult enumerate(const Target &target, const SearchOptions &options);
+
+// Random walks over programs of each length up to maxLength, one per thread, guided by how many output bits are
+// wrong and then by steps
+SearchResult stochasticSearch(const Target &target, const SearchOptions &options);
+
+// Assembly source of a candidate, with the target's cells as labelled VARs after the code
+std::string candidateSource(const Target &target, const SearchOptions &options, const Candidate &candidate);
+
+// Address of input i (or output i, after the inputs) in a candidate's store
+int dataAddress(const Candidate &candidate, int cell);
+
+#endif //SEARCH_H
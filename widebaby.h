@@ -0,0 +1,305 @@
+#ifndef WIDEBABY_H
+#define WIDEBABY_H
+
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "clock.h"
+#include "isa.h"
+#include "word.h"
+
+// A Manchester Baby generic in its word width and instruction layout (see word.h), and in its store.
+//
+// BasicBaby runs the same instruction set with the same semantics as ManchesterBaby, on words of Layout::bits bits,
+// and keeps words as values rather than as stored bit patterns. It is a plain interpreter: ManchesterBaby remains
+// the 32-bit fast path, with fusion, loop acceleration, observers and the GUI. Use BasicBaby for wider arithmetic
+// (Layout64) and for address spaces larger than the 32-word store (SparseStore). CI wraps at the number of code
+// words given to the constructor, as it wraps at 32 on the Baby.
+//
+// Defined behaviour where ManchesterBaby has none: words never written read as 0, DIV and MOD by zero throw.
+//
+// A store provides read() and write(), and exchange() and fetchAdd() for XCH and XAD, which return the old word.
+// They are atomic only in a store shared between cores (see smp.h).
+
+// A store of consecutive words, growing as it is written
+template<class Layout>
+class DenseStore {
+public:
+    using Value = typename Layout::Value;
+
+    static constexpr uint64_t defaultCodeWords = 32;
+
+    [[nodiscard]] Value read(uint64_t address) const {
+        return address < words.size() ? words[address] : 0;
+    }
+
+    void write(uint64_t address, Value value) {
+        if (address >= words.size()) {
+            words.resize(address + 1);
+        }
+        words[address] = value;
+    }
+
+    Value exchange(uint64_t address, Value value) {
+        Value old = read(address);
+        write(address, value);
+        return old;
+    }
+
+    Value fetchAdd(uint64_t address, Value value) {
+        Value old = read(address);
+        write(address, (Value) (old + value));
+        return old;
+    }
+
+    // Words held
+    [[nodiscard]] uint64_t size() const {
+        return words.size();
+    }
+
+    void clear() {
+        words.clear();
+    }
+
+private:
+    std::vector<Value> words;
+};
+
+// A store for address spaces far larger than the program: the low addresses, where code and most data live, are
+// held densely and the rest only once written
+template<class Layout>
+class SparseStore {
+public:
+    using Value = typename Layout::Value;
+
+    static constexpr uint64_t defaultCodeWords = (uint64_t) 1 << Layout::operandBits;
+    static constexpr uint64_t denseWords = 4096;
+
+    [[nodiscard]] Value read(uint64_t address) const {
+        if (address < denseWords) {
+            return address < low.size() ? low[address] : 0;
+        }
+        auto word = high.find(address);
+        return word == high.end() ? 0 : word->second;
+    }
+
+    void write(uint64_t address, Value value) {
+        if (address < denseWords) {
+            if (address >= low.size()) {
+                low.resize(address + 1);
+            }
+            low[address] = value;
+        } else {
+            high[address] = value;
+        }
+    }
+
+    Value exchange(uint64_t address, Value value) {
+        Value old = read(address);
+        write(address, value);
+        return old;
+    }
+
+    Value fetchAdd(uint64_t address, Value value) {
+        Value old = read(address);
+        write(address, (Value) (old + value));
+        return old;
+    }
+
+    // Words held
+    [[nodiscard]] uint64_t size() const {
+        return low.size() + high.size();
+    }
+
+    void clear() {
+        low.clear();
+        high.clear();
+    }
+
+private:
+    std::vector<Value> low;
+    std::unordered_map<uint64_t, Value> high;
+};
+
+template<class Layout, class Store>
+class BasicBaby {
+public:
+    using Value = typename Layout::Value;
+
+    Store store;                    // Memory
+    Value accumulator{0};           // Accumulator
+    Value pi{0};                    // Present instruction
+    uint64_t ci{0};                 // The new Control instruction
+    uint64_t prevCi{0};             // The last Control instruction
+    int opcode{0};                  // current opcode
+    Value operand{0};               // current operand
+    bool immediate{false};          // if current addressing mode is immediate
+    long long round{0};             // Current Round
+    VirtualClock clock;             // Simulated elapsed time
+
+    explicit BasicBaby(uint64_t codeWords = Store::defaultCodeWords) : codeWords(codeWords) {}
+
+    // Load machine code, one line of Layout::bits digits per word, least significant bit first
+    void loadProgram(std::istream &input) {
+        std::string line;
+        uint64_t address = 0;
+        while (getline(input, line)) {
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            if (line.size() != (size_t) Layout::bits) {
+                std::cerr << "Error: line " << address + 1 << " in file does not have a valid number of bits."
+                          << std::endl;
+                throw std::runtime_error("Invalid line length in program file.");
+            }
+            Value value = 0;
+            for (int i = 0; i < Layout::bits; ++i) {
+                if (line[i] == '1') {
+                    value |= (Value) 1 << i;
+                }
+            }
+            store.write(address++, value);
+        }
+    }
+
+    // Fetch, decode and execute one instruction, then move CI on.
+    void step() {
+        static_assert(INSTRUCTIONS.size() == 19, "step() has a case for every instruction of isa.h: add the new one");
+        pi = store.read(ci);
+        int field = (int) ((pi & Layout::opcodeMask) >> Layout::opcodeShift);
+        opcode = field == 5 ? 4 : field;
+        operand = pi & Layout::operandMask;
+        if (takesImmediate(opcode)) {
+            immediate = (pi & Layout::immediateMask) != 0;
+        }
+        auto source = [&]() {
+            return immediate ? operand : store.read(operand);
+        };
+        switch (opcode) {
+            case 0:     // JMP
+                ci = source();
+                break;
+            case 1:     // JRP
+                ci = (Value) (ci + source());
+                break;
+            case 2:     // LDN
+                accumulator = (Value) (0 - source());
+                break;
+            case 3:     // STO
+                store.write(operand, accumulator);
+                break;
+            case 4:     // SUB
+                accumulator = (Value) (accumulator - source());
+                break;
+            case 6:     // CMP
+                if (accumulator & Layout::signMask) {
+                    ci++;
+                }
+                break;
+            case 7:     // STP
+                halted = true;
+                break;
+            case 8:     // LDP
+                accumulator = source();
+                break;
+            case 9:     // ADD
+                accumulator = (Value) (accumulator + source());
+                break;
+            case 10:    // DIV
+                accumulator = accumulator / divisor(source());
+                break;
+            case 11:    // MOD
+                accumulator = accumulator % divisor(source());
+                break;
+            case 12:    // LAN
+                accumulator &= store.read(operand);
+                break;
+            case 13:    // LOR
+                accumulator |= store.read(operand);
+                break;
+            case 14:    // LNT
+                accumulator = (Value) ~accumulator;
+                break;
+            case 15:    // SHL: the stored bits move up, so the value halves
+                accumulator >>= 1;
+                break;
+            case 16:    // SHR
+                accumulator = (Value) (accumulator << 1);
+                break;
+            case 17:    // XCH
+                accumulator = store.exchange(operand, accumulator);
+                break;
+            case 18:    // XAD
+                accumulator = store.fetchAdd(operand, accumulator);
+                break;
+            default:
+                halted = true;
+                illegalOpcode = true;
+                break;
+        }
+        clock.tick(opcode);
+        round++;
+
+        prevCi = ci;
+        ci = (ci + 1) % codeWords;
+    }
+
+    // Run until halted or until maxSteps instructions have been executed. Returns the number executed.
+    long long run(long long maxSteps) {
+        long long steps = 0;
+        while (!halted && steps < maxSteps) {
+            step();
+            steps++;
+        }
+        return steps;
+    }
+
+    // Check the operational state.
+    [[nodiscard]] bool isHalted() const {
+        return halted;
+    }
+
+    // Whether the machine halted on an unknown opcode
+    [[nodiscard]] bool haltedOnIllegalOpcode() const {
+        return illegalOpcode;
+    }
+
+    // Back to the state before the first instruction; the store is kept
+    void reset() {
+        accumulator = 0;
+        pi = 0;
+        ci = 0;
+        prevCi = 0;
+        opcode = 0;
+        operand = 0;
+        immediate = false;
+        round = 0;
+        halted = false;
+        illegalOpcode = false;
+        clock.reset();
+    }
+
+private:
+    uint64_t codeWords;
+    bool halted{false};
+    bool illegalOpcode{false};
+
+    static Value divisor(Value value) {
+        if (value == 0) {
+            throw std::runtime_error("Division by zero.");
+        }
+        return value;
+    }
+};
+
+// The Baby's own word, in a plain 32-word store
+using Baby32 = BasicBaby<Layout32, DenseStore<Layout32>>;
+
+// 64-bit words over a sparse 40-bit address space
+using WideBaby = BasicBaby<Layout64, SparseStore<Layout64>>;
+
+#endif //WIDEBABY_H
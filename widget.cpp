@@ -37,12 +37,15 @@ void Widget::run() {
 void Widget::execute() {
     if (!baby->isHalted()) {
         // Fetch, Decode and Execute
+        uint64_t cyclesBefore = baby->clock.cycles();
         baby->fetch();
         baby->decodeAndExecute();
         baby->increment_ci();
+        uint64_t cycles = baby->clock.cycles() - cyclesBefore;
 
         // Update GUI information panel
         round->setText(QString::fromStdString(std::to_string(baby->curRound)));
+        simulatedTime->setText(QString::number(baby->clock.elapsedSeconds() * 1000, 'f', 1) + " ms");
         prev_ci->setText(QString::fromStdString(std::to_string(baby->prev_ci)));
         pi->setText(QString::fromStdString(baby->pi.to_string()));
         ci->setText(QString::fromStdString(std::to_string(baby->ci)));
@@ -53,106 +56,14 @@ void Widget::execute() {
         accumulator->setText(QString::fromStdString(baby->accumulator.to_string()));
         accumulatorDec->setText(QString::fromStdString(
                 std::to_string(ManchesterBaby::binToDec(ManchesterBaby::convertInstruction(baby->accumulator)))));
-        QString expString;  // For Explanation
-        switch (baby->curOpCode) {
-            case 0:
-                expString = "JMP: CI = ";
-                if (baby->curImAddressing) {
-                    expString.append("OPERAND");
-                } else {
-                    expString.append("S");
-                }
-                break;
-            case 1:
-                expString = "JRP: CI += ";
-                if (baby->curImAddressing) {
-                    expString.append("OPERAND");
-                } else {
-                    expString.append("S");
-                }
-                break;
-            case 2:
-                expString = "LDN: A = -";
-                if (baby->curImAddressing) {
-                    expString.append("OPERAND");
-                } else {
-                    expString.append("S");
-                }
-                break;
-            case 3:
-                expString = "STO: S = A";
-                break;
-            case 4:
-                expString = "SUB: A -= ";
-                if (baby->curImAddressing) {
-                    expString.append("OPERAND");
-                } else {
-                    expString.append("S");
-                }
-                break;
-            case 6:
-                expString = "CMP: CI += 1 if A < 0";
-                break;
-            case 7:
-                expString = "STOP";
-                break;
-            case 8:
-                expString = "LDP: A = ";
-                if (baby->curImAddressing) {
-                    expString.append("OPERAND");
-                } else {
-                    expString.append("S");
-                }
-                break;
-            case 9:
-                expString = "ADD: A += ";
-                if (baby->curImAddressing) {
-                    expString.append("OPERAND");
-                } else {
-                    expString.append("S");
-                }
-                break;
-            case 10:
-                expString = "DIV: A /= ";
-                if (baby->curImAddressing) {
-                    expString.append("OPERAND");
-                } else {
-                    expString.append("S");
-                }
-                break;
-            case 11:
-                expString = "MOD: A %= ";
-                if (baby->curImAddressing) {
-                    expString.append("OPERAND");
-                } else {
-                    expString.append("S");
-                }
-                break;
-            case 12:
-                expString = "LAN: A = A & S";
-                break;
-            case 13:
-                expString = "LOR: A = A | S";
-                break;
-            case 14:
-                expString = "LNT: A = ~A";
-                break;
-            case 15:
-                expString = "SHL: A <<= 1";
-                break;
-            case 16:
-                expString = "SHR: A >>= 1";
-                break;
-            default:
-                expString = "Invalid OPCODE!";
-                break;
-        }
-
+        // For Explanation, from the instruction table (see isa.h)
+        QString expString = QString::fromStdString(explainInstruction(baby->curOpCode, baby->curImAddressing));
         explanation->setText(expString);
         loadMachineCode();
 
-        // Wait for a while
-        QTimer::singleShot(1000, this, SLOT(execute()));
+        // Wait as long as the instruction takes on the virtual clock, slowed down to be followed
+        auto delay = std::chrono::duration_cast<std::chrono::milliseconds>(pacing.wallTime(cycles, baby->clock.table()));
+        QTimer::singleShot((int) delay.count(), this, SLOT(execute()));
     } else {
         baby->reset();
     }
@@ -183,6 +94,7 @@ Widget::Widget(ManchesterBaby *baby, QWidget *parent)
     loadButton = new QPushButton("Reload MC");
     runButton = new QPushButton("Run");
     stopButton = new QPushButton("Stop");
+    assemblyProgress = new QProgressBar();
 
     // Window Frame
     mainWindow.setCentralWidget(splitter);
@@ -197,6 +109,11 @@ Widget::Widget(ManchesterBaby *baby, QWidget *parent)
     rightWidget->setLayout(rightLayout);
     splitter->addWidget(rightWidget);
     rightLayout->addLayout(buttonLayout);
+    assemblyProgress->setRange(0, 0);   // Busy: the assembler doesn't report how far it has got
+    assemblyProgress->setFormat("Assembling assemble.txt...");
+    assemblyProgress->setTextVisible(true);
+    assemblyProgress->hide();
+    rightLayout->addWidget(assemblyProgress);
     buttonLayout->addWidget(loadButton);
     buttonLayout->addWidget(runButton);
     buttonLayout->addWidget(stopButton);
@@ -213,7 +130,7 @@ Widget::Widget(ManchesterBaby *baby, QWidget *parent)
     // Information Panel display setting
     QStringList infoLabels = {"Round", "CI", "PI", "New CI", "OPCODE", "OPERAND", "Address Mode", "Accumulator",
                               "Accumulator (DEC)",
-                              "Explanation"};
+                              "Explanation", "Simulated Time"};
 
     // Round
     roundTitle = new QLabel(infoLabels[0] + ":");
@@ -268,10 +185,44 @@ Widget::Widget(ManchesterBaby *baby, QWidget *parent)
     explanation = new QLabel(expString);
     infoLayout->addRow(explanationTitle, explanation);
 
+    // Simulated Time
+    simulatedTimeTitle = new QLabel(infoLabels[10] + ":");
+    simulatedTime = new QLabel("0.0 ms");
+    infoLayout->addRow(simulatedTimeTitle, simulatedTime);
+
     // Load the Machine Code
     loadMachineCode();
 }
 
+// Show the progress indicator and hold the buttons back while the program is assembled in the background
+void Widget::setAssembling() {
+    loadButton->setEnabled(false);
+    runButton->setEnabled(false);
+    assemblyProgress->show();
+}
+
+// Called once output.txt is ready, from the cache or from the assembler.
+// Loads it into the Baby and enables the buttons.
+void Widget::programReady(bool assembled) {
+    assemblyProgress->hide();
+    if (!assembled) {
+        std::cerr << "Assembly failed, see log.txt; loading the previous output.txt" << std::endl;
+    }
+    try {
+        baby->loadProgram("output.txt");
+        baby->reset();
+        loadButton->setEnabled(true);
+        runButton->setEnabled(true);
+    } catch (const std::runtime_error &e) {
+        std::cerr << "An error occurred: " << e.what() << std::endl;
+        assemblyProgress->setRange(0, 1);
+        assemblyProgress->setFormat("No program: see log.txt");
+        assemblyProgress->show();
+    }
+    loadMachineCode();
+    emit programLoaded();
+}
+
 // Destructor
 Widget::~Widget()
 = default;
@@ -13,6 +13,7 @@
 #include <QSplitter>
 #include <QFormLayout>
 #include <QTimer>
+#include <QProgressBar>
 
 #include "baby.h"
 
@@ -37,6 +38,7 @@ public:
     QPushButton *loadButton;
     QPushButton *runButton;
     QPushButton *stopButton;
+    QProgressBar *assemblyProgress;     // Shown while the program is being assembled
     QScrollArea *scrollArea;
     QFormLayout *infoLayout;
     QWidget *infoWidget;
@@ -51,6 +53,7 @@ public:
     QLabel *explanationTitle{};
     QLabel *accumulatorTitle{};
     QLabel *accumulatorDecTitle{};
+    QLabel *simulatedTimeTitle{};
 
     QLabel *round{};
     QLabel *prev_ci{};
@@ -62,6 +65,7 @@ public:
     QLabel *explanation{};
     QLabel *accumulator{};
     QLabel *accumulatorDec{};
+    QLabel *simulatedTime{};
 
     /* End of GUI Components */
 
@@ -82,8 +86,24 @@ public slots:
     // Terminates the MC execution progress, but not the program, unlike the console mode.
     void stop();
 
+    // Called once output.txt is ready, from the cache or from the assembler (assembled tells whether it succeeded).
+    // Loads it into the Baby and enables the buttons.
+    void programReady(bool assembled);
+
+public:
+    // Show the progress indicator and hold the buttons back while the program is assembled in the background
+    void setAssembling();
+
+signals:
+
+    // The program has been loaded, or could not be
+    void programLoaded();
+
 private:
     bool running{false};    // Flag to indicate whether the baby is running or not
+
+    // Speed of execution: the original machine slowed down to one instruction a second, so it can be followed
+    PacingPolicy pacing{PacingPolicy::scaled(0.0012)};
 };
 
 #endif // WIDGET_H
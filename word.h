@@ -0,0 +1,61 @@
+#ifndef WORD_H
+#define WORD_H
+
+#include <cstdint>
+#include <type_traits>
+
+// Word width and instruction field layout, with every mask computed at compile time.
+//
+// Fields are given as bit positions in the value of a word (most significant bit first, as an assembler writes it).
+// Words are stored, and written in machine code files, least significant bit first, so the "stored" masks are the
+// value masks reversed across the word: they apply to std::bitset<bits>::to_ulong() of a stored word.
+template<int WordBits, int OperandBits, int OpcodeShift, int ImmediateBit>
+struct WordLayout {
+    static_assert(WordBits == 32 || WordBits == 64, "words are 32 or 64 bits wide");
+    static_assert(OperandBits > 0 && OperandBits <= OpcodeShift && OpcodeShift + 5 <= ImmediateBit &&
+                  ImmediateBit < WordBits, "operand, opcode and immediate bit must not overlap");
+
+    using Value = std::conditional_t<WordBits == 32, uint32_t, uint64_t>;
+
+    static constexpr int bits = WordBits;
+    static constexpr int operandBits = OperandBits;
+    static constexpr int opcodeBits = 5;
+    static constexpr int opcodeShift = OpcodeShift;
+    static constexpr int immediateBit = ImmediateBit;
+
+    static constexpr Value wordMask = ~(Value) 0;
+    static constexpr Value signMask = (Value) 1 << (WordBits - 1);
+    static constexpr Value operandMask = ((Value) 1 << OperandBits) - 1;
+    static constexpr Value opcodeMask = (((Value) 1 << opcodeBits) - 1) << OpcodeShift;
+    static constexpr Value immediateMask = (Value) 1 << ImmediateBit;
+
+    // Reverse a value across the word
+    static constexpr Value reverse(Value value) {
+        Value reversed = 0;
+        for (int i = 0; i < WordBits; ++i) {
+            reversed = (Value) ((reversed << 1) | ((value >> i) & 1U));
+        }
+        return reversed;
+    }
+
+    static constexpr Value storedOperandMask = reverse(operandMask);
+    static constexpr Value storedOpcodeMask = reverse(opcodeMask);
+    static constexpr Value storedImmediateMask = reverse(immediateMask);
+    static constexpr int storedOperandShift = WordBits - OperandBits;
+    static constexpr int storedOpcodeShift = WordBits - OpcodeShift - opcodeBits;
+    static constexpr int storedImmediateShift = WordBits - 1 - ImmediateBit;
+};
+
+// The Baby's 32-bit word: a 13-bit operand, the opcode in bits 13-17 and the immediate addressing bit 30
+using Layout32 = WordLayout<32, 13, 13, 30>;
+
+// A 64-bit word with a 40-bit operand, for wider arithmetic and large (sparse) stores
+using Layout64 = WordLayout<64, 40, 40, 62>;
+
+static_assert(Layout32::storedOperandMask == ((1UL << 13) - 1) << 19, "operand is stored in bits 19-31");
+static_assert(Layout32::storedOpcodeMask == 31UL << 14, "opcode is stored in bits 14-18");
+static_assert(Layout32::storedImmediateMask == 1UL << 1, "immediate addressing is stored in bit 1");
+static_assert(Layout32::storedOperandShift == 19 && Layout32::storedOpcodeShift == 14 &&
+              Layout32::storedImmediateShift == 1, "stored shifts");
+
+#endif //WORD_H